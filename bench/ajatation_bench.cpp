@@ -0,0 +1,425 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Throughput of the CPU bound code on the capture and playback paths. Each benchmark reports bytes and
+// items (audio samples, or lookups) per second, so a JSON run can be kept as a baseline and compared
+// against after a kernel is rewritten, e.g. with Google Benchmark's tools/compare.py.
+
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "AudioKernels.h"
+#include "AudioResampler.h"
+#include "AudioTransform.h"
+#include "LoudnessAnalyser.h"
+#include "typemap.h"
+
+using namespace streampunk::Aja;
+
+namespace
+{
+
+const uint32_t CARD_CHANNELS = 16;
+
+// Samples per frame the card delivers at each supported frame rate: 23.98 and 29.97 (which alternate
+// 1601/1602 and 800/801 at 59.94), 24, 25, 30, 50 and 60
+const int64_t frameSampleCounts[] = { 2002, 2000, 1920, 1602, 1600, 960, 801, 800 };
+
+const int64_t clientChannelCounts[] = { 1, 2, 4, 6, 8, 16 };
+
+
+std::vector<uint32_t> ClientChannelMap(uint32_t numChannels)
+{
+    std::vector<uint32_t> channelMap(numChannels);
+
+    for (uint32_t channel = 0; channel < numChannels; channel++)
+        channelMap[channel] = channel;
+
+    return channelMap;
+}
+
+
+// Card words with random audio in the top 24 bits, as the card delivers them
+std::vector<uint32_t> RandomCardAudio(uint32_t numSamples)
+{
+    std::mt19937 rng(12345);
+    std::vector<uint32_t> audio(numSamples * CARD_CHANNELS);
+
+    for (auto& word : audio)
+        word = rng() & 0xFFFFFF00;
+
+    return audio;
+}
+
+
+std::vector<float> RandomFloatAudio(uint32_t numValues)
+{
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> level(-0.5f, 0.5f);
+    std::vector<float> audio(numValues);
+
+    for (auto& value : audio)
+        value = level(rng);
+
+    return audio;
+}
+
+
+// Unsupported instruction sets are reported as skipped rather than silently measuring the fallback
+bool SelectIsa(benchmark::State& state, int64_t isa)
+{
+    if (!IsAudioKernelIsaSupported(static_cast<AudioKernelIsa>(isa)))
+    {
+        state.SkipWithError("Instruction set not supported on this host");
+        return false;
+    }
+
+    state.SetLabel(AudioKernelIsaName(static_cast<AudioKernelIsa>(isa)));
+
+    return true;
+}
+
+
+void SamplesChannelsIsaArgs(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames({ "samples", "channels", "isa" });
+
+    for (auto numSamples : frameSampleCounts)
+        for (auto numChannels : clientChannelCounts)
+            for (int64_t isa = AudioKernelIsa_Scalar; isa < AudioKernelIsa_LAST; isa++)
+                b->Args({ numSamples, numChannels, isa });
+}
+
+
+void SampleTypeIsaArgs(benchmark::internal::Benchmark* b)
+{
+    const int64_t sampleTypes[] = {
+        AudioSampleType_S16, AudioSampleType_S24, AudioSampleType_S32, AudioSampleType_F32,
+        AudioSampleType_S16 | AudioSampleType_Planar, AudioSampleType_S24 | AudioSampleType_Planar,
+        AudioSampleType_S32 | AudioSampleType_Planar, AudioSampleType_F32 | AudioSampleType_Planar
+    };
+
+    b->ArgNames({ "type", "isa" });
+
+    for (auto sampleType : sampleTypes)
+        for (int64_t isa = AudioKernelIsa_Scalar; isa < AudioKernelIsa_LAST; isa++)
+            b->Args({ sampleType, isa });
+}
+
+
+void ChannelsIsaArgs(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames({ "channels", "isa" });
+
+    for (auto numChannels : clientChannelCounts)
+        for (int64_t isa = AudioKernelIsa_Scalar; isa < AudioKernelIsa_LAST; isa++)
+            b->Args({ numChannels, isa });
+}
+
+
+void IsaArgs(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames({ "isa" });
+
+    for (int64_t isa = AudioKernelIsa_Scalar; isa < AudioKernelIsa_LAST; isa++)
+        b->Args({ isa });
+}
+
+
+// A stand in for the AJA enum maps in gen2ajaTypeMaps, which need the SDK headers: the same
+// TypeMap<int, enum> shape, and the same number of entries as the display mode map
+enum BenchEnum
+{
+    BenchEnum_First = 0,
+    BenchEnum_Invalid = 1000
+};
+
+const int TYPE_MAP_ENTRIES = 41;
+
+TypeMap<int, BenchEnum>::Entry typeMapEntries[TYPE_MAP_ENTRIES] = {
+    { 0, BenchEnum(0) },   { 1, BenchEnum(1) },   { 2, BenchEnum(2) },   { 3, BenchEnum(3) },   { 4, BenchEnum(4) },
+    { 5, BenchEnum(5) },   { 6, BenchEnum(6) },   { 7, BenchEnum(7) },   { 8, BenchEnum(8) },   { 9, BenchEnum(9) },
+    { 10, BenchEnum(10) }, { 11, BenchEnum(11) }, { 12, BenchEnum(12) }, { 13, BenchEnum(13) }, { 14, BenchEnum(14) },
+    { 15, BenchEnum(15) }, { 16, BenchEnum(16) }, { 17, BenchEnum(17) }, { 18, BenchEnum(18) }, { 19, BenchEnum(19) },
+    { 20, BenchEnum(20) }, { 21, BenchEnum(21) }, { 22, BenchEnum(22) }, { 23, BenchEnum(23) }, { 24, BenchEnum(24) },
+    { 25, BenchEnum(25) }, { 26, BenchEnum(26) }, { 27, BenchEnum(27) }, { 28, BenchEnum(28) }, { 29, BenchEnum(29) },
+    { 30, BenchEnum(30) }, { 31, BenchEnum(31) }, { 32, BenchEnum(32) }, { 33, BenchEnum(33) }, { 34, BenchEnum(34) },
+    { 35, BenchEnum(35) }, { 36, BenchEnum(36) }, { 37, BenchEnum(37) }, { 38, BenchEnum(38) }, { 39, BenchEnum(39) },
+    { 40, BenchEnum(40) }
+};
+
+TypeMap<int, BenchEnum> benchTypeMap(typeMapEntries, -1, BenchEnum_Invalid);
+
+}
+
+
+// Capture: 16 card channels to S24 client audio, one frame at a time
+void BM_TransformFromCard(benchmark::State& state)
+{
+    const uint32_t numSamples = static_cast<uint32_t>(state.range(0));
+    const uint32_t numChannels = static_cast<uint32_t>(state.range(1));
+
+    if (!SelectIsa(state, state.range(2)))
+        return;
+
+    AudioTransform transform;
+    transform.SetFromCardChannelMap(CARD_CHANNELS, ClientChannelMap(numChannels));
+    transform.SetKernelIsa(static_cast<AudioKernelIsa>(state.range(2)));
+
+    const std::vector<uint32_t> input(RandomCardAudio(numSamples));
+    const uint32_t inputSize = static_cast<uint32_t>(input.size() * sizeof(uint32_t));
+    std::vector<char> output(transform.GetFromCardOutputSize(inputSize));
+
+    for (auto _ : state)
+    {
+        uint32_t written = transform.TransformFromCard(reinterpret_cast<const char*>(input.data()), inputSize, output.data(), static_cast<uint32_t>(output.size()));
+        benchmark::DoNotOptimize(written);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * inputSize);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * numSamples);
+}
+BENCHMARK(BM_TransformFromCard)->Apply(SamplesChannelsIsaArgs);
+
+
+// Capture: each client sample format, stereo, at the 29.97 frame size
+void BM_TransformFromCardSampleType(benchmark::State& state)
+{
+    const uint32_t numSamples = 1602;
+
+    if (!SelectIsa(state, state.range(1)))
+        return;
+
+    AudioTransform transform;
+    transform.SetFromCardFormat(CARD_CHANNELS, ClientChannelMap(2), static_cast<uint32_t>(state.range(0)));
+    transform.SetKernelIsa(static_cast<AudioKernelIsa>(state.range(1)));
+
+    const std::vector<uint32_t> input(RandomCardAudio(numSamples));
+    const uint32_t inputSize = static_cast<uint32_t>(input.size() * sizeof(uint32_t));
+    std::vector<char> output(transform.GetFromCardOutputSize(inputSize));
+
+    for (auto _ : state)
+    {
+        uint32_t written = transform.TransformFromCard(reinterpret_cast<const char*>(input.data()), inputSize, output.data(), static_cast<uint32_t>(output.size()));
+        benchmark::DoNotOptimize(written);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * inputSize);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * numSamples);
+}
+BENCHMARK(BM_TransformFromCardSampleType)->Apply(SampleTypeIsaArgs);
+
+
+// Playback: S24 client audio to 16 card channels, one frame at a time
+void BM_TransformToCard(benchmark::State& state)
+{
+    const uint32_t numSamples = static_cast<uint32_t>(state.range(0));
+    const uint32_t numChannels = static_cast<uint32_t>(state.range(1));
+
+    if (!SelectIsa(state, state.range(2)))
+        return;
+
+    AudioTransform transform;
+    transform.SetToCardChannelMap(CARD_CHANNELS, ClientChannelMap(numChannels));
+    transform.SetKernelIsa(static_cast<AudioKernelIsa>(state.range(2)));
+
+    std::mt19937 rng(12345);
+    std::vector<char> input(numSamples * numChannels * 3);
+    for (auto& byte : input)
+        byte = static_cast<char>(rng());
+
+    const uint32_t inputSize = static_cast<uint32_t>(input.size());
+    std::vector<char> output(transform.GetToCardOutputSize(inputSize));
+
+    for (auto _ : state)
+    {
+        uint32_t written = transform.TransformToCard(input.data(), inputSize, output.data(), static_cast<uint32_t>(output.size()));
+        benchmark::DoNotOptimize(written);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * inputSize);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * numSamples);
+}
+BENCHMARK(BM_TransformToCard)->Apply(SamplesChannelsIsaArgs);
+
+
+// Capture at 96kHz: a 29.97 frame of card audio, upsampled on the way out
+void BM_TransformFromCard96k(benchmark::State& state)
+{
+    const uint32_t numSamples = 1602;
+    const uint32_t numChannels = static_cast<uint32_t>(state.range(0));
+
+    if (!SelectIsa(state, state.range(1)))
+        return;
+
+    AudioTransform transform;
+    transform.SetFromCardChannelMap(CARD_CHANNELS, ClientChannelMap(numChannels));
+    transform.SetFromCardSampleRate(AudioTransform::HIGH_SAMPLE_RATE);
+    transform.SetKernelIsa(static_cast<AudioKernelIsa>(state.range(1)));
+
+    const std::vector<uint32_t> input(RandomCardAudio(numSamples));
+    const uint32_t inputSize = static_cast<uint32_t>(input.size() * sizeof(uint32_t));
+    std::vector<char> output(transform.GetFromCardOutputSize(inputSize));
+
+    for (auto _ : state)
+    {
+        uint32_t written = transform.TransformFromCard(reinterpret_cast<const char*>(input.data()), inputSize, output.data(), static_cast<uint32_t>(output.size()));
+        benchmark::DoNotOptimize(written);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * inputSize);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * numSamples);
+}
+BENCHMARK(BM_TransformFromCard96k)->Apply(ChannelsIsaArgs);
+
+
+// Playback at 96kHz: a 29.97 frame's worth of client audio, downsampled on the way in
+void BM_TransformToCard96k(benchmark::State& state)
+{
+    const uint32_t numSamples = 1602 * 2;
+    const uint32_t numChannels = static_cast<uint32_t>(state.range(0));
+
+    if (!SelectIsa(state, state.range(1)))
+        return;
+
+    AudioTransform transform;
+    transform.SetToCardChannelMap(CARD_CHANNELS, ClientChannelMap(numChannels));
+    transform.SetToCardSampleRate(AudioTransform::HIGH_SAMPLE_RATE);
+    transform.SetKernelIsa(static_cast<AudioKernelIsa>(state.range(1)));
+
+    std::mt19937 rng(12345);
+    std::vector<char> input(numSamples * numChannels * 3);
+    for (auto& byte : input)
+        byte = static_cast<char>(rng());
+
+    const uint32_t inputSize = static_cast<uint32_t>(input.size());
+    std::vector<char> output(transform.GetToCardOutputSize(inputSize));
+
+    for (auto _ : state)
+    {
+        uint32_t written = transform.TransformToCard(input.data(), inputSize, output.data(), static_cast<uint32_t>(output.size()));
+        benchmark::DoNotOptimize(written);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * inputSize);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * numSamples);
+}
+BENCHMARK(BM_TransformToCard96k)->Apply(ChannelsIsaArgs);
+
+
+// The per frame level meter on the capture thread, over all 16 card channels
+void BM_MeasureAudioLevels(benchmark::State& state)
+{
+    const uint32_t numSamples = 1602;
+
+    if (!SelectIsa(state, state.range(0)))
+        return;
+
+    const std::vector<uint32_t> input(RandomCardAudio(numSamples));
+    AudioLevels levels;
+
+    for (auto _ : state)
+    {
+        MeasureAudioLevels(reinterpret_cast<const uint8_t*>(input.data()), CARD_CHANNELS, numSamples, static_cast<AudioKernelIsa>(state.range(0)), levels);
+        benchmark::DoNotOptimize(levels);
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * input.size() * sizeof(uint32_t));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * numSamples);
+}
+BENCHMARK(BM_MeasureAudioLevels)->Apply(IsaArgs);
+
+
+// One channel of the resampler's FIR branch, over a frame of 96kHz output
+void BM_FilterFir(benchmark::State& state)
+{
+    const uint32_t numOutputs = 1602;
+
+    if (!SelectIsa(state, state.range(0)))
+        return;
+
+    const std::vector<float> input(RandomFloatAudio(numOutputs + AudioResampler::BRANCH_TAPS - 1));
+    const std::vector<float> coeffs(RandomFloatAudio(AudioResampler::BRANCH_TAPS));
+    std::vector<float> output(numOutputs);
+
+    for (auto _ : state)
+    {
+        FilterFir(input.data(), coeffs.data(), AudioResampler::BRANCH_TAPS, numOutputs, output.data(), static_cast<AudioKernelIsa>(state.range(0)));
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * numOutputs);
+}
+BENCHMARK(BM_FilterFir)->Apply(IsaArgs);
+
+
+// The loudness meter's worker, on a frame of 5.1
+void BM_LoudnessAnalyser(benchmark::State& state)
+{
+    const uint32_t numSamples = 1602;
+    const std::vector<double> weights = { 1.0, 1.0, 1.0, 0.0, 1.41, 1.41 };
+
+    LoudnessAnalyser analyser;
+    analyser.Configure(weights);
+
+    const std::vector<float> input(RandomFloatAudio(numSamples * static_cast<uint32_t>(weights.size())));
+
+    for (auto _ : state)
+    {
+        analyser.AddSamples(input.data(), numSamples);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * numSamples);
+}
+BENCHMARK(BM_LoudnessAnalyser);
+
+
+void BM_TypeMapToB(benchmark::State& state)
+{
+    int key = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(benchTypeMap.ToB(key));
+        key = (key + 7) % TYPE_MAP_ENTRIES;
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_TypeMapToB);
+
+
+void BM_TypeMapToA(benchmark::State& state)
+{
+    int value = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(benchTypeMap.ToA(static_cast<BenchEnum>(value)));
+        value = (value + 7) % TYPE_MAP_ENTRIES;
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_TypeMapToA);
+
+
+BENCHMARK_MAIN();
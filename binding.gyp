@@ -34,7 +34,18 @@
             "src/gen2ajaTypeMaps.cpp",
             "src/AjaDevice.cpp",
             "src/ntv2sharedcard.cpp",
-            "src/BufferStatus.cpp"
+            "src/BufferStatus.cpp",
+            "src/AudioKernels.cpp",
+            "src/AudioResampler.cpp",
+            "src/LoudnessAnalyser.cpp",
+            "src/LoudnessMeter.cpp",
+            "src/VideoBufferPool.cpp",
+            "src/EssenceWriter.cpp",
+            "src/TimeshiftRing.cpp",
+            "src/LatencyStats.cpp",
+            "src/AncPackets.cpp",
+            "src/DriverCallStats.cpp",
+            "src/ThreadPolicy.cpp"
 		],
         "configurations": {
           "Release": {
@@ -27,21 +27,42 @@ const EventEmitter = require('events');
 // var SegfaultHandler = require('../node-segfault-handler');
 // SegfaultHandler.registerHandler("crash.log");
 
-function Capture (deviceIndex, channelNumber, displayMode, pixelFormat) {
+// options is optional: { hostBuffers, deviceBuffers } sets the depth, in frames, of the host ring buffer and of the
+// buffering on the card. Shallow buffers (2 or 3) keep latency down for monitoring, deep ones (30 or more) ride out
+// longer stalls when recording. hugePages: true puts the video buffers on large pages, where the OS allows it.
+// anc: true captures ancillary data, parsed natively into each frame's info.anc, or give an array of [did, sdid]
+// pairs to keep just those packets - e.g. [[0x61, 0x01], [0x41, 0x05]] for CEA-708 captions and AFD.
+// threadPolicy: { cpus, realtime, numaNode } pins the capture threads to the listed CPU numbers, gives the capture
+// thread real time priority where the OS permits it, and puts the video buffers on the given NUMA node - pick the
+// node the card's PCIe slot hangs off, and CPUs on that node. Any of the three can be left out.
+// backpressure sets what happens when JavaScript falls behind and the host buffers are all full: 'block' (the
+// default) holds up the capture thread until a frame is read, so nothing is lost on the host but the card drops
+// frames if it goes on too long - the choice for recording. 'dropOldest' overwrites the oldest frame not yet
+// delivered, so live monitoring always gets the freshest, and 'dropNewest' throws away the frame just captured.
+function Capture (deviceIndex, channelNumber, displayMode, pixelFormat, options) {
     console.log("Capture Args: " + arguments.length);
     console.log("  deviceIndex: " + deviceIndex + " (" + typeof deviceIndex + ")");
     console.log("  channelNumber: " + channelNumber + " (" + typeof channelNumber + ")");
     console.log("  displayMode: " + displayMode + " (" + typeof displayMode + ")");
     console.log("  pixelFormat: " + pixelFormat + " (" + typeof pixelFormat + ")");
-    if (arguments.length !== 4 || 
+    if (arguments.length < 4 || 
       typeof deviceIndex !== 'number' ||
       typeof channelNumber !== 'number' ||
       typeof displayMode !== 'number' || 
-      typeof pixelFormat !== 'number' ) {
+      typeof pixelFormat !== 'number' ||
+      (options !== undefined && typeof options !== 'object')) {
     this.emit('error', new Error('Capture requires four number arguments: ' +
-      'index, channel, display mode and pixel format'));
+      'index, channel, display mode and pixel format, and an optional options object'));
   } else {
-    this.capture = new ajatatorNative.Capture(deviceIndex, channelNumber, displayMode, pixelFormat);
+    // With options.multiChannel, each channel of the device can have its own Capture in this one process, each
+    // capturing on its own thread into its own buffers, with audio from its channel's audio system where the card has one.
+    // The device is put in multi-format mode, and a process can't mix multi-channel and single channel use of a device.
+    this.capture = new ajatatorNative.Capture(deviceIndex, channelNumber, displayMode, pixelFormat, options);
+    // If the input changes format while capturing, capture reconfigures itself within a few frames and emits
+    // 'formatChange' with { displayMode, sequence }: frames from that sequence number on are in the new format
+    this.capture.onFormatChange(change => {
+      this.emit('formatChange', change);
+    });
   }
   this.initialised = false;
   EventEmitter.call(this);
@@ -49,7 +70,10 @@ function Capture (deviceIndex, channelNumber, displayMode, pixelFormat) {
 
 util.inherits(Capture, EventEmitter);
 
-Capture.prototype.start = function () {
+// options is optional. Set batchFrames, batchLatency (in milliseconds) or both to have frames delivered in
+// batches, as a 'frames' event carrying an array of { video, audio, info } - one call into JavaScript for
+// several frames, for clients such as recorders that can stand a few frames of latency.
+Capture.prototype.start = function (options) {
   try {
     if (!this.initialised) {
       this.initialised = this.capture.init() ? true : false;
@@ -58,9 +82,34 @@ Capture.prototype.start = function () {
         return 'Cannot start capture when no device is present.';
       }
     }
-    this.capture.doCapture((v, a) => {
-      this.emit('frame', v, a);
-    });
+    // v points straight at the capture buffer rather than a copy, and the buffer is only reused once v is
+    // garbage collected - so holding on to frames is safe, but costs a frame of memory each.
+    // info carries the per-frame metadata: sequence - the frame number, counting from zero -
+    // hardwareSequence - the frame's number among all the frames the card has seen, which jumps over dropped frames -
+    // cardDropped - frames the card dropped just before this one - gap - frames missing between the last frame
+    // delivered or recorded and this one, wherever they were lost, so a muxer can fill or flag them -
+    // framesWaiting - captured frames queued behind this one, so anything above zero is delivery latency -
+    // audioSamplePosition, audioSampleCount, cadenceSlot, discontinuity,
+    // nonPcmPairs - bit N set if card channels 2N and 2N+1 carry a bitstream such as Dolby E, passed through untouched -
+    // audioLevels - a Float32Array of [peak, rms, clipCount] for each card channel, with levels relative to full scale -
+    // frameTime - the driver's clock at the frame's vertical interrupt, in 100ns ticks - and dmaTime and deliveryTime -
+    // the host's monotonic clock in microseconds when the frame reached the host and when it was handed to JavaScript
+    // (in batch mode, when it joined the batch) - and, with the anc option, anc - an array of { type, did, sdid,
+    // field, line, data, decoded } for each packet kept, where type is 'cea608', 'cea708', 'afd', 'hdr', 'scte104',
+    // 'timecode' or 'unknown' and data is the packet's user data words as a Buffer. Captions and AFD are decoded
+    // natively into decoded: { field, lineOffset, data: [byte1, byte2], parityOk } for cea608, with the parity bits
+    // stripped; { frameRate, flags, sequence, ccData: [[valid, type, data1, data2], ...] } for cea708; and { afd,
+    // wide, barFlags, bar1, bar2 } for afd, where barFlags has 8 for top, 4 bottom, 2 left and 1 right, bar1 ends
+    // the top or left bar and bar2 starts the bottom or right bar. The other types are left to JavaScript in data.
+    if (options && (options.batchFrames || options.batchLatency)) {
+      this.capture.doCapture(frames => {
+        this.emit('frames', frames);
+      }, options);
+    } else {
+      this.capture.doCapture((v, a, info) => {
+        this.emit('frame', v, a, info);
+      });
+    }
   } catch (err) {
     this.emit('error', err);
   }
@@ -75,7 +124,9 @@ Capture.prototype.stop = function () {
   }
 }
 
-Capture.prototype.enableAudio = function (sampleRate, sampleType, channelCount) {
+// sampleRate is 48000, as the card runs, or 96000 to upsample natively.
+// channelMap is optional: element N is the card channel delivered as client channel N
+Capture.prototype.enableAudio = function (sampleRate, sampleType, channelCount, channelMap) {
     try {
         if (!this.initialised) {
             this.initialised = this.capture.init() ? true : false;
@@ -87,7 +138,8 @@ Capture.prototype.enableAudio = function (sampleRate, sampleType, channelCount)
         return this.capture.enableAudio(
           typeof sampleRate === 'string' ? +sampleRate : sampleRate,
           typeof sampleType === 'string' ? +sampleType: sampleType,
-          typeof channelCount === 'string' ? +channelCount : channelCount);
+          typeof channelCount === 'string' ? +channelCount : channelCount,
+          Array.isArray(channelMap) ? channelMap.map(x => +x) : undefined);
     } catch (err) {
         return "Error when enabling audio: " + err;
     }
@@ -108,33 +160,175 @@ Capture.prototype.getVideoFormat = function () {
     }
 }
 
+// EBU R128 loudness of the programme in the given card channels (default [0, 1]), measured natively
+// on a worker thread. weights are the BS.1770 channel weightings, e.g. 1.41 for surrounds and 0 for LFE.
+Capture.prototype.enableLoudness = function (channelMap, weights) {
+    try {
+        return this.capture.enableLoudness(
+          Array.isArray(channelMap) ? channelMap.map(x => +x) : undefined,
+          Array.isArray(weights) ? weights.map(x => +x) : undefined);
+    } catch (err) {
+        return "Error when enabling loudness: " + err;
+    }
+}
+
+// Returns { momentary, shortTerm, integrated, truePeak, samplesProcessed, droppedSamples },
+// in LUFS and dBTP, with -Infinity for figures that have no audio behind them yet
+Capture.prototype.getLoudness = function () {
+    return this.capture.getLoudness();
+}
+
+Capture.prototype.resetLoudness = function () {
+    this.capture.resetLoudness();
+}
+
+// Returns { vbiToDma, dmaToDelivery }, each { count, total, last, min, max, mean, p50, p99 } in microseconds over
+// the last 300 frames delivered: vbiToDma is from the frame's vertical interrupt to the end of its transfer to the
+// host, and dmaToDelivery from there to the frame being handed to JavaScript, including any time spent queued
+Capture.prototype.getLatencyStats = function () {
+    return this.capture.getLatencyStats();
+}
+
+Capture.prototype.resetLatencyStats = function () {
+    this.capture.resetLatencyStats();
+}
+
+// Returns { framesProcessed, framesDropped, bufferLevel } from AutoCirculate - frames captured and dropped by the
+// card since capture started, and frames waiting on the card - plus framesMissed, the total of the gaps seen in
+// the frames delivered, and hostFramesDropped, those of the gaps down to the backpressure policy rather than the
+// card. Returns null before the device is initialised.
+Capture.prototype.getCaptureStatus = function () {
+    return this.capture.getCaptureStatus();
+}
+
+// Returns the capture thread's calls into the driver since it started, or since resetDriverCalls, as { passes,
+// vbiWaits, statusQueries, transfers, other, meanPerPass, maxPerPass, budget, overBudget }. Each pass is one frame:
+// a wait for the vertical interrupt, an input format read, one status query and one transfer, plus a read of the
+// non-PCM audio pairs every fourth pass, so the budget is 5 and overBudget counts the passes that needed more, such
+// as catching up after a stall.
+// Returns null before the device is initialised.
+Capture.prototype.getDriverCalls = function () {
+    return this.capture.getDriverCalls();
+}
+
+Capture.prototype.resetDriverCalls = function () {
+    this.capture.resetDriverCalls();
+}
+
+// Returns the thread policy in effect once capture has started, as { cpus, realtime, numaNode }: the CPUs and
+// priority the OS actually allowed the capture thread, and the NUMA node its buffers landed on, or -1 for none
+// in particular. Returns null until the capture thread is running.
+Capture.prototype.getThreadPolicy = function () {
+    return this.capture.getThreadPolicy();
+}
+
+// Record straight to disk on a native thread, with no frames passing through JavaScript: path gets each
+// frame's video and then its audio, each padded to a 4096 byte block, and indexPath (default path + '.idx')
+// gets a 56 byte record per frame - hardwareSequence, videoOffset, audioOffset and audioSamplePosition as 64 bit
+// numbers, then videoSize, audioSize, audioSampleCount and the RP188 timecode (DBB, low, high) as 32 bit,
+// all little endian. Gaps in the sequence are frames the card dropped.
+// Capture starts if it isn't already running; while recording, no 'frame' events are sent.
+Capture.prototype.startRecording = function (path, indexPath) {
+  try {
+    if (!this.initialised) {
+      this.initialised = this.capture.init() ? true : false;
+      if (!this.initialised) {
+        console.error('Cannot start recording when no device is present.');
+        return 'Cannot start recording when no device is present.';
+      }
+    }
+    return this.capture.startRecording(path, indexPath);
+  } catch (err) {
+    this.emit('error', err);
+  }
+}
+
+Capture.prototype.stopRecording = function () {
+  try {
+    return this.capture.stopRecording();
+  } catch (err) {
+    this.emit('error', err);
+  }
+}
+
+// Returns { recording, framesWritten, bytesWritten, error } - recording goes false by itself,
+// with the reason in error, if a write fails
+Capture.prototype.getRecordingStatus = function () {
+  return this.capture.getRecordingStatus();
+}
 
-function Playback (deviceIndex, channelNumber, displayMode, pixelFormat) {
+// Keep the last slots frames in a memory mapped ring file at path, for instant replay by a Playback that
+// opens the same path. The file is allocated in full up front: each slot takes a frame of video and audio,
+// rounded up to 4096 bytes, plus 4096 bytes of header. Frames still arrive as 'frame' events as usual.
+Capture.prototype.startTimeshift = function (path, slots) {
+  try {
+    if (!this.initialised) {
+      this.initialised = this.capture.init() ? true : false;
+      if (!this.initialised) {
+        console.error('Cannot start timeshift when no device is present.');
+        return 'Cannot start timeshift when no device is present.';
+      }
+    }
+    return this.capture.startTimeshift(path, +slots);
+  } catch (err) {
+    this.emit('error', err);
+  }
+}
+
+Capture.prototype.stopTimeshift = function () {
+  try {
+    return this.capture.stopTimeshift();
+  } catch (err) {
+    this.emit('error', err);
+  }
+}
+
+
+// options is optional: { hostBuffers, deviceBuffers } sets the depth, in frames, of the host ring buffer and of the
+// buffering on the card. Shallow buffers (2 or 3) keep latency down for monitoring, deep ones (30 or more) ride out
+// longer stalls when recording. hugePages: true puts the video buffers on large pages, where the OS allows it.
+// threadPolicy: { cpus, realtime, numaNode } as for Capture, with the playout thread getting the real time priority.
+function Playback (deviceIndex, channelNumber, displayMode, pixelFormat, options) {
     console.log("Playback Args: " + arguments.length);
     console.log("  deviceIndex: " + deviceIndex + " (" + typeof deviceIndex + ")");
     console.log("  channelNumber: " + channelNumber + " (" + typeof channelNumber + ")");
     console.log("  displayMode: " + displayMode + " (" + typeof displayMode + ")");
     console.log("  pixelFormat: " + pixelFormat + " (" + typeof pixelFormat + ")");
-    if (arguments.length !== 4 || 
+    if (arguments.length < 4 || 
       typeof deviceIndex !== 'number' ||
       typeof channelNumber !== 'number' ||
       typeof displayMode !== 'number' || 
-      typeof pixelFormat !== 'number' ) {
+      typeof pixelFormat !== 'number' ||
+      (options !== undefined && typeof options !== 'object')) {
     this.emit('error', new Error('Playback requires four number arguments: ' +
-      'index, channel, display mode and pixel format'));
+      'index, channel, display mode and pixel format, and an optional options object'));
   } else {
-    this.playback = new ajatatorNative.Playback(deviceIndex, channelNumber, displayMode, pixelFormat);
+    this.playback = new ajatatorNative.Playback(deviceIndex, channelNumber, displayMode, pixelFormat, options);
   }
   this.initialised = false;
+  this.audioArgs = [];
   EventEmitter.call(this);
 }
 
 util.inherits(Playback, EventEmitter);
 
+// Must be called before start or the first frame, as the audio routing is fixed when the device is initialised.
+// channelMap is optional: element N is the card channel that client channel N is played out on
+// As Capture.enableAudio: 96000 sampleRate audio is downsampled to the card's 48kHz as it is scheduled. The only
+// sampleType played out is 24 (packed, most significant byte first); initialisation fails for any other.
+Playback.prototype.enableAudio = function (sampleRate, sampleType, channelCount, channelMap) {
+  this.audioArgs = [
+    typeof sampleRate === 'string' ? +sampleRate : sampleRate,
+    typeof sampleType === 'string' ? +sampleType : sampleType,
+    typeof channelCount === 'string' ? +channelCount : channelCount,
+    Array.isArray(channelMap) ? channelMap.map(x => +x) : undefined ];
+  return this.initialised ? 'Audio must be enabled before playback is initialised.' : 'audio enabled';
+}
+
 Playback.prototype.start = function () {
   try {
     if (!this.initialised) {
-      console.log("*** playback.init", this.playback.init());
+      console.log("*** playback.init", this.playback.init.apply(this.playback, this.audioArgs));
       this.initialised = true;
     }
     console.log("*** playback.doPlayback", this.playback.doPlayback(function (x) {
@@ -145,13 +339,15 @@ Playback.prototype.start = function () {
   }
 }
 
-Playback.prototype.frame = function (fv, fa) {
+// nonPcmPairs is optional, as in the capture frame info: flagged card channel pairs are played out
+// bit-exact and marked as non-PCM in the AES channel status
+Playback.prototype.frame = function (fv, fa, nonPcmPairs) {
   try {
     if (!this.initialised) {
-      this.playback.init();
+      this.playback.init.apply(this.playback, this.audioArgs);
       this.initialised = true;
     }
-    var result = this.playback.scheduleFrame(fv, fa);
+    var result = this.playback.scheduleFrame(fv, fa, nonPcmPairs);
     if (typeof result === 'string')
       throw new Error("Problem scheduling frame: " + result);
     else
@@ -161,6 +357,54 @@ Playback.prototype.frame = function (fv, fa) {
   }
 }
 
+// Replay from a Capture's timeshift ring: open the ring file by path, then schedule frames from it by
+// number. Frames are numbered from zero as the capture writes them; getTimeshiftRange gives the numbers
+// that can be played now as { oldest, newest }, or null if the ring is empty. The video and audio go from
+// the file to the card without passing through JavaScript.
+Playback.prototype.openTimeshift = function (path) {
+  try {
+    return this.playback.openTimeshift(path);
+  } catch (err) {
+    this.emit('error', err);
+  }
+}
+
+Playback.prototype.closeTimeshift = function () {
+  this.playback.closeTimeshift();
+}
+
+Playback.prototype.getTimeshiftRange = function () {
+  return this.playback.getTimeshiftRange();
+}
+
+// Returns the number of buffered frames, as frame does, or false if the frame is no longer in the ring
+Playback.prototype.timeshiftFrame = function (frameNumber) {
+  try {
+    if (!this.initialised) {
+      this.playback.init.apply(this.playback, this.audioArgs);
+      this.initialised = true;
+    }
+    return this.playback.scheduleTimeshiftFrame(frameNumber);
+  } catch (err) {
+    this.emit('error', err);
+  }
+}
+
+// Returns the playout thread's calls into the driver, as Capture's getDriverCalls does. Each pass is a wait for
+// the vertical interrupt, one status query and one transfer, so the budget is 3.
+Playback.prototype.getDriverCalls = function () {
+  return this.playback.getDriverCalls();
+}
+
+Playback.prototype.resetDriverCalls = function () {
+  this.playback.resetDriverCalls();
+}
+
+// Returns the playout thread's effective thread policy, as Capture's getThreadPolicy does.
+Playback.prototype.getThreadPolicy = function () {
+  return this.playback.getThreadPolicy();
+}
+
 Playback.prototype.stop = function () {
   try {
     console.log('*** playback stop', this.playback.stop());
@@ -622,7 +866,13 @@ var ajatation = {
   bmdDisplayModeColorspaceRec709  : 1 << 2,
   bmdAudioSampleRate48kHz	        : 48000,
   bmdAudioSampleType16bitInteger	: 16,
+  // Packed 24-bit, most significant byte first - the default capture format
+  bmdAudioSampleType24bitInteger	: 24,
   bmdAudioSampleType32bitInteger	: 32,
+  // Little-endian float, full scale +/-1.0
+  bmdAudioSampleType32bitFloat	: 0x120,
+  // Combine with any sample type to deliver each channel as a contiguous block rather than interleaved
+  audioSampleTypePlanar           : 0x200,
   // Convert to and from Black Magic codes.
   intToBMCode : intToBMCode,
   bmCodeToInt : bmCodeToInt,
@@ -0,0 +1,45 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Like record.js, but the frames are written to disk natively, without passing through JavaScript
+
+var aja = require('../index.js');
+
+var recorder = new aja.Capture(0, 1, aja.bmdModeHD1080i50, aja.bmdFormat10BitYUV);
+
+var path = (process.argv[2]) ? process.argv[2] : 'test.raw';
+var frames = (process.argv[3] && !isNaN(+process.argv[3])) ? +process.argv[3] : 250;
+
+recorder.on('error', console.error);
+
+console.log(recorder.startRecording(path));
+
+var stop = () => {
+  recorder.stopRecording();
+  recorder.stop();
+  console.log("Recording finished.", recorder.getRecordingStatus());
+  process.exit();
+};
+
+var poll = setInterval(() => {
+  var status = recorder.getRecordingStatus();
+  console.log(`${status.framesWritten} frames, ${status.bytesWritten} bytes`);
+  if (!status.recording || status.framesWritten >= frames) {
+    clearInterval(poll);
+    stop();
+  }
+}, 1000);
+
+process.on('SIGINT', stop);
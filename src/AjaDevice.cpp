@@ -33,6 +33,11 @@ const AjaDevice::InitParams DEFAULT_INIT_PARAMS = {
     AJA_FOURCC('S', 'T', 'P', 'K')  // App Signature
 };
 
+const AjaDevice::InitParams MULTICHANNEL_INIT_PARAMS = {
+    true,                           // Multi-channel
+    AJA_FOURCC('S', 'T', 'P', 'K')  // App Signature
+};
+
 map<string, shared_ptr<AjaDevice>> AjaDevice::references_;
 mutex AjaDevice::protectRefCounts_;
 AJAStatus AjaDevice::lastError_(AJA_STATUS_SUCCESS);
@@ -23,6 +23,15 @@
 #include "ajabase\common\types.h"
 #include "ntv2devicescanner.h"
 #include "ntv2sharedcard.h"
+#include "ntv2version.h"
+
+// CNTV2Card::DMABufferLock and DMABufferUnlock arrived with NTV2 SDK 14. With an older SDK, such as the 13.0
+// this addon is built against, video buffers aren't locked up front and the driver maps them on every transfer.
+#if defined(AJA_NTV2_SDK_VERSION_MAJOR) && (AJA_NTV2_SDK_VERSION_MAJOR >= 14)
+#define AJA_HAS_DMA_BUFFER_LOCK 1
+#else
+#define AJA_HAS_DMA_BUFFER_LOCK 0
+#endif
 
 namespace streampunk {
 
@@ -37,6 +46,13 @@ public:
     static const uint32_t DEFAULT_CAPTURE_CHANNEL = 1;
     static const uint32_t DEFAULT_PLAYBACK_CHANNEL = 3;
 
+    // Buffer depths, in frames, for the host ring and for AutoCirculate on the card. Shallow buffers keep
+    // latency down for monitoring; deep ones ride out longer stalls when recording.
+    static const uint32_t DEFAULT_DEVICE_BUFFERS = 7;
+    static const uint32_t MIN_BUFFERS = 2;
+    static const uint32_t MAX_HOST_BUFFERS = 120;
+    static const uint32_t MAX_DEVICE_BUFFERS = 60;
+
 // Typedefs and nested classes
 //
 public:
@@ -119,4 +135,8 @@ private:
 };
 
 extern const AjaDevice::InitParams DEFAULT_INIT_PARAMS;
+
+// Shares the device between channels in multi-format mode, without acquiring it for exclusive use, so that one
+// process can run a capture on each input. Every user of a device within the process must use the same params.
+extern const AjaDevice::InitParams MULTICHANNEL_INIT_PARAMS;
 }
\ No newline at end of file
@@ -0,0 +1,226 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "AncPackets.h"
+#include <algorithm>
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+namespace
+{
+
+struct AncRegistration
+{
+    uint8_t       did;
+    uint8_t       sdid;
+    AncPacketType type;
+};
+
+const AncRegistration ANC_REGISTRATIONS[] =
+{
+    { 0x61, 0x02, AncPacketType_Cea608 },
+    { 0x61, 0x01, AncPacketType_Cea708 },
+    { 0x41, 0x05, AncPacketType_Afd },
+    { 0x41, 0x0C, AncPacketType_Hdr },
+    { 0x41, 0x07, AncPacketType_Scte104 },
+    { 0x60, 0x60, AncPacketType_Timecode }
+};
+
+const char* const ANC_TYPE_NAMES[AncPacketType_LAST] =
+{
+    "unknown",
+    "cea608",
+    "cea708",
+    "afd",
+    "hdr",
+    "scte104",
+    "timecode"
+};
+
+}
+
+
+AncPacketType ClassifyAncPacket(uint8_t did, uint8_t sdid)
+{
+    for (size_t reg = 0; reg < sizeof(ANC_REGISTRATIONS) / sizeof(ANC_REGISTRATIONS[0]); reg++)
+    {
+        if (ANC_REGISTRATIONS[reg].did == did && ANC_REGISTRATIONS[reg].sdid == sdid)
+            return ANC_REGISTRATIONS[reg].type;
+    }
+
+    return AncPacketType_Unknown;
+}
+
+
+const char* GetAncPacketTypeName(AncPacketType type)
+{
+    return type < AncPacketType_LAST ? ANC_TYPE_NAMES[type] : ANC_TYPE_NAMES[AncPacketType_Unknown];
+}
+
+
+bool DecodeCea608(const uint8_t* payload, uint32_t payloadSize, Cea608Data& out)
+{
+    if (payloadSize < 3)
+        return false;
+
+    // The first word flags field 1 in its top bit, and carries the line offset in the bottom five
+    out.field = (payload[0] & 0x80) != 0 ? 1 : 2;
+    out.lineOffset = payload[0] & 0x1F;
+    out.parityOk = true;
+
+    for (uint32_t byte = 0; byte < 2; byte++)
+    {
+        uint8_t ones = 0;
+        for (uint8_t bits = payload[1 + byte]; bits != 0; bits &= bits - 1)
+            ones++;
+
+        out.parityOk = out.parityOk && (ones & 1) != 0;
+        out.data[byte] = payload[1 + byte] & 0x7F;
+    }
+
+    return true;
+}
+
+
+bool DecodeCea708(const uint8_t* payload, uint32_t payloadSize, Cea708Data& out)
+{
+    // cdp_identifier, cdp_length, frame rate, flags and sequence counter
+    const uint32_t HEADER_SIZE = 7;
+
+    if (payloadSize < HEADER_SIZE || payload[0] != 0x96 || payload[1] != 0x69 || payload[2] > payloadSize)
+        return false;
+
+    const uint32_t cdpLength = payload[2];
+
+    out.frameRate = payload[3] >> 4;
+    out.flags = payload[4];
+    out.sequence = static_cast<uint16_t>((payload[5] << 8) | payload[6]);
+    out.ccCount = 0;
+
+    uint32_t offset = HEADER_SIZE;
+
+    // The time code section, if there is one, comes first
+    if ((out.flags & 0x80) != 0)
+    {
+        if (offset + 5 > cdpLength || payload[offset] != 0x71)
+            return false;
+
+        offset += 5;
+    }
+
+    if ((out.flags & 0x40) != 0)
+    {
+        if (offset + 2 > cdpLength || payload[offset] != 0x72)
+            return false;
+
+        const uint32_t ccCount = payload[offset + 1] & 0x1F;
+        offset += 2;
+
+        if (offset + ccCount * 3 > cdpLength)
+            return false;
+
+        for (uint32_t cc = 0; cc < ccCount; cc++, offset += 3)
+        {
+            out.cc[cc].valid = (payload[offset] & 0x04) != 0;
+            out.cc[cc].type = payload[offset] & 0x03;
+            out.cc[cc].data[0] = payload[offset + 1];
+            out.cc[cc].data[1] = payload[offset + 2];
+        }
+
+        out.ccCount = ccCount;
+    }
+
+    return true;
+}
+
+
+bool DecodeAfd(const uint8_t* payload, uint32_t payloadSize, AfdData& out)
+{
+    if (payloadSize < 8)
+        return false;
+
+    out.afd = (payload[0] >> 3) & 0x0F;
+    out.wide = (payload[0] & 0x04) != 0;
+    out.barFlags = payload[3] >> 4;
+    out.bar1 = static_cast<uint16_t>((payload[4] << 8) | payload[5]);
+    out.bar2 = static_cast<uint16_t>((payload[6] << 8) | payload[7]);
+
+    return true;
+}
+
+
+void AncFilter::Set(const std::vector<uint16_t>& didSdids)
+{
+    didSdids_ = didSdids;
+    std::sort(didSdids_.begin(), didSdids_.end());
+}
+
+
+bool AncFilter::Accepts(uint8_t did, uint8_t sdid) const
+{
+    return didSdids_.empty() || std::binary_search(didSdids_.begin(), didSdids_.end(), static_cast<uint16_t>((did << 8) | sdid));
+}
+
+
+AncPacketList::AncPacketList()
+:   dropped_(0)
+{
+}
+
+
+void AncPacketList::Reserve()
+{
+    packets_.reserve(MAX_PACKETS);
+    payloads_.reserve(MAX_PAYLOAD_BYTES);
+}
+
+
+void AncPacketList::Clear()
+{
+    packets_.clear();
+    payloads_.clear();
+    dropped_ = 0;
+}
+
+
+bool AncPacketList::Add(uint8_t did, uint8_t sdid, uint8_t field, uint16_t line, const uint8_t* payload, uint32_t payloadSize)
+{
+    if (packets_.size() >= MAX_PACKETS || payloads_.size() + payloadSize > MAX_PAYLOAD_BYTES || (payload == nullptr && payloadSize > 0))
+    {
+        dropped_++;
+        return false;
+    }
+
+    AncPacket packet;
+    packet.did = did;
+    packet.sdid = sdid;
+    packet.field = field;
+    packet.type = static_cast<uint8_t>(ClassifyAncPacket(did, sdid));
+    packet.line = line;
+    packet.payloadSize = static_cast<uint16_t>(payloadSize);
+    packet.payloadOffset = static_cast<uint32_t>(payloads_.size());
+
+    packets_.push_back(packet);
+    payloads_.insert(payloads_.end(), payload, payload + payloadSize);
+
+    return true;
+}
+
+}
+}
@@ -0,0 +1,166 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+// What an ancillary packet carries, going by its SMPTE registered DID and SDID
+enum AncPacketType
+{
+    AncPacketType_Unknown = 0,
+    AncPacketType_Cea608,           // SMPTE 334 line 21 captions
+    AncPacketType_Cea708,           // SMPTE 334 caption distribution packet
+    AncPacketType_Afd,              // SMPTE 2016-3 active format description and bar data
+    AncPacketType_Hdr,              // SMPTE 2108-1 HDR/WCG metadata
+    AncPacketType_Scte104,          // SMPTE 2010 SCTE-104 messages
+    AncPacketType_Timecode,         // SMPTE 12-2 ancillary timecode
+    AncPacketType_LAST
+};
+
+AncPacketType ClassifyAncPacket(uint8_t did, uint8_t sdid);
+
+// A short lower case name for the type, such as "cea708"
+const char* GetAncPacketTypeName(AncPacketType type);
+
+
+// One ancillary packet, with its payload held by the AncPacketList it came from
+struct AncPacket
+{
+    uint8_t  did;
+    uint8_t  sdid;
+    uint8_t  field;                 // 1 or 2
+    uint8_t  type;                  // An AncPacketType
+    uint16_t line;
+    uint16_t payloadSize;           // The data count: user data words, with the 2 parity bits stripped
+    uint32_t payloadOffset;
+};
+
+
+// A CEA-608 byte pair from a SMPTE 334-1 packet
+struct Cea608Data
+{
+    uint8_t field;                  // The line 21 field the pair belongs to, 1 or 2
+    uint8_t lineOffset;             // Line number offset, 0 for line 21
+    uint8_t data[2];                // The byte pair, with the odd parity bits stripped
+    bool    parityOk;
+};
+
+// Returns false if the payload is too short to be a 608 packet
+bool DecodeCea608(const uint8_t* payload, uint32_t payloadSize, Cea608Data& out);
+
+
+// One cc_data construct from a CEA-708 caption distribution packet
+struct Cea708CcData
+{
+    bool    valid;
+    uint8_t type;                   // 0 and 1 for 608 fields 1 and 2, 2 for DTVCC data, 3 for the start of a DTVCC packet
+    uint8_t data[2];
+};
+
+// The header and cc_data of a SMPTE 334-2 caption distribution packet (CDP)
+struct Cea708Data
+{
+    static const uint32_t MAX_CC_COUNT = 31;
+
+    uint8_t      frameRate;         // The cdp_frame_rate code, 1 to 8 for 23.98 to 60
+    uint8_t      flags;             // The CDP flags byte: 0x40 cc data present, 0x02 caption service active, and so on
+    uint16_t     sequence;          // cdp_hdr_sequence_cntr
+    uint32_t     ccCount;
+    Cea708CcData cc[MAX_CC_COUNT];
+};
+
+// Returns false if the payload isn't a well formed CDP. A CDP without cc data decodes with ccCount 0.
+bool DecodeCea708(const uint8_t* payload, uint32_t payloadSize, Cea708Data& out);
+
+
+// Active format description and bar data from a SMPTE 2016-3 packet
+struct AfdData
+{
+    static const uint8_t BAR_TOP = 0x8;
+    static const uint8_t BAR_BOTTOM = 0x4;
+    static const uint8_t BAR_LEFT = 0x2;
+    static const uint8_t BAR_RIGHT = 0x1;
+
+    uint8_t  afd;                   // The 4 bit AFD code
+    bool     wide;                  // The coded frame is 16:9, rather than 4:3
+    uint8_t  barFlags;              // Which bars are described, from BAR_TOP to BAR_RIGHT
+    uint16_t bar1;                  // The end of the top bar or left bar, whichever is flagged
+    uint16_t bar2;                  // The start of the bottom bar or right bar, whichever is flagged
+};
+
+// Returns false if the payload is too short to be an AFD packet
+bool DecodeAfd(const uint8_t* payload, uint32_t payloadSize, AfdData& out);
+
+
+// Which packets to keep, by DID and SDID. An empty filter keeps everything.
+class AncFilter
+{
+public:
+
+    // Each entry is (DID << 8) | SDID
+    void Set(const std::vector<uint16_t>& didSdids);
+
+    bool Accepts(uint8_t did, uint8_t sdid) const;
+
+    bool IsEmpty() const { return didSdids_.empty(); }
+
+private:
+
+    std::vector<uint16_t> didSdids_;    // Sorted
+};
+
+
+// The ancillary packets from one frame, with their payloads packed together. Once Reserve has been called,
+// adding packets never allocates, so it is safe on the capture thread; packets that don't fit are counted.
+class AncPacketList
+{
+public:
+
+    static const uint32_t MAX_PACKETS = 128;
+    static const uint32_t MAX_PAYLOAD_BYTES = 32 * 1024;
+
+    AncPacketList();
+
+    void Reserve();
+
+    void Clear();
+
+    // Returns false if there's no room left for the packet
+    bool Add(uint8_t did, uint8_t sdid, uint8_t field, uint16_t line, const uint8_t* payload, uint32_t payloadSize);
+
+    uint32_t GetCount() const { return static_cast<uint32_t>(packets_.size()); }
+    const AncPacket& GetPacket(uint32_t index) const { return packets_[index]; }
+    const uint8_t* GetPayload(const AncPacket& packet) const { return payloads_.data() + packet.payloadOffset; }
+
+    // Packets that didn't fit since the last Clear
+    uint32_t GetDropped() const { return dropped_; }
+
+private:
+
+    std::vector<AncPacket> packets_;
+    std::vector<uint8_t>   payloads_;
+    uint32_t               dropped_;
+};
+
+}
+}
@@ -0,0 +1,205 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+// Client audio sample types, as passed to Capture.enableAudio. The integer types are the bit depth, so the
+// values match the bmdAudioSampleType constants; the float and planar flags are our own.
+enum AudioSampleType
+{
+    AudioSampleType_S16 = 16,       // 16 bit signed, little-endian
+    AudioSampleType_S24 = 24,       // 24 bit signed, packed, most significant byte first - the original client format
+    AudioSampleType_S32 = 32,       // 32 bit signed, little-endian
+    AudioSampleType_F32 = 0x120,    // 32 bit float, little-endian, full scale is +/-1.0
+
+    AudioSampleType_FormatMask = 0x1FF,
+    AudioSampleType_Planar = 0x200  // May be combined with any of the above: one contiguous block per channel
+};
+
+
+// Sample format traits. Each takes a 32 bit card word (24 bit audio in the top three bytes) and stores it
+// in the client format - all of the conversion happens in a single write, with no intermediate buffer.
+namespace AudioFormat
+{
+
+struct S16
+{
+    static const uint32_t BYTES = 2;
+
+    static void Store(uint32_t cardWord, uint8_t* out)
+    {
+        out[0] = static_cast<uint8_t>(cardWord >> 16);
+        out[1] = static_cast<uint8_t>(cardWord >> 24);
+    }
+};
+
+struct S24
+{
+    static const uint32_t BYTES = 3;
+
+    static void Store(uint32_t cardWord, uint8_t* out)
+    {
+        out[0] = static_cast<uint8_t>(cardWord >> 24);
+        out[1] = static_cast<uint8_t>(cardWord >> 16);
+        out[2] = static_cast<uint8_t>(cardWord >> 8);
+    }
+};
+
+struct S32
+{
+    static const uint32_t BYTES = 4;
+
+    static void Store(uint32_t cardWord, uint8_t* out)
+    {
+        // The bottom byte of the card word is always zero, so this is the 24 bit sample left justified
+        memcpy(out, &cardWord, BYTES);
+    }
+};
+
+struct F32
+{
+    static const uint32_t BYTES = 4;
+
+    static void Store(uint32_t cardWord, uint8_t* out)
+    {
+        const float sample = static_cast<float>(static_cast<int32_t>(cardWord)) * (1.0f / 2147483648.0f);
+        memcpy(out, &sample, BYTES);
+    }
+};
+
+}
+
+
+// Converts interleaved card audio into the client format. Instances are created once, when audio is enabled,
+// so the per frame cost is a single virtual call.
+class AudioConverter
+{
+public:
+
+    virtual ~AudioConverter() {}
+
+    // Convert numSamples samples (each one word per card channel) into output, which must have room
+    // for numSamples * GetBytesPerSample() * channelMap.size() bytes. Returns the number of bytes written.
+    virtual uint32_t Convert(const uint8_t* input, uint32_t cardChannels, const uint32_t* channelMap,
+                             uint32_t numSamples, uint8_t* output) const = 0;
+
+    virtual uint32_t GetBytesPerSample() const = 0;
+    virtual uint32_t GetClientChannels() const = 0;
+};
+
+
+// One converter per format, layout and channel count. When Channels is non-zero the channel loop has a
+// constant trip count and is unrolled by the compiler; zero means the count is only known at run time.
+template <class Format, bool Planar, uint32_t Channels>
+class AudioConverterImpl : public AudioConverter
+{
+public:
+
+    explicit AudioConverterImpl(uint32_t clientChannels)
+    :   clientChannels_(Channels != 0 ? Channels : clientChannels)
+    {
+    }
+
+    virtual uint32_t Convert(const uint8_t* input, uint32_t cardChannels, const uint32_t* channelMap,
+                             uint32_t numSamples, uint8_t* output) const
+    {
+        const uint32_t clientChannels = Channels != 0 ? Channels : clientChannels_;
+
+        for (uint32_t sampleIdx = 0; sampleIdx < numSamples; sampleIdx++)
+        {
+            const uint8_t* cardSample = input + sampleIdx * cardChannels * sizeof(uint32_t);
+
+            for (uint32_t channel = 0; channel < clientChannels; channel++)
+            {
+                uint32_t cardWord;
+                memcpy(&cardWord, cardSample + channelMap[channel] * sizeof(uint32_t), sizeof(cardWord));
+
+                const uint32_t outIdx = Planar ? channel * numSamples + sampleIdx : sampleIdx * clientChannels + channel;
+                Format::Store(cardWord, output + outIdx * Format::BYTES);
+            }
+        }
+
+        return numSamples * clientChannels * Format::BYTES;
+    }
+
+    virtual uint32_t GetBytesPerSample() const { return Format::BYTES; }
+    virtual uint32_t GetClientChannels() const { return clientChannels_; }
+
+private:
+
+    uint32_t clientChannels_;
+};
+
+
+namespace detail
+{
+
+template <class Format, bool Planar>
+AudioConverter* CreateAudioConverter(uint32_t clientChannels)
+{
+    // Specialise the common channel counts, and fall back to a run time count for the rest
+    switch (clientChannels)
+    {
+        case 1:  return new AudioConverterImpl<Format, Planar, 1>(clientChannels);
+        case 2:  return new AudioConverterImpl<Format, Planar, 2>(clientChannels);
+        case 4:  return new AudioConverterImpl<Format, Planar, 4>(clientChannels);
+        case 6:  return new AudioConverterImpl<Format, Planar, 6>(clientChannels);
+        case 8:  return new AudioConverterImpl<Format, Planar, 8>(clientChannels);
+        case 16: return new AudioConverterImpl<Format, Planar, 16>(clientChannels);
+        default: return new AudioConverterImpl<Format, Planar, 0>(clientChannels);
+    }
+}
+
+template <class Format>
+AudioConverter* CreateAudioConverter(bool planar, uint32_t clientChannels)
+{
+    return planar ? CreateAudioConverter<Format, true>(clientChannels) : CreateAudioConverter<Format, false>(clientChannels);
+}
+
+}
+
+
+// Returns the converter for the given sample type (optionally with AudioSampleType_Planar set) and
+// channel count, or nullptr if the sample type is not recognised
+inline std::unique_ptr<AudioConverter> CreateAudioConverter(uint32_t sampleType, uint32_t clientChannels)
+{
+    const bool planar = (sampleType & AudioSampleType_Planar) != 0;
+
+    if (clientChannels == 0 || (sampleType & ~(AudioSampleType_FormatMask | AudioSampleType_Planar)) != 0)
+        return std::unique_ptr<AudioConverter>();
+
+    switch (sampleType & AudioSampleType_FormatMask)
+    {
+        case AudioSampleType_S16: return std::unique_ptr<AudioConverter>(detail::CreateAudioConverter<AudioFormat::S16>(planar, clientChannels));
+        case AudioSampleType_S24: return std::unique_ptr<AudioConverter>(detail::CreateAudioConverter<AudioFormat::S24>(planar, clientChannels));
+        case AudioSampleType_S32: return std::unique_ptr<AudioConverter>(detail::CreateAudioConverter<AudioFormat::S32>(planar, clientChannels));
+        case AudioSampleType_F32: return std::unique_ptr<AudioConverter>(detail::CreateAudioConverter<AudioFormat::F32>(planar, clientChannels));
+        default:                  return std::unique_ptr<AudioConverter>();
+    }
+}
+
+}
+}
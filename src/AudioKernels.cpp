@@ -0,0 +1,605 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "AudioKernels.h"
+#include <atomic>
+#include <math.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#define AUDIO_KERNELS_X86
+#define AUDIO_TARGET_SSSE3
+#define AUDIO_TARGET_AVX2
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define AUDIO_KERNELS_X86
+#define AUDIO_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define AUDIO_TARGET_AVX2  __attribute__((target("avx2")))
+#endif
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+namespace
+{
+
+const int32_t AUDIO_FULL_SCALE = 0x7FFFFF;          // Largest 24 bit sample magnitude, other than the negative full scale
+const double  AUDIO_LEVEL_SCALE = 1.0 / 8388608.0;  // 2^23, so negative full scale reads as 1.0
+
+// Running totals for each channel, shared by all of the metering kernels
+struct LevelAccumulators
+{
+    int32_t  peak[AudioLevels::MAX_CHANNELS];
+    uint32_t clips[AudioLevels::MAX_CHANNELS];
+    double   sumSquares[AudioLevels::MAX_CHANNELS];
+};
+
+
+void MeasureLevelsScalar(const uint8_t* cardAudio, uint32_t numChannels, uint32_t numSamples, LevelAccumulators& acc)
+{
+    for (uint32_t sampleIdx = 0; sampleIdx < numSamples; sampleIdx++)
+    {
+        const uint8_t* frame = cardAudio + sampleIdx * numChannels * sizeof(int32_t);
+
+        for (uint32_t channel = 0; channel < numChannels; channel++)
+        {
+            int32_t word;
+            memcpy(&word, frame + channel * sizeof(int32_t), sizeof(word));
+
+            const int32_t sample = word >> 8;
+            const int32_t magnitude = sample < 0 ? -sample : sample;
+
+            if (magnitude > acc.peak[channel])
+                acc.peak[channel] = magnitude;
+            if (magnitude >= AUDIO_FULL_SCALE)
+                acc.clips[channel]++;
+
+            acc.sumSquares[channel] += static_cast<double>(sample) * static_cast<double>(sample);
+        }
+    }
+}
+
+void FilterFirScalar(const float* input, const float* coeffs, uint32_t numTaps, uint32_t firstOutput, uint32_t numOutputs, float* output)
+{
+    for (uint32_t n = firstOutput; n < numOutputs; n++)
+    {
+        float sum = 0.0f;
+
+        for (uint32_t tap = 0; tap < numTaps; tap++)
+            sum += coeffs[tap] * input[n + tap];
+
+        output[n] = sum;
+    }
+}
+
+#ifdef AUDIO_KERNELS_X86
+
+void QueryCpuId(int leaf, int subLeaf, int regs[4])
+{
+#if defined(_MSC_VER)
+    __cpuidex(regs, leaf, subLeaf);
+#else
+    unsigned int a(0), b(0), c(0), d(0);
+    __cpuid_count(leaf, subLeaf, a, b, c, d);
+    regs[0] = a; regs[1] = b; regs[2] = c; regs[3] = d;
+#endif
+}
+
+
+uint64_t QueryXcr0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax(0), edx(0);
+    __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+
+AudioKernelIsa DetectBestIsa()
+{
+    int regs[4] = { 0, 0, 0, 0 };
+
+    QueryCpuId(0, 0, regs);
+    const int maxLeaf = regs[0];
+
+    if (maxLeaf < 1)
+        return AudioKernelIsa_Scalar;
+
+    QueryCpuId(1, 0, regs);
+    const bool ssse3   = (regs[2] & (1 << 9)) != 0;
+    const bool osxsave = (regs[2] & (1 << 27)) != 0;
+    const bool avx     = (regs[2] & (1 << 28)) != 0;
+
+    if (!ssse3)
+        return AudioKernelIsa_Scalar;
+
+    // AVX2 needs the OS to save the YMM registers on context switch, as well as CPU support
+    if (maxLeaf >= 7 && osxsave && avx && (QueryXcr0() & 0x6) == 0x6)
+    {
+        QueryCpuId(7, 0, regs);
+        if (regs[1] & (1 << 5))
+            return AudioKernelIsa_AVX2;
+    }
+
+    return AudioKernelIsa_SSSE3;
+}
+
+
+AUDIO_TARGET_SSSE3
+void ShuffleSSSE3(const AudioShuffle::Op* ops, uint32_t numOps, uint32_t numChunks,
+                  const uint8_t* input, uint32_t inputStride,
+                  uint8_t* output, uint32_t outputStride,
+                  uint32_t numFrames)
+{
+    __m128i masks[16];
+    for (uint32_t i = 0; i < numOps; i++)
+        masks[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ops[i].mask));
+
+    for (uint32_t frame = 0; frame < numFrames; frame++)
+    {
+        __m128i chunks[4] = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+
+        for (uint32_t i = 0; i < numOps; i++)
+        {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + ops[i].srcBlock * 16));
+            chunks[ops[i].dstChunk] = _mm_or_si128(chunks[ops[i].dstChunk], _mm_shuffle_epi8(block, masks[i]));
+        }
+
+        // Chunks may spill into the start of the next output frame, which is overwritten on the next pass
+        for (uint32_t chunk = 0; chunk < numChunks; chunk++)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + chunk * 16), chunks[chunk]);
+
+        input  += inputStride;
+        output += outputStride;
+    }
+}
+
+
+AUDIO_TARGET_AVX2
+void ShuffleAVX2(const AudioShuffle::Op* ops, uint32_t numOps, uint32_t numChunks,
+                 const uint8_t* input, uint32_t inputStride,
+                 uint8_t* output, uint32_t outputStride,
+                 uint32_t numFrames)
+{
+    // Two frames per iteration: the first frame in the low lane, the second in the high lane,
+    // so that each vpshufb does the work of two pshufbs
+    __m256i masks[16];
+    for (uint32_t i = 0; i < numOps; i++)
+    {
+        const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ops[i].mask));
+        masks[i] = _mm256_inserti128_si256(_mm256_castsi128_si256(mask), mask, 1);
+    }
+
+    uint32_t frame = 0;
+
+    for (; frame + 2 <= numFrames; frame += 2)
+    {
+        __m256i chunks[4] = { _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256() };
+
+        for (uint32_t i = 0; i < numOps; i++)
+        {
+            const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + ops[i].srcBlock * 16));
+            const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + inputStride + ops[i].srcBlock * 16));
+            const __m256i blocks = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            chunks[ops[i].dstChunk] = _mm256_or_si256(chunks[ops[i].dstChunk], _mm256_shuffle_epi8(blocks, masks[i]));
+        }
+
+        // All of the first frame must be stored before the second, as its stores can spill into the second frame
+        for (uint32_t chunk = 0; chunk < numChunks; chunk++)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + chunk * 16), _mm256_castsi256_si128(chunks[chunk]));
+        for (uint32_t chunk = 0; chunk < numChunks; chunk++)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + outputStride + chunk * 16), _mm256_extracti128_si256(chunks[chunk], 1));
+
+        input  += inputStride * 2;
+        output += outputStride * 2;
+    }
+
+    if (frame < numFrames)
+        ShuffleSSSE3(ops, numOps, numChunks, input, inputStride, output, outputStride, numFrames - frame);
+}
+
+
+// Four channels per vector, so numChannels must be a multiple of 4
+AUDIO_TARGET_SSSE3
+void MeasureLevelsSSSE3(const uint8_t* cardAudio, uint32_t numChannels, uint32_t numSamples, LevelAccumulators& acc)
+{
+    const uint32_t numVectors = numChannels / 4;
+    const __m128i clipThreshold = _mm_set1_epi32(AUDIO_FULL_SCALE - 1);
+
+    __m128i peak[4], clips[4];
+    __m128d sumSquares[8];
+
+    for (uint32_t v = 0; v < numVectors; v++)
+    {
+        peak[v] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc.peak + v * 4));
+        clips[v] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc.clips + v * 4));
+        sumSquares[v * 2] = _mm_loadu_pd(acc.sumSquares + v * 4);
+        sumSquares[v * 2 + 1] = _mm_loadu_pd(acc.sumSquares + v * 4 + 2);
+    }
+
+    for (uint32_t sampleIdx = 0; sampleIdx < numSamples; sampleIdx++)
+    {
+        const uint8_t* frame = cardAudio + sampleIdx * numChannels * sizeof(int32_t);
+
+        for (uint32_t v = 0; v < numVectors; v++)
+        {
+            const __m128i sample = _mm_srai_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + v * 16)), 8);
+            const __m128i magnitude = _mm_abs_epi32(sample);
+
+            // No pmaxsd before SSE4.1, so select the larger with a compare
+            const __m128i greater = _mm_cmpgt_epi32(magnitude, peak[v]);
+            peak[v] = _mm_or_si128(_mm_and_si128(greater, magnitude), _mm_andnot_si128(greater, peak[v]));
+
+            // The compare gives -1 for each clipped lane
+            clips[v] = _mm_sub_epi32(clips[v], _mm_cmpgt_epi32(magnitude, clipThreshold));
+
+            const __m128d lo = _mm_cvtepi32_pd(sample);
+            const __m128d hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(sample, _MM_SHUFFLE(1, 0, 3, 2)));
+            sumSquares[v * 2] = _mm_add_pd(sumSquares[v * 2], _mm_mul_pd(lo, lo));
+            sumSquares[v * 2 + 1] = _mm_add_pd(sumSquares[v * 2 + 1], _mm_mul_pd(hi, hi));
+        }
+    }
+
+    for (uint32_t v = 0; v < numVectors; v++)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc.peak + v * 4), peak[v]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc.clips + v * 4), clips[v]);
+        _mm_storeu_pd(acc.sumSquares + v * 4, sumSquares[v * 2]);
+        _mm_storeu_pd(acc.sumSquares + v * 4 + 2, sumSquares[v * 2 + 1]);
+    }
+}
+
+
+// Eight channels per vector, so numChannels must be a multiple of 8
+AUDIO_TARGET_AVX2
+void MeasureLevelsAVX2(const uint8_t* cardAudio, uint32_t numChannels, uint32_t numSamples, LevelAccumulators& acc)
+{
+    const uint32_t numVectors = numChannels / 8;
+    const __m256i clipThreshold = _mm256_set1_epi32(AUDIO_FULL_SCALE - 1);
+
+    __m256i peak[2], clips[2];
+    __m256d sumSquares[4];
+
+    for (uint32_t v = 0; v < numVectors; v++)
+    {
+        peak[v] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc.peak + v * 8));
+        clips[v] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc.clips + v * 8));
+        sumSquares[v * 2] = _mm256_loadu_pd(acc.sumSquares + v * 8);
+        sumSquares[v * 2 + 1] = _mm256_loadu_pd(acc.sumSquares + v * 8 + 4);
+    }
+
+    for (uint32_t sampleIdx = 0; sampleIdx < numSamples; sampleIdx++)
+    {
+        const uint8_t* frame = cardAudio + sampleIdx * numChannels * sizeof(int32_t);
+
+        for (uint32_t v = 0; v < numVectors; v++)
+        {
+            const __m256i sample = _mm256_srai_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(frame + v * 32)), 8);
+            const __m256i magnitude = _mm256_abs_epi32(sample);
+
+            peak[v] = _mm256_max_epi32(peak[v], magnitude);
+            clips[v] = _mm256_sub_epi32(clips[v], _mm256_cmpgt_epi32(magnitude, clipThreshold));
+
+            // Multiply and add separately rather than fused, to match the scalar rounding exactly
+            const __m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(sample));
+            const __m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(sample, 1));
+            sumSquares[v * 2] = _mm256_add_pd(sumSquares[v * 2], _mm256_mul_pd(lo, lo));
+            sumSquares[v * 2 + 1] = _mm256_add_pd(sumSquares[v * 2 + 1], _mm256_mul_pd(hi, hi));
+        }
+    }
+
+    for (uint32_t v = 0; v < numVectors; v++)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc.peak + v * 8), peak[v]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc.clips + v * 8), clips[v]);
+        _mm256_storeu_pd(acc.sumSquares + v * 8, sumSquares[v * 2]);
+        _mm256_storeu_pd(acc.sumSquares + v * 8 + 4, sumSquares[v * 2 + 1]);
+    }
+}
+
+
+// Four outputs per vector, each lane accumulating its taps in the scalar order
+AUDIO_TARGET_SSSE3
+uint32_t FilterFirSSSE3(const float* input, const float* coeffs, uint32_t numTaps, uint32_t numOutputs, float* output)
+{
+    uint32_t n = 0;
+
+    for (; n + 4 <= numOutputs; n += 4)
+    {
+        __m128 sum = _mm_setzero_ps();
+
+        for (uint32_t tap = 0; tap < numTaps; tap++)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(coeffs[tap]), _mm_loadu_ps(input + n + tap)));
+
+        _mm_storeu_ps(output + n, sum);
+    }
+
+    return n;
+}
+
+
+AUDIO_TARGET_AVX2
+uint32_t FilterFirAVX2(const float* input, const float* coeffs, uint32_t numTaps, uint32_t numOutputs, float* output)
+{
+    uint32_t n = 0;
+
+    // Two vectors of outputs at a time, sharing the coefficient broadcasts
+    for (; n + 16 <= numOutputs; n += 16)
+    {
+        __m256 sum0 = _mm256_setzero_ps();
+        __m256 sum1 = _mm256_setzero_ps();
+
+        for (uint32_t tap = 0; tap < numTaps; tap++)
+        {
+            const __m256 coeff = _mm256_set1_ps(coeffs[tap]);
+            sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(coeff, _mm256_loadu_ps(input + n + tap)));
+            sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(coeff, _mm256_loadu_ps(input + n + 8 + tap)));
+        }
+
+        _mm256_storeu_ps(output + n, sum0);
+        _mm256_storeu_ps(output + n + 8, sum1);
+    }
+
+    for (; n + 8 <= numOutputs; n += 8)
+    {
+        __m256 sum = _mm256_setzero_ps();
+
+        for (uint32_t tap = 0; tap < numTaps; tap++)
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(coeffs[tap]), _mm256_loadu_ps(input + n + tap)));
+
+        _mm256_storeu_ps(output + n, sum);
+    }
+
+    return n;
+}
+
+#endif // AUDIO_KERNELS_X86
+
+// The best ISA once detected, or -1. At namespace scope, so it is set up as the module loads rather than on
+// first use, which MSVC 2013 doesn't make thread safe; capture threads on several channels then race to fill it in.
+std::atomic<int> bestIsa(-1);
+
+} // anonymous namespace
+
+
+bool IsAudioKernelIsaSupported(AudioKernelIsa isa)
+{
+    return isa >= AudioKernelIsa_Scalar && isa <= GetBestAudioKernelIsa();
+}
+
+
+AudioKernelIsa GetBestAudioKernelIsa()
+{
+    // Every thread that gets here first detects the same value, so the order they store it in doesn't matter
+    int isa = bestIsa.load(std::memory_order_relaxed);
+
+    if (isa < 0)
+    {
+#ifdef AUDIO_KERNELS_X86
+        isa = DetectBestIsa();
+#else
+        isa = AudioKernelIsa_Scalar;
+#endif
+        bestIsa.store(isa, std::memory_order_relaxed);
+    }
+
+    return static_cast<AudioKernelIsa>(isa);
+}
+
+
+const char* AudioKernelIsaName(AudioKernelIsa isa)
+{
+    switch (isa)
+    {
+        case AudioKernelIsa_Scalar: return "scalar";
+        case AudioKernelIsa_SSSE3:  return "ssse3";
+        case AudioKernelIsa_AVX2:   return "avx2";
+        default:                    return "unknown";
+    }
+}
+
+
+void MeasureAudioLevels(const uint8_t* cardAudio, uint32_t numChannels, uint32_t numSamples, AudioKernelIsa isa, AudioLevels& levels)
+{
+    LevelAccumulators acc;
+    memset(&acc, 0, sizeof(acc));
+    memset(&levels, 0, sizeof(levels));
+
+    if (numChannels > AudioLevels::MAX_CHANNELS)
+        numChannels = AudioLevels::MAX_CHANNELS;
+
+    levels.numChannels = numChannels;
+
+    if (numChannels == 0 || numSamples == 0)
+        return;
+
+    bool measured(false);
+
+#ifdef AUDIO_KERNELS_X86
+    if (isa == AudioKernelIsa_AVX2 && (numChannels % 8) == 0 && IsAudioKernelIsaSupported(isa))
+    {
+        MeasureLevelsAVX2(cardAudio, numChannels, numSamples, acc);
+        measured = true;
+    }
+    else if (isa != AudioKernelIsa_Scalar && (numChannels % 4) == 0 && IsAudioKernelIsaSupported(AudioKernelIsa_SSSE3))
+    {
+        MeasureLevelsSSSE3(cardAudio, numChannels, numSamples, acc);
+        measured = true;
+    }
+#else
+    (void)isa;
+#endif
+
+    if (!measured)
+        MeasureLevelsScalar(cardAudio, numChannels, numSamples, acc);
+
+    for (uint32_t channel = 0; channel < numChannels; channel++)
+    {
+        levels.peak[channel] = static_cast<float>(acc.peak[channel] * AUDIO_LEVEL_SCALE);
+        levels.rms[channel] = static_cast<float>(sqrt(acc.sumSquares[channel] / numSamples) * AUDIO_LEVEL_SCALE);
+        levels.clipCount[channel] = acc.clips[channel];
+    }
+}
+
+
+void FilterFir(const float* input, const float* coeffs, uint32_t numTaps, uint32_t numOutputs, float* output, AudioKernelIsa isa)
+{
+    uint32_t filtered(0);
+
+#ifdef AUDIO_KERNELS_X86
+    if (isa == AudioKernelIsa_AVX2 && IsAudioKernelIsaSupported(isa))
+        filtered = FilterFirAVX2(input, coeffs, numTaps, numOutputs, output);
+    else if (isa != AudioKernelIsa_Scalar && IsAudioKernelIsaSupported(AudioKernelIsa_SSSE3))
+        filtered = FilterFirSSSE3(input, coeffs, numTaps, numOutputs, output);
+#else
+    (void)isa;
+#endif
+
+    // The scalar loop picks up whatever did not fill a whole vector
+    FilterFirScalar(input, coeffs, numTaps, filtered, numOutputs, output);
+}
+
+
+AudioShuffle::AudioShuffle()
+:   inputStride_(0),
+    outputStride_(0),
+    numChunks_(0),
+    simdTailBytes_(0),
+    simdCapable_(false)
+{
+    memset(byteSources_, 0, sizeof(byteSources_));
+}
+
+
+bool AudioShuffle::Build(uint32_t inputStrideBytes, const std::vector<int8_t>& byteSources)
+{
+    inputStride_ = 0;
+    outputStride_ = 0;
+    ops_.clear();
+
+    if (inputStrideBytes == 0 || inputStrideBytes > MAX_INPUT_STRIDE || byteSources.empty() || byteSources.size() > MAX_OUTPUT_STRIDE)
+        return false;
+
+    for (size_t i = 0; i < byteSources.size(); i++)
+    {
+        if (byteSources[i] != ZERO_BYTE && (byteSources[i] < 0 || static_cast<uint32_t>(byteSources[i]) >= inputStrideBytes))
+            return false;
+
+        byteSources_[i] = byteSources[i];
+    }
+
+    inputStride_   = inputStrideBytes;
+    outputStride_  = static_cast<uint32_t>(byteSources.size());
+    numChunks_     = (outputStride_ + 15) / 16;
+    simdTailBytes_ = numChunks_ * 16 - outputStride_;
+
+    // The SIMD kernels load whole 16 byte blocks, so the input frame must be a whole number of blocks
+    simdCapable_ = (inputStride_ % 16) == 0;
+
+    const uint32_t numBlocks = inputStride_ / 16;
+
+    for (uint32_t chunk = 0; chunk < numChunks_ && simdCapable_; chunk++)
+    {
+        for (uint32_t block = 0; block < numBlocks; block++)
+        {
+            Op op;
+            bool used(false);
+
+            op.srcBlock = static_cast<uint8_t>(block);
+            op.dstChunk = static_cast<uint8_t>(chunk);
+
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                const uint32_t outIdx = chunk * 16 + i;
+                int src = ZERO_BYTE;
+
+                if (outIdx < outputStride_)
+                    src = byteSources_[outIdx];
+
+                if (src != ZERO_BYTE && static_cast<uint32_t>(src) / 16 == block)
+                {
+                    op.mask[i] = static_cast<uint8_t>(src % 16);
+                    used = true;
+                }
+                else
+                {
+                    op.mask[i] = 0x80; // pshufb writes zero for any mask byte with the top bit set
+                }
+            }
+
+            if (used)
+                ops_.push_back(op);
+        }
+    }
+
+    return true;
+}
+
+
+uint32_t AudioShuffle::Run(const uint8_t* input, uint8_t* output, uint32_t numFrames, AudioKernelIsa isa) const
+{
+    if (!IsValid())
+        return 0;
+
+    uint32_t simdFrames(0);
+
+#ifdef AUDIO_KERNELS_X86
+    if (simdCapable_ && isa != AudioKernelIsa_Scalar && IsAudioKernelIsaSupported(isa))
+    {
+        // The last few frames are left to the scalar loop, so the SIMD stores never spill past the end of the output
+        const uint32_t tailFrames = (simdTailBytes_ + outputStride_ - 1) / outputStride_;
+        simdFrames = numFrames > tailFrames ? numFrames - tailFrames : 0;
+
+        const Op* ops = ops_.empty() ? nullptr : &ops_[0];
+        const uint32_t numOps = static_cast<uint32_t>(ops_.size());
+
+        if (isa == AudioKernelIsa_AVX2)
+            ShuffleAVX2(ops, numOps, numChunks_, input, inputStride_, output, outputStride_, simdFrames);
+        else
+            ShuffleSSSE3(ops, numOps, numChunks_, input, inputStride_, output, outputStride_, simdFrames);
+    }
+#else
+    (void)isa;
+#endif
+
+    RunScalar(input, output, simdFrames, numFrames);
+
+    return numFrames * outputStride_;
+}
+
+
+void AudioShuffle::RunScalar(const uint8_t* input, uint8_t* output, uint32_t firstFrame, uint32_t numFrames) const
+{
+    for (uint32_t frame = firstFrame; frame < numFrames; frame++)
+    {
+        const uint8_t* in = input + frame * inputStride_;
+        uint8_t* out = output + frame * outputStride_;
+
+        for (uint32_t i = 0; i < outputStride_; i++)
+            out[i] = byteSources_[i] == ZERO_BYTE ? 0 : in[byteSources_[i]];
+    }
+}
+
+}
+}
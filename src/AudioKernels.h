@@ -0,0 +1,116 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+// Instruction sets the audio kernels can be dispatched to, in increasing order of preference
+enum AudioKernelIsa
+{
+    AudioKernelIsa_Scalar = 0,
+    AudioKernelIsa_SSSE3,
+    AudioKernelIsa_AVX2,
+    AudioKernelIsa_LAST
+};
+
+// Returns true if both the host CPU and the compiler support the given instruction set
+bool IsAudioKernelIsaSupported(AudioKernelIsa isa);
+
+// Returns the most capable instruction set supported on this host. The CPU is only queried once.
+AudioKernelIsa GetBestAudioKernelIsa();
+
+// Returns a printable name for the instruction set, for logging
+const char* AudioKernelIsaName(AudioKernelIsa isa);
+
+
+// Peak, RMS and clip count for each channel of a block of card audio. Levels are linear, relative to full scale.
+struct AudioLevels
+{
+    static const uint32_t MAX_CHANNELS = 16;
+
+    uint32_t numChannels;
+    float    peak[MAX_CHANNELS];
+    float    rms[MAX_CHANNELS];
+    uint32_t clipCount[MAX_CHANNELS];   // Samples at positive or negative full scale
+};
+
+// Measure numSamples samples of interleaved card audio (24 bit audio in the top three bytes of each 32 bit word).
+// The SIMD kernels accumulate each channel in the same order as the scalar loop, so all give identical results.
+void MeasureAudioLevels(const uint8_t* cardAudio, uint32_t numChannels, uint32_t numSamples, AudioKernelIsa isa, AudioLevels& levels);
+
+
+// Direct form FIR over a single channel: output[n] = sum of coeffs[t] * input[n + t] for t < numTaps, so input
+// must hold numOutputs + numTaps - 1 samples. The SIMD kernels compute several outputs at once, summing the
+// taps in the same order as the scalar loop and without fused multiply-add, so all give identical results.
+void FilterFir(const float* input, const float* coeffs, uint32_t numTaps, uint32_t numOutputs, float* output, AudioKernelIsa isa);
+
+
+// A precompiled byte shuffle over interleaved audio. Each input frame (one sample for every channel)
+// is rearranged into an output frame, where every output byte is either copied from a fixed byte
+// offset within the input frame or set to zero. Channel selection, reordering, sample truncation and
+// byte order conversion can all be expressed this way, so one set of SIMD kernels covers them all.
+class AudioShuffle
+{
+public:
+
+    static const uint32_t MAX_INPUT_STRIDE  = 64;   // 16 channels of 32 bit samples
+    static const uint32_t MAX_OUTPUT_STRIDE = 64;
+    static const int8_t   ZERO_BYTE         = -1;
+
+    AudioShuffle();
+
+    // Build the shuffle. byteSources holds one entry per output byte: the offset of the input byte
+    // to copy, or ZERO_BYTE. Returns false if the strides or offsets are out of range.
+    bool Build(uint32_t inputStrideBytes, const std::vector<int8_t>& byteSources);
+
+    // Shuffle numFrames frames from input to output, returning the number of bytes written.
+    // Falls back to the scalar loop if the requested instruction set cannot be used.
+    uint32_t Run(const uint8_t* input, uint8_t* output, uint32_t numFrames, AudioKernelIsa isa) const;
+
+    bool IsValid() const { return outputStride_ != 0; }
+    uint32_t InputStride() const { return inputStride_; }
+    uint32_t OutputStride() const { return outputStride_; }
+
+    // One pshufb step: gather bytes from a 16 byte block of the input frame into a 16 byte chunk of the output frame
+    struct Op
+    {
+        uint8_t srcBlock;
+        uint8_t dstChunk;
+        uint8_t mask[16];
+    };
+
+private:
+
+    void RunScalar(const uint8_t* input, uint8_t* output, uint32_t firstFrame, uint32_t numFrames) const;
+
+    uint32_t inputStride_;
+    uint32_t outputStride_;
+    uint32_t numChunks_;        // Number of 16 byte stores needed per output frame
+    uint32_t simdTailBytes_;    // Bytes written past the end of an output frame by the SIMD stores
+    bool     simdCapable_;
+    int8_t   byteSources_[MAX_OUTPUT_STRIDE];
+    std::vector<Op> ops_;
+};
+
+}
+}
@@ -0,0 +1,213 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "AudioResampler.h"
+#include <math.h>
+#include <string.h>
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+namespace
+{
+
+const double PI = 3.14159265358979323846;
+
+// Kaiser window shape: about 100dB of stopband rejection, with the passband flat to 20kHz
+const double KAISER_BETA = 10.0;
+
+
+double BesselI0(double x)
+{
+    double sum(1.0), term(1.0);
+
+    for (int k = 1; k < 50; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+}
+
+
+AudioResampler::AudioResampler()
+:   mode_(Mode_Upsample2x),
+    numChannels_(0),
+    pendingValid_(false)
+{
+    // The full filter has 2 * BRANCH_TAPS - 1 taps, centred on 0.5 at tap HISTORY. Its even taps are the
+    // windowed sinc at the odd offsets from the centre; the odd taps, other than the centre, are all zero.
+    const double centre = HISTORY;
+    double sum(0.0);
+    double coeffs[BRANCH_TAPS];
+
+    for (uint32_t i = 0; i < BRANCH_TAPS; i++)
+    {
+        const double offset = 2.0 * i - centre;
+        const double sinc = sin(PI * offset / 2.0) / (PI * offset);
+        const double ratio = offset / centre;
+        const double window = BesselI0(KAISER_BETA * sqrt(1.0 - ratio * ratio)) / BesselI0(KAISER_BETA);
+
+        coeffs[i] = sinc * window;
+        sum += coeffs[i];
+    }
+
+    // Normalise so the branch and the centre tap each have a DC gain of exactly 0.5
+    for (uint32_t i = 0; i < BRANCH_TAPS; i++)
+        branchCoeffs_[i] = static_cast<float>(coeffs[i] * 0.5 / sum);
+}
+
+
+bool AudioResampler::Configure(Mode mode, uint32_t numChannels)
+{
+    if (numChannels == 0 || numChannels > MAX_CHANNELS)
+        return false;
+
+    mode_ = mode;
+    numChannels_ = numChannels;
+
+    branch_.assign(numChannels, std::vector<float>(HISTORY, 0.0f));
+    delay_.assign(numChannels, std::vector<float>(HISTORY, 0.0f));
+    pending_.assign(numChannels, 0.0f);
+
+    Reset();
+
+    return true;
+}
+
+
+void AudioResampler::Reset()
+{
+    for (uint32_t channel = 0; channel < numChannels_; channel++)
+    {
+        branch_[channel].assign(HISTORY, 0.0f);
+        delay_[channel].assign(HISTORY, 0.0f);
+        pending_[channel] = 0.0f;
+    }
+
+    pendingValid_ = false;
+}
+
+
+uint32_t AudioResampler::Process(const float* input, uint32_t numInputSamples, float* output, AudioKernelIsa isa)
+{
+    if (numChannels_ == 0)
+        return 0;
+
+    return mode_ == Mode_Upsample2x ? Upsample(input, numInputSamples, output, isa) : Downsample(input, numInputSamples, output, isa);
+}
+
+
+uint32_t AudioResampler::GetMaxOutputSamples(uint32_t numInputSamples) const
+{
+    return mode_ == Mode_Upsample2x ? numInputSamples * 2 : (numInputSamples + (pendingValid_ ? 1 : 0)) / 2;
+}
+
+
+uint32_t AudioResampler::GetMaxInputSamples(uint32_t maxOutputSamples) const
+{
+    return mode_ == Mode_Upsample2x ? maxOutputSamples / 2 : maxOutputSamples * 2 + (pendingValid_ ? 0 : 1);
+}
+
+
+uint32_t AudioResampler::Upsample(const float* input, uint32_t numInputSamples, float* output, AudioKernelIsa isa)
+{
+    // The even outputs come from the FIR branch, and the odd outputs are the input delayed to line up with it:
+    // output 2n is centred on input n - 19.5, so output 2n + 1 falls exactly on input n - 19
+    const uint32_t delayTap = (HISTORY + 1) / 2;
+
+    filtered_.resize(numInputSamples);
+
+    for (uint32_t channel = 0; channel < numChannels_; channel++)
+    {
+        std::vector<float>& work = branch_[channel];
+        work.resize(HISTORY + numInputSamples);
+
+        for (uint32_t n = 0; n < numInputSamples; n++)
+            work[HISTORY + n] = input[n * numChannels_ + channel];
+
+        if (numInputSamples > 0)
+            FilterFir(&work[0], branchCoeffs_, BRANCH_TAPS, numInputSamples, &filtered_[0], isa);
+
+        for (uint32_t n = 0; n < numInputSamples; n++)
+        {
+            // The branch coefficients sum to 0.5, and zero stuffing halves the level, so the FIR output is doubled
+            output[(2 * n) * numChannels_ + channel] = 2.0f * filtered_[n];
+            output[(2 * n + 1) * numChannels_ + channel] = work[n + delayTap];
+        }
+
+        // Keep the most recent samples for next time
+        memmove(&work[0], &work[numInputSamples], HISTORY * sizeof(float));
+        work.resize(HISTORY);
+    }
+
+    return numInputSamples * 2;
+}
+
+
+uint32_t AudioResampler::Downsample(const float* input, uint32_t numInputSamples, float* output, AudioKernelIsa isa)
+{
+    // Each output takes an even input sample into the FIR branch, and the following odd sample through the
+    // centre tap: output n sees odd sample n - 20, which is input 2n - 39, the centre of the full filter
+    const uint32_t delayTap = HISTORY / 2;
+    const uint32_t pendingCount = pendingValid_ ? 1 : 0;
+    const uint32_t totalSamples = numInputSamples + pendingCount;
+    const uint32_t numOutputs = totalSamples / 2;
+
+    filtered_.resize(numOutputs);
+
+    for (uint32_t channel = 0; channel < numChannels_; channel++)
+    {
+        std::vector<float>& even = branch_[channel];
+        std::vector<float>& odd = delay_[channel];
+        even.resize(HISTORY + numOutputs);
+        odd.resize(HISTORY + numOutputs);
+
+        for (uint32_t n = 0; n < numOutputs; n++)
+        {
+            // Sample indices count the pending sample, if there is one, as the first
+            const uint32_t evenIdx = 2 * n;
+            even[HISTORY + n] = (evenIdx < pendingCount) ? pending_[channel] : input[(evenIdx - pendingCount) * numChannels_ + channel];
+            odd[HISTORY + n] = input[(evenIdx + 1 - pendingCount) * numChannels_ + channel];
+        }
+
+        if (totalSamples % 2)
+            pending_[channel] = numInputSamples > 0 ? input[(numInputSamples - 1) * numChannels_ + channel] : pending_[channel];
+
+        if (numOutputs > 0)
+            FilterFir(&even[0], branchCoeffs_, BRANCH_TAPS, numOutputs, &filtered_[0], isa);
+
+        for (uint32_t n = 0; n < numOutputs; n++)
+            output[n * numChannels_ + channel] = filtered_[n] + 0.5f * odd[n + delayTap];
+
+        memmove(&even[0], &even[numOutputs], HISTORY * sizeof(float));
+        memmove(&odd[0], &odd[numOutputs], HISTORY * sizeof(float));
+        even.resize(HISTORY);
+        odd.resize(HISTORY);
+    }
+
+    pendingValid_ = (totalSamples % 2) != 0;
+
+    return numOutputs;
+}
+
+}
+}
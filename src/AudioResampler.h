@@ -0,0 +1,87 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "AudioKernels.h"
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+// Converts interleaved float audio between 48kHz and 96kHz with a halfband polyphase FIR. Every other
+// coefficient of a halfband filter is zero, so each direction is one FIR branch plus a pure delay. The
+// filter history is carried from one call to the next, so audio split into frames resamples exactly as
+// it would in one piece.
+class AudioResampler
+{
+public:
+
+    enum Mode
+    {
+        Mode_Upsample2x,        // 48kHz to 96kHz
+        Mode_Downsample2x       // 96kHz to 48kHz
+    };
+
+    static const uint32_t MAX_CHANNELS = 16;
+    static const uint32_t BRANCH_TAPS = 40;                     // Non-zero taps outside the centre of the 79 tap halfband filter
+    static const uint32_t HISTORY = BRANCH_TAPS - 1;
+
+    AudioResampler();
+
+    // Set the direction and channel count, and clear the history. Returns false if the channel count is out of range.
+    bool Configure(Mode mode, uint32_t numChannels);
+
+    // Clear the history, as if the audio had been silent up to now
+    void Reset();
+
+    // Resample numInputSamples interleaved samples into output, returning the number of samples written,
+    // which is never more than GetMaxOutputSamples(numInputSamples)
+    uint32_t Process(const float* input, uint32_t numInputSamples, float* output, AudioKernelIsa isa);
+
+    uint32_t GetMaxOutputSamples(uint32_t numInputSamples) const;
+
+    // The largest input that is certain to produce no more than maxOutputSamples
+    uint32_t GetMaxInputSamples(uint32_t maxOutputSamples) const;
+
+    Mode GetMode() const { return mode_; }
+    uint32_t GetNumChannels() const { return numChannels_; }
+
+private:
+
+    uint32_t Upsample(const float* input, uint32_t numInputSamples, float* output, AudioKernelIsa isa);
+    uint32_t Downsample(const float* input, uint32_t numInputSamples, float* output, AudioKernelIsa isa);
+
+    Mode     mode_;
+    uint32_t numChannels_;
+    float    branchCoeffs_[BRANCH_TAPS];
+
+    // Per channel working buffers: HISTORY samples carried over from the last call, followed by the new samples.
+    // On downsampling, the even input samples feed the FIR branch and the odd ones the delay.
+    std::vector<std::vector<float>> branch_;
+    std::vector<std::vector<float>> delay_;
+    std::vector<float> filtered_;
+
+    // On downsampling, an odd input sample left over from the last call, waiting for its partner
+    bool               pendingValid_;
+    std::vector<float> pending_;
+};
+
+}
+}
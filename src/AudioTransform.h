@@ -16,9 +16,13 @@
 #pragma once
 
 #include <cstdint>
-#include <tuple>
+#include <cstring>
+#include <memory>
+#include <vector>
 #include <assert.h>
-#include "ntv2capture.h"
+#include "AudioKernels.h"
+#include "AudioConverter.h"
+#include "AudioResampler.h"
 
 namespace streampunk
 {
@@ -26,113 +30,501 @@ namespace streampunk
 namespace Aja
 {
 
+// Converts between the card's audio layout and the client's. The transforms write straight into a buffer
+// owned by the caller - a Node Buffer on capture, the player's host audio buffer on playback - so there is
+// no staging copy, and the output size can be queried up front to allocate exactly what is needed.
+// The card always runs at 48kHz; clients at 96kHz go through a resampler, which does need a float staging buffer.
 class AudioTransform
 {
-    static const uint32_t MAX_BUFFER_SIZE = NTV2_AUDIOSIZE_MAX;
     static const uint32_t AUDIO_4BYTE_SAMPLE_SIZE_BYTES = 4; // 24bit audio in 32bit buffers
     static const uint32_t AUDIO_3BYTE_SAMPLE_SIZE_BYTES = 3; // 24bit audio
 
 public:
 
+    static const uint32_t MAX_CARD_CHANNELS = AudioShuffle::MAX_INPUT_STRIDE / AUDIO_4BYTE_SAMPLE_SIZE_BYTES;
+    static const uint32_t DEFAULT_CARD_CHANNELS = 16;
+    static const uint32_t DEFAULT_CLIENT_CHANNELS = 2;
+    static const uint32_t CARD_SAMPLE_RATE = 48000;
+    static const uint32_t HIGH_SAMPLE_RATE = 96000;
+
     AudioTransform()
+    :   isa_(GetBestAudioKernelIsa()),
+        fromCardCardChannels_(0),
+        fromCardSampleType_(AudioSampleType_S24),
+        fromCardSampleRate_(CARD_SAMPLE_RATE),
+        toCardCardChannels_(0),
+        toCardSampleRate_(CARD_SAMPLE_RATE)
     {
+        // Default routing is the first two card channels to and from a stereo client
+        std::vector<uint32_t> stereo;
+        for (uint32_t channel = 0; channel < DEFAULT_CLIENT_CHANNELS; channel++)
+            stereo.push_back(channel);
+
+        SetFromCardChannelMap(DEFAULT_CARD_CHANNELS, stereo);
+        SetToCardChannelMap(DEFAULT_CARD_CHANNELS, stereo);
     }
 
 
-    std::tuple<const char*, uint32_t> TransformFromCard(const char* inputBuffer, uint32_t inputBufferSize, uint32_t inputChannels, uint32_t outputChannels)
+    // Build the capture routing plan: client channel N is taken from card channel channelMap[N] and converted
+    // to sampleType (an AudioSampleType, optionally with AudioSampleType_Planar set). Card channels may be
+    // repeated or omitted. Returns false (leaving the plan unchanged) if the map or sample type is invalid.
+    bool SetFromCardFormat(uint32_t cardChannels, const std::vector<uint32_t>& channelMap, uint32_t sampleType)
     {
-        // For the time being, just to be safe
-        assert(inputChannels == 16);
-        assert(outputChannels == 2);
+        if (!IsValidChannelMap(cardChannels, channelMap, false))
+            return false;
 
-        uint32_t strideBytes = inputChannels * AUDIO_4BYTE_SAMPLE_SIZE_BYTES; // where stride is the distance between subsequent samples across all channels
+        std::unique_ptr<AudioConverter> converter = CreateAudioConverter(sampleType, static_cast<uint32_t>(channelMap.size()));
+        if (!converter)
+            return false;
 
-        uint32_t numSamples = inputBufferSize / strideBytes;
-        uint32_t bytesWritten = 0;
-        uint32_t bytesRead = 0;
-        const char* readBuffer = inputBuffer;
-        char* writeBuffer = outputBuffer;
+        // Interleaved integer formats are pure byte rearrangements of the card words, so they can also be
+        // precompiled into a shuffle for the SIMD kernels. Float and planar output always use the converter.
+        std::vector<int8_t> byteSources;
 
-        for(uint32_t sampleIdx = 0; sampleIdx < numSamples; sampleIdx++)
+        if ((sampleType & AudioSampleType_Planar) == 0)
         {
-            // Convert the 4bytes of each channel data into a 24 bit sample
-            // Left Channel
-            int sample = *(int *)readBuffer;
-            sample = (sample & 0xFF000000) >> 24 | (sample & 0x00FF0000) >> 8 | (sample & 0x0000FF00) << 8 | (sample & 0x000000FF) << 24;
-            sample = sample & 0x00FFFFFF;
-            memcpy_s(writeBuffer, MAX_BUFFER_SIZE - bytesWritten, (void *)&sample, AUDIO_3BYTE_SAMPLE_SIZE_BYTES);
-
-            bytesWritten += AUDIO_3BYTE_SAMPLE_SIZE_BYTES;
-            writeBuffer  += AUDIO_3BYTE_SAMPLE_SIZE_BYTES;
-
-            // Right Channel
-            sample = *(int *)&readBuffer[AUDIO_4BYTE_SAMPLE_SIZE_BYTES];
-            sample = (sample & 0xFF000000) >> 24 | (sample & 0x00FF0000) >> 8 | (sample & 0x0000FF00) << 8 | (sample & 0x000000FF) << 24;
-            sample = sample & 0x00FFFFFF;
-            memcpy_s(writeBuffer, MAX_BUFFER_SIZE - bytesWritten, (void *)&sample, AUDIO_3BYTE_SAMPLE_SIZE_BYTES);
-
-            bytesWritten += AUDIO_3BYTE_SAMPLE_SIZE_BYTES;
-            writeBuffer  += AUDIO_3BYTE_SAMPLE_SIZE_BYTES;
-            readBuffer   += strideBytes;
-            bytesRead    += strideBytes;
+            for (auto cardChannel : channelMap)
+            {
+                const uint32_t sampleOffset = cardChannel * AUDIO_4BYTE_SAMPLE_SIZE_BYTES;
+
+                switch (sampleType)
+                {
+                    case AudioSampleType_S16:
+                        byteSources.push_back(static_cast<int8_t>(sampleOffset + 2));
+                        byteSources.push_back(static_cast<int8_t>(sampleOffset + 3));
+                        break;
+                    case AudioSampleType_S24:
+                        // The top three bytes of the card sample in reverse order, as the original client format
+                        byteSources.push_back(static_cast<int8_t>(sampleOffset + 3));
+                        byteSources.push_back(static_cast<int8_t>(sampleOffset + 2));
+                        byteSources.push_back(static_cast<int8_t>(sampleOffset + 1));
+                        break;
+                    case AudioSampleType_S32:
+                        for (uint32_t i = 0; i < AUDIO_4BYTE_SAMPLE_SIZE_BYTES; i++)
+                            byteSources.push_back(static_cast<int8_t>(sampleOffset + i));
+                        break;
+                    default:
+                        break;
+                }
+            }
         }
 
-        assert(bytesRead == inputBufferSize);
+        AudioShuffle shuffle;
+        if (!byteSources.empty() && !shuffle.Build(cardChannels * AUDIO_4BYTE_SAMPLE_SIZE_BYTES, byteSources))
+            return false;
+
+        fromCardShuffle_ = shuffle;
+        fromCardConverter_ = std::move(converter);
+        fromCardCardChannels_ = cardChannels;
+        fromCardMap_ = channelMap;
+        fromCardSampleType_ = sampleType;
+
+        // Resampled audio is staged as one word per client channel, so it is converted through an identity map
+        fromCardIdentityMap_.clear();
+        for (uint32_t channel = 0; channel < channelMap.size(); channel++)
+            fromCardIdentityMap_.push_back(channel);
+
+        // The channel count may have changed, so the resampler history has to start again
+        SetFromCardSampleRate(fromCardSampleRate_);
+
+        return true;
+    }
+
+
+    // Deliver captured audio at 48kHz, as it comes from the card, or upsampled to 96kHz. Returns false for any other rate.
+    bool SetFromCardSampleRate(uint32_t sampleRate)
+    {
+        if (sampleRate != CARD_SAMPLE_RATE && sampleRate != HIGH_SAMPLE_RATE)
+            return false;
+
+        if (sampleRate == HIGH_SAMPLE_RATE && !fromCardResampler_.Configure(AudioResampler::Mode_Upsample2x, GetFromCardClientChannels()))
+            return false;
+
+        fromCardSampleRate_ = sampleRate;
+
+        return true;
+    }
+
+
+    // As SetFromCardFormat, keeping the current sample type
+    bool SetFromCardChannelMap(uint32_t cardChannels, const std::vector<uint32_t>& channelMap)
+    {
+        return SetFromCardFormat(cardChannels, channelMap, fromCardSampleType_);
+    }
+
+
+    // Build the playback routing plan: client channel N is written to card channel channelMap[N].
+    // Each card channel may only be written once; unrouted card channels are silent.
+    bool SetToCardChannelMap(uint32_t cardChannels, const std::vector<uint32_t>& channelMap)
+    {
+        if (!IsValidChannelMap(cardChannels, channelMap, true))
+            return false;
+
+        // For each card channel, the client channel that feeds it - or -1 for silence
+        toCardSources_.assign(cardChannels, -1);
+        for (uint32_t channel = 0; channel < channelMap.size(); channel++)
+            toCardSources_[channelMap[channel]] = static_cast<int>(channel);
+
+        toCardCardChannels_ = cardChannels;
+        toCardMap_ = channelMap;
 
-        return std::make_tuple(outputBuffer, bytesWritten);
+        SetToCardSampleRate(toCardSampleRate_);
+
+        return true;
     }
 
 
-    std::tuple<const char*, uint32_t> TransformToCard(const char* inputBuffer, uint32_t inputBufferSize, uint32_t inputChannels, uint32_t outputChannels)
+    // Accept client audio for playback at 48kHz, or at 96kHz to be downsampled. Returns false for any other rate.
+    bool SetToCardSampleRate(uint32_t sampleRate)
     {
-        // For the time being, just to be safe
-        assert(inputChannels == 2);
-        assert(outputChannels == 16);
+        if (sampleRate != CARD_SAMPLE_RATE && sampleRate != HIGH_SAMPLE_RATE)
+            return false;
+
+        if (sampleRate == HIGH_SAMPLE_RATE && !toCardResampler_.Configure(AudioResampler::Mode_Downsample2x, GetToCardClientChannels()))
+            return false;
+
+        toCardSampleRate_ = sampleRate;
+
+        return true;
+    }
 
-        uint32_t inputStrideBytes = inputChannels * AUDIO_3BYTE_SAMPLE_SIZE_BYTES;
-        uint32_t outputStrideBytes = outputChannels * AUDIO_4BYTE_SAMPLE_SIZE_BYTES; // where stride is the distance between subsequent samples across all channels
+
+    uint32_t GetFromCardClientChannels() const { return static_cast<uint32_t>(fromCardMap_.size()); }
+    uint32_t GetFromCardSampleType() const { return fromCardSampleType_; }
+    uint32_t GetFromCardSampleRate() const { return fromCardSampleRate_; }
+    uint32_t GetToCardClientChannels() const { return static_cast<uint32_t>(toCardMap_.size()); }
+    uint32_t GetToCardSampleRate() const { return toCardSampleRate_; }
+
+
+    // Override the instruction set used by the transform kernels - requests for an unsupported set fall back to the best available
+    void SetKernelIsa(AudioKernelIsa isa)
+    {
+        isa_ = IsAudioKernelIsaSupported(isa) ? isa : GetBestAudioKernelIsa();
+    }
+
+    AudioKernelIsa GetKernelIsa() const { return isa_; }
+
+
+    // The number of bytes TransformFromCard will write for inputBufferSize bytes of card audio
+    uint32_t GetFromCardOutputSize(uint32_t inputBufferSize) const
+    {
+        return (inputBufferSize / GetFromCardInputStride()) * GetFromCardRateRatio() * GetFromCardOutputStride();
+    }
+
+
+    // Transform card audio into outputBuffer, returning the number of bytes written. Any samples that
+    // would not fit in outputBufferSize bytes are dropped. Channels in the card channel pairs flagged in
+    // nonPcmPairs (bit N for card channels 2N and 2N + 1) carry a bitstream such as Dolby E, and are passed
+    // through untouched - see CopyNonPcmFromCard. A bitstream cannot be resampled, so at 96kHz they are silenced.
+    uint32_t TransformFromCard(const char* inputBuffer, uint32_t inputBufferSize, char* outputBuffer, uint32_t outputBufferSize, uint32_t nonPcmPairs = 0)
+    {
+        uint32_t bytesWritten;
+
+        if (fromCardSampleRate_ != CARD_SAMPLE_RATE)
+        {
+            return TransformFromCardResampled(inputBuffer, inputBufferSize, outputBuffer, outputBufferSize, nonPcmPairs);
+        }
+
+        if (isa_ == AudioKernelIsa_Scalar || !fromCardShuffle_.IsValid())
+        {
+            bytesWritten = TransformFromCardReference(inputBuffer, inputBufferSize, outputBuffer, outputBufferSize);
+        }
+        else
+        {
+            uint32_t numSamples = GetFromCardNumSamples(inputBufferSize, outputBufferSize);
+            bytesWritten = fromCardShuffle_.Run(reinterpret_cast<const uint8_t*>(inputBuffer), reinterpret_cast<uint8_t*>(outputBuffer), numSamples, isa_);
+        }
+
+        if (nonPcmPairs != 0)
+        {
+            CopyNonPcmFromCard(reinterpret_cast<const uint8_t*>(inputBuffer), GetFromCardNumSamples(inputBufferSize, outputBufferSize),
+                               reinterpret_cast<uint8_t*>(outputBuffer), nonPcmPairs);
+        }
+
+        return bytesWritten;
+    }
+
+
+    // The scalar converter for the current sample type, kept as the reference for the SIMD kernels and
+    // used directly for float and planar output and on hosts without SSSE3
+    uint32_t TransformFromCardReference(const char* inputBuffer, uint32_t inputBufferSize, char* outputBuffer, uint32_t outputBufferSize) const
+    {
+        uint32_t numSamples = GetFromCardNumSamples(inputBufferSize, outputBufferSize);
+        return fromCardConverter_->Convert(reinterpret_cast<const uint8_t*>(inputBuffer), fromCardCardChannels_, fromCardMap_.data(),
+                                           numSamples, reinterpret_cast<uint8_t*>(outputBuffer));
+    }
+
+
+    // The number of bytes TransformToCard will write for inputBufferSize bytes of client audio
+    uint32_t GetToCardOutputSize(uint32_t inputBufferSize) const
+    {
+        uint32_t numSamples = inputBufferSize / (GetToCardClientChannels() * AUDIO_3BYTE_SAMPLE_SIZE_BYTES);
+
+        if (toCardSampleRate_ != CARD_SAMPLE_RATE)
+            numSamples = toCardResampler_.GetMaxOutputSamples(numSamples);
+
+        return numSamples * toCardCardChannels_ * AUDIO_4BYTE_SAMPLE_SIZE_BYTES;
+    }
+
+
+    // Transform client audio into whole card frames in outputBuffer, returning the number of bytes written.
+    // Every card channel is written, with silence on the unrouted ones, so the destination needs no clearing.
+    // Card channel pairs flagged in nonPcmPairs take the client bytes in card order, without the byte swap.
+    uint32_t TransformToCard(const char* inputBuffer, uint32_t inputBufferSize, char* outputBuffer, uint32_t outputBufferSize, uint32_t nonPcmPairs = 0)
+    {
+        if (toCardSampleRate_ != CARD_SAMPLE_RATE)
+        {
+            return TransformToCardResampled(inputBuffer, inputBufferSize, outputBuffer, outputBufferSize, nonPcmPairs);
+        }
+
+        uint32_t inputStrideBytes = GetToCardClientChannels() * AUDIO_3BYTE_SAMPLE_SIZE_BYTES;
+        uint32_t outputStrideBytes = toCardCardChannels_ * AUDIO_4BYTE_SAMPLE_SIZE_BYTES; // where stride is the distance between subsequent samples across all channels
 
         uint32_t numSamples = inputBufferSize / inputStrideBytes;
-        uint32_t outputBufferSize = numSamples * outputStrideBytes;
 
-        assert(outputBufferSize <= MAX_BUFFER_SIZE);
-        memset(outputBuffer, 0x00, outputBufferSize);
+        if (numSamples * outputStrideBytes > outputBufferSize)
+        {
+            numSamples = outputBufferSize / outputStrideBytes;
+        }
 
-        uint32_t bytesWritten = 0;
-        uint32_t bytesRead = 0;
-        const char* readBuffer = inputBuffer;
-        char* writeBuffer = outputBuffer;
+        const uint8_t* readBuffer = reinterpret_cast<const uint8_t*>(inputBuffer);
+        uint8_t* writeBuffer = reinterpret_cast<uint8_t*>(outputBuffer);
 
         for(uint32_t sampleIdx = 0; sampleIdx < numSamples; sampleIdx++)
         {
-            // Convert the 4bytes of each channel data into a 24 bit sample
-            // Left Channel
-            int sample = (*(int *)readBuffer) & 0x00FFFFFF;
-			sample = (sample & 0xFF000000) >> 24 | (sample & 0x00FF0000) >> 8 | (sample & 0x0000FF00) << 8 | (sample & 0x000000FF) << 24;
-			memcpy_s(writeBuffer, MAX_BUFFER_SIZE - bytesWritten, (void *)&sample, AUDIO_4BYTE_SAMPLE_SIZE_BYTES);
-
-            // Right Channel
-			sample = (*(int *)&readBuffer[AUDIO_3BYTE_SAMPLE_SIZE_BYTES]) & 0xFFFFFF00;
-			sample = (sample & 0xFF000000) >> 24 | (sample & 0x00FF0000) >> 8 | (sample & 0x0000FF00) << 8 | (sample & 0x000000FF) << 24;
-			memcpy_s(&writeBuffer[AUDIO_4BYTE_SAMPLE_SIZE_BYTES], MAX_BUFFER_SIZE - bytesWritten, (void *)&sample, AUDIO_4BYTE_SAMPLE_SIZE_BYTES);
-
-            bytesWritten += outputStrideBytes;
+            // The 24 bit big-endian client sample goes into the top three bytes of the little-endian 32 bit card sample
+            for (uint32_t cardChannel = 0; cardChannel < toCardCardChannels_; cardChannel++)
+            {
+                const int channel = toCardSources_[cardChannel];
+                uint8_t* cardSample = writeBuffer + cardChannel * AUDIO_4BYTE_SAMPLE_SIZE_BYTES;
+
+                if (channel < 0)
+                {
+                    memset(cardSample, 0x00, AUDIO_4BYTE_SAMPLE_SIZE_BYTES);
+                    continue;
+                }
+
+                const uint8_t* clientSample = readBuffer + channel * AUDIO_3BYTE_SAMPLE_SIZE_BYTES;
+
+                cardSample[0] = 0x00;
+
+                if (IsNonPcmChannel(nonPcmPairs, cardChannel))
+                {
+                    memcpy(cardSample + 1, clientSample, AUDIO_3BYTE_SAMPLE_SIZE_BYTES);
+                }
+                else
+                {
+                    cardSample[1] = clientSample[2];
+                    cardSample[2] = clientSample[1];
+                    cardSample[3] = clientSample[0];
+                }
+            }
+
             writeBuffer  += outputStrideBytes;
             readBuffer   += inputStrideBytes;
-            bytesRead    += inputStrideBytes;
         }
 
-        //cout << "%%% Bytes Read: " << bytesRead << "; input buffer size: " << inputBufferSize << endl;
-        //cout << "%%% Bytes Written: " << bytesWritten << "; output buffer size: " << outputBufferSize << endl;
-        // ???!!assert(bytesRead == inputBufferSize);
-        assert(bytesWritten == outputBufferSize);
-
-        return std::make_tuple(outputBuffer, bytesWritten);
+        return numSamples * outputStrideBytes;
     }
 
 private:
 
-    char outputBuffer[MAX_BUFFER_SIZE];
+    // Where stride is the distance between subsequent samples across all channels
+    uint32_t GetFromCardInputStride() const { return fromCardCardChannels_ * AUDIO_4BYTE_SAMPLE_SIZE_BYTES; }
+    uint32_t GetFromCardOutputStride() const { return GetFromCardClientChannels() * fromCardConverter_->GetBytesPerSample(); }
+    uint32_t GetFromCardRateRatio() const { return fromCardSampleRate_ / CARD_SAMPLE_RATE; }
+
+    // The number of card samples to transform, limited to what will fit in the output
+    uint32_t GetFromCardNumSamples(uint32_t inputBufferSize, uint32_t outputBufferSize) const
+    {
+        uint32_t numSamples = inputBufferSize / GetFromCardInputStride();
+        assert(numSamples * GetFromCardInputStride() == inputBufferSize);
+
+        const uint32_t outputStride = GetFromCardOutputStride() * GetFromCardRateRatio();
+
+        if (numSamples * outputStride > outputBufferSize)
+        {
+            numSamples = outputBufferSize / outputStride;
+        }
+
+        return numSamples;
+    }
+
+    // 24 bit card words to float and back, with full scale at +/-1.0. The conversion back rounds to the nearest
+    // 24 bit value and clips, since the filter can overshoot on full scale input.
+    static float CardWordToFloat(uint32_t cardWord)
+    {
+        return static_cast<float>(static_cast<int32_t>(cardWord)) * (1.0f / 2147483648.0f);
+    }
+
+    static uint32_t FloatToCardWord(float sample)
+    {
+        float scaled = sample * 8388608.0f;
+        scaled = scaled < -8388608.0f ? -8388608.0f : (scaled > 8388607.0f ? 8388607.0f : scaled);
+
+        const int32_t rounded = static_cast<int32_t>(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+        return static_cast<uint32_t>(rounded) << 8;
+    }
+
+    uint32_t TransformFromCardResampled(const char* inputBuffer, uint32_t inputBufferSize, char* outputBuffer, uint32_t outputBufferSize, uint32_t nonPcmPairs)
+    {
+        const uint32_t numSamples = GetFromCardNumSamples(inputBufferSize, outputBufferSize);
+        const uint32_t clientChannels = GetFromCardClientChannels();
+        const uint8_t* input = reinterpret_cast<const uint8_t*>(inputBuffer);
+
+        resampleInput_.resize(numSamples * clientChannels);
+        resampleOutput_.resize(fromCardResampler_.GetMaxOutputSamples(numSamples) * clientChannels);
+
+        for (uint32_t sampleIdx = 0; sampleIdx < numSamples; sampleIdx++)
+        {
+            const uint8_t* cardSample = input + sampleIdx * GetFromCardInputStride();
+
+            for (uint32_t channel = 0; channel < clientChannels; channel++)
+            {
+                uint32_t cardWord;
+                memcpy(&cardWord, cardSample + fromCardMap_[channel] * AUDIO_4BYTE_SAMPLE_SIZE_BYTES, sizeof(cardWord));
+
+                resampleInput_[sampleIdx * clientChannels + channel] = IsNonPcmChannel(nonPcmPairs, fromCardMap_[channel]) ? 0.0f : CardWordToFloat(cardWord);
+            }
+        }
+
+        const uint32_t numOutputSamples = fromCardResampler_.Process(resampleInput_.data(), numSamples, resampleOutput_.data(), isa_);
+
+        // Back to card words, so the same converter delivers the client sample type
+        resampleWords_.resize(numOutputSamples * clientChannels);
+        for (uint32_t i = 0; i < resampleWords_.size(); i++)
+            resampleWords_[i] = FloatToCardWord(resampleOutput_[i]);
+
+        return fromCardConverter_->Convert(reinterpret_cast<const uint8_t*>(resampleWords_.data()), clientChannels, fromCardIdentityMap_.data(),
+                                           numOutputSamples, reinterpret_cast<uint8_t*>(outputBuffer));
+    }
+
+    uint32_t TransformToCardResampled(const char* inputBuffer, uint32_t inputBufferSize, char* outputBuffer, uint32_t outputBufferSize, uint32_t nonPcmPairs)
+    {
+        const uint32_t clientChannels = GetToCardClientChannels();
+        const uint32_t inputStrideBytes = clientChannels * AUDIO_3BYTE_SAMPLE_SIZE_BYTES;
+        const uint32_t outputStrideBytes = toCardCardChannels_ * AUDIO_4BYTE_SAMPLE_SIZE_BYTES;
+
+        uint32_t numSamples = inputBufferSize / inputStrideBytes;
+        const uint32_t maxInputSamples = toCardResampler_.GetMaxInputSamples(outputBufferSize / outputStrideBytes);
+
+        if (numSamples > maxInputSamples)
+        {
+            numSamples = maxInputSamples;
+        }
+
+        const uint8_t* readBuffer = reinterpret_cast<const uint8_t*>(inputBuffer);
+
+        resampleInput_.resize(numSamples * clientChannels);
+        resampleOutput_.resize(toCardResampler_.GetMaxOutputSamples(numSamples) * clientChannels);
+
+        for (uint32_t i = 0; i < resampleInput_.size(); i++)
+        {
+            const uint8_t* clientSample = readBuffer + i * AUDIO_3BYTE_SAMPLE_SIZE_BYTES;
+            const uint32_t cardWord = (static_cast<uint32_t>(clientSample[0]) << 24) | (clientSample[1] << 16) | (clientSample[2] << 8);
+
+            resampleInput_[i] = CardWordToFloat(cardWord);
+        }
+
+        const uint32_t numOutputSamples = toCardResampler_.Process(resampleInput_.data(), numSamples, resampleOutput_.data(), isa_);
+
+        uint8_t* writeBuffer = reinterpret_cast<uint8_t*>(outputBuffer);
+
+        for (uint32_t sampleIdx = 0; sampleIdx < numOutputSamples; sampleIdx++)
+        {
+            for (uint32_t cardChannel = 0; cardChannel < toCardCardChannels_; cardChannel++)
+            {
+                const int channel = toCardSources_[cardChannel];
+                uint32_t cardWord(0);
+
+                if (channel >= 0 && !IsNonPcmChannel(nonPcmPairs, cardChannel))
+                    cardWord = FloatToCardWord(resampleOutput_[sampleIdx * clientChannels + channel]);
+
+                memcpy(writeBuffer + cardChannel * AUDIO_4BYTE_SAMPLE_SIZE_BYTES, &cardWord, sizeof(cardWord));
+            }
+
+            writeBuffer += outputStrideBytes;
+        }
+
+        return numOutputSamples * outputStrideBytes;
+    }
+
+    static bool IsNonPcmChannel(uint32_t nonPcmPairs, uint32_t cardChannel)
+    {
+        return (nonPcmPairs & (1 << (cardChannel / 2))) != 0;
+    }
+
+    // Overwrite the converted samples of any client channels taken from non-PCM pairs with the top bytes of
+    // the card word, in card order: no byte swap, scaling or float conversion. For the 32 bit sample types
+    // this is the whole card word; 24 bit keeps every bit of the AES payload, while 16 bit has to truncate.
+    void CopyNonPcmFromCard(const uint8_t* input, uint32_t numSamples, uint8_t* output, uint32_t nonPcmPairs) const
+    {
+        const uint32_t clientChannels = GetFromCardClientChannels();
+        const uint32_t bytesPerSample = fromCardConverter_->GetBytesPerSample();
+        const uint32_t inputStride = GetFromCardInputStride();
+        const bool planar = (fromCardSampleType_ & AudioSampleType_Planar) != 0;
+
+        for (uint32_t channel = 0; channel < clientChannels; channel++)
+        {
+            const uint32_t cardChannel = fromCardMap_[channel];
+
+            if (!IsNonPcmChannel(nonPcmPairs, cardChannel))
+                continue;
+
+            const uint8_t* cardSample = input + cardChannel * AUDIO_4BYTE_SAMPLE_SIZE_BYTES + (AUDIO_4BYTE_SAMPLE_SIZE_BYTES - bytesPerSample);
+
+            for (uint32_t sampleIdx = 0; sampleIdx < numSamples; sampleIdx++)
+            {
+                const uint32_t outIdx = planar ? channel * numSamples + sampleIdx : sampleIdx * clientChannels + channel;
+
+                memcpy(output + outIdx * bytesPerSample, cardSample, bytesPerSample);
+                cardSample += inputStride;
+            }
+        }
+    }
+
+    static bool IsValidChannelMap(uint32_t cardChannels, const std::vector<uint32_t>& channelMap, bool uniqueChannels)
+    {
+        if (cardChannels == 0 || cardChannels > MAX_CARD_CHANNELS || channelMap.empty() || channelMap.size() > MAX_CARD_CHANNELS)
+            return false;
+
+        uint32_t usedChannels(0);
+
+        for (auto cardChannel : channelMap)
+        {
+            if (cardChannel >= cardChannels)
+                return false;
+
+            if (uniqueChannels && (usedChannels & (1 << cardChannel)))
+                return false;
+
+            usedChannels |= (1 << cardChannel);
+        }
+
+        return true;
+    }
+
+    AudioKernelIsa isa_;
+
+    uint32_t fromCardCardChannels_;
+    std::vector<uint32_t> fromCardMap_;
+    uint32_t fromCardSampleType_;
+    AudioShuffle fromCardShuffle_;
+    std::unique_ptr<AudioConverter> fromCardConverter_;
+    std::vector<uint32_t> fromCardIdentityMap_;
+    uint32_t fromCardSampleRate_;
+    AudioResampler fromCardResampler_;
+
+    uint32_t toCardCardChannels_;
+    std::vector<uint32_t> toCardMap_;
+    std::vector<int> toCardSources_;
+    uint32_t toCardSampleRate_;
+    AudioResampler toCardResampler_;
+
+    // Staging for resampled audio, grown to fit the largest frame seen
+    std::vector<float> resampleInput_;
+    std::vector<float> resampleOutput_;
+    std::vector<uint32_t> resampleWords_;
 };
 
 }
@@ -16,6 +16,8 @@
 #include <memory>
 #include "Capture.h"
 #include "gen2ajaTypeMaps.h"
+#include "utils.h"
+#include "ajabase/system/systemtime.h"
 
 namespace streampunk {
 
@@ -24,23 +26,56 @@ inline Nan::Persistent<v8::Function> &Capture::constructor() {
   return myConstructor;
 }
 
-Capture::Capture(uint32_t deviceIndex, uint32_t channelNumber, uint32_t displayMode, uint32_t pixelFormat) 
+Capture::Capture(uint32_t deviceIndex, uint32_t channelNumber, uint32_t displayMode, uint32_t pixelFormat, uint32_t hostBuffers, uint32_t deviceBuffers, bool hugePages, bool anc, const std::vector<uint16_t>& ancFilter, bool multiChannel, const Aja::ThreadPolicy& threadPolicy, Aja::BackpressurePolicy backpressure) 
 : deviceIndex_(deviceIndex),
   channelNumber_(channelNumber),
   displayMode_(displayMode), 
   genericPixelFormat_(pixelFormat),
-  audioEnabled_(false)
+  hostBuffers_(hostBuffers),
+  deviceBuffers_(deviceBuffers),
+  hugePages_(hugePages),
+  anc_(anc),
+  ancFilter_(ancFilter),
+  multiChannel_(multiChannel),
+  threadPolicy_(threadPolicy),
+  backpressure_(backpressure),
+  audioEnabled_(false),
+  audioSampleRate_(48000),
+  audioSampleType_(Aja::AudioSampleType_S24),
+  batchMode_(false),
+  batchFrames_(0),
+  batchLatencyMs_(0),
+  batchStartTime_(0),
+  framesMissed_(0),
+  formatChangePending_(false),
+  changedFormat_(bmdModeUnknown),
+  changedFormatSequence_(0)
 {
   async = new uv_async_t;
   uv_async_init(uv_default_loop(), async, FrameCallback);
   uv_mutex_init(&padlock);
   async->data = this;
+
+  formatAsync = new uv_async_t;
+  uv_async_init(uv_default_loop(), formatAsync, FormatChangeCallback);
+  formatAsync->data = this;
+
+  batchTimer = new uv_timer_t;
+  uv_timer_init(uv_default_loop(), batchTimer);
+  batchTimer->data = this;
 }
 
 
 Capture::~Capture() {
   if (!captureCB_.IsEmpty())
     captureCB_.Reset();
+
+  formatChangeCB_.Reset();
+
+  batch_.Reset();
+
+  uv_timer_stop(batchTimer);
+  uv_close(reinterpret_cast<uv_handle_t*>(batchTimer), closeBatchTimer);
 }
 
 
@@ -57,6 +92,21 @@ NAN_MODULE_INIT(Capture::Init) {
   Nan::SetPrototypeMethod(tpl, "stop", StopCapture);
   Nan::SetPrototypeMethod(tpl, "enableAudio", EnableAudio);
   Nan::SetPrototypeMethod(tpl, "getVideoFormat", GetVideoFormat);
+  Nan::SetPrototypeMethod(tpl, "enableLoudness", EnableLoudness);
+  Nan::SetPrototypeMethod(tpl, "getLoudness", GetLoudness);
+  Nan::SetPrototypeMethod(tpl, "resetLoudness", ResetLoudness);
+  Nan::SetPrototypeMethod(tpl, "getLatencyStats", GetLatencyStats);
+  Nan::SetPrototypeMethod(tpl, "resetLatencyStats", ResetLatencyStats);
+  Nan::SetPrototypeMethod(tpl, "getCaptureStatus", GetCaptureStatus);
+  Nan::SetPrototypeMethod(tpl, "getDriverCalls", GetDriverCalls);
+  Nan::SetPrototypeMethod(tpl, "resetDriverCalls", ResetDriverCalls);
+  Nan::SetPrototypeMethod(tpl, "getThreadPolicy", GetThreadPolicy);
+  Nan::SetPrototypeMethod(tpl, "onFormatChange", OnFormatChange);
+  Nan::SetPrototypeMethod(tpl, "startRecording", StartRecording);
+  Nan::SetPrototypeMethod(tpl, "stopRecording", StopRecording);
+  Nan::SetPrototypeMethod(tpl, "getRecordingStatus", GetRecordingStatus);
+  Nan::SetPrototypeMethod(tpl, "startTimeshift", StartTimeshift);
+  Nan::SetPrototypeMethod(tpl, "stopTimeshift", StopTimeshift);
 
   constructor().Reset(Nan::GetFunction(tpl).ToLocalChecked());
   Nan::Set(target, Nan::New("Capture").ToLocalChecked(),
@@ -68,15 +118,78 @@ NAN_METHOD(Capture::New) {
   if (info.IsConstructCall()) {
     // Invoked as constructor: `new Capture(...)`
     uint32_t deviceIndex = info[0]->IsUndefined() ? 0 : Nan::To<uint32_t>(info[0]).FromJust();
-    uint32_t displayMode = info[1]->IsUndefined() ? 0 : Nan::To<uint32_t>(info[1]).FromJust();
-    uint32_t pixelFormat = info[2]->IsUndefined() ? 0 : Nan::To<uint32_t>(info[2]).FromJust();
-    Capture* obj = new Capture(deviceIndex, displayMode, pixelFormat);
+    uint32_t channelNumber = info[1]->IsUndefined() ? AjaDevice::DEFAULT_CAPTURE_CHANNEL : Nan::To<uint32_t>(info[1]).FromJust();
+    uint32_t displayMode = info[2]->IsUndefined() ? 0 : Nan::To<uint32_t>(info[2]).FromJust();
+    uint32_t pixelFormat = info[3]->IsUndefined() ? 0 : Nan::To<uint32_t>(info[3]).FromJust();
+    uint32_t hostBuffers = CIRCULAR_BUFFER_SIZE;
+    uint32_t deviceBuffers = AjaDevice::DEFAULT_DEVICE_BUFFERS;
+    bool hugePages = false;
+    bool anc = false;
+    std::vector<uint16_t> ancFilter;
+    bool multiChannel = false;
+    Aja::ThreadPolicy threadPolicy;
+    Aja::BackpressurePolicy backpressure = Aja::BackpressurePolicy_Block;
+
+    // Optional settings: { hostBuffers, deviceBuffers, hugePages, anc, multiChannel, threadPolicy, backpressure } - the depths, in frames, of the host ring buffer and of
+    // AutoCirculate on the card, both clamped to between AjaDevice::MIN_BUFFERS and their maximum, and whether to put
+    // the video buffers on large pages. Large pages need the OS to allow it, and fall back to normal pages otherwise.
+    // anc is true to capture every ancillary packet, or an array of [did, sdid] pairs to capture just those.
+    // multiChannel shares the device in multi-format mode with the other multi-channel captures in this process, one per input.
+    // threadPolicy is { cpus, realtime, numaNode }: the CPU numbers the capture threads may run on, whether the capture thread
+    // gets real time priority where the OS permits, and the NUMA node for the video buffers.
+    // backpressure is what happens once the host ring buffer is full: "block" waits for JavaScript, "dropOldest"
+    // overwrites the oldest frame not yet delivered and "dropNewest" throws away the frame just captured.
+    if (info[4]->IsObject()) {
+      v8::Local<v8::Object> options = Nan::To<v8::Object>(info[4]).ToLocalChecked();
+      v8::Local<v8::Value> hostBuffersValue = Nan::Get(options, Nan::New("hostBuffers").ToLocalChecked()).ToLocalChecked();
+      v8::Local<v8::Value> deviceBuffersValue = Nan::Get(options, Nan::New("deviceBuffers").ToLocalChecked()).ToLocalChecked();
+      v8::Local<v8::Value> hugePagesValue = Nan::Get(options, Nan::New("hugePages").ToLocalChecked()).ToLocalChecked();
+      v8::Local<v8::Value> ancValue = Nan::Get(options, Nan::New("anc").ToLocalChecked()).ToLocalChecked();
+      v8::Local<v8::Value> multiChannelValue = Nan::Get(options, Nan::New("multiChannel").ToLocalChecked()).ToLocalChecked();
+      v8::Local<v8::Value> threadPolicyValue = Nan::Get(options, Nan::New("threadPolicy").ToLocalChecked()).ToLocalChecked();
+      v8::Local<v8::Value> backpressureValue = Nan::Get(options, Nan::New("backpressure").ToLocalChecked()).ToLocalChecked();
+
+      if (hostBuffersValue->IsNumber())
+        hostBuffers = Nan::To<uint32_t>(hostBuffersValue).FromJust();
+      if (deviceBuffersValue->IsNumber())
+        deviceBuffers = Nan::To<uint32_t>(deviceBuffersValue).FromJust();
+      if (hugePagesValue->IsBoolean())
+        hugePages = Nan::To<bool>(hugePagesValue).FromJust();
+      if (multiChannelValue->IsBoolean())
+        multiChannel = Nan::To<bool>(multiChannelValue).FromJust();
+      if (threadPolicyValue->IsObject())
+        threadPolicy = parseThreadPolicy(Nan::To<v8::Object>(threadPolicyValue).ToLocalChecked());
+      if (backpressureValue->IsString()) {
+        const std::string policy(*Nan::Utf8String(backpressureValue));
+        if (policy == "dropOldest")
+          backpressure = Aja::BackpressurePolicy_DropOldest;
+        else if (policy == "dropNewest")
+          backpressure = Aja::BackpressurePolicy_DropNewest;
+      }
+
+      if (ancValue->IsBoolean()) {
+        anc = Nan::To<bool>(ancValue).FromJust();
+      } else if (ancValue->IsArray()) {
+        v8::Local<v8::Array> ancArray = v8::Local<v8::Array>::Cast(ancValue);
+        for (uint32_t i = 0; i < ancArray->Length(); i++) {
+          v8::Local<v8::Value> pair = Nan::Get(ancArray, i).ToLocalChecked();
+          if (pair->IsArray() && v8::Local<v8::Array>::Cast(pair)->Length() == 2) {
+            uint32_t did = Nan::To<uint32_t>(Nan::Get(v8::Local<v8::Array>::Cast(pair), 0).ToLocalChecked()).FromJust();
+            uint32_t sdid = Nan::To<uint32_t>(Nan::Get(v8::Local<v8::Array>::Cast(pair), 1).ToLocalChecked()).FromJust();
+            ancFilter.push_back(static_cast<uint16_t>(((did & 0xff) << 8) | (sdid & 0xff)));
+          }
+        }
+        anc = !ancFilter.empty();
+      }
+    }
+
+    Capture* obj = new Capture(deviceIndex, channelNumber, displayMode, pixelFormat, hostBuffers, deviceBuffers, hugePages, anc, ancFilter, multiChannel, threadPolicy, backpressure);
     obj->Wrap(info.This());
     info.GetReturnValue().Set(info.This());
   } else {
     // Invoked as plain function `Capture(...)`, turn into construct call.
-    const int argc = 3;
-    v8::Local<v8::Value> argv[argc] = { info[0], info[1], info[2] };
+    const int argc = 5;
+    v8::Local<v8::Value> argv[argc] = { info[0], info[1], info[2], info[3], info[4] };
     v8::Local<v8::Function> cons = Nan::New(constructor());
     info.GetReturnValue().Set(Nan::NewInstance(cons, argc, argv).ToLocalChecked());
   }
@@ -97,12 +210,25 @@ NAN_METHOD(Capture::EnableAudio) {
   Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
   HRESULT result;
 
-  result = obj->setupAudioInput();
+  uint32_t sampleRate = info[0]->IsNumber() ? Nan::To<uint32_t>(info[0]).FromJust() : obj->audioSampleRate_;
+  uint32_t sampleType = info[1]->IsNumber() ? Nan::To<uint32_t>(info[1]).FromJust() : obj->audioSampleType_;
+  uint32_t channelCount = info[2]->IsNumber() ? Nan::To<uint32_t>(info[2]).FromJust() : Aja::AudioTransform::DEFAULT_CLIENT_CHANNELS;
+  std::vector<uint32_t> channelMap;
+
+  // Optional routing: element N is the card channel delivered as client channel N
+  if (info[3]->IsArray()) {
+    v8::Local<v8::Array> mapArray = v8::Local<v8::Array>::Cast(info[3]);
+    for (uint32_t i = 0; i < mapArray->Length(); i++) {
+      channelMap.push_back(Nan::To<uint32_t>(Nan::Get(mapArray, i).ToLocalChecked()).FromJust());
+    }
+  }
+
+  result = obj->setupAudioInput(sampleRate, sampleType, channelCount, channelMap);
 
   switch (result) {
     case E_INVALIDARG:
       info.GetReturnValue().Set(
-        Nan::New<v8::String>("audio channel count must be 2, 8 or 16").ToLocalChecked());
+        Nan::New<v8::String>("audio sample rate must be 48000 or 96000, sample type must be 16, 24, 32 or float (optionally planar), and the channel count and channel map must select between 1 and 16 of the card's channels").ToLocalChecked());
       break;
     case S_OK:
       info.GetReturnValue().Set(Nan::New<v8::String>("audio enabled").ToLocalChecked());
@@ -118,6 +244,25 @@ NAN_METHOD(Capture::DoCapture) {
   Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
   obj->captureCB_.Reset(cb);
 
+  // Optional batching: { batchFrames, batchLatency } - the callback then receives an array of
+  // { video, audio, info } objects once batchFrames have arrived, or batchLatency milliseconds after the first
+  obj->batchFrames_ = 0;
+  obj->batchLatencyMs_ = 0;
+
+  if (info[1]->IsObject()) {
+    v8::Local<v8::Object> options = Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    v8::Local<v8::Value> batchFrames = Nan::Get(options, Nan::New("batchFrames").ToLocalChecked()).ToLocalChecked();
+    v8::Local<v8::Value> batchLatency = Nan::Get(options, Nan::New("batchLatency").ToLocalChecked()).ToLocalChecked();
+
+    if (batchFrames->IsNumber())
+      obj->batchFrames_ = Nan::To<uint32_t>(batchFrames).FromJust();
+    if (batchLatency->IsNumber())
+      obj->batchLatencyMs_ = Nan::To<uint32_t>(batchLatency).FromJust();
+  }
+
+  obj->batchMode_ = obj->batchFrames_ > 0 || obj->batchLatencyMs_ > 0;
+  obj->batch_.Reset(Nan::New<v8::Array>());
+
   if (obj->capture())
   {
     info.GetReturnValue().Set(Nan::New("Capture started.").ToLocalChecked());
@@ -132,6 +277,10 @@ NAN_METHOD(Capture::DoCapture) {
 NAN_METHOD(Capture::StopCapture) {
   Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
 
+  // Hand over any part batch, rather than lose the frames in it
+  if (obj->batchMode_)
+    obj->flushBatch();
+
   if (obj->stop())
   {
     info.GetReturnValue().Set(Nan::New<v8::String>("Capture stopped.").ToLocalChecked());
@@ -150,15 +299,248 @@ NAN_METHOD(Capture::GetVideoFormat) {
 }
 
 
+NAN_METHOD(Capture::EnableLoudness) {
+  Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
+  std::vector<uint32_t> channelMap;
+  std::vector<double> weights;
+
+  // Element N of the map is the card channel measured as programme channel N; weights default to 1.0
+  if (info[0]->IsArray()) {
+    v8::Local<v8::Array> mapArray = v8::Local<v8::Array>::Cast(info[0]);
+    for (uint32_t i = 0; i < mapArray->Length(); i++) {
+      channelMap.push_back(Nan::To<uint32_t>(Nan::Get(mapArray, i).ToLocalChecked()).FromJust());
+    }
+  } else {
+    channelMap.push_back(0);
+    channelMap.push_back(1);
+  }
+
+  if (info[1]->IsArray()) {
+    v8::Local<v8::Array> weightArray = v8::Local<v8::Array>::Cast(info[1]);
+    for (uint32_t i = 0; i < weightArray->Length(); i++) {
+      weights.push_back(Nan::To<double>(Nan::Get(weightArray, i).ToLocalChecked()).FromJust());
+    }
+  } else {
+    weights.assign(channelMap.size(), 1.0);
+  }
+
+  if (obj->loudnessMeter_.Enable(channelMap, weights)) {
+    info.GetReturnValue().Set(Nan::New<v8::String>("loudness enabled").ToLocalChecked());
+  } else {
+    info.GetReturnValue().Set(
+      Nan::New<v8::String>("loudness needs between 1 and 16 card channels, each with a non-negative weight").ToLocalChecked());
+  }
+}
+
+
+NAN_METHOD(Capture::GetLoudness) {
+  Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
+  Aja::LoudnessResults results;
+  uint64_t droppedSamples;
+
+  obj->loudnessMeter_.GetResults(results, droppedSamples);
+
+  v8::Local<v8::Object> loudness = Nan::New<v8::Object>();
+  Nan::Set(loudness, Nan::New("momentary").ToLocalChecked(), Nan::New<v8::Number>(results.momentary));
+  Nan::Set(loudness, Nan::New("shortTerm").ToLocalChecked(), Nan::New<v8::Number>(results.shortTerm));
+  Nan::Set(loudness, Nan::New("integrated").ToLocalChecked(), Nan::New<v8::Number>(results.integrated));
+  Nan::Set(loudness, Nan::New("truePeak").ToLocalChecked(), Nan::New<v8::Number>(results.truePeak));
+  Nan::Set(loudness, Nan::New("samplesProcessed").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(results.samplesProcessed)));
+  Nan::Set(loudness, Nan::New("droppedSamples").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(droppedSamples)));
+
+  info.GetReturnValue().Set(loudness);
+}
+
+
+NAN_METHOD(Capture::ResetLoudness) {
+  Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
+
+  obj->loudnessMeter_.Reset();
+}
+
+
+NAN_METHOD(Capture::GetLatencyStats) {
+  Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
+
+  v8::Local<v8::Object> stats = Nan::New<v8::Object>();
+  Nan::Set(stats, Nan::New("vbiToDma").ToLocalChecked(), makeLatencySummary(obj->vbiToDma_));
+  Nan::Set(stats, Nan::New("dmaToDelivery").ToLocalChecked(), makeLatencySummary(obj->dmaToDelivery_));
+
+  info.GetReturnValue().Set(stats);
+}
+
+
+NAN_METHOD(Capture::ResetLatencyStats) {
+  Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
+
+  obj->vbiToDma_.Reset();
+  obj->dmaToDelivery_.Reset();
+}
+
+
+NAN_METHOD(Capture::GetCaptureStatus) {
+  Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
+
+  if (!obj->capture_) {
+    info.GetReturnValue().Set(Nan::Null());
+    return;
+  }
+
+  ULWord framesProcessed(0), framesDropped(0), bufferLevel(0);
+  obj->capture_->GetACStatus(framesProcessed, framesDropped, bufferLevel);
+
+  v8::Local<v8::Object> status = Nan::New<v8::Object>();
+  Nan::Set(status, Nan::New("framesProcessed").ToLocalChecked(), Nan::New<v8::Uint32>(framesProcessed));
+  Nan::Set(status, Nan::New("framesDropped").ToLocalChecked(), Nan::New<v8::Uint32>(framesDropped));
+  Nan::Set(status, Nan::New("bufferLevel").ToLocalChecked(), Nan::New<v8::Uint32>(bufferLevel));
+  Nan::Set(status, Nan::New("framesMissed").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(obj->framesMissed_)));
+  Nan::Set(status, Nan::New("hostFramesDropped").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(obj->capture_->GetHostFramesDropped())));
+
+  info.GetReturnValue().Set(status);
+}
+
+
+NAN_METHOD(Capture::GetDriverCalls) {
+  Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
+
+  if (!obj->capture_) {
+    info.GetReturnValue().Set(Nan::Null());
+    return;
+  }
+
+  Aja::DriverCallSummary summary;
+  obj->capture_->GetDriverCallSummary(summary);
+
+  info.GetReturnValue().Set(makeDriverCallSummary(summary));
+}
+
+
+NAN_METHOD(Capture::ResetDriverCalls) {
+  Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
+
+  if (obj->capture_)
+    obj->capture_->ResetDriverCallStats();
+}
+
+
+NAN_METHOD(Capture::GetThreadPolicy) {
+  Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
+  Aja::ThreadPolicy effective;
+
+  if (!obj->capture_ || !obj->capture_->GetThreadPolicy(effective)) {
+    info.GetReturnValue().Set(Nan::Null());
+    return;
+  }
+
+  info.GetReturnValue().Set(makeThreadPolicy(effective));
+}
+
+
+NAN_METHOD(Capture::StartRecording) {
+  Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
+
+  if (!info[0]->IsString()) {
+    info.GetReturnValue().Set(Nan::New<v8::String>("recording needs an essence file path").ToLocalChecked());
+    return;
+  }
+
+  if (!obj->capture_) {
+    info.GetReturnValue().Set(Nan::New<v8::String>("Unable to start recording: capture is not initialised").ToLocalChecked());
+    return;
+  }
+
+  // The index defaults to the essence path with .idx on the end
+  std::string essencePath(*Nan::Utf8String(info[0]));
+  std::string indexPath(info[1]->IsString() ? std::string(*Nan::Utf8String(info[1])) : essencePath + ".idx");
+
+  AJAStatus status = obj->capture_->StartRecording(essencePath, indexPath);
+
+  if (AJA_SUCCESS(status)) {
+    // Recording doesn't need doCapture, so start capturing if nothing else has
+    if (!obj->capture_->IsRunning())
+      obj->capture();
+
+    info.GetReturnValue().Set(Nan::New<v8::String>("Recording started.").ToLocalChecked());
+  } else {
+    bool recording;
+    uint64_t framesWritten, bytesWritten;
+    std::string error;
+
+    obj->capture_->GetRecordingStatus(recording, framesWritten, bytesWritten, error);
+    info.GetReturnValue().Set(Nan::New<v8::String>("Unable to start recording: " + error).ToLocalChecked());
+  }
+}
+
+
+NAN_METHOD(Capture::StopRecording) {
+  Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
+
+  if (obj->capture_)
+    obj->capture_->StopRecording();
+
+  info.GetReturnValue().Set(Nan::New<v8::String>("Recording stopped.").ToLocalChecked());
+}
+
+
+NAN_METHOD(Capture::GetRecordingStatus) {
+  Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
+  bool recording(false);
+  uint64_t framesWritten(0), bytesWritten(0);
+  std::string error;
+
+  if (obj->capture_)
+    obj->capture_->GetRecordingStatus(recording, framesWritten, bytesWritten, error);
+
+  v8::Local<v8::Object> status = Nan::New<v8::Object>();
+  Nan::Set(status, Nan::New("recording").ToLocalChecked(), Nan::New<v8::Boolean>(recording));
+  Nan::Set(status, Nan::New("framesWritten").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(framesWritten)));
+  Nan::Set(status, Nan::New("bytesWritten").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(bytesWritten)));
+  Nan::Set(status, Nan::New("error").ToLocalChecked(), Nan::New<v8::String>(error).ToLocalChecked());
+
+  info.GetReturnValue().Set(status);
+}
+
+
+NAN_METHOD(Capture::StartTimeshift) {
+  Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
+
+  if (!info[0]->IsString() || !info[1]->IsNumber()) {
+    info.GetReturnValue().Set(Nan::New<v8::String>("timeshift needs a ring file path and a number of frames").ToLocalChecked());
+    return;
+  }
+
+  if (!obj->capture_) {
+    info.GetReturnValue().Set(Nan::New<v8::String>("Unable to start timeshift: capture is not initialised").ToLocalChecked());
+    return;
+  }
+
+  std::string path(*Nan::Utf8String(info[0]));
+  std::string error;
+
+  if (AJA_SUCCESS(obj->capture_->StartTimeshift(path, Nan::To<uint32_t>(info[1]).FromJust(), error)))
+    info.GetReturnValue().Set(Nan::New<v8::String>("Timeshift started.").ToLocalChecked());
+  else
+    info.GetReturnValue().Set(Nan::New<v8::String>("Unable to start timeshift: " + error).ToLocalChecked());
+}
+
+
+NAN_METHOD(Capture::StopTimeshift) {
+  Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
+
+  if (obj->capture_)
+    obj->capture_->StopTimeshift();
+
+  info.GetReturnValue().Set(Nan::New<v8::String>("Timeshift stopped.").ToLocalChecked());
+}
+
+
 bool Capture::capture()
 {
     bool success = false;
 
     if (capture_)
     {
-        capture_->Run();
-
-        success = true;
+        success = AJA_SUCCESS(capture_->Run());
     }
 
     return success;
@@ -169,6 +551,8 @@ bool Capture::stop()
 {
     bool success = false;
 
+    uv_timer_stop(batchTimer);
+
     if (capture_)
     {
         capture_->Quit();
@@ -207,26 +591,35 @@ bool Capture::initNtv2Capture()
     }
 
     const NTV2FrameBufferFormat  pixelFormat(getPixelFormat(genericPixelFormat_));
-    bool                         multiFormat(false); 
-    bool                         captureAncilliaryData(false); 
+    bool                         multiFormat(multiChannel_); 
+    bool                         captureAncilliaryData(anc_); 
     AJAStatus                    status(AJA_STATUS_SUCCESS);
 
     cout << "Capture initializing with pixelFormat " << pixelFormat << endl;
 
     //    Instantiate the NTV2Capture object, using the specified AJA device...
-    capture_.reset(new NTV2Capture(&DEFAULT_INIT_PARAMS,
+    capture_.reset(new NTV2Capture(multiFormat ? &MULTICHANNEL_INIT_PARAMS : &DEFAULT_INIT_PARAMS,
         deviceSpec, true,                               //    With audio?
         ::GetNTV2ChannelForIndex(channelNumber_ - 1),   //    Channel
         pixelFormat,                                    //    Pixel format
         false,                                          //    Level A/B conversion?
         multiFormat,                                    //    Multi-format mode?
-        captureAncilliaryData));                        //    Capture Anc data?
+        captureAncilliaryData,                          //    Capture Anc data?
+        hostBuffers_,                                   //    Host ring buffer depth
+        deviceBuffers_,                                 //    On-device buffer depth
+        hugePages_));                                   //    Video buffers on large pages?
+
+    capture_->SetAncFilter(ancFilter_);
+    capture_->SetThreadPolicy(threadPolicy_);
+    capture_->SetBackpressurePolicy(backpressure_);
 
     //    Initialize the capture device...
     status = capture_->Init();
     if (AJA_SUCCESS(status))
     {
         capture_->SetFrameArrivedCallback(this, Capture::_frameArrived);
+        capture_->SetAudioCapturedCallback(this, Capture::_audioCaptured);
+        capture_->SetFormatChangedCallback(this, Capture::_formatChanged);
 
         success = true;
     }    //    if capture Init succeeded
@@ -240,8 +633,34 @@ bool Capture::initNtv2Capture()
 }
 
 
-HRESULT Capture::setupAudioInput() {
+HRESULT Capture::setupAudioInput(uint32_t sampleRate, uint32_t sampleType, uint32_t channelCount, const std::vector<uint32_t>& channelMap) {
+
+  uint32_t cardChannels = (capture_ && capture_->GetNumAudioChannels() > 0) ? capture_->GetNumAudioChannels() : Aja::AudioTransform::DEFAULT_CARD_CHANNELS;
+  std::vector<uint32_t> routing(channelMap);
+
+  // Without an explicit map, deliver the first channelCount card channels in order
+  if (routing.empty()) {
+    for (uint32_t channel = 0; channel < channelCount; channel++) {
+      routing.push_back(channel);
+    }
+  }
+
+  // The card runs at 48kHz, so anything else has to be resampled
+  if (sampleRate != Aja::AudioTransform::CARD_SAMPLE_RATE && sampleRate != Aja::AudioTransform::HIGH_SAMPLE_RATE) {
+    return E_INVALIDARG;
+  }
+
+  // The sample type picks the converter, so samples are delivered in their final format in a single pass
+  if (routing.size() != channelCount || !audioTransform.SetFromCardFormat(cardChannels, routing, sampleType)) {
+    return E_INVALIDARG;
+  }
+
+  if (!audioTransform.SetFromCardSampleRate(sampleRate)) {
+    return E_INVALIDARG;
+  }
 
+  audioSampleRate_ = sampleRate;
+  audioSampleType_ = sampleType;
   audioEnabled_ = true;
 
   return S_OK;
@@ -282,47 +701,408 @@ void Capture::_frameArrived(void* context)
 }
 
 
+void Capture::audioCaptured(const CaptureFrame* frame)
+{
+    // Runs on the capture thread; the meter only copies out the programme channels and never blocks
+    loudnessMeter_.Push(reinterpret_cast<const uint8_t*>(frame->fAudioBuffer), capture_->GetNumAudioChannels(), frame->fAudioSampleCount);
+}
+
+
+void Capture::_audioCaptured(void* context, const CaptureFrame* frame)
+{
+    Capture* localThis = reinterpret_cast<Capture*>(context);
+
+    localThis->audioCaptured(frame);
+}
+
+
+void Capture::formatChanged(NTV2VideoFormat newFormat, uint64_t firstSequence)
+{
+  // Runs on the capture thread, while AutoCirculate is stopped, so only the latest change is kept
+  uv_mutex_lock(&padlock);
+  formatChangePending_ = true;
+  changedFormat_ = DISPLAY_MODE_MAP.ToA(newFormat);
+  changedFormatSequence_ = firstSequence;
+  uv_mutex_unlock(&padlock);
+
+  uv_async_send(formatAsync);
+}
+
+
+void Capture::_formatChanged(void* context, NTV2VideoFormat newFormat, uint64_t firstSequence)
+{
+    Capture* localThis = reinterpret_cast<Capture*>(context);
+
+    localThis->formatChanged(newFormat, firstSequence);
+}
+
+
 void Capture::TestUV() {
   uv_async_send(async);
 }
 
 
 NAUV_WORK_CB(Capture::FrameCallback) {
-  Nan::HandleScope scope;
   Capture *capture = static_cast<Capture*>(async->data);
-  Nan::Callback cb(Nan::New(capture->captureCB_));
 
+  if (!capture->capture_)
+    return;
+
+  // uv_async_send coalesces wakeups, so a busy loop can be woken once for several frames. Deliver every
+  // frame that was ready when we woke, in order; any that arrive meanwhile bring another wakeup.
+  unsigned int framesToDeliver = capture->capture_->GetNumAvailableFrames();
+
+  for (unsigned int frameNdx = 0; frameNdx < framesToDeliver && capture->capture_; frameNdx++) {
+    Nan::HandleScope scope;
+    Nan::Callback cb(Nan::New(capture->captureCB_));
+    v8::Local<v8::Value> argv[3];
+
+    if (!capture->readNextFrame(argv))
+      break;
+
+    if (capture->batchMode_)
+      capture->addToBatch(argv);
+    else
+      cb.Call(3, argv);
+  }
+}
+
+
+NAN_METHOD(Capture::OnFormatChange) {
+  Capture* obj = ObjectWrap::Unwrap<Capture>(info.Holder());
+
+  if (info[0]->IsFunction())
+    obj->formatChangeCB_.Reset(v8::Local<v8::Function>::Cast(info[0]));
+  else
+    obj->formatChangeCB_.Reset();
+}
+
+
+NAUV_WORK_CB(Capture::FormatChangeCallback) {
+  Capture *capture = static_cast<Capture*>(async->data);
+  Nan::HandleScope scope;
+
+  uv_mutex_lock(&capture->padlock);
+  const bool pending = capture->formatChangePending_;
+  const GenericDisplayMode displayMode = capture->changedFormat_;
+  const uint64_t sequence = capture->changedFormatSequence_;
+  capture->formatChangePending_ = false;
+  uv_mutex_unlock(&capture->padlock);
+
+  if (!pending || capture->formatChangeCB_.IsEmpty())
+    return;
+
+  // Frames already captured in the old format may still be on their way, so the change says where the new one starts
+  v8::Local<v8::Object> change = Nan::New<v8::Object>();
+  Nan::Set(change, Nan::New("displayMode").ToLocalChecked(), Nan::New<v8::Uint32>(displayMode));
+  Nan::Set(change, Nan::New("sequence").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(sequence)));
+
+  Nan::Callback cb(Nan::New(capture->formatChangeCB_));
+  v8::Local<v8::Value> argv[1] = { change };
+  cb.Call(1, argv);
+}
+
+
+void Capture::addToBatch(v8::Local<v8::Value> frame[3]) {
+  v8::Local<v8::Array> batch = Nan::New(batch_);
+  v8::Local<v8::Object> batchFrame = Nan::New<v8::Object>();
+
+  Nan::Set(batchFrame, Nan::New("video").ToLocalChecked(), frame[0]);
+  Nan::Set(batchFrame, Nan::New("audio").ToLocalChecked(), frame[1]);
+  Nan::Set(batchFrame, Nan::New("info").ToLocalChecked(), frame[2]);
+
+  if (batch->Length() == 0) {
+    batchStartTime_ = uv_hrtime();
+
+    // The timer delivers the batch if the input stalls before it fills
+    if (batchLatencyMs_ > 0)
+      uv_timer_start(batchTimer, BatchTimerCallback, batchLatencyMs_, 0);
+  }
+
+  Nan::Set(batch, batch->Length(), batchFrame);
+
+  // The latency budget is checked as frames arrive too, as a busy event loop can run the timer late
+  const uint64_t waitedMs = (uv_hrtime() - batchStartTime_) / 1000000;
+
+  if ((batchFrames_ > 0 && batch->Length() >= batchFrames_) || (batchLatencyMs_ > 0 && waitedMs >= batchLatencyMs_))
+    flushBatch();
+}
+
+
+void Capture::flushBatch() {
+  Nan::HandleScope scope;
+
+  uv_timer_stop(batchTimer);
+
+  if (batch_.IsEmpty())
+    return;
+
+  v8::Local<v8::Array> batch = Nan::New(batch_);
+
+  if (batch->Length() == 0)
+    return;
+
+  // Start the next batch first, in case the callback stops the capture
+  batch_.Reset(Nan::New<v8::Array>());
+
+  Nan::Callback cb(Nan::New(captureCB_));
+  v8::Local<v8::Value> argv[1] = { batch };
+  cb.Call(1, argv);
+}
+
+
+void Capture::BatchTimerCallback(uv_timer_t* handle) {
+  Capture *capture = static_cast<Capture*>(handle->data);
+
+  if (capture->batchMode_)
+    capture->flushBatch();
+}
+
+
+void Capture::closeBatchTimer(uv_handle_t* handle) {
+  delete reinterpret_cast<uv_timer_t*>(handle);
+}
+
+
+bool Capture::readNextFrame(v8::Local<v8::Value> frame[3]) {
   v8::Local<v8::Value> bv = Nan::Null();
   v8::Local<v8::Value> ba = Nan::Null();
-  uv_mutex_lock(&capture->padlock);
+  v8::Local<v8::Object> bi;
+  unsigned int framesWaiting(0);
 
-  AVDataBuffer* nextFrame = capture->capture_->LockNextFrame();
+  uv_mutex_lock(&padlock);
 
-  if (nextFrame != nullptr)
+  CaptureFrame* nextFrame = capture_->LockNextFrame();
+
+  if (nextFrame == nullptr)
   {
-    if (nextFrame->fVideoBuffer != nullptr)
-    {
-        bv = Nan::CopyBuffer(reinterpret_cast<char*>(nextFrame->fVideoBuffer), nextFrame->fVideoBufferSize).ToLocalChecked();
+    uv_mutex_unlock(&padlock);
+    return false;
+  }
+
+  bi = makeFrameInfo(nextFrame);
+
+  if (nextFrame->fVideoBuffer != nullptr)
+  {
+      bv = wrapVideoBuffer(nextFrame);
+  }
+
+  if (nextFrame->fAudioBuffer != nullptr && audioEnabled_ == true)
+  {
+      // Transform the card audio into the routed client channels, as set up in enableAudio, writing
+      // straight into a Node buffer of exactly the right size
+      const char* cardAudio = reinterpret_cast<char*>(nextFrame->fAudioBuffer);
+      uint32_t audioBufferSize = audioTransform.GetFromCardOutputSize(nextFrame->fAudioBufferSize);
+      v8::Local<v8::Object> audioBuffer = Nan::NewBuffer(audioBufferSize).ToLocalChecked();
+
+      audioTransform.TransformFromCard(cardAudio, nextFrame->fAudioBufferSize, node::Buffer::Data(audioBuffer), audioBufferSize, nextFrame->fNonPcmPairs);
+
+      ba = audioBuffer;
+  }
+
+  const uint64_t deliveryTime = AJATime::GetSystemMicroseconds();
+  addLatencySamples(nextFrame, deliveryTime);
+
+  // Anything skipped in the hardware sequence was lost before it got here, whether on the card or in the host.
+  // Frames that went to the recorder instead were taken, not lost, so they don't count
+  const uint64_t gap = capture_->CountMissedFrames(nextFrame);
+  framesMissed_ += gap;
+
+  capture_->UnlockFrame(&framesWaiting);
+  nextFrame = nullptr;
+
+  uv_mutex_unlock(&padlock);
+
+  // Frames captured but not yet delivered: anything above zero is latency the client is adding
+  Nan::Set(bi, Nan::New("framesWaiting").ToLocalChecked(), Nan::New<v8::Uint32>(framesWaiting));
+  Nan::Set(bi, Nan::New("deliveryTime").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(deliveryTime)));
+  Nan::Set(bi, Nan::New("gap").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(gap)));
+
+  frame[0] = bv;
+  frame[1] = ba;
+  frame[2] = bi;
+
+  return true;
+}
+
+
+v8::Local<v8::Object> Capture::wrapVideoBuffer(CaptureFrame* frame) {
+  Aja::VideoBufferPool* pool = capture_->GetVideoBufferPool();
+  char* video = reinterpret_cast<char*>(frame->fVideoBuffer);
+
+  // Take the buffer from the frame, so the JS buffer can point straight at it; the capture thread fills
+  // the frame with a fresh buffer from the pool next time round, and this one goes back when it is collected.
+  // V8 is told about the memory, or it would not see the garbage piling up.
+  frame->fVideoBuffer = nullptr;
+  Nan::AdjustExternalMemory(static_cast<int>(frame->fVideoBufferCapacity));
+
+  return Nan::NewBuffer(video, frame->fVideoBufferSize, releaseVideoBuffer, pool).ToLocalChecked();
+}
+
+
+void Capture::releaseVideoBuffer(char* data, void* hint) {
+  Aja::VideoBufferPool* pool = reinterpret_cast<Aja::VideoBufferPool*>(hint);
+
+  // Release gives the size the buffer was allocated with, as counted when it was wrapped, even if the pool has been resized since
+  const int bufferSize = static_cast<int>(pool->Release(reinterpret_cast<uint8_t*>(data)));
+
+  Nan::AdjustExternalMemory(-bufferSize);
+}
+
+
+v8::Local<v8::Object> Capture::makeFrameInfo(const CaptureFrame* frame) {
+  v8::Local<v8::Object> frameInfo = Nan::New<v8::Object>();
+
+  // The sample position is 64 bit, but a double holds it exactly for over 5000 years at 48kHz
+  Nan::Set(frameInfo, Nan::New("sequence").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(frame->fSequence)));
+  Nan::Set(frameInfo, Nan::New("hardwareSequence").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(frame->fHardwareSequence)));
+  Nan::Set(frameInfo, Nan::New("cardDropped").ToLocalChecked(), Nan::New<v8::Uint32>(frame->fCardFramesDropped));
+  Nan::Set(frameInfo, Nan::New("audioSamplePosition").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(frame->fAudioSamplePosition)));
+  Nan::Set(frameInfo, Nan::New("audioSampleCount").ToLocalChecked(), Nan::New<v8::Uint32>(frame->fAudioSampleCount));
+  Nan::Set(frameInfo, Nan::New("cadenceSlot").ToLocalChecked(), Nan::New<v8::Uint32>(frame->fAudioCadenceSlot));
+  Nan::Set(frameInfo, Nan::New("discontinuity").ToLocalChecked(), Nan::New<v8::Boolean>(frame->fAudioDiscontinuity));
+  Nan::Set(frameInfo, Nan::New("nonPcmPairs").ToLocalChecked(), Nan::New<v8::Uint32>(frame->fNonPcmPairs));
+  Nan::Set(frameInfo, Nan::New("frameTime").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(frame->fFrameTime)));
+  Nan::Set(frameInfo, Nan::New("dmaTime").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(frame->fDmaCompleteTime)));
+
+  // Metering for every card channel, as peak, RMS and clip count triples
+  const Aja::AudioLevels& levels = frame->fAudioLevels;
+  const uint32_t numLevels = levels.numChannels * 3;
+  v8::Local<v8::ArrayBuffer> levelsBuffer = v8::ArrayBuffer::New(v8::Isolate::GetCurrent(), numLevels * sizeof(float));
+  float* levelsData = static_cast<float*>(levelsBuffer->GetContents().Data());
+
+  for (uint32_t channel = 0; channel < levels.numChannels; channel++) {
+    levelsData[channel * 3] = levels.peak[channel];
+    levelsData[channel * 3 + 1] = levels.rms[channel];
+    levelsData[channel * 3 + 2] = static_cast<float>(levels.clipCount[channel]);
+  }
+
+  Nan::Set(frameInfo, Nan::New("audioLevels").ToLocalChecked(), v8::Float32Array::New(levelsBuffer, 0, numLevels));
+
+  if (frame->fAncBuffer != nullptr) {
+    Nan::Set(frameInfo, Nan::New("anc").ToLocalChecked(), makeAncPackets(frame->fAncPackets));
+  }
+
+  return frameInfo;
+}
+
+
+v8::Local<v8::Array> Capture::makeAncPackets(const Aja::AncPacketList& packets) {
+  v8::Local<v8::Array> ancPackets = Nan::New<v8::Array>(packets.GetCount());
+
+  // Only the payloads are copied: a few bytes each, where the raw anc is kilobytes a field
+  for (uint32_t packetNdx = 0; packetNdx < packets.GetCount(); packetNdx++) {
+    const Aja::AncPacket& packet = packets.GetPacket(packetNdx);
+    v8::Local<v8::Object> ancPacket = Nan::New<v8::Object>();
+
+    Nan::Set(ancPacket, Nan::New("type").ToLocalChecked(),
+      Nan::New(Aja::GetAncPacketTypeName(static_cast<Aja::AncPacketType>(packet.type))).ToLocalChecked());
+    Nan::Set(ancPacket, Nan::New("did").ToLocalChecked(), Nan::New<v8::Uint32>(packet.did));
+    Nan::Set(ancPacket, Nan::New("sdid").ToLocalChecked(), Nan::New<v8::Uint32>(packet.sdid));
+    Nan::Set(ancPacket, Nan::New("field").ToLocalChecked(), Nan::New<v8::Uint32>(packet.field));
+    Nan::Set(ancPacket, Nan::New("line").ToLocalChecked(), Nan::New<v8::Uint32>(packet.line));
+    Nan::Set(ancPacket, Nan::New("data").ToLocalChecked(),
+      Nan::CopyBuffer(reinterpret_cast<const char*>(packets.GetPayload(packet)), packet.payloadSize).ToLocalChecked());
+
+    v8::Local<v8::Object> decoded;
+    if (makeDecodedAnc(packet, packets.GetPayload(packet), decoded)) {
+      Nan::Set(ancPacket, Nan::New("decoded").ToLocalChecked(), decoded);
     }
 
-    if (nextFrame->fAudioBuffer != nullptr && capture->audioEnabled_ == true)
-    {
-        // Transform the output buffer into the desired number of channels - currently this is 2
-        const char* audioTransformBuffer(nullptr);
-        uint32_t audioTransformBufferSize(0);
+    Nan::Set(ancPackets, packetNdx, ancPacket);
+  }
+
+  return ancPackets;
+}
+
+
+bool Capture::makeDecodedAnc(const Aja::AncPacket& packet, const uint8_t* payload, v8::Local<v8::Object>& decoded) {
+  decoded = Nan::New<v8::Object>();
 
-        tie(audioTransformBuffer, audioTransformBufferSize) = 
-            capture->audioTransform.TransformFromCard(reinterpret_cast<char*>(nextFrame->fAudioBuffer), nextFrame->fAudioBufferSize, 16, 2);
+  switch (packet.type) {
+    case Aja::AncPacketType_Cea608: {
+      Aja::Cea608Data cc;
+      if (!Aja::DecodeCea608(payload, packet.payloadSize, cc))
+        return false;
 
-        ba = Nan::CopyBuffer(audioTransformBuffer, audioTransformBufferSize).ToLocalChecked();
+      v8::Local<v8::Array> data = Nan::New<v8::Array>(2);
+      Nan::Set(data, 0, Nan::New<v8::Uint32>(cc.data[0]));
+      Nan::Set(data, 1, Nan::New<v8::Uint32>(cc.data[1]));
+
+      Nan::Set(decoded, Nan::New("field").ToLocalChecked(), Nan::New<v8::Uint32>(cc.field));
+      Nan::Set(decoded, Nan::New("lineOffset").ToLocalChecked(), Nan::New<v8::Uint32>(cc.lineOffset));
+      Nan::Set(decoded, Nan::New("data").ToLocalChecked(), data);
+      Nan::Set(decoded, Nan::New("parityOk").ToLocalChecked(), Nan::New<v8::Boolean>(cc.parityOk));
+      return true;
     }
 
-    capture->capture_->UnlockFrame();
-    nextFrame = nullptr;
+    case Aja::AncPacketType_Cea708: {
+      Aja::Cea708Data captions;
+      if (!Aja::DecodeCea708(payload, packet.payloadSize, captions))
+        return false;
+
+      // Each cc_data construct as [valid, type, data1, data2]
+      v8::Local<v8::Array> ccData = Nan::New<v8::Array>(captions.ccCount);
+      for (uint32_t cc = 0; cc < captions.ccCount; cc++) {
+        v8::Local<v8::Array> construct = Nan::New<v8::Array>(4);
+        Nan::Set(construct, 0, Nan::New<v8::Boolean>(captions.cc[cc].valid));
+        Nan::Set(construct, 1, Nan::New<v8::Uint32>(captions.cc[cc].type));
+        Nan::Set(construct, 2, Nan::New<v8::Uint32>(captions.cc[cc].data[0]));
+        Nan::Set(construct, 3, Nan::New<v8::Uint32>(captions.cc[cc].data[1]));
+        Nan::Set(ccData, cc, construct);
+      }
+
+      Nan::Set(decoded, Nan::New("frameRate").ToLocalChecked(), Nan::New<v8::Uint32>(captions.frameRate));
+      Nan::Set(decoded, Nan::New("flags").ToLocalChecked(), Nan::New<v8::Uint32>(captions.flags));
+      Nan::Set(decoded, Nan::New("sequence").ToLocalChecked(), Nan::New<v8::Uint32>(captions.sequence));
+      Nan::Set(decoded, Nan::New("ccData").ToLocalChecked(), ccData);
+      return true;
+    }
+
+    case Aja::AncPacketType_Afd: {
+      Aja::AfdData afd;
+      if (!Aja::DecodeAfd(payload, packet.payloadSize, afd))
+        return false;
+
+      Nan::Set(decoded, Nan::New("afd").ToLocalChecked(), Nan::New<v8::Uint32>(afd.afd));
+      Nan::Set(decoded, Nan::New("wide").ToLocalChecked(), Nan::New<v8::Boolean>(afd.wide));
+      Nan::Set(decoded, Nan::New("barFlags").ToLocalChecked(), Nan::New<v8::Uint32>(afd.barFlags));
+      Nan::Set(decoded, Nan::New("bar1").ToLocalChecked(), Nan::New<v8::Uint32>(afd.bar1));
+      Nan::Set(decoded, Nan::New("bar2").ToLocalChecked(), Nan::New<v8::Uint32>(afd.bar2));
+      return true;
+    }
+
+    default:
+      return false;
   }
+}
+
+
+void Capture::addLatencySamples(const CaptureFrame* frame, uint64_t deliveryTime) {
+  // The driver's clock counts in 100ns ticks; a driver that doesn't stamp frames leaves them at zero
+  if (frame->fFrameTime != 0 && frame->fTransferTime >= frame->fFrameTime)
+    vbiToDma_.Add((frame->fTransferTime - frame->fFrameTime) / 10.0);
+
+  if (deliveryTime >= frame->fDmaCompleteTime)
+    dmaToDelivery_.Add(static_cast<double>(deliveryTime - frame->fDmaCompleteTime));
+}
+
+
+v8::Local<v8::Object> Capture::makeLatencySummary(const Aja::LatencyStats& stats) {
+  Aja::LatencySummary summary;
+  stats.GetSummary(summary);
+
+  v8::Local<v8::Object> result = Nan::New<v8::Object>();
+  Nan::Set(result, Nan::New("count").ToLocalChecked(), Nan::New<v8::Uint32>(summary.count));
+  Nan::Set(result, Nan::New("total").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(summary.total)));
+  Nan::Set(result, Nan::New("last").ToLocalChecked(), Nan::New<v8::Number>(summary.last));
+  Nan::Set(result, Nan::New("min").ToLocalChecked(), Nan::New<v8::Number>(summary.min));
+  Nan::Set(result, Nan::New("max").ToLocalChecked(), Nan::New<v8::Number>(summary.max));
+  Nan::Set(result, Nan::New("mean").ToLocalChecked(), Nan::New<v8::Number>(summary.mean));
+  Nan::Set(result, Nan::New("p50").ToLocalChecked(), Nan::New<v8::Number>(summary.p50));
+  Nan::Set(result, Nan::New("p99").ToLocalChecked(), Nan::New<v8::Number>(summary.p99));
 
-  v8::Local<v8::Value> argv[2] = { bv, ba };
-  cb.Call(2, argv);
+  return result;
 }
 
 
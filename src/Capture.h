@@ -22,9 +22,12 @@
 #include <node_buffer.h>
 #include <nan.h>
 #include <memory>
+#include <vector>
 
 #include "ntv2capture.h"
 #include "AudioTransform.h"
+#include "LatencyStats.h"
+#include "LoudnessMeter.h"
 #include "gen2ajaTypeMaps.h"
 
 namespace streampunk {
@@ -32,19 +35,25 @@ namespace streampunk {
 class Capture : public Nan::ObjectWrap
 {
 private:
-  explicit Capture(uint32_t deviceIndex = 0, uint32_t channelNumber = 0, uint32_t displayMode = 0, uint32_t pixelFormat = 0);
+  explicit Capture(uint32_t deviceIndex = 0, uint32_t channelNumber = 0, uint32_t displayMode = 0, uint32_t pixelFormat = 0,
+                   uint32_t hostBuffers = CIRCULAR_BUFFER_SIZE, uint32_t deviceBuffers = AjaDevice::DEFAULT_DEVICE_BUFFERS,
+                   bool hugePages = false, bool anc = false, const std::vector<uint16_t>& ancFilter = std::vector<uint16_t>(),
+                   bool multiChannel = false, const Aja::ThreadPolicy& threadPolicy = Aja::ThreadPolicy(),
+                   Aja::BackpressurePolicy backpressure = Aja::BackpressurePolicy_Block);
   ~Capture();
 
   static NAN_METHOD(New);
   static inline Nan::Persistent<v8::Function> &constructor();
 
   uv_async_t *async;
+  uv_async_t *formatAsync;
+  uv_timer_t *batchTimer;
   uv_mutex_t padlock;
 
   // setup the AJA Kona interface (video standard, pixel format, callback object, ...)
   bool initNtv2Capture();
 
-  HRESULT setupAudioInput();
+  HRESULT setupAudioInput(uint32_t sampleRate, uint32_t sampleType, uint32_t channelCount, const std::vector<uint32_t>& channelMap);
 
   bool initInput();
 
@@ -67,19 +76,116 @@ private:
 
   static NAN_METHOD(GetVideoFormat);
 
+  static NAN_METHOD(EnableLoudness);
+
+  static NAN_METHOD(GetLoudness);
+
+  static NAN_METHOD(ResetLoudness);
+
+  // Rolling statistics of how long frames take from the vertical interrupt to the host, and from there to JavaScript
+  static NAN_METHOD(GetLatencyStats);
+
+  static NAN_METHOD(ResetLatencyStats);
+
+  // AutoCirculate's counts of frames captured and dropped by the card, and frames waiting on it, plus the frames
+  // the backpressure policy dropped from the host ring buffer
+  static NAN_METHOD(GetCaptureStatus);
+
+  // Counts of the capture thread's calls into the driver, against its budget of calls per frame
+  static NAN_METHOD(GetDriverCalls);
+
+  static NAN_METHOD(ResetDriverCalls);
+
+  // The CPUs, priority and NUMA node the capture thread actually got, or null until it has started
+  static NAN_METHOD(GetThreadPolicy);
+
+  // Write frames straight to disk on a native thread, rather than delivering them to JavaScript
+  static NAN_METHOD(StartRecording);
+
+  static NAN_METHOD(StopRecording);
+
+  static NAN_METHOD(GetRecordingStatus);
+
+  // Keep the most recent frames in a memory mapped ring file, which Playback can replay from
+  static NAN_METHOD(StartTimeshift);
+
+  static NAN_METHOD(StopTimeshift);
+
   static NAUV_WORK_CB(FrameCallback);
 
+  // Set the callback for input format changes, which is given { displayMode, sequence }
+  static NAN_METHOD(OnFormatChange);
+
+  static NAUV_WORK_CB(FormatChangeCallback);
+
+  // Collect a frame read by readNextFrame into the current batch, and deliver the batch once it is full or
+  // its first frame has waited out the latency budget
+  void addToBatch(v8::Local<v8::Value> frame[3]);
+  void flushBatch();
+
+  // Deliver a part batch once its first frame has waited out the latency budget, even if no more frames come
+  static void BatchTimerCallback(uv_timer_t* handle);
+  static void closeBatchTimer(uv_handle_t* handle);
+
+  // Take the next captured frame as the video, audio and info arguments for the frame callback. Returns false if none is ready.
+  bool readNextFrame(v8::Local<v8::Value> frame[3]);
+
+  // Hand a locked frame's video buffer to JavaScript without copying it. The buffer returns to the pool when collected.
+  v8::Local<v8::Object> wrapVideoBuffer(CaptureFrame* frame);
+  static void releaseVideoBuffer(char* data, void* hint);
+
+  // Build the per-frame metadata object passed to the frame callback alongside the video and audio buffers
+  static v8::Local<v8::Object> makeFrameInfo(const CaptureFrame* frame);
+
+  // The frame's parsed ancillary packets, as an array of { type, did, sdid, field, line, data }
+  static v8::Local<v8::Array> makeAncPackets(const Aja::AncPacketList& packets);
+  // The fields of a caption or AFD packet, decoded; false for other types, or a packet too malformed to decode
+  static bool makeDecodedAnc(const Aja::AncPacket& packet, const uint8_t* payload, v8::Local<v8::Object>& decoded);
+
+  // Time a frame on its way to JavaScript, deliveryTime being the host clock as it is handed over
+  void addLatencySamples(const CaptureFrame* frame, uint64_t deliveryTime);
+  static v8::Local<v8::Object> makeLatencySummary(const Aja::LatencyStats& stats);
+
   uint32_t deviceIndex_;
   uint32_t channelNumber_;
   uint32_t displayMode_;
   uint32_t genericPixelFormat_;
+  uint32_t hostBuffers_;
+  uint32_t deviceBuffers_;
+  bool hugePages_;
+  bool anc_;
+  std::vector<uint16_t> ancFilter_;
+  bool multiChannel_;
+  Aja::ThreadPolicy threadPolicy_;
+  Aja::BackpressurePolicy backpressure_;
   //uint32_t width_;
   //uint32_t height_;
   bool audioEnabled_;
+  uint32_t audioSampleRate_;
+  uint32_t audioSampleType_;
 
   Aja::AudioTransform audioTransform;
+  Aja::LoudnessMeter loudnessMeter_;
+
+  // Only touched on the Node thread
+  Aja::LatencyStats vbiToDma_;
+  Aja::LatencyStats dmaToDelivery_;
+  uint64_t framesMissed_;           // Frames lost before reaching JavaScript, from the gaps in the hardware sequence; recorded frames aren't lost
 
   Nan::Persistent<v8::Function> captureCB_;
+  Nan::Persistent<v8::Function> formatChangeCB_;
+
+  // The latest format change, waiting for FormatChangeCallback; guarded by padlock
+  bool formatChangePending_;
+  GenericDisplayMode changedFormat_;
+  uint64_t changedFormatSequence_;
+
+  // Batch delivery, off unless doCapture is given batch options: the callback then gets an array of frames
+  bool batchMode_;
+  uint32_t batchFrames_;          // Deliver once this many frames are waiting, or 0 for no limit
+  uint32_t batchLatencyMs_;       // Deliver once the oldest frame has waited this long, or 0 for no limit
+  uint64_t batchStartTime_;       // uv_hrtime when the first frame of the batch arrived
+  Nan::Persistent<v8::Array> batch_;
 
   std::unique_ptr<NTV2Capture> capture_;
 
@@ -91,6 +197,12 @@ public:
   void frameArrived();
   static void _frameArrived(void* context);
 
+  void audioCaptured(const CaptureFrame* frame);
+  static void _audioCaptured(void* context, const CaptureFrame* frame);
+
+  void formatChanged(NTV2VideoFormat newFormat, uint64_t firstSequence);
+  static void _formatChanged(void* context, NTV2VideoFormat newFormat, uint64_t firstSequence);
+
   static const NTV2FrameBufferFormat defaultPixelFormat_ = NTV2_FBF_10BIT_YCBCR;
 };
 
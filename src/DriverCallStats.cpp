@@ -0,0 +1,81 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+
+#include "DriverCallStats.h"
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+DriverCallStats::DriverCallStats(uint32_t budget)
+:   totals_()
+{
+    for (int call = 0; call < DriverCall_LAST; call++)
+        pass_[call] = 0;
+
+    totals_.budget = budget;
+}
+
+
+void DriverCallStats::EndPass()
+{
+    uint32_t passCalls(0);
+
+    std::lock_guard<std::mutex> lock(lock_);
+
+    for (int call = 0; call < DriverCall_LAST; call++)
+    {
+        totals_.calls[call] += pass_[call];
+        passCalls += pass_[call];
+        pass_[call] = 0;
+    }
+
+    totals_.passes++;
+
+    if (passCalls > totals_.budget)
+        totals_.overBudget++;
+    if (passCalls > totals_.maxPerPass)
+        totals_.maxPerPass = passCalls;
+}
+
+
+void DriverCallStats::Reset()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+
+    const uint32_t budget(totals_.budget);
+    totals_ = DriverCallSummary();
+    totals_.budget = budget;
+}
+
+
+void DriverCallStats::GetSummary(DriverCallSummary& summary) const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+
+    summary = totals_;
+
+    uint64_t calls(0);
+    for (int call = 0; call < DriverCall_LAST; call++)
+        calls += summary.calls[call];
+
+    summary.meanPerPass = summary.passes > 0 ? static_cast<double>(calls) / summary.passes : 0.0;
+}
+
+}
+}
@@ -0,0 +1,76 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+// The kinds of call a producer loop makes into the driver
+enum DriverCall
+{
+    DriverCall_VbiWait = 0,         // Waiting for a vertical interrupt
+    DriverCall_Status,              // AutoCirculateGetStatus
+    DriverCall_Transfer,            // AutoCirculateTransfer
+    DriverCall_Other,               // Anything else, such as reading the input format
+    DriverCall_LAST
+};
+
+
+// A summary of the driver calls made by a producer loop since the last reset
+struct DriverCallSummary
+{
+    uint64_t passes;                // Times round the loop, normally one per frame
+    uint64_t calls[DriverCall_LAST];
+    uint64_t overBudget;            // Passes that made more calls than the budget
+    uint32_t maxPerPass;            // The most calls made in a single pass
+    uint32_t budget;                // The calls a pass is expected to make
+    double   meanPerPass;
+};
+
+
+// Counts the driver calls a producer loop makes, pass by pass, so its cost per frame can be checked against
+// the budget it was designed for. Counting is for the producer thread alone; the summary can be read and
+// reset from any thread.
+class DriverCallStats
+{
+public:
+
+    explicit DriverCallStats(uint32_t budget);
+
+    // Producer thread only
+    void Count(DriverCall call) { pass_[call]++; }
+    void EndPass();
+
+    void Reset();
+
+    void GetSummary(DriverCallSummary& summary) const;
+
+private:
+
+    uint32_t           pass_[DriverCall_LAST];     // This pass so far
+    DriverCallSummary  totals_;
+    mutable std::mutex lock_;
+};
+
+}
+}
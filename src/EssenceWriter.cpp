@@ -0,0 +1,245 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "EssenceWriter.h"
+#include <string.h>
+#include <sstream>
+#include "ajabase/system/memory.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+#if defined(_WIN32)
+#define ESSENCE_FILE_CLOSED INVALID_HANDLE_VALUE
+#else
+#define ESSENCE_FILE_CLOSED -1
+#endif
+
+
+EssenceWriter::EssenceWriter()
+:   file_(ESSENCE_FILE_CLOSED),
+    index_(nullptr),
+    unbuffered_(false),
+    staging_(nullptr),
+    offset_(0),
+    framesWritten_(0),
+    bytesWritten_(0)
+{
+}
+
+
+EssenceWriter::~EssenceWriter()
+{
+    Close();
+}
+
+
+bool EssenceWriter::Open(const std::string& essencePath, const std::string& indexPath)
+{
+    Close();
+
+    lastError_.clear();
+    offset_ = 0;
+    framesWritten_ = 0;
+    bytesWritten_ = 0;
+
+    staging_ = static_cast<uint8_t*>(AJAMemory::AllocateAligned(STAGING_SIZE, BLOCK_SIZE));
+    if (staging_ == nullptr)
+    {
+        SetError("unable to allocate the staging buffer");
+        return false;
+    }
+
+#if defined(_WIN32)
+    file_ = CreateFileA(essencePath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    unbuffered_ = file_ != INVALID_HANDLE_VALUE;
+
+    if (!unbuffered_)
+        file_ = CreateFileA(essencePath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+#elif defined(O_DIRECT)
+    // Some file systems, such as tmpfs, refuse O_DIRECT - those get written through the cache
+    file_ = open(essencePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    unbuffered_ = file_ != -1;
+
+    if (!unbuffered_)
+        file_ = open(essencePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#else
+    file_ = open(essencePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#if defined(F_NOCACHE)
+    unbuffered_ = file_ != -1 && fcntl(file_, F_NOCACHE, 1) != -1;
+#endif
+#endif
+
+    if (file_ == ESSENCE_FILE_CLOSED)
+    {
+        SetError("unable to create essence file " + essencePath);
+        Close();
+        return false;
+    }
+
+    index_ = fopen(indexPath.c_str(), "wb");
+    if (index_ == nullptr)
+    {
+        SetError("unable to create index file " + indexPath);
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+
+bool EssenceWriter::WriteFrame(EssenceIndexEntry& entry, const uint8_t* video, const uint8_t* audio)
+{
+    if (!IsOpen())
+    {
+        lastError_ = "not open";
+        return false;
+    }
+
+    entry.videoOffset = offset_;
+    if (!Append(video, entry.videoSize))
+        return false;
+
+    entry.audioOffset = offset_;
+    if (audio == nullptr)
+        entry.audioSize = 0;
+    else if (!Append(audio, entry.audioSize))
+        return false;
+
+    if (fwrite(&entry, sizeof(entry), 1, index_) != 1)
+    {
+        SetError("unable to write index");
+        return false;
+    }
+
+    framesWritten_++;
+    bytesWritten_ += entry.videoSize + entry.audioSize;
+
+    return true;
+}
+
+
+void EssenceWriter::Close()
+{
+    if (index_ != nullptr)
+    {
+        fclose(index_);
+        index_ = nullptr;
+    }
+
+    if (file_ != ESSENCE_FILE_CLOSED)
+    {
+#if defined(_WIN32)
+        CloseHandle(file_);
+#else
+        close(file_);
+#endif
+        file_ = ESSENCE_FILE_CLOSED;
+    }
+
+    if (staging_ != nullptr)
+    {
+        AJAMemory::FreeAligned(staging_);
+        staging_ = nullptr;
+    }
+
+    unbuffered_ = false;
+}
+
+
+bool EssenceWriter::Append(const uint8_t* data, uint32_t size)
+{
+    // Whole blocks of aligned memory go straight to the file...
+    const bool aligned = (reinterpret_cast<uintptr_t>(data) % BLOCK_SIZE) == 0;
+    const uint32_t direct = aligned ? size - size % BLOCK_SIZE : 0;
+
+    if (direct > 0 && !WriteBlocks(data, direct))
+        return false;
+
+    // ...and the rest is copied through the staging buffer, with the last block padded out with zeros
+    for (uint32_t done = direct; done < size; )
+    {
+        const uint32_t chunk = (size - done) < STAGING_SIZE ? (size - done) : STAGING_SIZE;
+        const uint32_t padded = (chunk + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+
+        memcpy(staging_, data + done, chunk);
+        memset(staging_ + chunk, 0, padded - chunk);
+
+        if (!WriteBlocks(staging_, padded))
+            return false;
+
+        done += chunk;
+    }
+
+    return true;
+}
+
+
+bool EssenceWriter::WriteBlocks(const uint8_t* data, uint32_t size)
+{
+    while (size > 0)
+    {
+#if defined(_WIN32)
+        DWORD written(0);
+        if (!WriteFile(file_, data, size, &written, NULL) || written == 0)
+#else
+        const ssize_t written = write(file_, data, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+#endif
+        {
+            SetError("unable to write essence");
+            return false;
+        }
+
+        data += written;
+        size -= static_cast<uint32_t>(written);
+        offset_ += written;
+    }
+
+    return true;
+}
+
+
+void EssenceWriter::SetError(const std::string& what)
+{
+    std::ostringstream error;
+
+#if defined(_WIN32)
+    error << what << " (error " << ::GetLastError() << ")";
+#else
+    error << what << " (" << strerror(errno) << ")";
+#endif
+
+    lastError_ = error.str();
+}
+
+}
+}
@@ -0,0 +1,105 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+// One record in a recording's index file: the file is nothing but these, one per frame, in the order
+// the frames were written. Offsets are into the essence file, and always a multiple of BLOCK_SIZE.
+struct EssenceIndexEntry
+{
+    uint64_t sequence;              // Hardware sequence number, so gaps show where the card dropped frames
+    uint64_t videoOffset;
+    uint64_t audioOffset;
+    uint64_t audioSamplePosition;   // Cumulative index of the first audio sample, from the start of capture
+    uint32_t videoSize;             // In bytes, not counting the padding up to the next block
+    uint32_t audioSize;
+    uint32_t audioSampleCount;      // Per channel
+    uint32_t timecodeDBB;           // RP188 timecode, as captured
+    uint32_t timecodeLow;
+    uint32_t timecodeHigh;
+};
+
+
+// Writes captured frames to a raw essence file plus an index, bypassing the OS file cache: each frame's
+// video and audio are written in whole, aligned blocks (O_DIRECT on Linux, F_NOCACHE on the Mac and
+// FILE_FLAG_NO_BUFFERING on Windows), so recording at 4K rates doesn't flood the cache with data that
+// won't be read again. Buffers that are already block aligned, such as the capture video buffers, are
+// written in place; anything else goes through an aligned staging buffer. Not thread safe.
+class EssenceWriter
+{
+public:
+
+    static const uint32_t BLOCK_SIZE = 4096;
+    static const uint32_t STAGING_SIZE = 1024 * 1024;
+
+    EssenceWriter();
+    ~EssenceWriter();
+
+    // Create or truncate the essence and index files. If the file system won't do unbuffered I/O, the
+    // essence is written through the cache instead. Returns false, with GetError set, on failure.
+    bool Open(const std::string& essencePath, const std::string& indexPath);
+
+    // Append a frame, filling in the entry's offsets and adding it to the index. The audio may be NULL.
+    bool WriteFrame(EssenceIndexEntry& entry, const uint8_t* video, const uint8_t* audio);
+
+    // Flush the index and close both files. Safe to call when not open.
+    void Close();
+
+    bool IsOpen() const { return index_ != nullptr; }
+    bool IsUnbuffered() const { return unbuffered_; }
+
+    uint64_t GetFramesWritten() const { return framesWritten_; }
+    uint64_t GetBytesWritten() const { return bytesWritten_; }
+    const std::string& GetError() const { return lastError_; }
+
+private:
+
+    EssenceWriter(const EssenceWriter&);
+    EssenceWriter& operator=(const EssenceWriter&);
+
+    // Write size bytes at the current offset, padded with zeros up to the next block. Returns false on error.
+    bool Append(const uint8_t* data, uint32_t size);
+
+    // Write whole blocks from block aligned memory
+    bool WriteBlocks(const uint8_t* data, uint32_t size);
+
+    void SetError(const std::string& what);
+
+#if defined(_WIN32)
+    void*       file_;
+#else
+    int         file_;
+#endif
+    FILE*       index_;
+    bool        unbuffered_;
+    uint8_t*    staging_;
+    uint64_t    offset_;
+    uint64_t    framesWritten_;
+    uint64_t    bytesWritten_;
+    std::string lastError_;
+};
+
+}
+}
@@ -0,0 +1,235 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+// What the producer does when the consumer has fallen behind and there is no free frame to fill
+enum BackpressurePolicy
+{
+    BackpressurePolicy_Block = 0,       // Wait for the consumer. Nothing is lost here, but the card drops frames if it goes on too long
+    BackpressurePolicy_DropOldest,      // Reuse the oldest unread frame, so the consumer always gets the freshest
+    BackpressurePolicy_DropNewest,      // Fill the spare frame and throw it away, keeping the frames already waiting
+    BackpressurePolicy_LAST
+};
+
+
+// Hands frames from one producer thread to one consumer thread, with the same produce and consume calls as
+// AJACircularBuffer but a choice of what happens when it is full. The frames are pointers to buffers owned
+// elsewhere, which just move between free, waiting and in use; nothing is allocated once they have been added.
+template <typename FramePtr>
+class FrameQueue
+{
+public:
+
+    FrameQueue()
+    :   policy_(BackpressurePolicy_Block),
+        abortFlag_(nullptr),
+        spare_(),
+        producing_(),
+        producingSpare_(false),
+        consuming_(),
+        oldest_(0),
+        waiting_(0),
+        dropped_(0)
+    {
+    }
+
+    // While blocked, the producer and consumer give up and return a null frame once this is set
+    void SetAbortFlag(const std::atomic<bool>* abortFlag)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        abortFlag_ = abortFlag;
+    }
+
+    // Can be changed at any time; it applies from the next frame produced
+    void SetPolicy(BackpressurePolicy policy)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        policy_ = policy < BackpressurePolicy_LAST ? policy : BackpressurePolicy_Block;
+    }
+
+    BackpressurePolicy GetPolicy() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return policy_;
+    }
+
+    // Add a frame to fill. All the frames must be added before the first is produced.
+    void Add(FramePtr frame)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(frame);
+        ring_.push_back(FramePtr());
+    }
+
+    // The frame BackpressurePolicy_DropNewest fills and throws away. Without one, that policy blocks instead.
+    void SetSpare(FramePtr frame)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        spare_ = frame;
+    }
+
+    // Returns the next frame to fill, or a null frame if blocked when the abort flag was set
+    FramePtr StartProduceNextBuffer()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        while (free_.empty())
+        {
+            if (policy_ == BackpressurePolicy_DropOldest && waiting_ > 0)
+            {
+                free_.push_back(ring_[oldest_]);
+                oldest_ = (oldest_ + 1) % ring_.size();
+                waiting_--;
+                dropped_++;
+                break;
+            }
+
+            if (policy_ == BackpressurePolicy_DropNewest && spare_ != FramePtr())
+            {
+                producing_ = spare_;
+                producingSpare_ = true;
+                dropped_++;
+                return producing_;
+            }
+
+            if (IsAborted())
+                return FramePtr();
+
+            // Wake now and then to check the abort flag, which is set without notifying
+            notFull_.wait_for(lock, std::chrono::milliseconds(50));
+        }
+
+        producing_ = free_.back();
+        producingSpare_ = false;
+        free_.pop_back();
+        return producing_;
+    }
+
+    // Make the frame filled since StartProduceNextBuffer available to the consumer, unless it was the spare
+    void EndProduceNextBuffer()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!producingSpare_)
+        {
+            ring_[(oldest_ + waiting_) % ring_.size()] = producing_;
+            waiting_++;
+            notEmpty_.notify_one();
+        }
+
+        producing_ = FramePtr();
+        producingSpare_ = false;
+    }
+
+    // Give back the frame from StartProduceNextBuffer instead, for when what was copied into it turned out to be
+    // bad. The consumer never sees it, and it is free to fill again.
+    void AbandonProduceNextBuffer()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (producing_ != FramePtr() && !producingSpare_)
+        {
+            free_.push_back(producing_);
+            notFull_.notify_one();
+        }
+
+        producing_ = FramePtr();
+        producingSpare_ = false;
+    }
+
+    // Returns the oldest waiting frame, blocking until there is one, or a null frame if the abort flag was set
+    FramePtr StartConsumeNextBuffer()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        while (waiting_ == 0)
+        {
+            if (IsAborted())
+                return FramePtr();
+
+            notEmpty_.wait_for(lock, std::chrono::milliseconds(50));
+        }
+
+        consuming_ = ring_[oldest_];
+        oldest_ = (oldest_ + 1) % ring_.size();
+        waiting_--;
+        return consuming_;
+    }
+
+    // Give the frame from StartConsumeNextBuffer back to be filled again
+    void EndConsumeNextBuffer()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (consuming_ != FramePtr())
+        {
+            free_.push_back(consuming_);
+            consuming_ = FramePtr();
+            notFull_.notify_one();
+        }
+    }
+
+    // Frames produced and waiting to be consumed
+    unsigned int GetCircBufferCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return waiting_;
+    }
+
+    // Frames lost to the policy, whether the oldest overwritten or the newest thrown away
+    uint64_t GetDropped() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return dropped_;
+    }
+
+private:
+
+    bool IsAborted() const { return abortFlag_ != nullptr && *abortFlag_; }
+
+    mutable std::mutex      mutex_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+
+    BackpressurePolicy      policy_;
+    const std::atomic<bool>* abortFlag_;
+
+    std::vector<FramePtr>   free_;          // Frames ready to fill, used as a stack
+    std::vector<FramePtr>   ring_;          // Frames waiting to be consumed, oldest first from oldest_
+    FramePtr                spare_;
+    FramePtr                producing_;
+    bool                    producingSpare_;
+    FramePtr                consuming_;
+    size_t                  oldest_;
+    unsigned int            waiting_;
+    uint64_t                dropped_;
+};
+
+}
+}
@@ -0,0 +1,88 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "LatencyStats.h"
+#include <algorithm>
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+// The nearest rank percentile of sorted samples: the smallest that at least percent% of them are no greater than
+static double nearestRank(const std::vector<double>& sorted, uint32_t percent)
+{
+    const size_t rank = (sorted.size() * percent + 99) / 100;
+
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+
+LatencyStats::LatencyStats(uint32_t window)
+:   window_(window > 0 ? window : 1),
+    total_(0),
+    last_(0.0)
+{
+    samples_.reserve(window_);
+}
+
+
+void LatencyStats::Add(double microseconds)
+{
+    if (samples_.size() < window_)
+        samples_.push_back(microseconds);
+    else
+        samples_[total_ % window_] = microseconds;
+
+    last_ = microseconds;
+    total_++;
+}
+
+
+void LatencyStats::Reset()
+{
+    samples_.clear();
+    total_ = 0;
+    last_ = 0.0;
+}
+
+
+void LatencyStats::GetSummary(LatencySummary& summary) const
+{
+    summary = LatencySummary();
+    summary.count = static_cast<uint32_t>(samples_.size());
+    summary.total = total_;
+
+    if (samples_.empty())
+        return;
+
+    std::vector<double> sorted(samples_);
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum(0.0);
+    for (size_t sample = 0; sample < sorted.size(); sample++)
+        sum += sorted[sample];
+
+    summary.last = last_;
+    summary.min = sorted.front();
+    summary.max = sorted.back();
+    summary.mean = sum / sorted.size();
+    summary.p50 = nearestRank(sorted, 50);
+    summary.p99 = nearestRank(sorted, 99);
+}
+
+}
+}
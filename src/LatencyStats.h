@@ -0,0 +1,67 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+// A summary of the latencies in a LatencyStats window, in microseconds. All zero if there are none.
+struct LatencySummary
+{
+    uint32_t count;                 // Samples in the window
+    uint64_t total;                 // Samples added since the last reset, including those gone from the window
+    double   last;
+    double   min;
+    double   max;
+    double   mean;
+    double   p50;
+    double   p99;
+};
+
+
+// Rolling statistics over the last so many latency measurements, such as one per captured frame.
+// Adding a sample is cheap enough for every frame; the percentiles are only worked out when asked for.
+// Not thread safe: add and read on the same thread.
+class LatencyStats
+{
+public:
+
+    static const uint32_t DEFAULT_WINDOW = 300;     // Five seconds at 60 frames per second
+
+    explicit LatencyStats(uint32_t window = DEFAULT_WINDOW);
+
+    void Add(double microseconds);
+
+    void Reset();
+
+    void GetSummary(LatencySummary& summary) const;
+
+private:
+
+    std::vector<double> samples_;   // A ring of the last window_ samples
+    uint32_t            window_;
+    uint64_t            total_;
+    double              last_;
+};
+
+}
+}
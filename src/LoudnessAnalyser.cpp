@@ -0,0 +1,252 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "LoudnessAnalyser.h"
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <string.h>
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+namespace
+{
+
+// BS.1770-4 K-weighting at 48kHz: a high shelf modelling the head, then the RLB high pass
+const double SHELF_B0 =  1.53512485958697;
+const double SHELF_B1 = -2.69169618940638;
+const double SHELF_B2 =  1.19839281085285;
+const double SHELF_A1 = -1.69065929318241;
+const double SHELF_A2 =  0.73248077421585;
+
+const double HIGH_PASS_B0 =  1.0;
+const double HIGH_PASS_B1 = -2.0;
+const double HIGH_PASS_B2 =  1.0;
+const double HIGH_PASS_A1 = -1.99004745483398;
+const double HIGH_PASS_A2 =  0.99007225036621;
+
+// BS.1770-4 Annex 2 polyphase interpolation filter for 4x oversampled true peak
+const float TRUE_PEAK_COEFFS[4][12] =
+{
+    {  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f, -0.0594482421875f,  0.1373291015625f,
+       0.9721679687500f, -0.1022949218750f,  0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+    { -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f, -0.1665039062500f,  0.4650878906250f,
+       0.7797851562500f, -0.2003173828125f,  0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+    { -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f, -0.2003173828125f,  0.7797851562500f,
+       0.4650878906250f, -0.1665039062500f,  0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+    { -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f, -0.1022949218750f,  0.9721679687500f,
+       0.1373291015625f, -0.0594482421875f,  0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f }
+};
+
+const double RELATIVE_GATE_LU = -10.0;
+
+}
+
+
+LoudnessAnalyser::LoudnessAnalyser()
+:   histogramCounts_(HISTOGRAM_BINS),
+    histogramPowers_(HISTOGRAM_BINS)
+{
+    // Default to stereo
+    Configure(std::vector<double>(2, 1.0));
+}
+
+
+bool LoudnessAnalyser::Configure(const std::vector<double>& channelWeights)
+{
+    if (channelWeights.empty() || channelWeights.size() > MAX_CHANNELS)
+        return false;
+
+    for (auto weight : channelWeights)
+    {
+        if (!(weight >= 0.0))
+            return false;
+    }
+
+    weights_ = channelWeights;
+    channels_.resize(weights_.size());
+
+    Reset();
+
+    return true;
+}
+
+
+void LoudnessAnalyser::Reset()
+{
+    for (auto& channel : channels_)
+        memset(&channel, 0, sizeof(channel));
+
+    subBlockEnergy_ = 0.0;
+    subBlockSamples_ = 0;
+    memset(subBlockPowers_, 0, sizeof(subBlockPowers_));
+    subBlockIndex_ = 0;
+    subBlocksCompleted_ = 0;
+
+    std::fill(histogramCounts_.begin(), histogramCounts_.end(), 0);
+    std::fill(histogramPowers_.begin(), histogramPowers_.end(), 0.0);
+
+    truePeak_ = 0.0f;
+    samplesProcessed_ = 0;
+}
+
+
+void LoudnessAnalyser::AddSamples(const float* samples, uint32_t numSamples)
+{
+    const uint32_t numChannels = GetNumChannels();
+
+    for (uint32_t sampleIdx = 0; sampleIdx < numSamples; sampleIdx++)
+    {
+        const float* frame = samples + sampleIdx * numChannels;
+
+        for (uint32_t channelIdx = 0; channelIdx < numChannels; channelIdx++)
+        {
+            ChannelState& channel = channels_[channelIdx];
+            const double x = frame[channelIdx];
+
+            // K-weighting, both stages in direct form II transposed
+            const double shelved = SHELF_B0 * x + channel.shelf[0];
+            channel.shelf[0] = SHELF_B1 * x - SHELF_A1 * shelved + channel.shelf[1];
+            channel.shelf[1] = SHELF_B2 * x - SHELF_A2 * shelved;
+
+            const double weighted = HIGH_PASS_B0 * shelved + channel.highPass[0];
+            channel.highPass[0] = HIGH_PASS_B1 * shelved - HIGH_PASS_A1 * weighted + channel.highPass[1];
+            channel.highPass[1] = HIGH_PASS_B2 * shelved - HIGH_PASS_A2 * weighted;
+
+            subBlockEnergy_ += weights_[channelIdx] * weighted * weighted;
+
+            // True peak runs on the unweighted signal
+            memmove(channel.history + 1, channel.history, (TRUE_PEAK_TAPS - 1) * sizeof(float));
+            channel.history[0] = frame[channelIdx];
+
+            for (uint32_t phase = 0; phase < TRUE_PEAK_PHASES; phase++)
+            {
+                float interpolated = 0.0f;
+                for (uint32_t tap = 0; tap < TRUE_PEAK_TAPS; tap++)
+                    interpolated += TRUE_PEAK_COEFFS[phase][tap] * channel.history[tap];
+
+                if (fabsf(interpolated) > truePeak_)
+                    truePeak_ = fabsf(interpolated);
+            }
+
+            if (fabsf(frame[channelIdx]) > truePeak_)
+                truePeak_ = fabsf(frame[channelIdx]);
+        }
+
+        if (++subBlockSamples_ == SUB_BLOCK_SAMPLES)
+            EndSubBlock();
+    }
+
+    samplesProcessed_ += numSamples;
+}
+
+
+void LoudnessAnalyser::GetResults(LoudnessResults& results) const
+{
+    const double minusInfinity = -std::numeric_limits<double>::infinity();
+
+    // The sliding windows are zero padded, as if measurement started from silence
+    results.momentary = subBlocksCompleted_ > 0 ? PowerToLoudness(SlidingPower(MOMENTARY_SUB_BLOCKS)) : minusInfinity;
+    results.shortTerm = subBlocksCompleted_ > 0 ? PowerToLoudness(SlidingPower(SHORT_TERM_SUB_BLOCKS)) : minusInfinity;
+    results.truePeak = truePeak_ > 0.0f ? 20.0 * log10(truePeak_) : minusInfinity;
+    results.samplesProcessed = samplesProcessed_;
+
+    // Everything in the histogram has already passed the absolute gate. The relative gate is 10 LU below
+    // the loudness of all of those blocks together.
+    uint64_t totalCount(0);
+    double totalPower(0.0);
+
+    for (uint32_t bin = 0; bin < HISTOGRAM_BINS; bin++)
+    {
+        totalCount += histogramCounts_[bin];
+        totalPower += histogramPowers_[bin];
+    }
+
+    if (totalCount == 0)
+    {
+        results.integrated = minusInfinity;
+        return;
+    }
+
+    const double relativeGate = PowerToLoudness(totalPower / totalCount) + RELATIVE_GATE_LU;
+    const int gateBin = static_cast<int>(floor((relativeGate - HISTOGRAM_MIN_LUFS) * HISTOGRAM_BINS_PER_LU));
+
+    uint64_t gatedCount(0);
+    double gatedPower(0.0);
+
+    for (uint32_t bin = gateBin > 0 ? gateBin : 0; bin < HISTOGRAM_BINS; bin++)
+    {
+        gatedCount += histogramCounts_[bin];
+        gatedPower += histogramPowers_[bin];
+    }
+
+    results.integrated = gatedCount > 0 ? PowerToLoudness(gatedPower / gatedCount) : minusInfinity;
+}
+
+
+void LoudnessAnalyser::EndSubBlock()
+{
+    subBlockPowers_[subBlockIndex_] = subBlockEnergy_ / SUB_BLOCK_SAMPLES;
+    subBlockIndex_ = (subBlockIndex_ + 1) % SHORT_TERM_SUB_BLOCKS;
+    subBlocksCompleted_++;
+
+    subBlockEnergy_ = 0.0;
+    subBlockSamples_ = 0;
+
+    // Gating blocks are 400ms long with 75% overlap, so one completes with every 100ms sub-block
+    if (subBlocksCompleted_ >= MOMENTARY_SUB_BLOCKS)
+        AddGatingBlock(SlidingPower(MOMENTARY_SUB_BLOCKS));
+}
+
+
+void LoudnessAnalyser::AddGatingBlock(double power)
+{
+    const double loudness = PowerToLoudness(power);
+
+    if (!(loudness > HISTOGRAM_MIN_LUFS))
+        return;
+
+    int bin = static_cast<int>(floor((loudness - HISTOGRAM_MIN_LUFS) * HISTOGRAM_BINS_PER_LU));
+    if (bin >= static_cast<int>(HISTOGRAM_BINS))
+        bin = HISTOGRAM_BINS - 1;
+
+    // Each bin keeps the exact power sum, so only the position of the relative gate is quantised (to 0.01 LU)
+    histogramCounts_[bin]++;
+    histogramPowers_[bin] += power;
+}
+
+
+double LoudnessAnalyser::SlidingPower(uint32_t numSubBlocks) const
+{
+    double sum(0.0);
+
+    for (uint32_t i = 1; i <= numSubBlocks; i++)
+        sum += subBlockPowers_[(subBlockIndex_ + SHORT_TERM_SUB_BLOCKS - i) % SHORT_TERM_SUB_BLOCKS];
+
+    return sum / numSubBlocks;
+}
+
+
+double LoudnessAnalyser::PowerToLoudness(double power)
+{
+    return power > 0.0 ? -0.691 + 10.0 * log10(power) : -std::numeric_limits<double>::infinity();
+}
+
+}
+}
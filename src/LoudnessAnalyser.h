@@ -0,0 +1,106 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+// Loudness figures in LUFS, and true peak in dBTP. Figures with no audio behind them yet are -infinity.
+struct LoudnessResults
+{
+    double   momentary;         // 400ms sliding window
+    double   shortTerm;         // 3s sliding window
+    double   integrated;        // Gated, since the last reset
+    double   truePeak;          // Maximum 4x oversampled peak across the programme channels, since the last reset
+    uint64_t samplesProcessed;
+};
+
+
+// Incremental ITU-R BS.1770-4 / EBU R128 loudness measurement of 48kHz audio. Not thread safe:
+// LoudnessMeter runs one of these on its worker thread.
+class LoudnessAnalyser
+{
+public:
+
+    static const uint32_t SAMPLE_RATE = 48000;
+    static const uint32_t MAX_CHANNELS = 16;
+
+    LoudnessAnalyser();
+
+    // Set the channel weightings (1.0 for L, R and C, 1.41 for the surrounds, 0.0 to exclude LFE), and reset
+    bool Configure(const std::vector<double>& channelWeights);
+
+    // Discard all measurements and filter state, keeping the configuration
+    void Reset();
+
+    // Add numSamples samples of interleaved float audio, one value per configured channel, full scale +/-1.0
+    void AddSamples(const float* samples, uint32_t numSamples);
+
+    void GetResults(LoudnessResults& results) const;
+
+    uint32_t GetNumChannels() const { return static_cast<uint32_t>(weights_.size()); }
+
+private:
+
+    static const uint32_t SUB_BLOCK_SAMPLES = SAMPLE_RATE / 10;    // Gating blocks step by 100ms
+    static const uint32_t MOMENTARY_SUB_BLOCKS = 4;
+    static const uint32_t SHORT_TERM_SUB_BLOCKS = 30;
+    static const uint32_t TRUE_PEAK_PHASES = 4;
+    static const uint32_t TRUE_PEAK_TAPS = 12;                     // Per phase
+
+    // Gated blocks are kept as a histogram rather than a list, so memory stays fixed however long we run
+    static const int HISTOGRAM_BINS_PER_LU = 100;
+    static const int HISTOGRAM_MIN_LUFS = -70;                     // The absolute gate
+    static const int HISTOGRAM_MAX_LUFS = 10;
+    static const uint32_t HISTOGRAM_BINS = (HISTOGRAM_MAX_LUFS - HISTOGRAM_MIN_LUFS) * HISTOGRAM_BINS_PER_LU;
+
+    struct ChannelState
+    {
+        double shelf[2];                    // Direct form II transposed state for each K-weighting stage
+        double highPass[2];
+        float  history[TRUE_PEAK_TAPS];     // Most recent input samples, newest first, for the true peak filter
+    };
+
+    void EndSubBlock();
+    void AddGatingBlock(double power);
+    double SlidingPower(uint32_t numSubBlocks) const;
+
+    static double PowerToLoudness(double power);
+
+    std::vector<double> weights_;
+    std::vector<ChannelState> channels_;
+
+    double   subBlockEnergy_;                       // Weighted sum of squares so far in the current 100ms
+    uint32_t subBlockSamples_;
+    double   subBlockPowers_[SHORT_TERM_SUB_BLOCKS];  // Ring of the most recent 100ms mean squares
+    uint32_t subBlockIndex_;
+    uint64_t subBlocksCompleted_;
+
+    std::vector<uint64_t> histogramCounts_;
+    std::vector<double>   histogramPowers_;
+
+    float    truePeak_;
+    uint64_t samplesProcessed_;
+};
+
+}
+}
@@ -0,0 +1,217 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "LoudnessMeter.h"
+#include <string.h>
+#include "ajabase/system/systemtime.h"
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+LoudnessMeter::LoudnessMeter()
+:   workerThread_(nullptr),
+    quit_(false),
+    enabled_(false),
+    ringHead_(0),
+    ringTail_(0),
+    droppedSamples_(0)
+{
+}
+
+
+LoudnessMeter::~LoudnessMeter()
+{
+    quit_ = true;
+
+    if (workerThread_)
+    {
+        while (workerThread_->Active())
+            AJATime::Sleep(10);
+
+        delete workerThread_;
+        workerThread_ = nullptr;
+    }
+}
+
+
+bool LoudnessMeter::Enable(const std::vector<uint32_t>& cardChannels, const std::vector<double>& weights)
+{
+    if (cardChannels.size() != weights.size())
+        return false;
+
+    for (auto cardChannel : cardChannels)
+    {
+        if (cardChannel >= LoudnessAnalyser::MAX_CHANNELS)
+            return false;
+    }
+
+    {
+        AJAAutoLock analyserLock(&analyserLock_);
+
+        if (!analyser_.Configure(weights))
+            return false;
+
+        AJAAutoLock pushLock(&pushLock_);
+        AJAAutoLock ringLock(&ringLock_);
+
+        cardChannels_ = cardChannels;
+        ring_.assign(RING_SAMPLES * cardChannels.size(), 0.0f);
+        ringHead_ = 0;
+        ringTail_ = 0;
+        droppedSamples_ = 0;
+        enabled_ = true;
+    }
+
+    if (!workerThread_)
+    {
+        workerThread_ = new AJAThread();
+        workerThread_->Attach(WorkerThreadStatic, this);
+        workerThread_->SetPriority(AJA_ThreadPriority_Normal);
+        workerThread_->Start();
+    }
+
+    return true;
+}
+
+
+void LoudnessMeter::Disable()
+{
+    enabled_ = false;
+}
+
+
+void LoudnessMeter::Push(const uint8_t* cardAudio, uint32_t numCardChannels, uint32_t numSamples)
+{
+    // Only Enable competes for this lock, so the capture thread never waits for the worker
+    AJAAutoLock pushLock(&pushLock_);
+
+    if (!enabled_ || cardAudio == nullptr)
+        return;
+
+    const uint32_t numChannels = static_cast<uint32_t>(cardChannels_.size());
+
+    for (auto cardChannel : cardChannels_)
+    {
+        if (cardChannel >= numCardChannels)
+            return;
+    }
+
+    // Only Push moves the head, so it can be read once here and moved on once the samples are in
+    uint64_t head, tail;
+    {
+        AJAAutoLock ringLock(&ringLock_);
+        head = ringHead_;
+        tail = ringTail_;
+    }
+
+    const uint64_t space = RING_SAMPLES - (head - tail);
+    const uint32_t numToWrite = numSamples < space ? numSamples : static_cast<uint32_t>(space);
+
+    // Only the programme channels are taken, converted to float ready for the filters. This is done without the
+    // ring lock: the worker never reads past ringHead_, so it can't see these samples until they are published.
+    for (uint32_t sampleIdx = 0; sampleIdx < numToWrite; sampleIdx++)
+    {
+        const uint8_t* frame = cardAudio + sampleIdx * numCardChannels * sizeof(int32_t);
+        float* out = &ring_[((head + sampleIdx) % RING_SAMPLES) * numChannels];
+
+        for (uint32_t channel = 0; channel < numChannels; channel++)
+        {
+            int32_t word;
+            memcpy(&word, frame + cardChannels_[channel] * sizeof(int32_t), sizeof(word));
+            out[channel] = static_cast<float>(word) * (1.0f / 2147483648.0f);
+        }
+    }
+
+    AJAAutoLock ringLock(&ringLock_);
+    ringHead_ = head + numToWrite;
+    droppedSamples_ += numSamples - numToWrite;
+}
+
+
+void LoudnessMeter::GetResults(LoudnessResults& results, uint64_t& droppedSamples)
+{
+    {
+        AJAAutoLock analyserLock(&analyserLock_);
+        analyser_.GetResults(results);
+    }
+
+    AJAAutoLock ringLock(&ringLock_);
+    droppedSamples = droppedSamples_;
+}
+
+
+void LoudnessMeter::Reset()
+{
+    AJAAutoLock analyserLock(&analyserLock_);
+
+    analyser_.Reset();
+}
+
+
+void LoudnessMeter::WorkerThreadStatic(AJAThread* pThread, void* pContext)
+{
+    (void) pThread;
+
+    LoudnessMeter* pMeter(reinterpret_cast<LoudnessMeter*>(pContext));
+    pMeter->ProcessSamples();
+}
+
+
+void LoudnessMeter::ProcessSamples()
+{
+    while (!quit_)
+    {
+        // Audio arrives a frame at a time, so there is no point waking more often than that
+        if (!ProcessWaitingSamples())
+            AJATime::Sleep(10);
+    }
+}
+
+
+bool LoudnessMeter::ProcessWaitingSamples()
+{
+    // Holding the analyser lock keeps the ring from being reconfigured underneath us
+    AJAAutoLock analyserLock(&analyserLock_);
+
+    uint64_t head, tail;
+    {
+        AJAAutoLock ringLock(&ringLock_);
+        head = ringHead_;
+        tail = ringTail_;
+    }
+
+    if (head == tail)
+        return false;
+
+    const uint32_t numChannels = analyser_.GetNumChannels();
+
+    // Process up to the end of the ring, then pick up any wrapped samples next time round
+    const uint32_t start = static_cast<uint32_t>(tail % RING_SAMPLES);
+    const uint64_t waiting = head - tail;
+    const uint32_t numSamples = static_cast<uint32_t>(waiting < RING_SAMPLES - start ? waiting : RING_SAMPLES - start);
+
+    analyser_.AddSamples(&ring_[start * numChannels], numSamples);
+
+    AJAAutoLock ringLock(&ringLock_);
+    ringTail_ += numSamples;
+
+    return true;
+}
+
+}
+}
@@ -0,0 +1,85 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "ajabase/system/lock.h"
+#include "ajabase/system/thread.h"
+#include "LoudnessAnalyser.h"
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+// Runs a LoudnessAnalyser on its own worker thread. The capture thread pushes each frame's card audio in,
+// taking only the programme channels, and the results can be read at any time from the Node thread.
+class LoudnessMeter
+{
+public:
+
+    LoudnessMeter();
+    ~LoudnessMeter();
+
+    // Measure the given card channels with the given BS.1770 weightings, discarding any previous measurements.
+    // Starts the worker thread the first time it is called. Returns false if the channels or weights are invalid.
+    bool Enable(const std::vector<uint32_t>& cardChannels, const std::vector<double>& weights);
+
+    void Disable();
+
+    bool IsEnabled() const { return enabled_; }
+
+    // Called on the capture thread. Never waits for the analysis: if the worker falls behind, the audio that
+    // does not fit is dropped and counted.
+    void Push(const uint8_t* cardAudio, uint32_t numCardChannels, uint32_t numSamples);
+
+    void GetResults(LoudnessResults& results, uint64_t& droppedSamples);
+
+    // Restart the integrated measurement and true peak hold
+    void Reset();
+
+private:
+
+    static const uint32_t RING_SAMPLES = LoudnessAnalyser::SAMPLE_RATE * 2;
+
+    static void WorkerThreadStatic(AJAThread* pThread, void* pContext);
+    void ProcessSamples();
+
+    // Returns false if there was nothing waiting
+    bool ProcessWaitingSamples();
+
+    AJAThread*            workerThread_;
+    std::atomic<bool>     quit_;
+    std::atomic<bool>     enabled_;
+
+    AJALock               analyserLock_;      // Held by the worker while it analyses, and by anything changing the configuration
+    LoudnessAnalyser      analyser_;
+
+    AJALock               pushLock_;          // Held by Push while it writes, and by Enable, so the ring and channels can't change under it
+    std::vector<uint32_t> cardChannels_;
+
+    AJALock               ringLock_;          // Guards the ring indices; only held briefly
+    std::vector<float>    ring_;              // Interleaved programme channels, as floats
+    uint64_t              ringHead_;          // Samples written, ever
+    uint64_t              ringTail_;          // Samples analysed, ever
+    uint64_t              droppedSamples_;
+};
+
+}
+}
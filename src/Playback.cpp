@@ -25,6 +25,7 @@
 #include <iomanip>
 #include "ajabase/system/systemtime.h"
 #include "gen2ajaTypeMaps.h"
+#include "utils.h"
 
 using namespace std;
 
@@ -35,11 +36,15 @@ inline Nan::Persistent<v8::Function> &Playback::constructor() {
   return myConstructor;
 }
 
-Playback::Playback(uint32_t deviceIndex, uint32_t channelNumber, uint32_t displayMode, uint32_t pixelFormat)
+Playback::Playback(uint32_t deviceIndex, uint32_t channelNumber, uint32_t displayMode, uint32_t pixelFormat, uint32_t hostBuffers, uint32_t deviceBuffers, bool hugePages, const Aja::ThreadPolicy& threadPolicy)
 :   deviceIndex_(deviceIndex), 
     channelNumber_(channelNumber), 
     displayMode_(displayMode), 
     pixelFormat_(pixelFormat),
+    hostBuffers_(hostBuffers),
+    deviceBuffers_(deviceBuffers),
+    hugePages_(hugePages),
+    threadPolicy_(threadPolicy),
     result_(0)
 {
   async = new uv_async_t;
@@ -65,6 +70,13 @@ NAN_MODULE_INIT(Playback::Init) {
   Nan::SetPrototypeMethod(tpl, "scheduleFrame", ScheduleFrame);
   Nan::SetPrototypeMethod(tpl, "doPlayback", DoPlayback);
   Nan::SetPrototypeMethod(tpl, "stop", StopPlayback);
+  Nan::SetPrototypeMethod(tpl, "openTimeshift", OpenTimeshift);
+  Nan::SetPrototypeMethod(tpl, "closeTimeshift", CloseTimeshift);
+  Nan::SetPrototypeMethod(tpl, "getTimeshiftRange", GetTimeshiftRange);
+  Nan::SetPrototypeMethod(tpl, "scheduleTimeshiftFrame", ScheduleTimeshiftFrame);
+  Nan::SetPrototypeMethod(tpl, "getDriverCalls", GetDriverCalls);
+  Nan::SetPrototypeMethod(tpl, "resetDriverCalls", ResetDriverCalls);
+  Nan::SetPrototypeMethod(tpl, "getThreadPolicy", GetThreadPolicy);
 
   constructor().Reset(Nan::GetFunction(tpl).ToLocalChecked());
   Nan::Set(target, Nan::New("Playback").ToLocalChecked(),
@@ -75,15 +87,43 @@ NAN_METHOD(Playback::New) {
   if (info.IsConstructCall()) {
     // Invoked as constructor: `new Playback(...)`
     uint32_t deviceIndex = info[0]->IsUndefined() ? 0 : Nan::To<uint32_t>(info[0]).FromJust();
-    uint32_t displayMode = info[1]->IsUndefined() ? 0 : Nan::To<uint32_t>(info[1]).FromJust();
-    uint32_t pixelFormat = info[2]->IsUndefined() ? 0 : Nan::To<uint32_t>(info[2]).FromJust();
-    Playback* obj = new Playback(deviceIndex, displayMode, pixelFormat);
+    uint32_t channelNumber = info[1]->IsUndefined() ? AjaDevice::DEFAULT_PLAYBACK_CHANNEL : Nan::To<uint32_t>(info[1]).FromJust();
+    uint32_t displayMode = info[2]->IsUndefined() ? 0 : Nan::To<uint32_t>(info[2]).FromJust();
+    uint32_t pixelFormat = info[3]->IsUndefined() ? 0 : Nan::To<uint32_t>(info[3]).FromJust();
+    uint32_t hostBuffers = CIRCULAR_BUFFER_SIZE;
+    uint32_t deviceBuffers = AjaDevice::DEFAULT_DEVICE_BUFFERS;
+    bool hugePages = false;
+    Aja::ThreadPolicy threadPolicy;
+
+    // Optional settings: { hostBuffers, deviceBuffers, hugePages, threadPolicy } - the depths, in frames, of the host ring buffer and of
+    // AutoCirculate on the card, both clamped to between AjaDevice::MIN_BUFFERS and their maximum, and whether to put
+    // the video buffers on large pages. Large pages need the OS to allow it, and fall back to normal pages otherwise.
+    // threadPolicy is { cpus, realtime, numaNode }: the CPU numbers the playout threads may run on, whether the playout thread
+    // gets real time priority where the OS permits, and the NUMA node for the video buffers.
+    if (info[4]->IsObject()) {
+      v8::Local<v8::Object> options = Nan::To<v8::Object>(info[4]).ToLocalChecked();
+      v8::Local<v8::Value> hostBuffersValue = Nan::Get(options, Nan::New("hostBuffers").ToLocalChecked()).ToLocalChecked();
+      v8::Local<v8::Value> deviceBuffersValue = Nan::Get(options, Nan::New("deviceBuffers").ToLocalChecked()).ToLocalChecked();
+      v8::Local<v8::Value> hugePagesValue = Nan::Get(options, Nan::New("hugePages").ToLocalChecked()).ToLocalChecked();
+      v8::Local<v8::Value> threadPolicyValue = Nan::Get(options, Nan::New("threadPolicy").ToLocalChecked()).ToLocalChecked();
+
+      if (hostBuffersValue->IsNumber())
+        hostBuffers = Nan::To<uint32_t>(hostBuffersValue).FromJust();
+      if (deviceBuffersValue->IsNumber())
+        deviceBuffers = Nan::To<uint32_t>(deviceBuffersValue).FromJust();
+      if (hugePagesValue->IsBoolean())
+        hugePages = Nan::To<bool>(hugePagesValue).FromJust();
+      if (threadPolicyValue->IsObject())
+        threadPolicy = parseThreadPolicy(Nan::To<v8::Object>(threadPolicyValue).ToLocalChecked());
+    }
+
+    Playback* obj = new Playback(deviceIndex, channelNumber, displayMode, pixelFormat, hostBuffers, deviceBuffers, hugePages, threadPolicy);
     obj->Wrap(info.This());
     info.GetReturnValue().Set(info.This());
   } else {
     // Invoked as plain function `Playback(...)`, turn into construct call.
-    const int argc = 3;
-    v8::Local<v8::Value> argv[argc] = { info[0], info[1], info[2] };
+    const int argc = 5;
+    v8::Local<v8::Value> argv[argc] = { info[0], info[1], info[2], info[3], info[4] };
     v8::Local<v8::Function> cons = Nan::New(constructor());
     info.GetReturnValue().Set(Nan::NewInstance(cons, argc, argv).ToLocalChecked());
   }
@@ -92,7 +132,22 @@ NAN_METHOD(Playback::New) {
 NAN_METHOD(Playback::DeviceInit) {
     Playback* obj = ObjectWrap::Unwrap<Playback>(info.Holder());
 
-    if (obj->initNtv2Player())
+    // Optional audio arguments, in the same order as Capture.enableAudio: sample rate, sample type, channel count and
+    // channel map, where element N of the map is the card channel that client channel N is played out on. Playback
+    // only takes 24 bit packed samples, most significant byte first, so any other sample type is refused.
+    uint32_t sampleRate = info[0]->IsNumber() ? Nan::To<uint32_t>(info[0]).FromJust() : Aja::AudioTransform::CARD_SAMPLE_RATE;
+    uint32_t sampleType = info[1]->IsNumber() ? Nan::To<uint32_t>(info[1]).FromJust() : Aja::AudioSampleType_S24;
+    uint32_t channelCount = info[2]->IsNumber() ? Nan::To<uint32_t>(info[2]).FromJust() : Aja::AudioTransform::DEFAULT_CLIENT_CHANNELS;
+    std::vector<uint32_t> channelMap;
+
+    if (info[3]->IsArray()) {
+        v8::Local<v8::Array> mapArray = v8::Local<v8::Array>::Cast(info[3]);
+        for (uint32_t i = 0; i < mapArray->Length(); i++) {
+            channelMap.push_back(Nan::To<uint32_t>(Nan::Get(mapArray, i).ToLocalChecked()).FromJust());
+        }
+    }
+
+    if (obj->initNtv2Player() && obj->setupAudioOutput(sampleRate, sampleType, channelCount, channelMap))
         info.GetReturnValue().Set(Nan::New("made it!").ToLocalChecked());
     else
         info.GetReturnValue().Set(Nan::New("sad :-(").ToLocalChecked());
@@ -159,24 +214,113 @@ NAN_METHOD(Playback::ScheduleFrame) {
     audioBufLength = node::Buffer::Length(audioBufObj);
   }
 
+  // Optional mask of card channel pairs carrying non-PCM audio, to be played out bit-exact
+  uint32_t nonPcmPairs = info[2]->IsNumber() ? Nan::To<uint32_t>(info[2]).FromJust() : 0;
+
   //DumpAudioInfo(obj->deviceIndex_, "Playback Sending: ", true, (uint32_t*)audioBufData, audioBufLength);
 
   uint32_t bufferedFrames(0);
 
-  // Transform the input buffer to the native number of channels - currently this is 16
-  const char* audioTransformBuffer(nullptr);
-  uint32_t audioTransformBufferSize(0);
+  obj->scheduleFrame(videoBufData, videoBufLength, audioBufData, audioBufLength, nonPcmPairs, bufferedFrames);
+
+  info.GetReturnValue().Set(Nan::New<v8::Uint32>(bufferedFrames));
+}
+
+
+NAN_METHOD(Playback::OpenTimeshift) {
+  Playback* obj = ObjectWrap::Unwrap<Playback>(info.Holder());
+
+  if (!info[0]->IsString()) {
+    info.GetReturnValue().Set(Nan::New<v8::String>("timeshift needs a ring file path").ToLocalChecked());
+    return;
+  }
 
+  std::unique_ptr<Aja::TimeshiftRing> ring(new Aja::TimeshiftRing());
 
-  tie(audioTransformBuffer, audioTransformBufferSize) = 
-        obj->audioTransform.TransformToCard(reinterpret_cast<char*>(audioBufData), audioBufLength, 2, 16);
+  if (!ring->Open(*Nan::Utf8String(info[0]))) {
+    info.GetReturnValue().Set(Nan::New<v8::String>("Unable to open timeshift: " + ring->GetError()).ToLocalChecked());
+    return;
+  }
 
-  obj->scheduleFrame(videoBufData, videoBufLength, audioTransformBuffer, audioTransformBufferSize, bufferedFrames);
+  obj->timeshift_ = std::move(ring);
+  info.GetReturnValue().Set(Nan::New<v8::String>("Timeshift opened.").ToLocalChecked());
+}
+
+
+NAN_METHOD(Playback::CloseTimeshift) {
+  Playback* obj = ObjectWrap::Unwrap<Playback>(info.Holder());
+
+  obj->timeshift_.reset();
+}
+
+
+NAN_METHOD(Playback::GetTimeshiftRange) {
+  Playback* obj = ObjectWrap::Unwrap<Playback>(info.Holder());
+  uint64_t oldest, newest;
+
+  // Frame numbers count up from zero as the capture writes them, so the same number always means the same frame
+  if (!obj->timeshift_ || !obj->timeshift_->GetRange(oldest, newest)) {
+    info.GetReturnValue().Set(Nan::Null());
+    return;
+  }
+
+  v8::Local<v8::Object> range = Nan::New<v8::Object>();
+  Nan::Set(range, Nan::New("oldest").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(oldest)));
+  Nan::Set(range, Nan::New("newest").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(newest)));
+
+  info.GetReturnValue().Set(range);
+}
+
+
+NAN_METHOD(Playback::ScheduleTimeshiftFrame) {
+  Playback* obj = ObjectWrap::Unwrap<Playback>(info.Holder());
+  uint32_t bufferedFrames(0);
+
+  if (!info[0]->IsNumber() || !obj->scheduleTimeshiftFrame(static_cast<uint64_t>(Nan::To<double>(info[0]).FromJust()), bufferedFrames)) {
+    info.GetReturnValue().Set(Nan::False());
+    return;
+  }
 
   info.GetReturnValue().Set(Nan::New<v8::Uint32>(bufferedFrames));
 }
 
 
+NAN_METHOD(Playback::GetDriverCalls) {
+  Playback* obj = ObjectWrap::Unwrap<Playback>(info.Holder());
+
+  if (!obj->player_) {
+    info.GetReturnValue().Set(Nan::Null());
+    return;
+  }
+
+  Aja::DriverCallSummary summary;
+  obj->player_->GetDriverCallSummary(summary);
+
+  info.GetReturnValue().Set(makeDriverCallSummary(summary));
+}
+
+
+NAN_METHOD(Playback::ResetDriverCalls) {
+  Playback* obj = ObjectWrap::Unwrap<Playback>(info.Holder());
+
+  if (obj->player_)
+    obj->player_->ResetDriverCallStats();
+}
+
+
+NAN_METHOD(Playback::GetThreadPolicy) {
+  Playback* obj = ObjectWrap::Unwrap<Playback>(info.Holder());
+  Aja::ThreadPolicy effective;
+
+  if (!obj->player_ || !obj->player_->GetThreadPolicy(effective)) {
+    info.GetReturnValue().Set(Nan::Null());
+    return;
+  }
+
+  info.GetReturnValue().Set(makeThreadPolicy(effective));
+}
+
+
 bool Playback::initNtv2Player()
 {
     bool  success(false);
@@ -215,7 +359,12 @@ bool Playback::initNtv2Player()
             false, 
             false, 
             doMultiChannel ? true : false, 
-            sendType));
+            sendType,
+            hostBuffers_,
+            deviceBuffers_,
+            hugePages_));
+
+    player_->SetThreadPolicy(threadPolicy_);
 
     //    Initialize the player...
     status = player_->Init();
@@ -235,6 +384,43 @@ bool Playback::initNtv2Player()
 }
 
 
+bool Playback::setupAudioOutput(uint32_t sampleRate, uint32_t sampleType, uint32_t channelCount, const std::vector<uint32_t>& channelMap)
+{
+    if (sampleType != Aja::AudioSampleType_S24)
+    {
+        cerr << "Playback audio sample type must be 24, not " << sampleType << endl;
+        return false;
+    }
+
+    uint32_t cardChannels = (player_ && player_->GetNumAudioChannels() > 0) ? player_->GetNumAudioChannels() : Aja::AudioTransform::DEFAULT_CARD_CHANNELS;
+    std::vector<uint32_t> routing(channelMap);
+
+    // Without an explicit map, play the client channels out on the first card channels in order
+    if (routing.empty())
+    {
+        for (uint32_t channel = 0; channel < channelCount; channel++)
+        {
+            routing.push_back(channel);
+        }
+    }
+
+    if (routing.size() != channelCount || !audioTransform.SetToCardChannelMap(cardChannels, routing))
+    {
+        cerr << "Playback audio channel map is invalid for a device with " << cardChannels << " audio channels" << endl;
+        return false;
+    }
+
+    // The card plays out at 48kHz, so 96kHz audio is downsampled as it is scheduled
+    if (!audioTransform.SetToCardSampleRate(sampleRate))
+    {
+        cerr << "Playback audio sample rate must be 48000 or 96000, not " << sampleRate << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
 bool Playback::shutdownNtv2Player()
 {
     bool success = false;
@@ -281,19 +467,105 @@ bool Playback::stop()
 }
 
 
-bool Playback::scheduleFrame(const char* videoData, const size_t videoDataLength, const char* audioData, const size_t audioDataLength, uint32_t& bufferedFrames)
+bool Playback::scheduleFrame(const char* videoData, const size_t videoDataLength, const char* audioData, const size_t audioDataLength, uint32_t nonPcmPairs, uint32_t& bufferedFrames)
 {
     bool success = false;
 
     if (player_)
     {
-        success = player_->ScheduleFrame(videoData, videoDataLength, audioData, audioDataLength, &bufferedFrames);
+        player_->SetNonPcmPairs(nonPcmPairs);
+
+        // The client audio is transformed straight into the player's host buffer once a frame slot is free
+        PendingAudio audio = { this, audioData, audioDataLength, nonPcmPairs };
+
+        success = player_->ScheduleFrame(videoData, videoDataLength, _writeAudio, &audio, &bufferedFrames);
     }
 
     return success;
 }
 
 
+bool Playback::scheduleTimeshiftFrame(uint64_t frameNumber, uint32_t& bufferedFrames)
+{
+    Aja::TimeshiftFrameInfo frameInfo;
+    const uint8_t* video;
+    const uint8_t* audio;
+
+    if (!player_ || !timeshift_ || !timeshift_->GetFrame(frameNumber, frameInfo, video, audio))
+    {
+        return false;
+    }
+
+    // The ring's audio can only be played as it is if it has as many channels as we play out
+    PendingCardAudio cardAudio = { audio, frameInfo.audioSize };
+
+    if (timeshift_->GetNumAudioChannels() != player_->GetNumAudioChannels())
+    {
+        cardAudio.length = 0;
+    }
+
+    player_->SetNonPcmPairs(frameInfo.nonPcmPairs);
+
+    // The video and audio are copied into the player's host buffer straight from the mapped file, and only queued
+    // if the capture didn't overwrite the slot while they were being copied
+    PendingTimeshiftFrame pending = { timeshift_.get(), frameNumber, false };
+
+    bool success = player_->ScheduleFrame(reinterpret_cast<const char*>(video), frameInfo.videoSize, _copyCardAudio, &cardAudio,
+                                          &bufferedFrames, _validateTimeshiftFrame, &pending);
+
+    if (pending.overwritten)
+    {
+        cerr << "Timeshift frame " << frameNumber << " was overwritten while it was being scheduled" << endl;
+    }
+
+    return success;
+}
+
+
+bool Playback::_validateTimeshiftFrame(void* context)
+{
+    PendingTimeshiftFrame* frame = reinterpret_cast<PendingTimeshiftFrame*>(context);
+
+    frame->overwritten = !frame->ring->IsFrameValid(frame->frameNumber);
+
+    return !frame->overwritten;
+}
+
+
+uint32_t Playback::_copyCardAudio(void* context, uint32_t* audioBuffer, uint32_t audioBufferSize)
+{
+    const PendingCardAudio* audio = reinterpret_cast<const PendingCardAudio*>(context);
+    const uint32_t length = audio->length < audioBufferSize ? audio->length : audioBufferSize;
+
+    if (length > 0)
+    {
+        memcpy(audioBuffer, audio->data, length);
+    }
+
+    return length;
+}
+
+
+uint32_t Playback::writeAudio(const PendingAudio& audio, uint32_t* audioBuffer, uint32_t audioBufferSize)
+{
+    if (audio.data == nullptr || audio.length == 0)
+    {
+        return 0;
+    }
+
+    // Transform the input buffer to the native number of channels, routed as set up in init
+    return audioTransform.TransformToCard(audio.data, static_cast<uint32_t>(audio.length), reinterpret_cast<char*>(audioBuffer), audioBufferSize, audio.nonPcmPairs);
+}
+
+
+uint32_t Playback::_writeAudio(void* context, uint32_t* audioBuffer, uint32_t audioBufferSize)
+{
+    const PendingAudio* audio = reinterpret_cast<const PendingAudio*>(context);
+
+    return audio->playback->writeAudio(*audio, audioBuffer, audioBufferSize);
+}
+
+
 void Playback::scheduledFrameCompleted()
 {
     uv_async_send(async);
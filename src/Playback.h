@@ -22,9 +22,11 @@
 #include <node_buffer.h>
 #include <nan.h>
 #include <memory>
+#include <vector>
 
 #include "ntv2player.h"
 #include "AudioTransform.h"
+#include "TimeshiftRing.h"
 
 namespace streampunk {
 
@@ -34,7 +36,9 @@ public:
     static NAN_MODULE_INIT(Init);
 
 private:
-    explicit Playback(uint32_t deviceIndex = 0, uint32_t channelNumber = 3, uint32_t displayMode = 0, uint32_t pixelFormat = 0);
+    explicit Playback(uint32_t deviceIndex = 0, uint32_t channelNumber = 3, uint32_t displayMode = 0, uint32_t pixelFormat = 0,
+                      uint32_t hostBuffers = CIRCULAR_BUFFER_SIZE, uint32_t deviceBuffers = AjaDevice::DEFAULT_DEVICE_BUFFERS,
+                      bool hugePages = false, const Aja::ThreadPolicy& threadPolicy = Aja::ThreadPolicy());
     ~Playback();
 
     static NAN_METHOD(New);
@@ -52,23 +56,76 @@ private:
 
     static NAN_METHOD(ScheduleFrame);
 
+    // Play out frames from a Capture's timeshift ring, read straight from the ring file rather than through JavaScript
+    static NAN_METHOD(OpenTimeshift);
+
+    static NAN_METHOD(CloseTimeshift);
+
+    static NAN_METHOD(GetTimeshiftRange);
+
+    static NAN_METHOD(ScheduleTimeshiftFrame);
+
+    // Counts of the playout thread's calls into the driver, against its budget of calls per frame
+    static NAN_METHOD(GetDriverCalls);
+
+    static NAN_METHOD(ResetDriverCalls);
+
+    // The CPUs, priority and NUMA node the playout thread actually got, or null until it has started
+    static NAN_METHOD(GetThreadPolicy);
+
     static NAUV_WORK_CB(FrameCallback);
     Nan::Persistent<v8::Function> playbackCB_;
     uint32_t result_;
 
     std::unique_ptr<NTV2Player> player_;
+    std::unique_ptr<Aja::TimeshiftRing> timeshift_;
 
 private:
 
     bool initNtv2Player();
+    bool setupAudioOutput(uint32_t sampleRate, uint32_t sampleType, uint32_t channelCount, const std::vector<uint32_t>& channelMap);
     bool shutdownNtv2Player();
     bool play();
     bool stop();
-    bool scheduleFrame(const char* videoData, const size_t videoDataLength, const char* audioData, const size_t audioDataLength, uint32_t& bufferedFrames);
+    bool scheduleFrame(const char* videoData, const size_t videoDataLength, const char* audioData, const size_t audioDataLength, uint32_t nonPcmPairs, uint32_t& bufferedFrames);
 
     void scheduledFrameCompleted();
     static void _scheduledFrameCompleted(void* context);
 
+    // Client audio waiting to be transformed into the player's host buffer for the frame being scheduled
+    struct PendingAudio
+    {
+        Playback* playback;
+        const char* data;
+        size_t length;
+        uint32_t nonPcmPairs;
+    };
+
+    uint32_t writeAudio(const PendingAudio& audio, uint32_t* audioBuffer, uint32_t audioBufferSize);
+    static uint32_t _writeAudio(void* context, uint32_t* audioBuffer, uint32_t audioBufferSize);
+
+    // Schedule a frame from the timeshift ring. Returns false if the frame isn't in the ring, or was overwritten as it was scheduled.
+    bool scheduleTimeshiftFrame(uint64_t frameNumber, uint32_t& bufferedFrames);
+
+    // Audio from the timeshift ring is already in the card's format, so it is copied as it is
+    struct PendingCardAudio
+    {
+        const uint8_t* data;
+        uint32_t length;
+    };
+
+    static uint32_t _copyCardAudio(void* context, uint32_t* audioBuffer, uint32_t audioBufferSize);
+
+    // The ring slot a frame is being scheduled from, checked once it has been copied but before it is queued
+    struct PendingTimeshiftFrame
+    {
+        const Aja::TimeshiftRing* ring;
+        uint64_t frameNumber;
+        bool overwritten;
+    };
+
+    static bool _validateTimeshiftFrame(void* context);
+
     NTV2VideoFormat getVideoFormat(uint32_t genericDisplayMode);
     NTV2FrameBufferFormat getPixelFormat(uint32_t genericPixelFormat);
 
@@ -76,6 +133,10 @@ private:
     uint32_t channelNumber_;
     uint32_t displayMode_;
     uint32_t pixelFormat_;
+    uint32_t hostBuffers_;
+    uint32_t deviceBuffers_;
+    bool hugePages_;
+    Aja::ThreadPolicy threadPolicy_;
 
     Aja::AudioTransform audioTransform;
 
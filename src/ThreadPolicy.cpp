@@ -0,0 +1,101 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+
+#include "ThreadPolicy.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+namespace
+{
+
+// Returns the mask in effect, or zero if it couldn't be applied
+uint64_t ApplyCpuMask(uint64_t cpuMask)
+{
+#if defined(_WIN32)
+    DWORD_PTR processMask(0), systemMask(0);
+
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+        return 0;
+
+    const DWORD_PTR threadMask = static_cast<DWORD_PTR>(cpuMask) & processMask;
+
+    return (threadMask != 0 && SetThreadAffinityMask(GetCurrentThread(), threadMask) != 0) ? threadMask : 0;
+#elif defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+
+    for (int cpu = 0; cpu < 64; cpu++)
+    {
+        if (cpuMask & (static_cast<uint64_t>(1) << cpu))
+            CPU_SET(cpu, &cpus);
+    }
+
+    // The kernel drops any CPUs the process isn't allowed, so read back what was actually set
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0 ||
+        pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+        return 0;
+
+    uint64_t threadMask(0);
+
+    for (int cpu = 0; cpu < 64; cpu++)
+    {
+        if (CPU_ISSET(cpu, &cpus))
+            threadMask |= static_cast<uint64_t>(1) << cpu;
+    }
+
+    return threadMask;
+#else
+    (void) cpuMask;
+    return 0;
+#endif
+}
+
+
+bool ApplyRealtimePriority()
+{
+#if defined(_WIN32)
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#else
+    sched_param param;
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+
+    return param.sched_priority >= 0 && pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#endif
+}
+
+}
+
+
+void ApplyThreadPolicy(const ThreadPolicy& policy, bool withRealtime, ThreadPolicy& effective)
+{
+    effective.cpuMask = policy.cpuMask != 0 ? ApplyCpuMask(policy.cpuMask) : 0;
+    effective.realtime = policy.realtime && withRealtime && ApplyRealtimePriority();
+    effective.numaNode = policy.numaNode;
+}
+
+}
+}
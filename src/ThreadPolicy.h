@@ -0,0 +1,51 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+// How a capture or playout runs its threads and where it puts its buffers, so that several channels on a
+// multi-socket machine can each be kept to their own cores and memory rather than migrating between them
+struct ThreadPolicy
+{
+    static const int32_t ANY_NUMA_NODE = -1;
+
+    uint64_t cpuMask;               // Bit N allows CPU N. Zero leaves the threads wherever the OS puts them.
+    bool     realtime;              // Run the thread that services the card at the highest priority the OS permits
+    int32_t  numaNode;              // The node to allocate video buffers on, or ANY_NUMA_NODE
+
+    ThreadPolicy() : cpuMask(0), realtime(false), numaNode(ANY_NUMA_NODE) {}
+};
+
+
+// Apply a policy's CPU mask, and optionally its real time priority, to the calling thread. Reports what the
+// OS actually allowed in effective: the mask is narrowed to the CPUs the process may use, or left zero if
+// none of them are, and realtime is false if the priority was refused. The NUMA node is copied as it is;
+// it is up to the buffer allocator whether it can be honoured.
+//
+// On Windows the mask covers the calling thread's processor group, and real time is THREAD_PRIORITY_TIME_CRITICAL.
+// Elsewhere real time is SCHED_FIFO, which needs privileges such as CAP_SYS_NICE.
+void ApplyThreadPolicy(const ThreadPolicy& policy, bool withRealtime, ThreadPolicy& effective);
+
+}
+}
@@ -0,0 +1,401 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "TimeshiftRing.h"
+#include <string.h>
+#include <atomic>
+#include <sstream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+namespace
+{
+
+const uint32_t RING_MAGIC = 0x52505453;             // "STPR"
+const uint32_t RING_VERSION = 1;
+const uint64_t INVALID_FRAME = ~static_cast<uint64_t>(0);
+
+uint32_t RoundUpToPage(uint32_t size)
+{
+    return (size + TimeshiftRing::PAGE_SIZE - 1) / TimeshiftRing::PAGE_SIZE * TimeshiftRing::PAGE_SIZE;
+}
+
+}
+
+
+// The fields one thread writes while another reads them, maybe from another process, are atomics laid over the
+// mapping. That only works if they are lock free and just the size of the plain values.
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "atomic<uint32_t> can't be shared in a mapping");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "atomic<uint64_t> can't be shared in a mapping");
+
+
+// The first page of the file
+struct TimeshiftRing::FileHeader
+{
+    std::atomic<uint32_t> magic;
+    uint32_t              version;
+    uint32_t              numSlots;
+    uint32_t              maxVideoSize;
+    uint32_t              maxAudioSize;
+    uint32_t              numAudioChannels;
+    uint64_t              slotSize;
+    std::atomic<uint64_t> framesWritten;
+};
+
+
+// The first page of each slot
+struct TimeshiftRing::SlotHeader
+{
+    std::atomic<uint64_t> frameNumber;      // INVALID_FRAME while the slot is being written
+    TimeshiftFrameInfo    info;
+};
+
+
+TimeshiftRing::TimeshiftRing()
+:
+#if defined(_WIN32)
+    file_(INVALID_HANDLE_VALUE),
+    mapping_(NULL),
+#else
+    file_(-1),
+#endif
+    base_(nullptr),
+    size_(0),
+    writable_(false),
+    numSlots_(0),
+    slotSize_(0),
+    videoOffset_(0),
+    audioOffset_(0),
+    maxVideoSize_(0),
+    maxAudioSize_(0),
+    numAudioChannels_(0)
+{
+}
+
+
+TimeshiftRing::~TimeshiftRing()
+{
+    Close();
+}
+
+
+bool TimeshiftRing::Create(const std::string& path, uint32_t numSlots, uint32_t maxVideoSize, uint32_t maxAudioSize, uint32_t numAudioChannels)
+{
+    Close();
+    lastError_.clear();
+
+    if (numSlots < 2 || maxVideoSize == 0)
+    {
+        lastError_ = "a timeshift ring needs at least two slots, with room for video";
+        return false;
+    }
+
+    const uint32_t videoOffset = PAGE_SIZE;
+    const uint32_t audioOffset = videoOffset + RoundUpToPage(maxVideoSize);
+    const uint64_t slotSize = audioOffset + RoundUpToPage(maxAudioSize);
+
+    if (!Map(path, PAGE_SIZE + numSlots * slotSize, true))
+        return false;
+
+    numSlots_ = numSlots;
+    slotSize_ = slotSize;
+    videoOffset_ = videoOffset;
+    audioOffset_ = audioOffset;
+    maxVideoSize_ = maxVideoSize;
+    maxAudioSize_ = maxAudioSize;
+    numAudioChannels_ = numAudioChannels;
+
+    for (uint32_t slot = 0; slot < numSlots; slot++)
+        GetSlotHeader(slot)->frameNumber.store(INVALID_FRAME, std::memory_order_relaxed);
+
+    FileHeader* header = GetFileHeader();
+    header->version = RING_VERSION;
+    header->numSlots = numSlots;
+    header->maxVideoSize = maxVideoSize;
+    header->maxAudioSize = maxAudioSize;
+    header->numAudioChannels = numAudioChannels;
+    header->slotSize = slotSize;
+    header->framesWritten.store(0, std::memory_order_relaxed);
+
+    // The magic number goes in last, so a reader never sees a half made header
+    header->magic.store(RING_MAGIC, std::memory_order_release);
+
+    return true;
+}
+
+
+bool TimeshiftRing::Open(const std::string& path)
+{
+    Close();
+    lastError_.clear();
+
+    if (!Map(path, 0, false))
+        return false;
+
+    const FileHeader* header = GetFileHeader();
+
+    if (size_ < PAGE_SIZE || header->magic.load(std::memory_order_acquire) != RING_MAGIC || header->version != RING_VERSION)
+    {
+        lastError_ = path + " is not a timeshift ring";
+        Close();
+        return false;
+    }
+
+    numSlots_ = header->numSlots;
+    slotSize_ = header->slotSize;
+    maxVideoSize_ = header->maxVideoSize;
+    maxAudioSize_ = header->maxAudioSize;
+    numAudioChannels_ = header->numAudioChannels;
+    videoOffset_ = PAGE_SIZE;
+    audioOffset_ = videoOffset_ + RoundUpToPage(maxVideoSize_);
+
+    if (numSlots_ < 2 || slotSize_ < audioOffset_ + maxAudioSize_ || size_ < PAGE_SIZE + numSlots_ * slotSize_)
+    {
+        lastError_ = path + " is truncated or corrupt";
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+
+void TimeshiftRing::Close()
+{
+#if defined(_WIN32)
+    if (base_ != nullptr)
+        UnmapViewOfFile(base_);
+    if (mapping_ != NULL)
+        CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE)
+        CloseHandle(file_);
+
+    mapping_ = NULL;
+    file_ = INVALID_HANDLE_VALUE;
+#else
+    if (base_ != nullptr)
+        munmap(base_, size_);
+    if (file_ != -1)
+        close(file_);
+
+    file_ = -1;
+#endif
+
+    base_ = nullptr;
+    size_ = 0;
+    writable_ = false;
+    numSlots_ = 0;
+}
+
+
+bool TimeshiftRing::WriteFrame(const TimeshiftFrameInfo& info, const uint8_t* video, const uint8_t* audio)
+{
+    if (!writable_)
+    {
+        lastError_ = "not open for writing";
+        return false;
+    }
+
+    if (info.videoSize > maxVideoSize_ || info.audioSize > maxAudioSize_ || (video == nullptr && info.videoSize > 0) || (audio == nullptr && info.audioSize > 0))
+    {
+        lastError_ = "frame does not fit the ring's slots";
+        return false;
+    }
+
+    FileHeader* header = GetFileHeader();
+    const uint64_t frameNumber = header->framesWritten.load(std::memory_order_relaxed);     // Only this thread writes it
+    SlotHeader* slot = GetSlotHeader(frameNumber);
+    uint8_t* slotData = reinterpret_cast<uint8_t*>(slot);
+
+    // Readers must see the slot go invalid before any of the old frame is overwritten...
+    slot->frameNumber.store(INVALID_FRAME, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (info.videoSize > 0)
+        memcpy(slotData + videoOffset_, video, info.videoSize);
+    if (info.audioSize > 0)
+        memcpy(slotData + audioOffset_, audio, info.audioSize);
+    slot->info = info;
+
+    // ...and only see it come back once all of the new frame is in place
+    slot->frameNumber.store(frameNumber, std::memory_order_release);
+    header->framesWritten.store(frameNumber + 1, std::memory_order_release);
+
+    return true;
+}
+
+
+bool TimeshiftRing::GetRange(uint64_t& oldest, uint64_t& newest) const
+{
+    if (!IsOpen())
+        return false;
+
+    const uint64_t framesWritten = GetFileHeader()->framesWritten.load(std::memory_order_acquire);
+
+    if (framesWritten == 0)
+        return false;
+
+    newest = framesWritten - 1;
+    oldest = framesWritten >= numSlots_ ? framesWritten - numSlots_ + 1 : 0;
+
+    return true;
+}
+
+
+bool TimeshiftRing::GetFrame(uint64_t frameNumber, TimeshiftFrameInfo& info, const uint8_t*& video, const uint8_t*& audio) const
+{
+    uint64_t oldest, newest;
+
+    if (!GetRange(oldest, newest) || frameNumber < oldest || frameNumber > newest)
+        return false;
+
+    const SlotHeader* slot = GetSlotHeader(frameNumber);
+    const uint8_t* slotData = reinterpret_cast<const uint8_t*>(slot);
+
+    if (slot->frameNumber.load(std::memory_order_acquire) != frameNumber)
+        return false;
+
+    info = slot->info;
+    video = slotData + videoOffset_;
+    audio = slotData + audioOffset_;
+
+    // Make sure the info wasn't being overwritten as we copied it
+    return IsFrameValid(frameNumber);
+}
+
+
+bool TimeshiftRing::IsFrameValid(uint64_t frameNumber) const
+{
+    if (!IsOpen())
+        return false;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return GetSlotHeader(frameNumber)->frameNumber.load(std::memory_order_relaxed) == frameNumber;
+}
+
+
+bool TimeshiftRing::Map(const std::string& path, uint64_t size, bool writable)
+{
+#if defined(_WIN32)
+    file_ = CreateFileA(path.c_str(), writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                        NULL, writable ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file_ == INVALID_HANDLE_VALUE)
+    {
+        SetError("unable to open " + path);
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    fileSize.QuadPart = static_cast<LONGLONG>(size);
+
+    // Setting the end of the file allocates the space for it, so we don't run out of disk part way round
+    if (writable ? !(SetFilePointerEx(file_, fileSize, NULL, FILE_BEGIN) && SetEndOfFile(file_)) : !GetFileSizeEx(file_, &fileSize))
+    {
+        SetError("unable to size " + path);
+        Close();
+        return false;
+    }
+
+    size = static_cast<uint64_t>(fileSize.QuadPart);
+
+    mapping_ = size > 0 ? CreateFileMappingA(file_, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), NULL) : NULL;
+    base_ = mapping_ != NULL ? static_cast<uint8_t*>(MapViewOfFile(mapping_, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+    file_ = open(path.c_str(), writable ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDONLY, 0644);
+    if (file_ == -1)
+    {
+        SetError("unable to open " + path);
+        return false;
+    }
+
+    struct stat fileStat;
+
+    // Allocate the space now, so we don't run out of disk part way round
+#if defined(__linux__)
+    const bool sized = writable ? (errno = posix_fallocate(file_, 0, static_cast<off_t>(size))) == 0 : fstat(file_, &fileStat) == 0;
+#else
+    const bool sized = writable ? ftruncate(file_, static_cast<off_t>(size)) == 0 : fstat(file_, &fileStat) == 0;
+#endif
+
+    if (!sized)
+    {
+        SetError("unable to size " + path);
+        Close();
+        return false;
+    }
+
+    if (!writable)
+        size = static_cast<uint64_t>(fileStat.st_size);
+
+    void* base = size > 0 ? mmap(NULL, static_cast<size_t>(size), PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, file_, 0) : MAP_FAILED;
+    base_ = base != MAP_FAILED ? static_cast<uint8_t*>(base) : nullptr;
+#endif
+
+    if (base_ == nullptr)
+    {
+        SetError("unable to map " + path);
+        Close();
+        return false;
+    }
+
+    size_ = size;
+    writable_ = writable;
+
+    return true;
+}
+
+
+TimeshiftRing::FileHeader* TimeshiftRing::GetFileHeader() const
+{
+    return reinterpret_cast<FileHeader*>(base_);
+}
+
+
+TimeshiftRing::SlotHeader* TimeshiftRing::GetSlotHeader(uint64_t frameNumber) const
+{
+    return reinterpret_cast<SlotHeader*>(base_ + PAGE_SIZE + (frameNumber % numSlots_) * slotSize_);
+}
+
+
+void TimeshiftRing::SetError(const std::string& what)
+{
+    std::ostringstream error;
+
+#if defined(_WIN32)
+    error << what << " (error " << ::GetLastError() << ")";
+#else
+    error << what << " (" << strerror(errno) << ")";
+#endif
+
+    lastError_ = error.str();
+}
+
+}
+}
@@ -0,0 +1,123 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+// What is known about a frame in a timeshift ring, apart from its video and audio
+struct TimeshiftFrameInfo
+{
+    uint64_t captureSequence;       // The frame's sequence number in the capture that wrote it
+    uint64_t audioSamplePosition;
+    uint32_t videoSize;             // In bytes
+    uint32_t audioSize;
+    uint32_t audioSampleCount;      // Per channel
+    uint32_t nonPcmPairs;
+    uint32_t timecodeDBB;           // RP188 timecode, as captured
+    uint32_t timecodeLow;
+    uint32_t timecodeHigh;
+    uint32_t reserved;
+};
+
+
+// The last so many captured frames, kept on disk in a fixed size, memory mapped file. Frames are numbered
+// from zero as they are written, and frame N goes in slot N % numSlots, so the file never grows and old
+// frames are simply overwritten. Each slot is a page of header followed by page aligned space for the
+// largest video and audio frames.
+//
+// One instance writes the ring, and any number of others - in this process or another - can open it by path
+// and read frames straight out of the mapping. A frame being overwritten is marked invalid first, so a
+// reader checks IsFrameValid after using a frame to be sure it wasn't overwritten underneath it.
+class TimeshiftRing
+{
+public:
+
+    static const uint32_t PAGE_SIZE = 4096;
+
+    TimeshiftRing();
+    ~TimeshiftRing();
+
+    // Create, or recreate, the ring file for writing, sized for numSlots frames of up to maxVideoSize bytes of
+    // video and maxAudioSize bytes of audio with numAudioChannels channels. The space is allocated up front.
+    bool Create(const std::string& path, uint32_t numSlots, uint32_t maxVideoSize, uint32_t maxAudioSize, uint32_t numAudioChannels);
+
+    // Open an existing ring file for reading
+    bool Open(const std::string& path);
+
+    void Close();
+
+    // Add the next frame, overwriting the oldest if the ring is full. Only for a ring made with Create.
+    bool WriteFrame(const TimeshiftFrameInfo& info, const uint8_t* video, const uint8_t* audio);
+
+    // The frames that can be read now: oldest to newest inclusive. Returns false if the ring is empty.
+    // The oldest frame in a full ring is left out, as it is the next to be overwritten.
+    bool GetRange(uint64_t& oldest, uint64_t& newest) const;
+
+    // Point to frame number frameNumber in the mapping, returning false if it isn't in the ring
+    bool GetFrame(uint64_t frameNumber, TimeshiftFrameInfo& info, const uint8_t*& video, const uint8_t*& audio) const;
+
+    // True if frame number frameNumber is still in the ring, and hasn't been overwritten since GetFrame
+    bool IsFrameValid(uint64_t frameNumber) const;
+
+    bool IsOpen() const { return base_ != nullptr; }
+    uint32_t GetNumSlots() const { return numSlots_; }
+    uint32_t GetMaxVideoSize() const { return maxVideoSize_; }
+    uint32_t GetNumAudioChannels() const { return numAudioChannels_; }
+    const std::string& GetError() const { return lastError_; }
+
+private:
+
+    struct FileHeader;
+    struct SlotHeader;
+
+    TimeshiftRing(const TimeshiftRing&);
+    TimeshiftRing& operator=(const TimeshiftRing&);
+
+    bool Map(const std::string& path, uint64_t size, bool writable);
+
+    FileHeader* GetFileHeader() const;
+    SlotHeader* GetSlotHeader(uint64_t frameNumber) const;
+
+    void SetError(const std::string& what);
+
+#if defined(_WIN32)
+    void*       file_;
+    void*       mapping_;
+#else
+    int         file_;
+#endif
+    uint8_t*    base_;
+    uint64_t    size_;
+    bool        writable_;
+    uint32_t    numSlots_;
+    uint64_t    slotSize_;
+    uint32_t    videoOffset_;           // Of the video and audio from the start of each slot
+    uint32_t    audioOffset_;
+    uint32_t    maxVideoSize_;
+    uint32_t    maxAudioSize_;
+    uint32_t    numAudioChannels_;
+    std::string lastError_;
+};
+
+}
+}
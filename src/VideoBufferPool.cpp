@@ -0,0 +1,457 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "VideoBufferPool.h"
+#include "ajabase/system/memory.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+namespace
+{
+
+// The size of a large page, or 0 if the platform doesn't offer them
+size_t HugePageSize()
+{
+#if defined(_WIN32)
+    return GetLargePageMinimum();
+#elif defined(__linux__) && defined(MAP_HUGETLB)
+    return 2 * 1024 * 1024;
+#else
+    return 0;
+#endif
+}
+
+
+// Large page allocations must be a whole number of pages
+size_t HugePageAllocationSize(uint32_t size)
+{
+    const size_t pageSize = HugePageSize();
+
+    return pageSize > 0 ? (size + pageSize - 1) / pageSize * pageSize : 0;
+}
+
+
+size_t PageAllocationSize(uint32_t size)
+{
+    return (size + VideoBufferPool::BUFFER_ALIGNMENT - 1) / VideoBufferPool::BUFFER_ALIGNMENT * VideoBufferPool::BUFFER_ALIGNMENT;
+}
+
+
+#if defined(_WIN32)
+
+uint8_t* AllocateOnNode(size_t size, DWORD flags, int32_t numaNode)
+{
+    ULONG highestNode(0);
+
+    if (numaNode < 0 || !GetNumaHighestNodeNumber(&highestNode) || static_cast<ULONG>(numaNode) > highestNode)
+        return nullptr;
+
+    return reinterpret_cast<uint8_t*>(VirtualAllocExNuma(GetCurrentProcess(), NULL, size, MEM_RESERVE | MEM_COMMIT | flags, PAGE_READWRITE, numaNode));
+}
+
+#elif defined(__linux__)
+
+uint8_t* MapOnNode(size_t size, int flags, int32_t numaNode)
+{
+    void* buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+
+    if (buffer == MAP_FAILED)
+        return nullptr;
+
+#if defined(SYS_mbind)
+    // Bind before first touch, so the pages are faulted in on the node. Asks for MPOL_BIND (2) directly rather than
+    // depending on libnuma for the one call.
+    if (numaNode >= 0)
+    {
+        const unsigned long MPOL_BIND_MODE = 2;
+        const unsigned long maxNode = sizeof(unsigned long) * 8;
+        unsigned long nodeMask = static_cast<unsigned long>(numaNode) < maxNode ? 1UL << numaNode : 0;
+
+        if (nodeMask == 0 || syscall(SYS_mbind, buffer, size, MPOL_BIND_MODE, &nodeMask, maxNode, 0) != 0)
+        {
+            munmap(buffer, size);
+            return nullptr;
+        }
+    }
+#else
+    if (numaNode >= 0)
+    {
+        munmap(buffer, size);
+        return nullptr;
+    }
+#endif
+
+    return reinterpret_cast<uint8_t*>(buffer);
+}
+
+#endif
+
+}
+
+
+VideoBufferPool* VideoBufferPool::Create(uint32_t bufferSize, uint32_t numBuffers, uint32_t maxFreeBuffers, bool hugePages, int32_t numaNode)
+{
+    VideoBufferPool* pool = new VideoBufferPool(bufferSize, maxFreeBuffers > numBuffers ? maxFreeBuffers : numBuffers, hugePages, numaNode);
+
+    AJAAutoLock lock(&pool->lock_);
+
+    for (uint32_t i = 0; i < numBuffers; i++)
+    {
+        uint8_t* buffer = pool->AllocateBuffer();
+
+        if (buffer != nullptr)
+            pool->freeBuffers_.push_back(buffer);
+    }
+
+    return pool;
+}
+
+
+VideoBufferPool::VideoBufferPool(uint32_t bufferSize, uint32_t maxFreeBuffers, bool hugePages, int32_t numaNode)
+:   bufferSize_(bufferSize),
+    allocationSize_(bufferSize),
+    maxFreeBuffers_(maxFreeBuffers),
+    hugePages_(hugePages),
+    numaNode_(numaNode >= 0 ? numaNode : ANY_NUMA_NODE),
+    outstanding_(0),
+    allocated_(0),
+    closed_(false),
+    dmaContext_(nullptr),
+    dmaLockCallback_(nullptr),
+    dmaUnlockCallback_(nullptr)
+{
+}
+
+
+VideoBufferPool::~VideoBufferPool()
+{
+    for (auto buffer : freeBuffers_)
+        FreeBuffer(buffer);
+}
+
+
+void VideoBufferPool::SetDmaLockCallbacks(void* pInstance, DmaLockCallback* lockCallback, DmaUnlockCallback* unlockCallback)
+{
+    AJAAutoLock lock(&lock_);
+
+    if (closed_)
+        return;
+
+    dmaContext_ = pInstance;
+    dmaLockCallback_ = lockCallback;
+    dmaUnlockCallback_ = unlockCallback;
+
+    for (auto& allocation : allocations_)
+    {
+        if (!allocation.second.dmaLocked && dmaLockCallback_)
+            allocation.second.dmaLocked = dmaLockCallback_(dmaContext_, allocation.first, allocation.second.size);
+    }
+}
+
+
+uint8_t* VideoBufferPool::Acquire()
+{
+    AJAAutoLock lock(&lock_);
+    uint8_t* buffer(nullptr);
+
+    if (!freeBuffers_.empty())
+    {
+        buffer = freeBuffers_.back();
+        freeBuffers_.pop_back();
+    }
+    else
+    {
+        // JavaScript is holding on to more frames than we expected, so the pool grows to match
+        buffer = AllocateBuffer();
+    }
+
+    if (buffer != nullptr)
+    {
+        allocations_[buffer].refs = 1;
+        outstanding_++;
+    }
+
+    return buffer;
+}
+
+
+uint32_t VideoBufferPool::Release(uint8_t* buffer)
+{
+    if (buffer == nullptr)
+        return 0;
+
+    bool deletePool(false);
+    uint32_t size(0);
+
+    {
+        AJAAutoLock lock(&lock_);
+
+        auto iter = allocations_.find(buffer);
+        size = iter != allocations_.end() ? iter->second.size : 0;
+
+        // Someone else still has it
+        if (iter != allocations_.end() && --iter->second.refs > 0)
+            return size;
+
+        outstanding_--;
+
+        // A buffer from before the pool grew is too small to reuse
+        if (!closed_ && freeBuffers_.size() < maxFreeBuffers_ && size >= allocationSize_)
+            freeBuffers_.push_back(buffer);
+        else
+            FreeBuffer(buffer);
+
+        deletePool = closed_ && outstanding_ == 0;
+    }
+
+    if (deletePool)
+        delete this;
+
+    return size;
+}
+
+
+void VideoBufferPool::Retain(uint8_t* buffer)
+{
+    AJAAutoLock lock(&lock_);
+
+    auto iter = allocations_.find(buffer);
+
+    if (iter != allocations_.end())
+        iter->second.refs++;
+}
+
+
+bool VideoBufferPool::IsShared(uint8_t* buffer)
+{
+    AJAAutoLock lock(&lock_);
+
+    auto iter = allocations_.find(buffer);
+
+    return iter != allocations_.end() && iter->second.refs > 1;
+}
+
+
+bool VideoBufferPool::Resize(uint32_t bufferSize)
+{
+    AJAAutoLock lock(&lock_);
+
+    bufferSize_ = bufferSize;
+
+    if (bufferSize <= allocationSize_)
+        return true;
+
+    // Replace the free buffers with bigger ones now, so the next frames don't have to wait for allocations
+    const size_t numFree = freeBuffers_.size();
+
+    for (auto buffer : freeBuffers_)
+        FreeBuffer(buffer);
+
+    freeBuffers_.clear();
+    allocationSize_ = bufferSize;
+
+    for (size_t i = 0; i < numFree; i++)
+    {
+        uint8_t* buffer = AllocateBuffer();
+
+        if (buffer != nullptr)
+            freeBuffers_.push_back(buffer);
+    }
+
+    return false;
+}
+
+
+void VideoBufferPool::Close()
+{
+    bool deletePool(false);
+
+    {
+        AJAAutoLock lock(&lock_);
+
+        // Unlock everything while the device is still there, including buffers JavaScript still holds
+        for (auto& allocation : allocations_)
+        {
+            if (allocation.second.dmaLocked && dmaUnlockCallback_)
+                dmaUnlockCallback_(dmaContext_, allocation.first, allocation.second.size);
+
+            allocation.second.dmaLocked = false;
+        }
+
+        dmaLockCallback_ = nullptr;
+        dmaUnlockCallback_ = nullptr;
+        closed_ = true;
+        deletePool = outstanding_ == 0;
+    }
+
+    if (deletePool)
+        delete this;
+}
+
+
+void VideoBufferPool::GetStatistics(uint32_t& outstanding, uint64_t& allocated, uint32_t& hugePageBuffers, uint32_t& dmaLockedBuffers)
+{
+    AJAAutoLock lock(&lock_);
+
+    outstanding = outstanding_;
+    allocated = allocated_;
+    hugePageBuffers = 0;
+    dmaLockedBuffers = 0;
+
+    for (auto& allocation : allocations_)
+    {
+        hugePageBuffers += allocation.second.hugePage ? 1 : 0;
+        dmaLockedBuffers += allocation.second.dmaLocked ? 1 : 0;
+    }
+}
+
+
+int32_t VideoBufferPool::GetNumaNode()
+{
+    AJAAutoLock lock(&lock_);
+
+    return numaNode_;
+}
+
+
+uint8_t* VideoBufferPool::AllocateBuffer()
+{
+    Allocation allocation = { allocationSize_, false, false, false, 0 };
+    uint8_t* buffer(nullptr);
+
+    if (hugePages_)
+    {
+        buffer = AllocateHugePages(allocationSize_, numaNode_);
+        allocation.hugePage = buffer != nullptr;
+        allocation.pageAllocated = buffer != nullptr;
+    }
+
+    if (buffer == nullptr && numaNode_ != ANY_NUMA_NODE)
+    {
+        buffer = AllocateNumaPages(allocationSize_, numaNode_);
+        allocation.pageAllocated = buffer != nullptr;
+    }
+
+    // Once the node can't be had, stop asking for it, so GetNumaNode reports the buffers honestly
+    if (buffer == nullptr && numaNode_ != ANY_NUMA_NODE)
+    {
+        numaNode_ = ANY_NUMA_NODE;
+
+        if (hugePages_)
+        {
+            buffer = AllocateHugePages(allocationSize_, ANY_NUMA_NODE);
+            allocation.hugePage = buffer != nullptr;
+            allocation.pageAllocated = buffer != nullptr;
+        }
+    }
+
+    if (buffer == nullptr)
+        buffer = reinterpret_cast<uint8_t*>(AJAMemory::AllocateAligned(allocationSize_, BUFFER_ALIGNMENT));
+
+    if (buffer == nullptr)
+        return nullptr;
+
+    if (dmaLockCallback_)
+        allocation.dmaLocked = dmaLockCallback_(dmaContext_, buffer, allocationSize_);
+
+    allocations_[buffer] = allocation;
+    allocated_++;
+
+    return buffer;
+}
+
+
+void VideoBufferPool::FreeBuffer(uint8_t* buffer)
+{
+    auto iter = allocations_.find(buffer);
+
+    if (iter == allocations_.end())
+        return;
+
+    if (iter->second.dmaLocked && dmaUnlockCallback_)
+        dmaUnlockCallback_(dmaContext_, buffer, iter->second.size);
+
+    if (iter->second.pageAllocated)
+        FreePages(buffer, iter->second.size, iter->second.hugePage);
+    else
+        AJAMemory::FreeAligned(buffer);
+
+    allocations_.erase(iter);
+}
+
+
+uint8_t* VideoBufferPool::AllocateHugePages(uint32_t size, int32_t numaNode)
+{
+    const size_t allocationSize = HugePageAllocationSize(size);
+
+    if (allocationSize == 0)
+        return nullptr;
+
+#if defined(_WIN32)
+    if (numaNode != ANY_NUMA_NODE)
+        return AllocateOnNode(allocationSize, MEM_LARGE_PAGES, numaNode);
+
+    return reinterpret_cast<uint8_t*>(VirtualAlloc(NULL, allocationSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+#elif defined(__linux__) && defined(MAP_HUGETLB)
+    return MapOnNode(allocationSize, MAP_HUGETLB, numaNode);
+#else
+    (void) numaNode;
+    return nullptr;
+#endif
+}
+
+
+uint8_t* VideoBufferPool::AllocateNumaPages(uint32_t size, int32_t numaNode)
+{
+#if defined(_WIN32)
+    return AllocateOnNode(PageAllocationSize(size), 0, numaNode);
+#elif defined(__linux__)
+    return MapOnNode(PageAllocationSize(size), 0, numaNode);
+#else
+    (void) size;
+    (void) numaNode;
+    return nullptr;
+#endif
+}
+
+
+void VideoBufferPool::FreePages(uint8_t* buffer, uint32_t size, bool hugePage)
+{
+#if defined(_WIN32)
+    (void) size;
+    (void) hugePage;
+    VirtualFree(buffer, 0, MEM_RELEASE);
+#elif defined(__linux__)
+    munmap(buffer, hugePage ? HugePageAllocationSize(size) : PageAllocationSize(size));
+#else
+    (void) buffer;
+    (void) size;
+    (void) hugePage;
+#endif
+}
+}
+}
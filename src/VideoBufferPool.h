@@ -0,0 +1,137 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "ajabase/system/lock.h"
+
+namespace streampunk
+{
+
+namespace Aja
+{
+
+// A free list of equally sized video frame buffers, shared between the capture thread, which fills them,
+// and the Node thread, which hands them to JavaScript without copying. A buffer given to JavaScript comes
+// back through Release when its Node Buffer is garbage collected, which may be after the capture that
+// created the pool has gone - so the pool is only deleted once it has been closed and every buffer is home.
+//
+// Buffers are page aligned, and can be locked for DMA as they are allocated, so the driver does not have to
+// pin and map them again on every transfer. They stay locked until they are freed or the pool is closed.
+class VideoBufferPool
+{
+public:
+
+    static const uint32_t BUFFER_ALIGNMENT = 4096;
+    static const int32_t ANY_NUMA_NODE = -1;
+
+    // Lock or unlock a buffer for DMA. Locking may fail, in which case the buffer is used unlocked.
+    typedef bool(DmaLockCallback)(void* pInstance, uint8_t* buffer, uint32_t bufferSize);
+    typedef void(DmaUnlockCallback)(void* pInstance, uint8_t* buffer, uint32_t bufferSize);
+
+    // Create a pool of bufferSize byte buffers, with numBuffers allocated up front. Up to maxFreeBuffers
+    // are kept for reuse once returned; any more are freed. With hugePages, buffers are allocated on large
+    // pages where the OS allows it (on Windows, this needs the "Lock pages in memory" privilege), and on
+    // ordinary pages where it doesn't. With a numaNode, buffers are placed in that node's memory where the OS
+    // allows it, and wherever the OS chooses once it doesn't.
+    static VideoBufferPool* Create(uint32_t bufferSize, uint32_t numBuffers, uint32_t maxFreeBuffers, bool hugePages = false,
+                                   int32_t numaNode = ANY_NUMA_NODE);
+
+    // Lock every buffer for DMA now, and each new buffer as it is allocated, until Close
+    void SetDmaLockCallbacks(void* pInstance, DmaLockCallback* lockCallback, DmaUnlockCallback* unlockCallback);
+
+    // Take a buffer from the free list, allocating a new one if the list is empty. Returns NULL if allocation fails.
+    uint8_t* Acquire();
+
+    // Give back a buffer from Acquire, or a reference from Retain. The buffer only goes home once every reference
+    // has been given back. Deletes the pool if it was the last one out after Close. Returns the size the buffer was
+    // allocated with, which may be more than GetBufferSize if the pool has been resized since.
+    uint32_t Release(uint8_t* buffer);
+
+    // Take another reference to a buffer that is out, so it stays out until that is released too
+    void Retain(uint8_t* buffer);
+
+    // True while more than one reference to the buffer is out, so whoever fills it must not reuse it
+    bool IsShared(uint8_t* buffer);
+
+    // Change the size of the buffers handed out, for when the video format changes. If the buffers already allocated
+    // are big enough, they are kept and true is returned. If not, the free ones are reallocated at the new size now,
+    // and those still out are freed when they come back rather than reused.
+    bool Resize(uint32_t bufferSize);
+
+    // Called by the owner when it no longer needs the pool, and before the device goes: every buffer is
+    // unlocked for DMA. Buffers still out can be released afterwards.
+    void Close();
+
+    uint32_t GetBufferSize() const { return bufferSize_; }
+
+    // The size new buffers are allocated with: the largest the pool has been resized to
+    uint32_t GetAllocationSize() const { return allocationSize_; }
+
+    // Buffers acquired and not yet released, the total allocated over the life of the pool, and how many
+    // of the buffers currently allocated are on large pages and locked for DMA
+    void GetStatistics(uint32_t& outstanding, uint64_t& allocated, uint32_t& hugePageBuffers, uint32_t& dmaLockedBuffers);
+
+    // The NUMA node every buffer so far has been placed on, or ANY_NUMA_NODE if none was asked for or it couldn't be done
+    int32_t GetNumaNode();
+
+private:
+
+    struct Allocation
+    {
+        uint32_t size;
+        bool hugePage;
+        bool pageAllocated;         // From the OS's page allocator rather than AJAMemory, as NUMA placement needs
+        bool dmaLocked;
+        uint32_t refs;              // References out, from Acquire and Retain; 0 while the buffer is free
+    };
+
+    VideoBufferPool(uint32_t bufferSize, uint32_t maxFreeBuffers, bool hugePages, int32_t numaNode);
+    ~VideoBufferPool();
+
+    VideoBufferPool(const VideoBufferPool&);
+    VideoBufferPool& operator=(const VideoBufferPool&);
+
+    // Called with the lock held
+    uint8_t* AllocateBuffer();
+    void FreeBuffer(uint8_t* buffer);
+
+    static uint8_t* AllocateHugePages(uint32_t size, int32_t numaNode);
+    static uint8_t* AllocateNumaPages(uint32_t size, int32_t numaNode);
+    static void FreePages(uint8_t* buffer, uint32_t size, bool hugePage);
+
+    uint32_t              bufferSize_;
+    uint32_t              allocationSize_;
+    const uint32_t        maxFreeBuffers_;
+    const bool            hugePages_;
+    int32_t               numaNode_;
+
+    AJALock               lock_;
+    std::vector<uint8_t*> freeBuffers_;
+    std::map<uint8_t*, Allocation> allocations_;
+    uint32_t              outstanding_;
+    uint64_t              allocated_;
+    bool                  closed_;
+
+    void*                 dmaContext_;
+    DmaLockCallback*      dmaLockCallback_;
+    DmaUnlockCallback*    dmaUnlockCallback_;
+};
+
+}
+}
@@ -31,8 +31,19 @@ limitations under the License.
 
 static const ULWord    kAppSignature    AJA_FOURCC('S', 'T', 'P', 'K');
 
-const unsigned int ON_DEVICE_BUFFER_SIZE(7);/// Number of device buffers to allocate
-const unsigned int TOTAL_BUFFER_SIZE(ON_DEVICE_BUFFER_SIZE + CIRCULAR_BUFFER_SIZE);/// Number of device buffers to allocate
+const unsigned int AUDIO_CADENCE_LENGTH(5);/// Every NTV2 frame rate repeats its audio cadence within 5 frames
+const unsigned int FREE_VIDEO_BUFFERS_PER_HOST_BUFFER(2);/// Video buffers kept for reuse once JavaScript lets go of them, per host buffer
+const uint32_t RECORDER_WAIT_MS(100);/// Longest the recorder thread waits for a frame before checking whether to stop
+const uint32_t TIMESHIFT_QUEUE_FRAMES(4);/// Frames that can wait for the timeshift writer before the oldest is dropped
+const uint32_t FORMAT_CHANGE_CHECKS(3);/// Times in a row a new input format must be seen before capture is reconfigured for it
+const uint32_t NON_PCM_CHECK_PASSES(4);/// Frames between looks for audio pairs changing between PCM and non-PCM
+const uint32_t DRIVER_CALLS_PER_FRAME(5);/// A vertical interrupt wait, a format read, a status query, a transfer and, now and then, a non-PCM read
+
+
+static uint32_t ClampBufferCount (uint32_t count, uint32_t maxCount)
+{
+    return count < AjaDevice::MIN_BUFFERS ? AjaDevice::MIN_BUFFERS : (count > maxCount ? maxCount : count);
+}
 
 NTV2Capture::NTV2Capture (const streampunk::AjaDevice::InitParams* initParams,
                           const string                    inDeviceSpecifier,
@@ -41,7 +52,10 @@ NTV2Capture::NTV2Capture (const streampunk::AjaDevice::InitParams* initParams,
                           const NTV2FrameBufferFormat    inPixelFormat,
                           const bool                    inLevelConversion,
                           const bool                    inDoMultiFormat,
-                          const bool                    inWithAnc)
+                          const bool                    inWithAnc,
+                          const uint32_t                inHostBufferCount,
+                          const uint32_t                inDeviceBufferCount,
+                          const bool                    inHugePages)
 
 :       mProducerThread             (NULL),
         mLock                       (new AJALock (CNTV2DemoCommon::GetGlobalMutexName ())),
@@ -53,17 +67,41 @@ NTV2Capture::NTV2Capture (const streampunk::AjaDevice::InitParams* initParams,
         mPixelFormat                (inPixelFormat),
         mSavedTaskMode              (NTV2_DISABLE_TASKS),
         mAudioSystem                (inWithAudio ? NTV2_AUDIOSYSTEM_1 : NTV2_AUDIOSYSTEM_INVALID),
+        mNumAudioChannels           (0),
         mDoLevelConversion          (inLevelConversion),
+        mDoMultiFormat              (inDoMultiFormat),
         mGlobalQuit                 (false),
         mWithAnc                    (inWithAnc),
         mVideoBufferSize            (0),
+        mFrameSequence              (0),
+        mHardwareSequence           (0),
+        mNextTakenSequence          (0),
+        mAudioSamplePosition        (0),
+        mAudioCadenceSlot           (0),
+        mAudioCadenceRun            (0),
+        mHostBufferCount            (ClampBufferCount (inHostBufferCount, AjaDevice::MAX_HOST_BUFFERS)),
+        mDeviceBufferCount          (ClampBufferCount (inDeviceBufferCount, AjaDevice::MAX_DEVICE_BUFFERS)),
+        mHugePages                  (inHugePages),
+        mAVHostBuffer               (mHostBufferCount + 1),
+        mVideoBufferPool            (NULL),
         mFrameArrivedCallbackContext(NULL),
         mFrameArrivedCallback       (NULL),
+        mAudioCapturedCallbackContext(NULL),
+        mAudioCapturedCallback      (NULL),
+        mFormatChangedCallbackContext(NULL),
+        mFormatChangedCallback      (NULL),
         mFrameLocked                (false),
+        mRecorderThread             (NULL),
+        mRecording                  (false),
+        mRecorderQuit               (false),
+        mRecordFrameEvent           (false),
+        mRecordedFrames             (0),
+        mRecordedBytes              (0),
+        mTimeshift                  (NULL),
+        mDriverCalls                (DRIVER_CALLS_PER_FRAME),
+        mThreadPolicyApplied        (false),
         mInitParams                 (initParams)
 {
-    ::memset (mAVHostBuffer, 0x0, sizeof (mAVHostBuffer));
-
 }    //    constructor
 
 
@@ -82,25 +120,37 @@ NTV2Capture::~NTV2Capture ()
     }
 
     //    Free all my buffers...
-    for (unsigned bufferNdx = 0; bufferNdx < CIRCULAR_BUFFER_SIZE; bufferNdx++)
+    for (unsigned bufferNdx = 0; bufferNdx < mAVHostBuffer.size(); bufferNdx++)
     {
         if (mAVHostBuffer[bufferNdx].fVideoBuffer)
         {
-            delete mAVHostBuffer[bufferNdx].fVideoBuffer;
+            mVideoBufferPool->Release(reinterpret_cast<uint8_t*>(mAVHostBuffer[bufferNdx].fVideoBuffer));
             mAVHostBuffer[bufferNdx].fVideoBuffer = NULL;
         }
         if (mAVHostBuffer[bufferNdx].fAudioBuffer)
         {
-            delete mAVHostBuffer[bufferNdx].fAudioBuffer;
+            delete [] reinterpret_cast<uint8_t*>(mAVHostBuffer[bufferNdx].fAudioBuffer);
             mAVHostBuffer[bufferNdx].fAudioBuffer = NULL;
         }
         if (mAVHostBuffer[bufferNdx].fAncBuffer)
         {
-            delete mAVHostBuffer[bufferNdx].fAncBuffer;
+            delete [] reinterpret_cast<uint8_t*>(mAVHostBuffer[bufferNdx].fAncBuffer);
             mAVHostBuffer[bufferNdx].fAncBuffer = NULL;
         }
+        if (mAVHostBuffer[bufferNdx].fAncF2Buffer)
+        {
+            delete [] reinterpret_cast<uint8_t*>(mAVHostBuffer[bufferNdx].fAncF2Buffer);
+            mAVHostBuffer[bufferNdx].fAncF2Buffer = NULL;
+        }
     }    //    for each buffer in the ring
 
+    //    Any video buffers still held by JavaScript go back to the pool, which frees itself once they are all home...
+    if (mVideoBufferPool)
+    {
+        mVideoBufferPool->Close();
+        mVideoBufferPool = NULL;
+    }
+
 }    //    destructor
 
 
@@ -112,6 +162,10 @@ void NTV2Capture::Quit (void)
     if (mProducerThread)
         while (mProducerThread->Active ())
             AJATime::Sleep (10);
+
+    //    ...then close any recording and timeshift ring
+    StopRecording ();
+    StopTimeshift ();
 }    //    Quit
 
 
@@ -184,15 +238,20 @@ AJAStatus NTV2Capture::SetupVideo (void)
     }
 
     //    Determine the input video signal format...
-    mVideoFormat = mDeviceRef->GetInputVideoFormat(mInputSource);
+    {
+        AJAAutoLock    formatLock (&mFormatLock);
+        mVideoFormat = mDeviceRef->GetInputVideoFormat(mInputSource);
+    }
     if (mVideoFormat == NTV2_FORMAT_UNKNOWN)
     {
         cerr << "## ERROR:  No input signal or unknown format" << endl;
         return AJA_STATUS_NOINPUT;    //    Sorry, can't handle this format
     }
 
-    //    Set the device video format to whatever we detected at the input...
-    mDeviceRef->SetReference(true, ::NTV2InputSourceToReferenceSource(mInputSource));
+    //    Set the device video format to whatever we detected at the input. In multiformat mode the reference
+    //    is shared by every channel, so leave it alone rather than have each capture lock it to its own input...
+    if (!mDoMultiFormat)
+        mDeviceRef->SetReference(true, ::NTV2InputSourceToReferenceSource(mInputSource));
     mDeviceRef->SetVideoFormat(true, mVideoFormat, false, false, mInputChannel);
 
     {cout << "Set Input Video Format: " << mVideoFormat << endl;}
@@ -218,6 +277,13 @@ AJAStatus NTV2Capture::SetupAudio (void)
     //    In multiformat mode, base the audio system on the channel...
     if (::NTV2DeviceGetNumAudioSystems(mDeviceID) > 1  &&  UWord(mInputChannel) < ::NTV2DeviceGetNumAudioSystems(mDeviceID))
         mAudioSystem = ::NTV2ChannelToAudioSystem (mInputChannel);
+    else if (mDoMultiFormat  &&  mInputChannel != NTV2_CHANNEL1)
+    {
+        //    ...and don't steal the first channel's audio system when there isn't one for this channel
+        cerr << "## WARNING:  No audio system for channel " << mInputChannel << ", capturing video only" << endl;
+        mAudioSystem = NTV2_AUDIOSYSTEM_INVALID;
+        return AJA_STATUS_SUCCESS;
+    }
 
     cout << "NOTE: Setting Up Audio for Channel " << mInputChannel << endl;
     cout << "    mAudioSystem  = " << mAudioSystem << endl;
@@ -226,7 +292,8 @@ AJAStatus NTV2Capture::SetupAudio (void)
     //    Have the audio system capture audio from the designated device input (i.e., ch1 uses SDIIn1, ch2 uses SDIIn2, etc.)...
     mDeviceRef->SetAudioSystemInputSource(mAudioSystem, NTV2_AUDIO_EMBEDDED, ::NTV2ChannelToEmbeddedAudioInput(mInputChannel));
 
-    mDeviceRef->SetNumberAudioChannels(::NTV2DeviceGetMaxAudioChannels(mDeviceID), mAudioSystem);
+    mNumAudioChannels = ::NTV2DeviceGetMaxAudioChannels(mDeviceID);
+    mDeviceRef->SetNumberAudioChannels(mNumAudioChannels, mAudioSystem);
     mDeviceRef->SetAudioRate(NTV2_AUDIO_48K, mAudioSystem);
 
     //    The on-device audio buffer should be 4MB to work best across all devices & platforms...
@@ -247,21 +314,39 @@ void NTV2Capture::SetupHostBuffers (void)
     //    Let my circular buffer know when it's time to quit...
     mAVCircularBuffer.SetAbortFlag (&mGlobalQuit);
 
-    mVideoBufferSize = ::GetVideoWriteSize (mVideoFormat, mPixelFormat, vancMode);
+    {
+        AJAAutoLock    formatLock (&mFormatLock);
+        mVideoBufferSize = ::GetVideoWriteSize (mVideoFormat, mPixelFormat, vancMode);
+    }
     mFormatDesc = NTV2FormatDescriptor (standard, mPixelFormat, vancMode);
 
-    //    Allocate and add each in-host AVDataBuffer to my circular buffer member variable...
-    for (unsigned bufferNdx (0);  bufferNdx < CIRCULAR_BUFFER_SIZE;  bufferNdx++)
+    //    The video buffers come from a pool, so that frames can be handed to JavaScript without copying.
+    //    They are page aligned and, where the SDK can, locked for DMA once, up front, rather than by the driver on every transfer...
+    mVideoBufferPool = streampunk::Aja::VideoBufferPool::Create (mVideoBufferSize, mHostBufferCount + 1, mHostBufferCount * FREE_VIDEO_BUFFERS_PER_HOST_BUFFER, mHugePages, mThreadPolicy.numaNode);
+#if AJA_HAS_DMA_BUFFER_LOCK
+    mVideoBufferPool->SetDmaLockCallbacks (this, DmaLockBufferStatic, DmaUnlockBufferStatic);
+#endif
+
+    //    Allocate and add each in-host AVDataBuffer to my circular buffer member variable, bar the last, which is
+    //    the spare that the drop-newest policy captures into when the ring is full...
+    for (unsigned bufferNdx (0);  bufferNdx < mAVHostBuffer.size ();  bufferNdx++)
     {
-        mAVHostBuffer [bufferNdx].fVideoBuffer      = reinterpret_cast <uint32_t *> (new uint8_t [mVideoBufferSize]);
+        mAVHostBuffer [bufferNdx].fVideoBuffer      = reinterpret_cast <uint32_t *> (mVideoBufferPool->Acquire ());
         mAVHostBuffer [bufferNdx].fVideoBufferSize  = mVideoBufferSize;
+        mAVHostBuffer [bufferNdx].fVideoBufferCapacity = mVideoBufferPool->GetAllocationSize ();
         mAVHostBuffer [bufferNdx].fAudioBuffer      = NTV2_IS_VALID_AUDIO_SYSTEM (mAudioSystem) ? reinterpret_cast <uint32_t *> (new uint8_t [NTV2_AUDIOSIZE_MAX]) : 0;
         mAVHostBuffer [bufferNdx].fAudioBufferSize  = NTV2_IS_VALID_AUDIO_SYSTEM (mAudioSystem) ? NTV2_AUDIOSIZE_MAX : 0;
+        mAVHostBuffer [bufferNdx].fAudioBufferCapacity = mAVHostBuffer [bufferNdx].fAudioBufferSize;
         mAVHostBuffer [bufferNdx].fAncBuffer        = mWithAnc ? reinterpret_cast <uint32_t *> (new uint8_t [NTV2_ANCSIZE_MAX]) : 0;
         mAVHostBuffer [bufferNdx].fAncBufferSize    = mWithAnc ? NTV2_ANCSIZE_MAX : 0;
         mAVHostBuffer [bufferNdx].fAncF2Buffer      = mWithAnc ? reinterpret_cast <uint32_t *> (new uint8_t [NTV2_ANCSIZE_MAX]) : 0;
         mAVHostBuffer [bufferNdx].fAncF2BufferSize  = mWithAnc ? NTV2_ANCSIZE_MAX : 0;
-        mAVCircularBuffer.Add (& mAVHostBuffer [bufferNdx]);
+        if (mWithAnc)
+            mAVHostBuffer [bufferNdx].fAncPackets.Reserve ();
+        if (bufferNdx < mHostBufferCount)
+            mAVCircularBuffer.Add (& mAVHostBuffer [bufferNdx]);
+        else
+            mAVCircularBuffer.SetSpare (& mAVHostBuffer [bufferNdx]);
     }    //    for each AVDataBuffer
 
 }    //    SetupHostBuffers
@@ -293,6 +378,11 @@ void NTV2Capture::RouteInputSignal (void)
 
 AJAStatus NTV2Capture::Run ()
 {
+    //    There's only ever one capture thread, whether doCapture or a recording asked first. Once it has
+    //    been told to quit, it can't be started again...
+    if (mProducerThread)
+        return mGlobalQuit ? AJA_STATUS_FAIL : AJA_STATUS_SUCCESS;
+
     //    Start the playout and capture threads...
     StartProducerThread ();
     return AJA_STATUS_SUCCESS;
@@ -302,14 +392,18 @@ AJAStatus NTV2Capture::Run ()
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-AVDataBuffer* NTV2Capture::LockNextFrame()
+CaptureFrame* NTV2Capture::LockNextFrame()
 {
-    AVDataBuffer* pFrameData(nullptr);
+    CaptureFrame* pFrameData(nullptr);
 
     if (mFrameLocked == true)
     {
         cerr << "## ERROR:  attempt to lock next frame when it is already locked!" << endl;
     }
+    else if (mRecording)
+    {
+        //    The recorder thread is consuming the frames
+    }
     else
     {
         pFrameData = mAVCircularBuffer.StartConsumeNextBuffer();
@@ -324,6 +418,16 @@ AVDataBuffer* NTV2Capture::LockNextFrame()
 }
 
 
+uint64_t NTV2Capture::CountMissedFrames (const CaptureFrame * inFrame)
+{
+    const uint64_t    expected    (mNextTakenSequence);
+
+    mNextTakenSequence = inFrame->fHardwareSequence + 1;
+
+    return inFrame->fHardwareSequence > expected ? inFrame->fHardwareSequence - expected : 0;
+}
+
+
 void NTV2Capture::UnlockFrame(unsigned int* availableFrames)
 {
     if (mFrameLocked == false)
@@ -343,6 +447,12 @@ void NTV2Capture::UnlockFrame(unsigned int* availableFrames)
 }
 
 
+unsigned int NTV2Capture::GetNumAvailableFrames()
+{
+    return mAVCircularBuffer.GetCircBufferCount();
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 //    This is where we start the capture thread
@@ -365,6 +475,7 @@ void NTV2Capture::ProducerThreadStatic (AJAThread * pThread, void * pContext)
     //    Grab the NTV2Capture instance pointer from the pContext parameter,
     //    then call its CaptureFrames method...
     NTV2Capture *    pApp    (reinterpret_cast <NTV2Capture *> (pContext));
+    pApp->ApplyThreadPolicy (true);
     pApp->CaptureFrames ();
 
 }    //    ProducerThreadStatic
@@ -374,6 +485,11 @@ void NTV2Capture::CaptureFrames (void)
 {
     AUTOCIRCULATE_TRANSFER   inputXfer;    //    My A/C input transfer info
     NTV2AudioChannelPairs    nonPcmPairs, oldNonPcmPairs;
+    uint32_t                 nonPcmPairMask (0);
+    ULWord                   lastFramesDropped (0);    //    AutoCirculateInitForInput zeroes the card's count
+    NTV2VideoFormat          newFormat (NTV2_FORMAT_UNKNOWN);
+    uint32_t                 newFormatChecks (0);
+    uint64_t                 pass (0);
 
     bool setUpAC = StartAutoCirculateBuffers();
 
@@ -382,68 +498,75 @@ void NTV2Capture::CaptureFrames (void)
         cerr << "!! Unable to start auto circulate !!" << endl;
     }
 
+    //    Each pass round the loop is one frame: a wait for the input vertical interrupt, a format read, one status
+    //    query and a transfer for each frame the status says is ready, normally just the one. Every NON_PCM_CHECK_PASSES
+    //    passes there is a non-PCM read too...
     while (!mGlobalQuit)
     {
-        AUTOCIRCULATE_STATUS    acStatus;
-        mDeviceRef->AutoCirculateGetStatus(mInputChannel, acStatus);
+        mDeviceRef->WaitForInputVerticalInterrupt(mInputChannel);
+        mDriverCalls.Count (streampunk::Aja::DriverCall_VbiWait);
 
-        if (acStatus.IsRunning () && acStatus.HasAvailableInputFrame ())
+        //    Watch for the input changing format under us, every frame, as the frames are wrong until capture is
+        //    reconfigured. The receiver can pass through a format or two while it relocks, so only reconfigure once
+        //    the new one has been seen FORMAT_CHANGE_CHECKS frames in a row...
+        const NTV2VideoFormat    inputFormat    (mDeviceRef->GetInputVideoFormat (mInputSource));
+        mDriverCalls.Count (streampunk::Aja::DriverCall_Other);
+
+        if (inputFormat != mVideoFormat && inputFormat != NTV2_FORMAT_UNKNOWN)
         {
-            LogBufferState(acStatus.GetNumAvailableOutputFrames());
+            newFormatChecks = (inputFormat == newFormat) ? newFormatChecks + 1 : 1;
+            newFormat = inputFormat;
 
-            //    At this point, there's at least one fully-formed frame available in the device's
-            //    frame buffer to transfer to the host. Reserve an AVDataBuffer to "produce", and
-            //    use it in the next transfer from the device...
-            AVDataBuffer *    captureData    (mAVCircularBuffer.StartProduceNextBuffer ());
-
-            inputXfer.SetVideoBuffer (captureData->fVideoBuffer, captureData->fVideoBufferSize);
-            if (NTV2_IS_VALID_AUDIO_SYSTEM (mAudioSystem))
-                inputXfer.SetAudioBuffer (captureData->fAudioBuffer, captureData->fAudioBufferSize);
-            if (mWithAnc)
-                inputXfer.SetAncBuffers (captureData->fAncBuffer, captureData->fAncBufferSize, captureData->fAncF2Buffer, captureData->fAncF2BufferSize);
-
-            //    Do the transfer from the device into our host AVDataBuffer...
-            mDeviceRef->AutoCirculateTransfer(mInputChannel, inputXfer);
-            captureData->fAudioBufferSize = inputXfer.GetCapturedAudioByteCount();
-
-            NTV2SDIInStatistics    sdiStats;
-            mDeviceRef->ReadSDIStatistics(sdiStats);
-
-            //    "Capture" timecode into the host AVDataBuffer while we have full access to it...
-            NTV2_RP188    timecode;
-            inputXfer.GetInputTimeCode (timecode);
-            captureData->fRP188Data = timecode;
-
-            if (NTV2_IS_VALID_AUDIO_SYSTEM (mAudioSystem))
-                //    Look for PCM/NonPCM changes in the audio stream...
-                if (mDeviceRef->GetInputAudioChannelPairsWithoutPCM(mInputChannel, nonPcmPairs))
-                {
-                    NTV2AudioChannelPairs    becomingNonPCM, becomingPCM;
-                    set_difference (oldNonPcmPairs.begin(), oldNonPcmPairs.end(), nonPcmPairs.begin(), nonPcmPairs.end(),  inserter (becomingPCM, becomingPCM.begin()));
-                    set_difference (nonPcmPairs.begin(), nonPcmPairs.end(),  oldNonPcmPairs.begin(), oldNonPcmPairs.end(),  inserter (becomingNonPCM, becomingNonPCM.begin()));
-                    if (!becomingNonPCM.empty ())
-                        cerr << "## NOTE:  Audio channel pair(s) '" << becomingNonPCM << "' now non-PCM" << endl;
-                    if (!becomingPCM.empty ())
-                        cerr << "## NOTE:  Audio channel pair(s) '" << becomingPCM << "' now PCM" << endl;
-                    oldNonPcmPairs = nonPcmPairs;
-                }
-
-            //    Signal that we're done "producing" the frame, making it available for future "consumption"...
-            mAVCircularBuffer.EndProduceNextBuffer ();
-
-            if (mFrameArrivedCallback)
+            if (newFormatChecks >= FORMAT_CHANGE_CHECKS)
             {
-                // Signal to the client application that a new frame is available in the circular buffer
-                mFrameArrivedCallback(mFrameArrivedCallbackContext);
+                ChangeVideoFormat (newFormat);
+                lastFramesDropped = 0;
+                newFormatChecks = 0;
+                mDriverCalls.EndPass ();
+                continue;
             }
-        }    //    if A/C running and frame(s) are available for transfer
+        }
         else
+            newFormatChecks = 0;
+
+        //    Audio pairs switch between PCM and non-PCM rarely, and each frame carries the pairs last seen, so they
+        //    are looked at less often...
+        if ((pass++ % NON_PCM_CHECK_PASSES) == 0 && NTV2_IS_VALID_AUDIO_SYSTEM (mAudioSystem))
         {
-            //    Either AutoCirculate is not running, or there were no frames available on the device to transfer.
-            //    Rather than waste CPU cycles spinning, waiting until a frame becomes available, it's far more
-            //    efficient to wait for the next input vertical interrupt event to get signaled...
-            mDeviceRef->WaitForInputVerticalInterrupt(mInputChannel);
+            //    Look for PCM/NonPCM changes in the audio stream...
+            if (mDeviceRef->GetInputAudioChannelPairsWithoutPCM(mInputChannel, nonPcmPairs))
+            {
+                NTV2AudioChannelPairs    becomingNonPCM, becomingPCM;
+                set_difference (oldNonPcmPairs.begin(), oldNonPcmPairs.end(), nonPcmPairs.begin(), nonPcmPairs.end(),  inserter (becomingPCM, becomingPCM.begin()));
+                set_difference (nonPcmPairs.begin(), nonPcmPairs.end(),  oldNonPcmPairs.begin(), oldNonPcmPairs.end(),  inserter (becomingNonPCM, becomingNonPCM.begin()));
+                if (!becomingNonPCM.empty ())
+                    cerr << "## NOTE:  Audio channel pair(s) '" << becomingNonPCM << "' now non-PCM" << endl;
+                if (!becomingPCM.empty ())
+                    cerr << "## NOTE:  Audio channel pair(s) '" << becomingPCM << "' now PCM" << endl;
+                oldNonPcmPairs = nonPcmPairs;
+
+                nonPcmPairMask = 0;
+                for (NTV2AudioChannelPairsConstIter iter (oldNonPcmPairs.begin ());  iter != oldNonPcmPairs.end ();  ++iter)
+                    nonPcmPairMask |= 1 << *iter;
+            }
+            mDriverCalls.Count (streampunk::Aja::DriverCall_Other);
         }
+
+        AUTOCIRCULATE_STATUS    acStatus;
+        mDeviceRef->AutoCirculateGetStatus(mInputChannel, acStatus);
+        mDriverCalls.Count (streampunk::Aja::DriverCall_Status);
+
+        if (acStatus.IsRunning () && acStatus.HasAvailableInputFrame ())
+        {
+            LogBufferState(acStatus.GetNumAvailableOutputFrames());
+
+            //    The buffer level includes the frame being captured now, so the rest are ready. More than one means
+            //    a pass was late, and they are all transferred now rather than re-querying the status between them...
+            for (ULWord ready = acStatus.acBufferLevel - 1;  ready > 0 && !mGlobalQuit;  ready--)
+                TransferInputFrame (inputXfer, lastFramesDropped, nonPcmPairMask);
+        }    //    if A/C running and frame(s) are available for transfer
+
+        mDriverCalls.EndPass ();
     }    //    loop til quit signaled
 
     //    Stop AutoCirculate...
@@ -452,20 +575,476 @@ void NTV2Capture::CaptureFrames (void)
 }    //    CaptureFrames
 
 
+void NTV2Capture::TransferInputFrame (AUTOCIRCULATE_TRANSFER & ioInputXfer, ULWord & ioLastFramesDropped, const uint32_t inNonPcmPairs)
+{
+        //    At this point, there's at least one fully-formed frame available in the device's
+        //    frame buffer to transfer to the host. Reserve an AVDataBuffer to "produce", and
+        //    use it in the next transfer from the device. If the consumer has fallen behind, my backpressure
+        //    policy decides whether that waits, reuses the oldest unread frame, or gets the spare to throw away...
+        CaptureFrame *    captureData    (mAVCircularBuffer.StartProduceNextBuffer ());
+        if (captureData == NULL)
+            return;    //    Gave up waiting, because capture is quitting
+
+        //    A buffer too small for the format, after it has changed, or still queued for the timeshift writer, goes back to the pool...
+        if (captureData->fVideoBuffer != NULL
+            && (captureData->fVideoBufferCapacity < mVideoBufferSize
+                || mVideoBufferPool->IsShared (reinterpret_cast <uint8_t *> (captureData->fVideoBuffer))))
+        {
+            mVideoBufferPool->Release (reinterpret_cast <uint8_t *> (captureData->fVideoBuffer));
+            captureData->fVideoBuffer = NULL;
+        }
+
+        //    ...and if that, or the consumer taking this frame's video buffer last time round, has left it without one,
+        //    it gets a fresh one from the pool...
+        if (captureData->fVideoBuffer == NULL)
+        {
+            captureData->fVideoBuffer         = reinterpret_cast <uint32_t *> (mVideoBufferPool->Acquire ());
+            captureData->fVideoBufferCapacity = mVideoBufferPool->GetAllocationSize ();
+        }
+        captureData->fVideoBufferSize = mVideoBufferSize;
+
+        ioInputXfer.SetVideoBuffer (captureData->fVideoBuffer, captureData->fVideoBufferSize);
+        //    The audio goes in with the whole buffer's capacity, not the bytes captured into it last time round,
+        //    which would cap every later frame in this slot after one short one...
+        if (NTV2_IS_VALID_AUDIO_SYSTEM (mAudioSystem))
+            ioInputXfer.SetAudioBuffer (captureData->fAudioBuffer, captureData->fAudioBufferCapacity);
+        if (mWithAnc)
+            ioInputXfer.SetAncBuffers (captureData->fAncBuffer, captureData->fAncBufferSize, captureData->fAncF2Buffer, captureData->fAncF2BufferSize);
+
+        //    Do the transfer from the device into our host AVDataBuffer...
+        mDeviceRef->AutoCirculateTransfer(mInputChannel, ioInputXfer);
+        mDriverCalls.Count (streampunk::Aja::DriverCall_Transfer);
+        captureData->fDmaCompleteTime = AJATime::GetSystemMicroseconds ();
+        captureData->fSequence = mFrameSequence++;
+
+        //    Every frame the card drops moves the hardware sequence on one, so consumers can see exactly where the gaps are...
+        const ULWord    framesDropped    (ioInputXfer.acTransferStatus.acFramesDropped);
+        captureData->fCardFramesDropped = framesDropped - ioLastFramesDropped;
+        captureData->fHardwareSequence  = mHardwareSequence + captureData->fCardFramesDropped;
+        mHardwareSequence = captureData->fHardwareSequence + 1;
+        ioLastFramesDropped = framesDropped;
+
+        //    The frame stamp's times are both on the driver's clock, so the gap between them is the time from the
+        //    frame's vertical interrupt to the end of its transfer, whatever the host clock is doing...
+        const FRAME_STAMP &    frameStamp    (ioInputXfer.acTransferStatus.acFrameStamp);
+        captureData->fFrameTime    = frameStamp.acFrameTime;
+        captureData->fTransferTime = frameStamp.acCurrentTime;
+
+        //    Pick the wanted packets out of the anc here, so only a few bytes of them ever go further...
+        if (mWithAnc)
+            ParseAncPackets (captureData, ioInputXfer);
+        captureData->fAudioBufferSize = ioInputXfer.GetCapturedAudioByteCount();
+        UpdateAudioTimeline(captureData);
+
+        //    Meter every card channel here on the capture thread, while the audio is still hot in the cache...
+        streampunk::Aja::MeasureAudioLevels(reinterpret_cast<const uint8_t*>(captureData->fAudioBuffer),
+                                            NTV2_IS_VALID_AUDIO_SYSTEM (mAudioSystem) ? mNumAudioChannels : 0,
+                                            captureData->fAudioSampleCount,
+                                            streampunk::Aja::GetBestAudioKernelIsa(),
+                                            captureData->fAudioLevels);
+
+        //    ...and hand it to anything else that wants to see every frame's audio, such as loudness metering
+        if (mAudioCapturedCallback && captureData->fAudioSampleCount > 0)
+            mAudioCapturedCallback(mAudioCapturedCallbackContext, captureData);
+
+        //    "Capture" timecode into the host AVDataBuffer while we have full access to it...
+        NTV2_RP188    timecode;
+        ioInputXfer.GetInputTimeCode (timecode);
+        captureData->fRP188Data = timecode;
+
+        //    Publish the non-PCM pairs with the frame, so the client can pass their bitstreams through untouched...
+        captureData->fNonPcmPairs = inNonPcmPairs;
+
+        //    Queue the frame for the timeshift ring, if there is one, unless it's the spare that drop-newest throws away...
+        if (captureData != &mAVHostBuffer [mHostBufferCount])
+        {
+            AJAAutoLock    timeshiftLock (&mTimeshiftLock);
+            if (mTimeshift)
+                QueueTimeshiftFrame (captureData);
+        }
+
+        //    Signal that we're done "producing" the frame, making it available for future "consumption"...
+        mAVCircularBuffer.EndProduceNextBuffer ();
+
+        if (mRecording)
+        {
+            //    Wake the recorder thread...
+            mRecordFrameEvent.Signal ();
+        }
+        else if (mFrameArrivedCallback)
+        {
+            // Signal to the client application that a new frame is available in the circular buffer
+            mFrameArrivedCallback(mFrameArrivedCallbackContext);
+        }
+
+}    //    TransferInputFrame
+
+
+void NTV2Capture::GetDriverCallSummary (streampunk::Aja::DriverCallSummary & outSummary) const
+{
+    mDriverCalls.GetSummary (outSummary);
+}
+
+
+void NTV2Capture::ResetDriverCallStats (void)
+{
+    mDriverCalls.Reset ();
+}
+
+
+AJAStatus NTV2Capture::StartRecording (const std::string & inEssencePath, const std::string & inIndexPath)
+{
+    //    Tidy up after a recording that stopped by itself...
+    if (mRecorderThread && !mRecording)
+        StopRecording ();
+
+    AJAAutoLock    statusLock (&mRecorderLock);
+
+    if (!mDeviceRef || mVideoBufferPool == NULL)
+    {
+        mRecordingError = "capture is not initialised";
+        return AJA_STATUS_INITIALIZE;
+    }
+
+    if (mRecording || mFrameLocked)
+    {
+        mRecordingError = "already recording, or a frame is locked";
+        return AJA_STATUS_BUSY;
+    }
+
+    mRecordedFrames = 0;
+    mRecordedBytes = 0;
+    mRecordingError.clear ();
+
+    if (!mEssenceWriter.Open (inEssencePath, inIndexPath))
+    {
+        mRecordingError = mEssenceWriter.GetError ();
+        return AJA_STATUS_OPEN;
+    }
+
+    if (!mEssenceWriter.IsUnbuffered ())
+        cerr << "## NOTE:  Unbuffered writes not supported for '" << inEssencePath << "', recording through the file cache" << endl;
+
+    //    From here on, frames go to the recorder rather than to LockNextFrame...
+    mRecorderQuit = false;
+    mRecording = true;
+
+    mRecorderThread = new AJAThread ();
+    mRecorderThread->Attach (RecorderThreadStatic, this);
+    mRecorderThread->SetPriority (AJA_ThreadPriority_High);
+    mRecorderThread->Start ();
+
+    return AJA_STATUS_SUCCESS;
+
+}    //    StartRecording
+
+
+void NTV2Capture::StopRecording (void)
+{
+    if (mRecorderThread == NULL)
+        return;
+
+    mRecorderQuit = true;
+    mRecordFrameEvent.Signal ();
+
+    while (mRecorderThread->Active ())
+        AJATime::Sleep (10);
+
+    delete mRecorderThread;
+    mRecorderThread = NULL;
+
+    mEssenceWriter.Close ();
+
+    AJAAutoLock    statusLock (&mRecorderLock);
+    mRecording = false;
+
+}    //    StopRecording
+
+
+void NTV2Capture::GetRecordingStatus (bool & outRecording, uint64_t & outFramesWritten, uint64_t & outBytesWritten, std::string & outError)
+{
+    AJAAutoLock    statusLock (&mRecorderLock);
+
+    outRecording = mRecording;
+    outFramesWritten = mRecordedFrames;
+    outBytesWritten = mRecordedBytes;
+    outError = mRecordingError;
+
+}    //    GetRecordingStatus
+
+
+AJAStatus NTV2Capture::StartTimeshift (const std::string & inPath, const uint32_t inNumSlots, std::string & outError)
+{
+    if (!mDeviceRef || mVideoBufferPool == NULL)
+    {
+        outError = "capture is not initialised";
+        return AJA_STATUS_INITIALIZE;
+    }
+
+    StopTimeshift ();
+
+    //    Size the ring for the frames being captured now...
+    uint32_t    videoBufferSize    (0);
+    {
+        AJAAutoLock    formatLock (&mFormatLock);
+        videoBufferSize = mVideoBufferSize;
+    }
+
+    //    Create the ring before taking the lock: allocating the file can take a while, and capture mustn't wait for it...
+    TimeshiftWriter *    writer    (new TimeshiftWriter (this));
+
+    if (!writer->fRing.Create (inPath, inNumSlots, videoBufferSize, NTV2_AUDIOSIZE_MAX, NTV2_IS_VALID_AUDIO_SYSTEM (mAudioSystem) ? mNumAudioChannels : 0))
+    {
+        outError = writer->fRing.GetError ();
+        delete writer;
+        return AJA_STATUS_OPEN;
+    }
+
+    //    The jobs' audio is allocated up front, so queueing a frame never allocates on the capture thread...
+    writer->fJobs.resize (TIMESHIFT_QUEUE_FRAMES);
+    for (size_t jobNdx = 0; jobNdx < writer->fJobs.size (); jobNdx++)
+    {
+        writer->fJobs [jobNdx].fAudioBuffer.resize (NTV2_AUDIOSIZE_MAX);
+        writer->fQueue.Add (&writer->fJobs [jobNdx]);
+    }
+    writer->fQueue.SetPolicy (streampunk::Aja::BackpressurePolicy_DropOldest);
+    writer->fQueue.SetAbortFlag (&writer->fQuit);
+
+    writer->fThread.Attach (TimeshiftThreadStatic, writer);
+    writer->fThread.SetPriority (AJA_ThreadPriority_High);
+    writer->fThread.Start ();
+
+    //    If the format has grown since the ring was sized, the capture thread has already looked for a ring to drop
+    //    and not found this one, so it's dropped here instead. Otherwise the capture thread will see it next time...
+    bool    installed    (false);
+    {
+        AJAAutoLock    timeshiftLock (&mTimeshiftLock);
+        AJAAutoLock    formatLock (&mFormatLock);
+        installed = writer->fRing.GetMaxVideoSize () >= mVideoBufferSize;
+        if (installed)
+            mTimeshift = writer;
+    }
+
+    if (!installed)
+    {
+        CloseTimeshift (writer);
+        outError = "the input format changed while the ring was being created";
+        return AJA_STATUS_FAIL;
+    }
+
+    return AJA_STATUS_SUCCESS;
+
+}    //    StartTimeshift
+
+
+void NTV2Capture::StopTimeshift (void)
+{
+    TimeshiftWriter *    writer    (NULL);
+
+    {
+        AJAAutoLock    timeshiftLock (&mTimeshiftLock);
+        writer = mTimeshift;
+        mTimeshift = NULL;
+    }
+
+    CloseTimeshift (writer);
+
+}    //    StopTimeshift
+
+
+void NTV2Capture::CloseTimeshift (TimeshiftWriter * pWriter)
+{
+    if (pWriter == NULL)
+        return;
+
+    pWriter->fQuit = true;
+
+    while (pWriter->fThread.Active ())
+        AJATime::Sleep (10);
+
+    //    Let go of the frames the writer never got to...
+    for (size_t jobNdx = 0; jobNdx < pWriter->fJobs.size (); jobNdx++)
+    {
+        if (pWriter->fJobs [jobNdx].fVideoBuffer)
+        {
+            mVideoBufferPool->Release (pWriter->fJobs [jobNdx].fVideoBuffer);
+            pWriter->fJobs [jobNdx].fVideoBuffer = NULL;
+        }
+    }
+
+    if (pWriter->fQueue.GetDropped () > 0)
+        cerr << "## WARNING:  " << pWriter->fQueue.GetDropped () << " frames were left out of the timeshift ring, as it couldn't keep up" << endl;
+
+    delete pWriter;
+
+}    //    CloseTimeshift
+
+
+void NTV2Capture::QueueTimeshiftFrame (const CaptureFrame * captureData)
+{
+    TimeshiftJob *    job    (mTimeshift->fQueue.StartProduceNextBuffer ());
+    if (job == NULL)
+        return;    //    Gave up waiting, because timeshift is stopping
+
+    //    A job the writer fell too far behind to get to gives up its frame now...
+    if (job->fVideoBuffer)
+    {
+        mVideoBufferPool->Release (job->fVideoBuffer);
+        job->fVideoBuffer = NULL;
+    }
+
+    const bool    withAudio    (NTV2_IS_VALID_AUDIO_SYSTEM (mAudioSystem));
+
+    ::memset (&job->fInfo, 0, sizeof (job->fInfo));
+    job->fInfo.captureSequence      = captureData->fSequence;
+    job->fInfo.audioSamplePosition  = captureData->fAudioSamplePosition;
+    job->fInfo.videoSize            = captureData->fVideoBufferSize;
+    job->fInfo.audioSize            = withAudio ? captureData->fAudioBufferSize : 0;
+    job->fInfo.audioSampleCount     = captureData->fAudioSampleCount;
+    job->fInfo.nonPcmPairs          = captureData->fNonPcmPairs;
+    job->fInfo.timecodeDBB          = captureData->fRP188Data.fDBB;
+    job->fInfo.timecodeLow          = captureData->fRP188Data.fLo;
+    job->fInfo.timecodeHigh         = captureData->fRP188Data.fHi;
+
+    //    The video stays where AutoCirculate put it: the job takes a reference, and the host buffer gets a fresh one
+    //    next time round rather than being refilled under the writer. The audio buffer can't be swapped, so it's copied...
+    job->fVideoBuffer = reinterpret_cast <uint8_t *> (captureData->fVideoBuffer);
+    mVideoBufferPool->Retain (job->fVideoBuffer);
+    if (job->fInfo.audioSize > 0)
+        ::memcpy (&job->fAudioBuffer [0], captureData->fAudioBuffer, job->fInfo.audioSize);
+
+    mTimeshift->fQueue.EndProduceNextBuffer ();
+
+}    //    QueueTimeshiftFrame
+
+
+void NTV2Capture::TimeshiftThreadStatic (AJAThread * pThread, void * pContext)        //    static
+{
+    (void) pThread;
+
+    TimeshiftWriter *    pWriter    (reinterpret_cast <TimeshiftWriter *> (pContext));
+    pWriter->fOwner->ApplyThreadPolicy (false);
+    pWriter->fOwner->WriteTimeshiftFrames (pWriter);
+
+}    //    TimeshiftThreadStatic
+
+
+void NTV2Capture::WriteTimeshiftFrames (TimeshiftWriter * pWriter)
+{
+    const bool    withAudio    (NTV2_IS_VALID_AUDIO_SYSTEM (mAudioSystem));
+
+    while (!pWriter->fQuit)
+    {
+        //    Wait for the capture thread to queue a frame, giving up once the ring is being closed...
+        TimeshiftJob *    job    (pWriter->fQueue.StartConsumeNextBuffer ());
+        if (job == NULL)
+            continue;
+
+        if (!pWriter->fRing.WriteFrame (job->fInfo, job->fVideoBuffer, withAudio ? &job->fAudioBuffer [0] : NULL))
+            cerr << "## ERROR:  Unable to write frame " << job->fInfo.captureSequence << " to the timeshift ring: " << pWriter->fRing.GetError () << endl;
+
+        mVideoBufferPool->Release (job->fVideoBuffer);
+        job->fVideoBuffer = NULL;
+
+        pWriter->fQueue.EndConsumeNextBuffer ();
+    }    //    loop til the ring is closed
+
+}    //    WriteTimeshiftFrames
+
+
+void NTV2Capture::RecorderThreadStatic (AJAThread * pThread, void * pContext)        //    static
+{
+    (void) pThread;
+
+    NTV2Capture *    pApp    (reinterpret_cast <NTV2Capture *> (pContext));
+    pApp->ApplyThreadPolicy (false);
+    pApp->RecordFrames ();
+
+}    //    RecorderThreadStatic
+
+
+void NTV2Capture::RecordFrames (void)
+{
+    while (!mRecorderQuit && !mGlobalQuit)
+    {
+        //    Sleep until the capture thread has a frame for us, waking now and then to check whether to stop...
+        if (mAVCircularBuffer.GetCircBufferCount () == 0)
+        {
+            mRecordFrameEvent.WaitForSignal (RECORDER_WAIT_MS);
+            continue;
+        }
+
+        CaptureFrame *    captureData    (mAVCircularBuffer.StartConsumeNextBuffer ());
+        if (captureData == NULL)
+            continue;    //    Aborted, because capture is quitting
+
+        //    Keep the hardware sequence moving, so the first frame LockNextFrame returns afterwards doesn't count these as missed...
+        CountMissedFrames (captureData);
+
+        streampunk::Aja::EssenceIndexEntry    entry;
+        ::memset (&entry, 0, sizeof (entry));
+        entry.sequence              = captureData->fHardwareSequence;
+        entry.videoSize             = captureData->fVideoBufferSize;
+        entry.audioSize             = captureData->fAudioBufferSize;
+        entry.audioSamplePosition   = captureData->fAudioSamplePosition;
+        entry.audioSampleCount      = captureData->fAudioSampleCount;
+        entry.timecodeDBB           = captureData->fRP188Data.fDBB;
+        entry.timecodeLow           = captureData->fRP188Data.fLo;
+        entry.timecodeHigh          = captureData->fRP188Data.fHi;
+
+        //    The video buffer is page aligned, so it goes to disk straight from where AutoCirculate put it...
+        const bool    written    (mEssenceWriter.WriteFrame (entry,
+                                                             reinterpret_cast <const uint8_t *> (captureData->fVideoBuffer),
+                                                             NTV2_IS_VALID_AUDIO_SYSTEM (mAudioSystem) ? reinterpret_cast <const uint8_t *> (captureData->fAudioBuffer) : NULL));
+
+        mAVCircularBuffer.EndConsumeNextBuffer ();
+
+        AJAAutoLock    statusLock (&mRecorderLock);
+        mRecordedFrames = mEssenceWriter.GetFramesWritten ();
+        mRecordedBytes = mEssenceWriter.GetBytesWritten ();
+
+        if (!written)
+        {
+            mRecordingError = mEssenceWriter.GetError ();
+            cerr << "## ERROR:  Recording stopped: " << mRecordingError << endl;
+            break;
+        }
+    }    //    loop til recording stopped
+
+    //    Let frames flow to LockNextFrame again; StopRecording closes the files...
+    AJAAutoLock    statusLock (&mRecorderLock);
+    mRecording = false;
+
+}    //    RecordFrames
+
+
 bool NTV2Capture::StartAutoCirculateBuffers(uint32_t retries)
 {
     ULWord acOptions(AUTOCIRCULATE_WITH_RP188 | (mWithAnc ? AUTOCIRCULATE_WITH_ANC : 0));
+    ULWord startFrame(0);
+    ULWord endFrame(0);    //    Both zero lets AutoCirculate place the frames itself
+
+    //    In multiformat mode the other channels are circulating on the same card, so keep to this channel's share of the frame buffers...
+    if (mDoMultiFormat)
+    {
+        const ULWord framesPerChannel (::NTV2DeviceGetNumberFrameBuffers (mDeviceID) / ::NTV2DeviceGetNumVideoChannels (mDeviceID));
+        startFrame = ULWord (mInputChannel) * framesPerChannel;
+        endFrame = startFrame + (mDeviceBufferCount < framesPerChannel ? mDeviceBufferCount : framesPerChannel) - 1;
+    }
 
     mDeviceRef->AutoCirculateStop(mInputChannel);    //    Just in case
     bool setUpAC(false);
 
-    //    Tell AutoCirculate to use 7 frame buffers for capturing from the device...
+    //    Tell AutoCirculate how many frame buffers to use for capturing from the device...
     {
         AJAAutoLock    autoLock (mLock);    //    Avoid A/C buffer collisions with other processes
         setUpAC = mDeviceRef->AutoCirculateInitForInput(mInputChannel, 
-                                                        ON_DEVICE_BUFFER_SIZE, //    Number of frames to circulate
+                                                        mDeviceBufferCount,    //    Number of frames to circulate
                                                         mAudioSystem,          //    Which audio system (if any)?
-                                                        acOptions);            //    Include timecode (and maybe Anc too)
+                                                        acOptions,             //    Include timecode (and maybe Anc too)
+                                                        1,                     //    Number of channels
+                                                        startFrame,            //    First frame buffer to use
+                                                        endFrame);             //    Last frame buffer to use
 
         if(setUpAC == false)
         {
@@ -501,18 +1080,119 @@ bool NTV2Capture::StartAutoCirculateBuffers(uint32_t retries)
 }
 
 
+#if AJA_HAS_DMA_BUFFER_LOCK
+bool NTV2Capture::DmaLockBufferStatic (void * pContext, uint8_t * pBuffer, uint32_t bufferSize)        //    static
+{
+    NTV2Capture *    pApp    (reinterpret_cast <NTV2Capture *> (pContext));
+    return pApp->mDeviceRef->DMABufferLock (reinterpret_cast <ULWord *> (pBuffer), bufferSize, true);
+}
+
+
+void NTV2Capture::DmaUnlockBufferStatic (void * pContext, uint8_t * pBuffer, uint32_t bufferSize)        //    static
+{
+    NTV2Capture *    pApp    (reinterpret_cast <NTV2Capture *> (pContext));
+    pApp->mDeviceRef->DMABufferUnlock (reinterpret_cast <ULWord *> (pBuffer), bufferSize);
+}
+#endif    //    AJA_HAS_DMA_BUFFER_LOCK
+
+
 /**
     @brief    log the buffer status
 **/
 void NTV2Capture::LogBufferState(ULWord cardBufferFreeSlots)
 {
-    float usedCircBufferPercent = (float)(mAVCircularBuffer.GetCircBufferCount() * 100) / (float)CIRCULAR_BUFFER_SIZE;
-    float userCardBufferPercent = (float)((ON_DEVICE_BUFFER_SIZE - cardBufferFreeSlots) * 100) / (float)ON_DEVICE_BUFFER_SIZE;
+    float usedCircBufferPercent = (float)(mAVCircularBuffer.GetCircBufferCount() * 100) / (float)mHostBufferCount;
+    float userCardBufferPercent = (float)((mDeviceBufferCount - cardBufferFreeSlots) * 100) / (float)mDeviceBufferCount;
 
     BufferStatus::AddSample(BufferStatus::CaptureCircBuffer, usedCircBufferPercent);
     BufferStatus::AddSample(BufferStatus::CaptureCardBuffer, userCardBufferPercent);
 }
 
+
+void NTV2Capture::ApplyThreadPolicy(const bool inIsCaptureThread)
+{
+    streampunk::Aja::ThreadPolicy    effective;
+    streampunk::Aja::ApplyThreadPolicy (mThreadPolicy, inIsCaptureThread, effective);
+
+    if (inIsCaptureThread)
+    {
+        AJAAutoLock    policyLock (&mThreadPolicyLock);
+        mEffectiveThreadPolicy = effective;
+        mThreadPolicyApplied = true;
+    }
+}
+
+
+void NTV2Capture::SetThreadPolicy (const streampunk::Aja::ThreadPolicy & inPolicy)
+{
+    assert (!mVideoBufferPool);
+    mThreadPolicy = inPolicy;
+}
+
+
+bool NTV2Capture::GetThreadPolicy (streampunk::Aja::ThreadPolicy & outPolicy)
+{
+    {
+        AJAAutoLock    policyLock (&mThreadPolicyLock);
+        if (!mThreadPolicyApplied)
+            return false;
+        outPolicy = mEffectiveThreadPolicy;
+    }
+
+    //    The pool gives up on the node if the OS won't place a buffer there, so ask it where they went
+    outPolicy.numaNode = mVideoBufferPool ? mVideoBufferPool->GetNumaNode () : streampunk::Aja::ThreadPolicy::ANY_NUMA_NODE;
+    return true;
+}
+
+
+void NTV2Capture::UpdateAudioTimeline(CaptureFrame * captureData)
+{
+    const uint32_t bytesPerSample = mNumAudioChannels * sizeof(uint32_t);
+    const uint32_t numSamples = bytesPerSample > 0 ? captureData->fAudioBufferSize / bytesPerSample : 0;
+
+    captureData->fAudioSamplePosition = mAudioSamplePosition;
+    captureData->fAudioSampleCount    = numSamples;
+    captureData->fAudioDiscontinuity  = false;
+
+    if (!NTV2_IS_VALID_AUDIO_SYSTEM (mAudioSystem) || bytesPerSample == 0)
+    {
+        captureData->fAudioCadenceSlot = 0;
+        return;
+    }
+
+    const NTV2FrameRate frameRate (::GetNTV2FrameRateFromVideoFormat (mVideoFormat));
+
+    //    The card delivers whatever has arrived by the vertical interrupt, so a frame with a different count
+    //    from the expected slot means the cadence phase has moved (or audio was lost). Re-synchronise to the
+    //    nearest slot that matches, and flag the frame so that downstream A/V sync can re-anchor...
+    if (::GetAudioSamplesPerFrame (frameRate, NTV2_AUDIO_48K, mAudioCadenceSlot) == numSamples)
+    {
+        mAudioCadenceRun++;
+    }
+    else
+    {
+        for (uint32_t offset = 1; offset < AUDIO_CADENCE_LENGTH; offset++)
+        {
+            const uint32_t slot = (mAudioCadenceSlot + offset) % AUDIO_CADENCE_LENGTH;
+            if (::GetAudioSamplesPerFrame (frameRate, NTV2_AUDIO_48K, slot) == numSamples)
+            {
+                mAudioCadenceSlot = slot;
+                break;
+            }
+        }
+
+        //    A single frame count can match more than one slot, so the phase is only trusted once a whole
+        //    cadence has matched - until then, re-phasing is not reported as a discontinuity...
+        captureData->fAudioDiscontinuity = mAudioCadenceRun >= AUDIO_CADENCE_LENGTH;
+        mAudioCadenceRun = 0;
+    }
+
+    captureData->fAudioCadenceSlot = mAudioCadenceSlot;
+
+    mAudioSamplePosition += numSamples;
+    mAudioCadenceSlot = (mAudioCadenceSlot + 1) % AUDIO_CADENCE_LENGTH;
+}
+
 //////////////////////////////////////////////
 
 
@@ -526,6 +1206,18 @@ void NTV2Capture::GetACStatus (ULWord & outGoodFrames, ULWord & outDroppedFrames
 }
 
 
+void NTV2Capture::SetBackpressurePolicy (const streampunk::Aja::BackpressurePolicy inPolicy)
+{
+    mAVCircularBuffer.SetPolicy (inPolicy);
+}
+
+
+uint64_t NTV2Capture::GetHostFramesDropped (void) const
+{
+    return mAVCircularBuffer.GetDropped ();
+}
+
+
 bool NTV2Capture::SetFrameArrivedCallback(void * const pInstance, FrameArrivedCallback * const callback)
 {
     mFrameArrivedCallbackContext = pInstance;
@@ -535,7 +1227,118 @@ bool NTV2Capture::SetFrameArrivedCallback(void * const pInstance, FrameArrivedCa
 }    //    SetCallback
 
 
+void NTV2Capture::ChangeVideoFormat(const NTV2VideoFormat inNewFormat)
+{
+    cout << "## NOTE:  Input format changed from " << mVideoFormat << " to " << inNewFormat << endl;
+
+    //    The device is already set up for this input, so there's no need for the waits a full Init makes
+    //    to let the receiver lock: just stop AutoCirculate, and set the frame store to the new format...
+    mDeviceRef->AutoCirculateStop (mInputChannel);
+
+    mDeviceRef->SetVideoFormat (true, inNewFormat, false, false, mInputChannel);
+    RouteInputSignal ();
+
+    NTV2VANCMode    vancMode    (NTV2_VANCMODE_INVALID);
+    NTV2Standard    standard    (NTV2_STANDARD_INVALID);
+    mDeviceRef->GetVANCMode (vancMode);
+    mDeviceRef->GetStandard (standard);
+
+    //    The Node thread reads the format and frame size, so they change together under the lock. This thread is
+    //    the only one that changes them, so it reads them without...
+    {
+        AJAAutoLock    formatLock (&mFormatLock);
+        mVideoFormat = inNewFormat;
+        mVideoBufferSize = ::GetVideoWriteSize (inNewFormat, mPixelFormat, vancMode);
+    }
+    mFormatDesc = NTV2FormatDescriptor (standard, mPixelFormat, vancMode);
+
+    //    Buffers big enough for the new format are kept; frames still in the host ring keep theirs, and any
+    //    too small are swapped as their slots come round again...
+    if (!mVideoBufferPool->Resize (mVideoBufferSize))
+        cout << "## NOTE:  Video buffers reallocated for " << mVideoBufferSize << " byte frames" << endl;
+
+    //    The new frame rate may have a different audio cadence...
+    mAudioCadenceSlot = 0;
+    mAudioCadenceRun = 0;
+
+    //    A timeshift ring made for smaller frames can't take the new ones...
+    TimeshiftWriter *    staleWriter    (NULL);
+    {
+        AJAAutoLock    timeshiftLock (&mTimeshiftLock);
+        if (mTimeshift && mTimeshift->fRing.GetMaxVideoSize () < mVideoBufferSize)
+        {
+            staleWriter = mTimeshift;
+            mTimeshift = NULL;
+        }
+    }
+    if (staleWriter)
+    {
+        cerr << "## WARNING:  Timeshift stopped, as its ring is too small for the new format" << endl;
+        CloseTimeshift (staleWriter);
+    }
+
+    if (mFormatChangedCallback)
+        mFormatChangedCallback (mFormatChangedCallbackContext, mVideoFormat, mFrameSequence);
+
+    if (!StartAutoCirculateBuffers ())
+        cerr << "!! Unable to restart AutoCirculate after the format change !!" << endl;
+
+}    //    ChangeVideoFormat
+
+
+void NTV2Capture::ParseAncPackets(CaptureFrame * captureData, const AUTOCIRCULATE_TRANSFER & inputXfer)
+{
+    captureData->fAncPackets.Clear ();
+
+    for (uint8_t field (1);  field <= 2;  field++)
+    {
+        const uint8_t *    ancBuffer    (reinterpret_cast <const uint8_t *> (field == 1 ? captureData->fAncBuffer : captureData->fAncF2Buffer));
+        const uint32_t     ancBytes     (inputXfer.GetCapturedAncByteCount (field == 2));
+
+        if (ancBuffer == NULL || ancBytes == 0)
+            continue;
+
+        //    The SDK's list allocates an object for every packet it parses, so this does allocate on the capture thread,
+        //    a few times a frame. Only the frame's own packet list, which the kept packets are copied into, is preallocated...
+        mAncList.Clear ();
+        if (AJA_FAILURE (mAncList.AddReceivedAncillaryData (ancBuffer, ancBytes)))
+            continue;
+
+        for (uint32_t packetNdx (0);  packetNdx < mAncList.CountAncillaryData ();  packetNdx++)
+        {
+            AJAAncillaryData *    packet    (mAncList.GetAncillaryDataAtIndex (packetNdx));
+            if (packet == NULL || !mAncFilter.Accepts (packet->GetDID (), packet->GetSID ()))
+                continue;
+
+            captureData->fAncPackets.Add (packet->GetDID (), packet->GetSID (), field,
+                                          static_cast <uint16_t> (packet->GetLocationLineNumber ()),
+                                          packet->GetPayloadData (), packet->GetDC ());
+        }
+    }
+
+}    //    ParseAncPackets
+
+
+bool NTV2Capture::SetAudioCapturedCallback(void * const pInstance, AudioCapturedCallback * const callback)
+{
+    mAudioCapturedCallbackContext = pInstance;
+    mAudioCapturedCallback        = callback;
+
+    return true;
+}    //    SetAudioCapturedCallback
+
+
+bool NTV2Capture::SetFormatChangedCallback(void * const pInstance, FormatChangedCallback * const callback)
+{
+    mFormatChangedCallbackContext = pInstance;
+    mFormatChangedCallback        = callback;
+
+    return true;
+}    //    SetFormatChangedCallback
+
+
 NTV2VideoFormat NTV2Capture::GetVideoFormat()
 {
+    AJAAutoLock    formatLock (&mFormatLock);
     return mVideoFormat;
 }
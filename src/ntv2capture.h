@@ -24,20 +24,55 @@
 #ifndef _NTV2CAPTURE_H
 #define _NTV2CAPTURE_H
 
+#include <atomic>
+#include <vector>
 #include "ntv2enums.h"
 #include "ntv2devicefeatures.h"
 #include "ntv2devicescanner.h"
 #include "ntv2democommon.h"
 #include "ntv2formatdescriptor.h"
 #include "ajabase/common/videotypes.h"
-#include "ajabase/common/circularbuffer.h"
+#include "ajabase/system/event.h"
+#include "ajabase/system/lock.h"
 #include "ajabase/system/thread.h"
+#include "ajaanc/includes/ancillarylist.h"
 #include "AjaDevice.h"
+#include "AncPackets.h"
+#include "AudioKernels.h"
+#include "DriverCallStats.h"
+#include "EssenceWriter.h"
+#include "FrameQueue.h"
+#include "ThreadPolicy.h"
+#include "TimeshiftRing.h"
+#include "VideoBufferPool.h"
 
 #define NTV2_AUDIOSIZE_MAX (401 * 1024)
 #define NTV2_ANCSIZE_MAX   (0x2000)
 
 
+/**
+    @brief    A captured frame: the host buffers filled by AutoCirculate, plus metadata computed on the capture thread.
+**/
+struct CaptureFrame : public AVDataBuffer
+{
+    uint64_t    fSequence;               ///< @brief    Position of this frame in the capture, counting from zero; consecutive frames have consecutive numbers
+    uint64_t    fHardwareSequence;       ///< @brief    Position of this frame among all those the card has seen, counting from zero; jumps past frames the card dropped
+    uint32_t    fCardFramesDropped;      ///< @brief    Number of frames the card dropped between the previous captured frame and this one
+    uint64_t    fAudioSamplePosition;    ///< @brief    Cumulative index of the first audio sample in this frame, counted from the start of capture
+    uint32_t    fAudioSampleCount;       ///< @brief    Number of audio samples (per channel) in this frame
+    uint32_t    fAudioCadenceSlot;       ///< @brief    Position of this frame in the audio cadence, e.g. 0 to 4 for the 1602/1601 sample cadence at 29.97
+    bool        fAudioDiscontinuity;     ///< @brief    True if the sample count broke the expected cadence, so the timeline was re-synchronised
+    uint32_t    fNonPcmPairs;            ///< @brief    Bit N set if card audio channels 2N and 2N+1 carry non-PCM data, such as Dolby E
+    streampunk::Aja::AudioLevels fAudioLevels;    ///< @brief    Peak, RMS and clip count for every card channel in this frame
+    int64_t     fFrameTime;              ///< @brief    Driver clock at the vertical interrupt that completed this frame, in 100ns ticks
+    int64_t     fTransferTime;           ///< @brief    Driver clock when the transfer of this frame to the host finished, in 100ns ticks
+    uint32_t    fVideoBufferCapacity;    ///< @brief    Bytes allocated at fVideoBuffer, which can be more than fVideoBufferSize after a format change
+    uint32_t    fAudioBufferCapacity;    ///< @brief    Bytes allocated at fAudioBuffer; fAudioBufferSize is just the bytes captured into it for this frame
+    uint64_t    fDmaCompleteTime;        ///< @brief    Host monotonic clock (AJATime::GetSystemMicroseconds) once the transfer had returned
+    streampunk::Aja::AncPacketList fAncPackets;    ///< @brief    The ancillary packets passed by the anc filter, parsed out of both fields' anc buffers
+};
+
+
 /**
     @brief    Instances of me capture frames in real time from a video signal provided to an input of an AJA device.
 **/
@@ -50,6 +85,8 @@ class NTV2Capture
     public:
 
         typedef void(FrameArrivedCallback)(void * pInstance);
+        typedef void(AudioCapturedCallback)(void * pInstance, const CaptureFrame * pFrame);
+        typedef void(FormatChangedCallback)(void * pInstance, NTV2VideoFormat newFormat, uint64_t firstSequence);
 
     //    Public Instance Methods
     public:
@@ -65,6 +102,9 @@ class NTV2Capture
                                             or release the device. If false (the default), acquires/releases exclusive use of the device.
             @param[in]    inWithAnc            If true, captures ancillary data using the new AutoCirculate APIs (if the device supports it).
                                             Defaults to false.
+            @param[in]    inHostBufferCount    Specifies the number of frames in my host ring buffer. Defaults to CIRCULAR_BUFFER_SIZE.
+            @param[in]    inDeviceBufferCount  Specifies the number of frames AutoCirculate captures into on the device. Defaults to 7.
+            @param[in]    inHugePages          If true, allocate my video buffers on large pages where the OS allows it. Defaults to false.
         **/
         NTV2Capture (   const AjaDevice::InitParams* initParams,
                         const std::string            inDeviceSpecifier    = "0",
@@ -73,7 +113,10 @@ class NTV2Capture
                         const NTV2FrameBufferFormat  inPixelFormat        = NTV2_FBF_8BIT_YCBCR,
                         const bool                   inDoLvlABConversion  = false,
                         const bool                   inMultiFormat        = false,
-                        const bool                   inWithAnc            = false);
+                        const bool                   inWithAnc            = false,
+                        const uint32_t               inHostBufferCount    = CIRCULAR_BUFFER_SIZE,
+                        const uint32_t               inDeviceBufferCount  = AjaDevice::DEFAULT_DEVICE_BUFFERS,
+                        const bool                   inHugePages          = false);
 
         virtual                        ~NTV2Capture ();
 
@@ -85,6 +128,7 @@ class NTV2Capture
         /**
             @brief    Runs me.
             @note    Do not call this method without first calling my Init method.
+            @note    Calling me again while I'm running does nothing; once I've quit, I fail.
         **/
         virtual AJAStatus            Run (void);
 
@@ -101,11 +145,51 @@ class NTV2Capture
         **/
         virtual void                GetACStatus (ULWord & outGoodFrames, ULWord & outDroppedFrames, ULWord & outBufferLevel);
 
+        /**
+            @brief    Sets what my capture thread does when my host ring buffer is full: wait for the consumer (the default),
+                      overwrite the oldest unread frame, or throw away the new one. Can be changed while capturing.
+            @param[in]    inPolicy    The backpressure policy.
+        **/
+        virtual void                SetBackpressurePolicy (const streampunk::Aja::BackpressurePolicy inPolicy);
+
+        /**
+            @brief    Provides the number of frames the backpressure policy has dropped from my host ring buffer,
+                      as opposed to those the card dropped, which GetACStatus reports.
+        **/
+        virtual uint64_t            GetHostFramesDropped (void) const;
+
+        /**
+            @brief    Sets the CPUs, priority and NUMA node for my threads and buffers. Must be called before Init.
+            @param[in]    inPolicy    The policy. My capture thread also gets its real time priority; the recorder thread just the CPUs.
+        **/
+        virtual void                SetThreadPolicy (const streampunk::Aja::ThreadPolicy & inPolicy);
+
+        /**
+            @brief    Provides the thread policy actually in effect, once my capture thread is running.
+            @param[out]    outPolicy    Receives the CPUs and priority the OS allowed, and the NUMA node my buffers are on.
+            @return    False if my capture thread hasn't started yet.
+        **/
+        virtual bool                GetThreadPolicy (streampunk::Aja::ThreadPolicy & outPolicy);
+
+        /**
+            @brief    Provides the counts of driver calls my capture thread has made, pass by pass, since they were last reset.
+            @param[out]    outSummary    Receives the counts, and how many passes went over the budget of calls for a frame.
+        **/
+        virtual void                GetDriverCallSummary (streampunk::Aja::DriverCallSummary & outSummary) const;
+
+        /**
+            @brief    Zeroes the driver call counts.
+        **/
+        virtual void                ResetDriverCallStats (void);
+
         /** 
             @brief    Lock the next frame to read the data from it, returns a pointer to the frame data if lock was successful.
             @note   It is essential to call UnlockFrame() after calling this, or the pipeline will become blocked.
+            @note   The caller may take the frame's video buffer rather than copying it, by setting fVideoBuffer to NULL
+                    before unlocking. It must then give the buffer back to GetVideoBufferPool() once finished with it,
+                    and the frame is given a fresh buffer from the pool the next time it is filled.
          **/
-        virtual AVDataBuffer*       LockNextFrame();
+        virtual CaptureFrame*       LockNextFrame();
 
         /**
             @brief    Unlock the previously locked frame to free up the circular buffer.
@@ -113,16 +197,137 @@ class NTV2Capture
         **/
         virtual void                UnlockFrame(unsigned int* availableFrames = nullptr);
 
+        /**
+            @brief    Note that a frame has been taken, by LockNextFrame's caller or by the recorder, and find how many frames
+                      were lost just before it. Only one of them takes frames at a time, so what one takes the other doesn't miss.
+            @param[in]    inFrame    The frame just taken.
+            @return    The frames missing from the hardware sequence since the last frame taken, lost on the card or to the backpressure policy.
+        **/
+        virtual uint64_t            CountMissedFrames (const CaptureFrame * inFrame);
+
+        /**
+            @brief    Return the number of captured frames waiting to be locked.
+        **/
+        virtual unsigned int        GetNumAvailableFrames();
+
         /**
             @brief  Set the callback to be invoked when a new frame becomes available.
         **/
         bool SetFrameArrivedCallback(void * const pInstance, FrameArrivedCallback * const callback);
 
+        /**
+            @brief  Set the callback to be invoked on the capture thread with each frame's audio, before the frame is made available.
+            @note   The callback must not block, or it will hold up capture.
+        **/
+        bool SetAudioCapturedCallback(void * const pInstance, AudioCapturedCallback * const callback);
+
+        /**
+            @brief  Set the callback to be invoked on the capture thread when I have reconfigured for a new input format.
+                    It is given the new format, and the sequence number of the first frame captured in it.
+        **/
+        bool SetFormatChangedCallback(void * const pInstance, FormatChangedCallback * const callback);
+
         /**
             @brief  Return the format of the video currently being received.
         **/
         virtual NTV2VideoFormat     GetVideoFormat();
 
+        /**
+            @brief  Return the number of interleaved audio channels in each captured audio buffer, or zero if audio is disabled.
+        **/
+        virtual uint32_t            GetNumAudioChannels() const { return mNumAudioChannels; }
+
+        /**
+            @brief  Choose which ancillary packets to keep, when capturing anc. Call this before Run.
+            @param[in]    inDidSdids    Each entry is (DID << 8) | SDID. If empty (the default), every packet is kept.
+        **/
+        virtual void                SetAncFilter (const std::vector<uint16_t> & inDidSdids) { mAncFilter.Set (inDidSdids); }
+
+        /**
+            @brief  Return true if I capture ancillary data. Only valid after Init, as not every device can.
+        **/
+        virtual bool                IsCapturingAnc() const { return mWithAnc; }
+
+        /**
+            @brief  Return the pool the video buffers are drawn from, or NULL before Init. The pool outlives me for as
+                    long as any of its buffers are still out.
+        **/
+        virtual streampunk::Aja::VideoBufferPool *  GetVideoBufferPool() const { return mVideoBufferPool; }
+
+        /**
+            @brief  Return true if my capture thread is running.
+        **/
+        virtual bool                IsRunning() const { return mProducerThread != NULL && mProducerThread->Active (); }
+
+        /**
+            @brief    Starts writing every captured frame to disk on a recorder thread of my own. While recording, frames go
+                      to the recorder rather than to LockNextFrame, and the frame arrived callback isn't called.
+            @note    Do not call this method without first calling my Init method. Recording stops by itself if a write fails.
+            @param[in]    inEssencePath    The raw essence file: each frame's video then its audio, each padded to a whole block.
+            @param[in]    inIndexPath      The index file, holding a streampunk::Aja::EssenceIndexEntry for each frame.
+            @return    AJA_STATUS_SUCCESS if recording started; otherwise GetRecordingStatus says why not.
+        **/
+        virtual AJAStatus           StartRecording (const std::string & inEssencePath, const std::string & inIndexPath);
+
+        /**
+            @brief    Stops recording, closing the files, and returns frames to LockNextFrame. Called by Quit.
+        **/
+        virtual void                StopRecording (void);
+
+        /**
+            @brief    Provides status information about the current or last recording, and is safe to call from any thread.
+            @param[out]    outRecording        Receives true while the recorder thread is writing frames.
+            @param[out]    outFramesWritten    Receives the number of frames written.
+            @param[out]    outBytesWritten     Receives the number of bytes of video and audio written, not counting padding.
+            @param[out]    outError            Receives the reason recording failed or stopped early, or an empty string.
+        **/
+        virtual void                GetRecordingStatus (bool & outRecording, uint64_t & outFramesWritten, uint64_t & outBytesWritten, std::string & outError);
+
+        /**
+            @brief    Starts keeping the most recent frames in a memory mapped timeshift ring file, which other instances can
+                      open by path to read past frames from. Frames still go to LockNextFrame or the recorder as usual.
+            @note    Do not call this method without first calling my Init method. Any ring already being fed is closed first.
+            @param[in]    inPath        The ring file to create, or overwrite.
+            @param[in]    inNumSlots    How many frames the ring holds.
+            @param[out]   outError      Receives the reason, if the ring couldn't be created.
+            @return    AJA_STATUS_SUCCESS if the ring was created.
+        **/
+        virtual AJAStatus           StartTimeshift (const std::string & inPath, const uint32_t inNumSlots, std::string & outError);
+
+        /**
+            @brief    Stops feeding the timeshift ring, and closes it. The file stays on disk.
+        **/
+        virtual void                StopTimeshift (void);
+
+    //    Protected Types
+    protected:
+        /**
+            @brief    A frame waiting for the timeshift writer: its video buffer is shared with the host buffer it was captured into.
+        **/
+        struct TimeshiftJob
+        {
+            TimeshiftJob () : fVideoBuffer (NULL) {}
+
+            streampunk::Aja::TimeshiftFrameInfo   fInfo;
+            uint8_t *                             fVideoBuffer;    ///< @brief    A reference retained from my video buffer pool, or NULL
+            std::vector<uint8_t>                  fAudioBuffer;    ///< @brief    A copy of the frame's audio, as its host buffer is refilled in place
+        };
+
+        /**
+            @brief    A timeshift ring, and the thread that writes into it, so the capture thread never waits for the disk.
+        **/
+        struct TimeshiftWriter
+        {
+            explicit TimeshiftWriter (NTV2Capture * pOwner) : fOwner (pOwner), fQuit (false) {}
+
+            NTV2Capture *                                    fOwner;
+            streampunk::Aja::TimeshiftRing                   fRing;
+            std::vector<TimeshiftJob>                        fJobs;
+            streampunk::Aja::FrameQueue <TimeshiftJob *>     fQueue;     ///< @brief    Drops the oldest job when the writer falls behind
+            AJAThread                                        fThread;
+            std::atomic<bool>                                fQuit;      ///< @brief    Set "true" to stop the thread
+        };
+
     //    Protected Instance Methods
     protected:
         /**
@@ -151,15 +356,40 @@ class NTV2Capture
         virtual void            StartProducerThread (void);
 
         /**
-            @brief    Repeatedly captures frames using AutoCirculate (until global quit flag set).
+            @brief    Repeatedly captures frames using AutoCirculate (until global quit flag set), one pass per input vertical interrupt.
         **/
         virtual void            CaptureFrames (void);
 
+        /**
+            @brief    Transfers one ready frame from the device into the next host buffer, and hands it on. Called on the capture thread.
+            @param[in,out]    ioInputXfer          The transfer to reuse.
+            @param[in,out]    ioLastFramesDropped  The card's dropped frame count as of the last transfer.
+            @param[in]        inNonPcmPairs        The audio channel pairs last seen carrying non-PCM data, one bit per pair.
+        **/
+        virtual void            TransferInputFrame (AUTOCIRCULATE_TRANSFER & ioInputXfer, ULWord & ioLastFramesDropped, const uint32_t inNonPcmPairs);
+
         /**
             @brief    Try to start the AutoCirculate buffer, recursively retrying if this doesn't work first time.
         **/
         virtual bool            StartAutoCirculateBuffers(uint32_t retries = 3);
 
+        /**
+            @brief    Repeatedly writes captured frames to disk (until recording is stopped, a write fails, or the global quit flag is set).
+        **/
+        virtual void            RecordFrames (void);
+
+        /**
+            @brief    Queues a captured frame for the timeshift writer thread, holding on to its video buffer rather than copying it.
+                      Called on the capture thread, with the timeshift lock held.
+        **/
+        virtual void            QueueTimeshiftFrame (const CaptureFrame * captureData);
+
+        /**
+            @brief    Repeatedly writes queued frames into a timeshift ring (until that ring is closed).
+            @param[in]    pWriter    The ring and queue to write from.
+        **/
+        virtual void            WriteTimeshiftFrames (TimeshiftWriter * pWriter);
+
     //    Protected Class Methods
     protected:
 
@@ -172,14 +402,67 @@ class NTV2Capture
         **/
         static void             ProducerThreadStatic (AJAThread * pThread, void * pContext);
 
+        /**
+            @brief    This is the recorder thread's static callback function, which calls RecordFrames.
+            @param[in]    pThread        Points to the AJAThread instance.
+            @param[in]    pContext    Points to the NTV2Capture instance.
+        **/
+        static void             RecorderThreadStatic (AJAThread * pThread, void * pContext);
+
+        /**
+            @brief    This is a timeshift writer thread's static callback function, which calls WriteTimeshiftFrames.
+            @param[in]    pThread        Points to the AJAThread instance.
+            @param[in]    pContext    Points to the TimeshiftWriter the thread writes for.
+        **/
+        static void             TimeshiftThreadStatic (AJAThread * pThread, void * pContext);
+
+#if AJA_HAS_DMA_BUFFER_LOCK
+        /**
+            @brief    Lock or unlock one of my video buffers for DMA, so the driver doesn't pin and map it on every transfer.
+                      These are the VideoBufferPool's DMA lock callbacks, with pContext pointing to the NTV2Capture instance.
+        **/
+        static bool             DmaLockBufferStatic (void * pContext, uint8_t * pBuffer, uint32_t bufferSize);
+        static void             DmaUnlockBufferStatic (void * pContext, uint8_t * pBuffer, uint32_t bufferSize);
+#endif
+
         /**
             @brief    log the buffer status
         **/
         virtual void            LogBufferState(ULWord cardBufferFreeSlots);
 
+        /**
+            @brief    Apply my thread policy to the calling thread.
+            @param[in]    inIsCaptureThread    True for the capture thread, which gets the real time priority and reports what took effect.
+        **/
+        virtual void            ApplyThreadPolicy(const bool inIsCaptureThread);
+
+        /**
+            @brief    Advance the audio timeline by the samples in a newly captured frame, and record its position and cadence slot.
+            @param[in,out]    captureData    The captured frame, with fAudioBufferSize set to the number of bytes transferred.
+        **/
+        virtual void            UpdateAudioTimeline(CaptureFrame * captureData);
+
+        /**
+            @brief    Reconfigure the frame store, buffers and AutoCirculate for a new input format, in place. Called on the capture thread.
+            @param[in]    inNewFormat    The format now being received.
+        **/
+        virtual void            ChangeVideoFormat(const NTV2VideoFormat inNewFormat);
+
+        /**
+            @brief    Parse the packets out of a newly captured frame's anc buffers into its fAncPackets, keeping those the anc filter passes.
+            @param[in,out]    captureData    The captured frame.
+            @param[in]        inputXfer      The transfer that filled it, which knows how much anc was captured.
+        **/
+        virtual void            ParseAncPackets(CaptureFrame * captureData, const AUTOCIRCULATE_TRANSFER & inputXfer);
+
+        /**
+            @brief    Stops a timeshift writer's thread, lets go of the frames it still holds, and deletes it with its ring.
+        **/
+        virtual void            CloseTimeshift (TimeshiftWriter * pWriter);
+
     //    Private Member Data
     private:
-        typedef    AJACircularBuffer <AVDataBuffer *>    MyCircularBuffer;
+        typedef    streampunk::Aja::FrameQueue <CaptureFrame *>    MyCircularBuffer;
 
         AJAThread *                  mProducerThread;                         ///< @brief    My producer thread object -- does the frame capturing
         AJALock *                    mLock;                                   ///< @brief    Global mutex to avoid device frame buffer allocation race condition
@@ -187,22 +470,59 @@ class NTV2Capture
         const std::string            mDeviceSpecifier;                        ///< @brief    The device specifier string
         const NTV2Channel            mInputChannel;                           ///< @brief    My input channel
         NTV2InputSource              mInputSource;                            ///< @brief    The input source I'm using
+        AJALock                      mFormatLock;                             ///< @brief    Guards my video format and buffer size, which change on the capture thread
         NTV2VideoFormat              mVideoFormat;                            ///< @brief    My video format
         NTV2FrameBufferFormat        mPixelFormat;                            ///< @brief    My pixel format
         NTV2FormatDescriptor         mFormatDesc;
         NTV2EveryFrameTaskMode       mSavedTaskMode;                          ///< @brief    Used to restore prior every-frame task mode
         NTV2AudioSystem              mAudioSystem;                            ///< @brief    The audio system I'm using (if any)
+        uint32_t                     mNumAudioChannels;                       ///< @brief    Number of audio channels captured from the audio system
         bool                         mDoLevelConversion;                      ///< @brief    Demonstrates a level A to level B conversion
-        bool                         mGlobalQuit;                             ///< @brief    Set "true" to gracefully stop
+        bool                         mDoMultiFormat;                          ///< @brief    Sharing the device with captures on other channels?
+        std::atomic<bool>            mGlobalQuit;                             ///< @brief    Set "true" to gracefully stop
         bool                         mWithAnc;                                ///< @brief    Capture custom anc data?
+        streampunk::Aja::AncFilter   mAncFilter;                              ///< @brief    Which anc packets to keep
+        AJAAncillaryList             mAncList;                                ///< @brief    Parses each field's anc, on the capture thread
         uint32_t                     mVideoBufferSize;                        ///< @brief    My video buffer size, in bytes
+        uint64_t                     mFrameSequence;                          ///< @brief    Sequence number for the next captured frame
+        uint64_t                     mHardwareSequence;                       ///< @brief    Hardware sequence number for the next frame, if none are dropped
+        std::atomic<uint64_t>        mNextTakenSequence;                      ///< @brief    Hardware sequence expected in the next frame taken, if none are lost
+        uint64_t                     mAudioSamplePosition;                    ///< @brief    Audio samples captured so far
+        uint32_t                     mAudioCadenceSlot;                       ///< @brief    Cadence slot expected for the next frame
+        uint32_t                     mAudioCadenceRun;                        ///< @brief    Consecutive frames that have matched the expected cadence
                                      
-        AVDataBuffer                 mAVHostBuffer [CIRCULAR_BUFFER_SIZE];    ///< @brief    My host buffers
+        const uint32_t               mHostBufferCount;                        ///< @brief    Number of frames in my host ring buffer
+        const uint32_t               mDeviceBufferCount;                      ///< @brief    Number of frames AutoCirculate uses on the device
+        const bool                   mHugePages;                              ///< @brief    Allocate video buffers on large pages?
+        std::vector<CaptureFrame>    mAVHostBuffer;                           ///< @brief    My host buffers, and then the spare that drop-newest captures into
         MyCircularBuffer             mAVCircularBuffer;                       ///< @brief    My ring buffer object
+        streampunk::Aja::VideoBufferPool * mVideoBufferPool;                  ///< @brief    Where my video buffers come from, and go back to
                                      
         void *                       mFrameArrivedCallbackContext;
         FrameArrivedCallback *       mFrameArrivedCallback;
+        void *                       mAudioCapturedCallbackContext;
+        AudioCapturedCallback *      mAudioCapturedCallback;
+        void *                       mFormatChangedCallbackContext;
+        FormatChangedCallback *      mFormatChangedCallback;
         bool                         mFrameLocked;
+
+        AJAThread *                  mRecorderThread;                         ///< @brief    My recorder thread object -- writes frames to disk
+        std::atomic<bool>            mRecording;                              ///< @brief    True while frames go to the recorder rather than LockNextFrame
+        std::atomic<bool>            mRecorderQuit;                           ///< @brief    Set "true" to stop recording
+        AJAEvent                     mRecordFrameEvent;                       ///< @brief    Signalled when a frame is captured for the recorder
+        streampunk::Aja::EssenceWriter mEssenceWriter;                        ///< @brief    Writes the recording, on the recorder thread only
+        AJALock                      mRecorderLock;                           ///< @brief    Guards the recording status below
+        uint64_t                     mRecordedFrames;
+        uint64_t                     mRecordedBytes;
+        std::string                  mRecordingError;
+
+        AJALock                      mTimeshiftLock;                          ///< @brief    Guards the timeshift writer pointer
+        TimeshiftWriter *            mTimeshift;                              ///< @brief    Keeps the most recent frames on disk, or NULL
+        streampunk::Aja::DriverCallStats mDriverCalls;                        ///< @brief    Counts the capture thread's calls into the driver
+        streampunk::Aja::ThreadPolicy mThreadPolicy;                          ///< @brief    The CPUs, priority and NUMA node asked for
+        streampunk::Aja::ThreadPolicy mEffectiveThreadPolicy;                 ///< @brief    What the capture thread actually got
+        bool                         mThreadPolicyApplied;
+        AJALock                      mThreadPolicyLock;                       ///< @brief    Guards the effective thread policy
         AjaDevice::Ref               mDeviceRef;
         const AjaDevice::InitParams* mInitParams;
 };    //    NTV2Capture
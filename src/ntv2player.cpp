@@ -69,10 +69,14 @@ static const uint32_t    AUDIOBYTES_MAX_96K    (401 * 1024);
 **/
 static const ULWord        kAppSignature    (AJA_FOURCC ('S','T','P','K'));
 
-const unsigned int ON_DEVICE_BUFFER_SIZE(7);/// Number of device buffers to allocate
-const unsigned int TOTAL_BUFFER_SIZE(ON_DEVICE_BUFFER_SIZE + CIRCULAR_BUFFER_SIZE);/// Number of device buffers to allocate
-const unsigned int TARGET_FILL_LEVEL(TOTAL_BUFFER_SIZE / 2);
 const unsigned int BUFFER_PRE_FILL_MARGIN(2);
+const uint32_t DRIVER_CALLS_PER_FRAME(3);/// A vertical interrupt wait, a status query and a transfer
+
+
+static uint32_t ClampBufferCount (uint32_t count, uint32_t maxCount)
+{
+    return count < AjaDevice::MIN_BUFFERS ? AjaDevice::MIN_BUFFERS : (count > maxCount ? maxCount : count);
+}
 
 /*
 #include <iostream>
@@ -132,7 +136,10 @@ NTV2Player::NTV2Player (const AjaDevice::InitParams* initParams,
                         const bool                   inEnableVanc,
                         const bool                   inLevelConversion,
                         const bool                   inDoMultiChannel,
-                        const AJAAncillaryDataType   inSendHDRType)
+                        const AJAAncillaryDataType   inSendHDRType,
+                        const uint32_t               inHostBufferCount,
+                        const uint32_t               inDeviceBufferCount,
+                        const bool                   inHugePages)
 
 :       mConsumerThread              (NULL),
         mProducerThread              (NULL),
@@ -148,6 +155,8 @@ NTV2Player::NTV2Player (const AjaDevice::InitParams* initParams,
         mPixelFormat                 (inPixelFormat),
         mSavedTaskMode               (NTV2_DISABLE_TASKS),
         mAudioSystem                 (NTV2_AUDIOSYSTEM_1),
+        mNumAudioChannels            (0),
+        mNonPcmPairs                 (0),
         mVancMode                    (NTV2_VANCMODE_OFF),
         mWithAudio                   (inWithAudio),
         mEnableVanc                  (inEnableVanc),
@@ -157,6 +166,11 @@ NTV2Player::NTV2Player (const AjaDevice::InitParams* initParams,
         mAudioBufferSize             (0),
         mTestPatternVideoBuffers     (NULL),
         mNumTestPatterns             (0),
+        mHostBufferCount             (ClampBufferCount (inHostBufferCount, AjaDevice::MAX_HOST_BUFFERS)),
+        mDeviceBufferCount           (ClampBufferCount (inDeviceBufferCount, AjaDevice::MAX_DEVICE_BUFFERS)),
+        mHugePages                   (inHugePages),
+        mAVHostBuffer                (mHostBufferCount),
+        mVideoBufferPool             (NULL),
         mCallbackUserData            (NULL),
         mCallback                    (NULL),
         mScheduleFrameCallbackContext(NULL),
@@ -165,9 +179,10 @@ NTV2Player::NTV2Player (const AjaDevice::InitParams* initParams,
         mInitParams                  (initParams),
         mEnableTestPatternFill       (false),
         mOutputStarted               (false),
-        mBufferedFrames              (0)
+        mBufferedFrames              (0),
+        mDriverCalls                 (DRIVER_CALLS_PER_FRAME),
+        mThreadPolicyApplied         (false)
 {
-    ::memset (mAVHostBuffer, 0, sizeof (mAVHostBuffer));
 }
 
 
@@ -191,11 +206,11 @@ NTV2Player::~NTV2Player (void)
         mNumTestPatterns = 0;
     }
 
-    for (unsigned int ndx = 0;  ndx < CIRCULAR_BUFFER_SIZE;  ndx++)
+    for (unsigned int ndx = 0;  ndx < mHostBufferCount;  ndx++)
     {
         if (mAVHostBuffer [ndx].fVideoBuffer)
         {
-            delete [] mAVHostBuffer [ndx].fVideoBuffer;
+            mVideoBufferPool->Release (reinterpret_cast <uint8_t *> (mAVHostBuffer [ndx].fVideoBuffer));
             mAVHostBuffer [ndx].fVideoBuffer = NULL;
         }
         if (mAVHostBuffer [ndx].fAudioBuffer)
@@ -204,6 +219,13 @@ NTV2Player::~NTV2Player (void)
             mAVHostBuffer [ndx].fAudioBuffer = NULL;
         }
     }    //    for each buffer in the ring
+
+    //    Unlock the video buffers for DMA while the device is still open...
+    if (mVideoBufferPool)
+    {
+        mVideoBufferPool->Close ();
+        mVideoBufferPool = NULL;
+    }
 }    //    destructor
 
 
@@ -347,6 +369,7 @@ AJAStatus NTV2Player::SetUpAudio ()
     if (!::NTV2DeviceCanDoFrameStore1Display (mDeviceID))
         mAudioSystem = NTV2_AUDIOSYSTEM_1;
 
+    mNumAudioChannels = numberOfAudioChannels;
     mDeviceRef->SetNumberAudioChannels(numberOfAudioChannels, mAudioSystem);
     mDeviceRef->SetAudioRate(NTV2_AUDIO_48K, mAudioSystem);
 
@@ -363,11 +386,35 @@ AJAStatus NTV2Player::SetUpAudio ()
     //    is present in whatever signal is feeding the device's SDI input...
     mDeviceRef->SetAudioLoopBack(NTV2_AUDIO_LOOPBACK_OFF, mAudioSystem);
 
+    //    Start with every channel pair flagged as PCM, until the client says otherwise...
+    mDeviceRef->SetAudioPCMControl(mAudioSystem, false);
+    mNonPcmPairs = 0;
+
     return AJA_STATUS_SUCCESS;
 
 }    //    SetUpAudio
 
 
+void NTV2Player::SetNonPcmPairs(uint32_t nonPcmPairs)
+{
+    if (!mWithAudio || nonPcmPairs == mNonPcmPairs)
+        return;
+
+    //    Only touch the pairs that have changed. The channel status flag is a register setting, so it changes
+    //    as soon as it is written rather than with the frame that carries the new audio...
+    for (uint32_t pair = 0; pair < mNumAudioChannels / 2; pair++)
+    {
+        const uint32_t pairBit = 1 << pair;
+
+        if ((nonPcmPairs ^ mNonPcmPairs) & pairBit)
+            mDeviceRef->SetAudioPCMControl(mAudioSystem, static_cast<NTV2AudioChannelPair>(pair), (nonPcmPairs & pairBit) != 0);
+    }
+
+    mNonPcmPairs = nonPcmPairs;
+
+}    //    SetNonPcmPairs
+
+
 void NTV2Player::SetUpHostBuffers ()
 {
     //    Let my circular buffer know when it's time to quit...
@@ -382,10 +429,15 @@ void NTV2Player::SetUpHostBuffers ()
     mDeviceRef->GetAudioRate(audioRate, mAudioSystem);
     mAudioBufferSize = (audioRate == NTV2_AUDIO_96K) ? AUDIOBYTES_MAX_96K : AUDIOBYTES_MAX_48K;
 
-    //    Allocate my buffers...
-    for (size_t ndx = 0; ndx < CIRCULAR_BUFFER_SIZE; ndx++)
+    //    Allocate my buffers, with the video page aligned and, where the SDK can, locked for DMA once, up front, rather than by the driver on every transfer...
+    mVideoBufferPool = streampunk::Aja::VideoBufferPool::Create (mVideoBufferSize, mHostBufferCount, mHostBufferCount, mHugePages, mThreadPolicy.numaNode);
+#if AJA_HAS_DMA_BUFFER_LOCK
+    mVideoBufferPool->SetDmaLockCallbacks (this, DmaLockBufferStatic, DmaUnlockBufferStatic);
+#endif
+
+    for (size_t ndx = 0; ndx < mHostBufferCount; ndx++)
     {
-        mAVHostBuffer [ndx].fVideoBuffer        = reinterpret_cast <uint32_t *> (new uint8_t [mVideoBufferSize]);
+        mAVHostBuffer [ndx].fVideoBuffer        = reinterpret_cast <uint32_t *> (mVideoBufferPool->Acquire ());
         mAVHostBuffer [ndx].fVideoBufferSize    = mVideoBufferSize;
         mAVHostBuffer [ndx].fAudioBuffer        = mWithAudio ? reinterpret_cast <uint32_t *> (new uint8_t [mAudioBufferSize]) : NULL;
         mAVHostBuffer [ndx].fAudioBufferSize    = mWithAudio ? mAudioBufferSize : 0;
@@ -453,7 +505,7 @@ void NTV2Player::RouteOutputSignal ()
 
 void NTV2Player::SetUpOutputAutoCirculate ()
 {
-    const uint32_t    buffersPerChannel (ON_DEVICE_BUFFER_SIZE);        //    Sufficient and safe for all devices & FBFs
+    const uint32_t    buffersPerChannel (mDeviceBufferCount);
 
     mDeviceRef->AutoCirculateStop(mOutputChannel);
     {
@@ -501,7 +553,10 @@ void NTV2Player::ConsumerThreadStatic (AJAThread * pThread, void * pContext)
     //    then call its PlayFrames method...
     NTV2Player *    pApp    (reinterpret_cast <NTV2Player *> (pContext));
     if (pApp)
+    {
+        pApp->ApplyThreadPolicy (true);
         pApp->PlayFrames ();
+    }
 
 }    //    ConsumerThreadStatic
 
@@ -536,10 +591,17 @@ void NTV2Player::PlayFrames (void)
     default:    break;
     }
 
+    //    Each pass round the loop is one frame: a wait for the output vertical interrupt, one status query, and a
+    //    transfer into each slot the status says is free, keeping one spare. Once the card's buffer is full that's
+    //    just the one slot the last vertical interrupt freed...
     while (!mGlobalQuit)
     {
+        mDeviceRef->WaitForOutputVerticalInterrupt(mOutputChannel);
+        mDriverCalls.Count (streampunk::Aja::DriverCall_VbiWait);
+
         AUTOCIRCULATE_STATUS    outputStatus;
         mDeviceRef->AutoCirculateGetStatus(mOutputChannel, outputStatus);
+        mDriverCalls.Count (streampunk::Aja::DriverCall_Status);
 
         ULWord numAvailableFrames = outputStatus.GetNumAvailableOutputFrames();
 
@@ -548,10 +610,14 @@ void NTV2Player::PlayFrames (void)
         {
             LogBufferState(numAvailableFrames);
 
-            //    Wait for the next frame to become ready to "consume"...
-            AVDataBuffer *    playData    (mAVCircularBuffer.StartConsumeNextBuffer ());
-            if (playData)
+            //    ...and fill it, without querying the status again between transfers
+            while (numAvailableFrames > 1 && !mGlobalQuit)
             {
+                //    Wait for the next frame to become ready to "consume"...
+                AVDataBuffer *    playData    (mAVCircularBuffer.StartConsumeNextBuffer ());
+                if (!playData)
+                    break;
+
                 //    Include timecode in output signal...
                 mOutputXferInfo.SetOutputTimeCode (NTV2_RP188 (playData->fRP188Data), ::NTV2ChannelToTimecodeIndex (mOutputChannel));
 
@@ -565,6 +631,7 @@ void NTV2Player::PlayFrames (void)
                 mOutputXferInfo.SetAudioBuffer (mWithAudio ? playData->fAudioBuffer : NULL, mWithAudio ? playData->fAudioBufferSize : 0);
                 mOutputXferInfo.SetAncBuffers(fAncBuffer, NTV2_ANCSIZE_MAX, NULL, 0);
                 mDeviceRef->AutoCirculateTransfer(mOutputChannel, mOutputXferInfo);
+                mDriverCalls.Count (streampunk::Aja::DriverCall_Transfer);
                 mAVCircularBuffer.EndConsumeNextBuffer ();    //    Signal that the frame has been "consumed"
 
                 LOG_BUFFER_STATE("Just added to card, requesting next frame");
@@ -573,10 +640,8 @@ void NTV2Player::PlayFrames (void)
                 --numAvailableFrames;
             }
         }
-        else
-        {
-            mDeviceRef->WaitForOutputVerticalInterrupt(mOutputChannel);
-        }
+
+        mDriverCalls.EndPass ();
 
         if (mScheduleFrameCallback)
         {
@@ -602,16 +667,32 @@ void NTV2Player::PlayFrames (void)
 }    //    PlayFrames
 
 
+#if AJA_HAS_DMA_BUFFER_LOCK
+bool NTV2Player::DmaLockBufferStatic (void * pContext, uint8_t * pBuffer, uint32_t bufferSize)    //    static
+{
+    NTV2Player *    pApp    (reinterpret_cast <NTV2Player *> (pContext));
+    return pApp->mDeviceRef->DMABufferLock (reinterpret_cast <ULWord *> (pBuffer), bufferSize, true);
+}
+
+
+void NTV2Player::DmaUnlockBufferStatic (void * pContext, uint8_t * pBuffer, uint32_t bufferSize)    //    static
+{
+    NTV2Player *    pApp    (reinterpret_cast <NTV2Player *> (pContext));
+    pApp->mDeviceRef->DMABufferUnlock (reinterpret_cast <ULWord *> (pBuffer), bufferSize);
+}
+#endif    //    AJA_HAS_DMA_BUFFER_LOCK
+
+
 void NTV2Player::LogBufferState(ULWord cardBufferFreeSlots)
 {
-    auto cardBufferUsedSlots = ON_DEVICE_BUFFER_SIZE - cardBufferFreeSlots;
+    auto cardBufferUsedSlots = mDeviceBufferCount - cardBufferFreeSlots;
     auto circBufferUsedSlots = mAVCircularBuffer.GetCircBufferCount();
 
     // Store the total number of used buffer slots to return from the producer thread
     SetUsedBuffers(cardBufferUsedSlots + circBufferUsedSlots);
 
-    float usedCircBufferPercent = (float)(circBufferUsedSlots * 100) / (float)CIRCULAR_BUFFER_SIZE;
-    float userCardBufferPercent = (float)(cardBufferUsedSlots * 100) / (float)ON_DEVICE_BUFFER_SIZE;
+    float usedCircBufferPercent = (float)(circBufferUsedSlots * 100) / (float)mHostBufferCount;
+    float userCardBufferPercent = (float)(cardBufferUsedSlots * 100) / (float)mDeviceBufferCount;
 
     BufferStatus::AddSample(BufferStatus::PlaybackCircBuffer, usedCircBufferPercent);
     BufferStatus::AddSample(BufferStatus::PlaybackCardBuffer, userCardBufferPercent);
@@ -625,7 +706,7 @@ bool NTV2Player::CheckOutputReady()
     if(mOutputStarted == false)
     {
         // If we're nearly full, start the output flowing
-        if((CIRCULAR_BUFFER_SIZE - mAVCircularBuffer.GetCircBufferCount()) < BUFFER_PRE_FILL_MARGIN)
+        if((mHostBufferCount - mAVCircularBuffer.GetCircBufferCount()) < BUFFER_PRE_FILL_MARGIN)
         {
             mDeviceRef->AutoCirculateStart(mOutputChannel);    //    Start it running
             mOutputStarted = true;
@@ -636,6 +717,42 @@ bool NTV2Player::CheckOutputReady()
 }
 
 
+void NTV2Player::ApplyThreadPolicy(const bool inIsPlayoutThread)
+{
+    streampunk::Aja::ThreadPolicy    effective;
+    streampunk::Aja::ApplyThreadPolicy (mThreadPolicy, inIsPlayoutThread, effective);
+
+    if (inIsPlayoutThread)
+    {
+        AJAAutoLock    policyLock (&mThreadPolicyLock);
+        mEffectiveThreadPolicy = effective;
+        mThreadPolicyApplied = true;
+    }
+}
+
+
+void NTV2Player::SetThreadPolicy (const streampunk::Aja::ThreadPolicy & inPolicy)
+{
+    assert (!mVideoBufferPool);
+    mThreadPolicy = inPolicy;
+}
+
+
+bool NTV2Player::GetThreadPolicy (streampunk::Aja::ThreadPolicy & outPolicy)
+{
+    {
+        AJAAutoLock    policyLock (&mThreadPolicyLock);
+        if (!mThreadPolicyApplied)
+            return false;
+        outPolicy = mEffectiveThreadPolicy;
+    }
+
+    //    The pool gives up on the node if the OS won't place a buffer there, so ask it where they went
+    outPolicy.numaNode = mVideoBufferPool ? mVideoBufferPool->GetNumaNode () : streampunk::Aja::ThreadPolicy::ANY_NUMA_NODE;
+    return true;
+}
+
+
 //////////////////////////////////////////////
 //    This is where the producer thread starts
 
@@ -656,7 +773,10 @@ void NTV2Player::ProducerThreadStatic (AJAThread * pThread, void * pContext)
 
     NTV2Player *    pApp    (reinterpret_cast <NTV2Player *> (pContext));
     if (pApp)
+    {
+        pApp->ApplyThreadPolicy (false);
         pApp->ProduceFrames ();
+    }
 
 }    //    ProducerThreadStatic
 
@@ -742,6 +862,33 @@ static const double    gAmplitudes []    =    {    0.10, 0.15,        0.20, 0.25
                                             0.85, 0.80,        0.75, 0.70,        0.65, 0.60,        0.55, 0.50,        0.45, 0.40,        0.35, 0.30,        0.25, 0.20,        0.15, 0.10};
 
 
+namespace
+{
+    struct AudioCopy
+    {
+        const char* data;
+        size_t length;
+    };
+
+    uint32_t CopyAudio(void* context, uint32_t* audioBuffer, uint32_t audioBufferSize)
+    {
+        const AudioCopy* audio = static_cast<const AudioCopy*>(context);
+
+        if (audio->data == nullptr)
+        {
+            return 0;
+        }
+
+        // TODO: for the time being, blindly copy mis-matched frame data - potentially handle this differently
+        uint32_t copyBytes = min(static_cast<uint32_t>(audio->length), audioBufferSize);
+
+        ::memcpy(audioBuffer, audio->data, copyBytes);
+
+        return copyBytes;
+    }
+}
+
+
 /**
 @brief    Add a frame to the frame buffer, to be played out in its turn.
 @param[in]    videoData            pointer to the video frame to queue.
@@ -756,6 +903,31 @@ bool NTV2Player::ScheduleFrame(
     const char* audioData,
     const size_t audioDataLength,
     uint32_t* usedFrames)
+{
+    AudioCopy audio = { audioData, audioDataLength };
+
+    return ScheduleFrame(videoData, videoDataLength, CopyAudio, &audio, usedFrames);
+}
+
+
+/**
+@brief    Add a frame to the frame buffer, with the audio written in place by a callback rather than copied.
+@param[in]    videoData            pointer to the video frame to queue.
+@param[in]    videoDataLength      length of the video data in bytes.
+@param[in]    audioWriter          called with the frame's host audio buffer, returning the number of bytes it wrote.
+@param[in]    audioWriterContext   passed through to the audio writer.
+@param[out]   usedFrames          If not null, receives the number of buffered frames.
+@param[in]    validator           If not null, decides whether the copied frame is queued or given back.
+@param[in]    validatorContext    passed through to the validator.
+**/
+bool NTV2Player::ScheduleFrame(
+    const char* videoData,
+    const size_t videoDataLength,
+    AudioWriterCallback* audioWriter,
+    void* audioWriterContext,
+    uint32_t* usedFrames,
+    FrameValidatorCallback* validator,
+    void* validatorContext)
 {
     bool addedFrame = false;
 
@@ -783,16 +955,10 @@ bool NTV2Player::ScheduleFrame(
             frameData->fVideoBufferSize = 0;
         }
 
-        //DumpAudioInfo(mDeviceSpecifier, "Transferring to circular buffer: ", mWithAudio, (uint32_t*)audioData, audioDataLength);
-
-        if (audioDataLength > 0 && audioData != nullptr)
+        if (mWithAudio && frameData->fAudioBuffer != nullptr && audioWriter != nullptr)
         {
-            // TODO: for the time being, blindly copy mis-matched frame data - potentially handle this differently
-            uint32_t copyBytes = min(static_cast<uint32_t>(audioDataLength), mAudioBufferSize);
-
-            //    Copy my pre-made test pattern into my video buffer...
-            ::memcpy(frameData->fAudioBuffer, audioData, copyBytes);
-            frameData->fAudioBufferSize = static_cast<uint32_t>(audioDataLength);
+            // The writer fills the host buffer directly - it always has the full allocated size available
+            frameData->fAudioBufferSize = audioWriter(audioWriterContext, frameData->fAudioBuffer, mAudioBufferSize);
         }
         else
         {
@@ -800,10 +966,18 @@ bool NTV2Player::ScheduleFrame(
         }
         // TODO: Copy other buffers
 
-        //    Signal that I'm done producing the buffer -- it's now available for playout...
-        mAVCircularBuffer.EndProduceNextBuffer();
+        if (validator != nullptr && !validator(validatorContext))
+        {
+            //    The source was overwritten under the copy, so the buffer goes back unplayed...
+            mAVCircularBuffer.AbandonProduceNextBuffer();
+        }
+        else
+        {
+            //    Signal that I'm done producing the buffer -- it's now available for playout...
+            mAVCircularBuffer.EndProduceNextBuffer();
 
-        addedFrame = true;
+            addedFrame = true;
+        }
     }
 #ifdef DEBUG_OUTPUT
     else
@@ -903,6 +1077,18 @@ void NTV2Player::GetACStatus (ULWord & outGoodFrames, ULWord & outDroppedFrames,
 }
 
 
+void NTV2Player::GetDriverCallSummary (streampunk::Aja::DriverCallSummary & outSummary) const
+{
+    mDriverCalls.GetSummary (outSummary);
+}
+
+
+void NTV2Player::ResetDriverCallStats (void)
+{
+    mDriverCalls.Reset ();
+}
+
+
 uint32_t NTV2Player::AddTone (ULWord * pInAudioBuffer)
 {
     NTV2FrameRate    frameRate    (NTV2_FRAMERATE_INVALID);
@@ -994,7 +1180,7 @@ void NTV2Player::LogBufferState(const char* location)
     mDevice.AutoCirculateGetStatus(mOutputChannel, outputStatus);
 
     ULWord numCardBufferFrames         = outputStatus.GetNumAvailableOutputFrames();
-    unsigned int numCircBufferFrames = CIRCULAR_BUFFER_SIZE - mAVCircularBuffer.GetCircBufferCount();
+    unsigned int numCircBufferFrames = mHostBufferCount - mAVCircularBuffer.GetCircBufferCount();
 
     std::printf("%s: CardBufferFree = %d; CircBufferFree = %d\n", location, numCardBufferFrames, numCircBufferFrames);
     //std::cout << location << ": CardBufferFree = " << numCardBufferFrames << "; CircBufferFree = " << numCircBufferFrames << std::endl;
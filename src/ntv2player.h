@@ -26,23 +26,27 @@ limitations under the License.
 #define _NTV2PLAYER_H
 
 #include <atomic>
+#include <vector>
 #include "ntv2enums.h"
 #include "ntv2devicefeatures.h"
 #include "ntv2devicescanner.h"
 #include "ntv2democommon.h"
-#include "ajabase/common/circularbuffer.h"
 #include "ajabase/system/thread.h"
 #include "ajaanc/includes/ancillarydata.h"
 #include "ajaanc/includes/ancillarydata_hdr_sdr.h"
 #include "ajaanc/includes/ancillarydata_hdr_hdr10.h"
 #include "ajaanc/includes/ancillarydata_hdr_hlg.h"
 #include "AjaDevice.h"
+#include "DriverCallStats.h"
+#include "FrameQueue.h"
+#include "ThreadPolicy.h"
+#include "VideoBufferPool.h"
 
 //#define DEBUG_OUTPUT
 
 /**
     @brief    I am an object that can play out a test pattern (with timecode) to an output of an AJA device
-            with or without audio tone in real time. I make use of the AJACircularBuffer, which simplifies
+            with or without audio tone in real time. I make use of a FrameQueue, which simplifies
             implementing a producer/consumer model, in which a "producer" thread generates the test pattern
             frames, and a "consumer" thread (i.e., the "play" thread) sends those frames to the AJA device.
             I demonstrate how to embed timecode into an SDI output signal using AutoCirculate during playout.
@@ -58,6 +62,8 @@ class NTV2Player
         **/
         typedef AJAStatus(NTV2PlayerCallback)(void * pInstance, const AVDataBuffer * const playData);
         typedef void(ScheduledFrameCallback)(void * pInstance);
+        typedef uint32_t(AudioWriterCallback)(void * pInstance, uint32_t * audioBuffer, uint32_t audioBufferSize);
+        typedef bool(FrameValidatorCallback)(void * pInstance);
 
     //    Public Instance Methods
     public:
@@ -75,6 +81,9 @@ class NTV2Player
             @param[in]    inWithVanc           If true, enable VANC; otherwise disable VANC. Defaults to false.
             @param[in]    inLevelConversion    If true, demonstrate level A to B conversion; otherwise don't. Defaults to false.
             @param[in]    inDoMultiFormat      If true, use multi-format mode; otherwise use uniformat mode. Defaults to false (uniformat mode).
+            @param[in]    inHostBufferCount    Specifies the number of frames in my host ring buffer. Defaults to CIRCULAR_BUFFER_SIZE.
+            @param[in]    inDeviceBufferCount  Specifies the number of frames AutoCirculate plays out from on the device. Defaults to 7.
+            @param[in]    inHugePages          If true, allocate my video buffers on large pages where the OS allows it. Defaults to false.
         **/
                                 NTV2Player (const AjaDevice::InitParams* initParams,
                                             const std::string &          inDeviceSpecifier    = "0",
@@ -86,7 +95,10 @@ class NTV2Player
                                             const bool                   inWithVanc           = false,
                                             const bool                   inLevelConversion    = false,
                                             const bool                   inDoMultiFormat      = false,
-                                            const AJAAncillaryDataType   inSendHDRType        = AJAAncillaryDataType_Unknown);
+                                            const AJAAncillaryDataType   inSendHDRType        = AJAAncillaryDataType_Unknown,
+                                            const uint32_t               inHostBufferCount    = CIRCULAR_BUFFER_SIZE,
+                                            const uint32_t               inDeviceBufferCount  = AjaDevice::DEFAULT_DEVICE_BUFFERS,
+                                            const bool                   inHugePages          = false);
 
         virtual                    ~NTV2Player (void);
 
@@ -119,6 +131,30 @@ class NTV2Player
         **/
         virtual void            GetACStatus (ULWord & outGoodFrames, ULWord & outDroppedFrames, ULWord & outBufferLevel);
 
+        /**
+            @brief    Sets the CPUs, priority and NUMA node for my threads and buffers. Must be called before Init.
+            @param[in]    inPolicy    The policy. My playout thread also gets its real time priority; the producer thread just the CPUs.
+        **/
+        virtual void            SetThreadPolicy (const streampunk::Aja::ThreadPolicy & inPolicy);
+
+        /**
+            @brief    Provides the thread policy actually in effect, once my playout thread is running.
+            @param[out]    outPolicy    Receives the CPUs and priority the OS allowed, and the NUMA node my buffers are on.
+            @return    False if my playout thread hasn't started yet.
+        **/
+        virtual bool            GetThreadPolicy (streampunk::Aja::ThreadPolicy & outPolicy);
+
+        /**
+            @brief    Provides the counts of driver calls my playout thread has made, pass by pass, since they were last reset.
+            @param[out]    outSummary    Receives the counts, and how many passes went over the budget of calls for a frame.
+        **/
+        virtual void            GetDriverCallSummary (streampunk::Aja::DriverCallSummary & outSummary) const;
+
+        /**
+            @brief    Zeroes the driver call counts.
+        **/
+        virtual void            ResetDriverCallStats (void);
+
         /**
             @brief    Returns the current callback function for requesting frames to be played.
         **/
@@ -149,6 +185,38 @@ class NTV2Player
             const size_t audioDataLength,
             uint32_t*    usedFrames = nullptr);
 
+        /**
+        @brief    Add a frame to the frame buffer, with the audio written in place by a callback rather than copied.
+        @param[in]    videoData            pointer to the video frame to queue.
+        @param[in]    videoDataLength      length of the video data in bytes.
+        @param[in]    audioWriter          called with the frame's host audio buffer, returning the number of bytes it wrote.
+        @param[in]    audioWriterContext   passed through to the audio writer.
+        @param[out]   usedFrames           If not null, receives the number of buffered frames.
+        @param[in]    validator            If not null, called once the video and audio are in the host buffer. If it returns
+                                           false, the source changed while it was being copied, and the frame is not queued.
+        @param[in]    validatorContext     passed through to the validator.
+        @return       True if the frame was queued.
+        **/
+        virtual bool ScheduleFrame(
+            const char* videoData,
+            const size_t videoDataLength,
+            AudioWriterCallback* audioWriter,
+            void* audioWriterContext,
+            uint32_t*    usedFrames = nullptr,
+            FrameValidatorCallback* validator = nullptr,
+            void* validatorContext = nullptr);
+
+        /**
+            @brief    Return the number of interleaved audio channels expected in each scheduled audio buffer.
+        **/
+        virtual uint32_t GetNumAudioChannels() const { return mNumAudioChannels; }
+
+        /**
+            @brief    Flag audio channel pairs as carrying non-PCM data, such as Dolby E, in the output AES channel status.
+            @param[in]    nonPcmPairs    Bit N set if audio channels 2N and 2N+1 are non-PCM.
+        **/
+        virtual void SetNonPcmPairs(uint32_t nonPcmPairs);
+
         //    Protected Instance Methods
     protected:
         /**
@@ -230,6 +298,12 @@ class NTV2Player
         **/
         virtual bool            CheckOutputReady();
 
+        /**
+            @brief    Apply my thread policy to the calling thread.
+            @param[in]    inIsPlayoutThread    True for the playout thread, which gets the real time priority and reports what took effect.
+        **/
+        virtual void            ApplyThreadPolicy(const bool inIsPlayoutThread);
+
         /**
             @brief    Get/Set the Used Buffers counter atomically
         **/
@@ -263,6 +337,15 @@ class NTV2Player
         **/
         static void                ProducerThreadStatic (AJAThread * pThread, void * pContext);
 
+#if AJA_HAS_DMA_BUFFER_LOCK
+        /**
+            @brief    Lock or unlock one of my video buffers for DMA, so the driver doesn't pin and map it on every transfer.
+                      These are the VideoBufferPool's DMA lock callbacks, with pContext pointing to the NTV2Player instance.
+        **/
+        static bool                DmaLockBufferStatic (void * pContext, uint8_t * pBuffer, uint32_t bufferSize);
+        static void                DmaUnlockBufferStatic (void * pContext, uint8_t * pBuffer, uint32_t bufferSize);
+#endif
+
         /**
             @brief        Returns the RP188 DBB register number to use for the given NTV2OutputDestination.
             @param[in]    inOutputSource    Specifies the NTV2OutputDestination of interest.
@@ -272,7 +355,7 @@ class NTV2Player
 
     //    Private Member Data
     private:
-        typedef AJACircularBuffer <AVDataBuffer *>        MyCirculateBuffer;
+        typedef streampunk::Aja::FrameQueue <AVDataBuffer *>    MyCirculateBuffer;
 
         AJAThread *                  mConsumerThread;                       ///< @brief    My playout (consumer) thread object
         AJAThread *                  mProducerThread;                       ///< @brief    My generator (producer) thread object
@@ -290,10 +373,12 @@ class NTV2Player
         NTV2FrameBufferFormat        mPixelFormat;                          ///< @brief    My pixel format
         NTV2EveryFrameTaskMode       mSavedTaskMode;                        ///< @brief    Used to restore the prior task mode
         NTV2AudioSystem              mAudioSystem;                          ///< @brief    The audio system I'm using
+        uint32_t                     mNumAudioChannels;                     ///< @brief    Number of audio channels played out by the audio system
+        uint32_t                     mNonPcmPairs;                          ///< @brief    Audio channel pairs currently flagged as non-PCM, bit N for channels 2N and 2N+1
         NTV2VANCMode                 mVancMode;                             ///< @brief    VANC mode
         const bool                   mWithAudio;                            ///< @brief    Playout audio?
         bool                         mEnableVanc;                           ///< @brief    Enable VANC?
-        bool                         mGlobalQuit;                           ///< @brief    Set "true" to gracefully stop
+        std::atomic<bool>            mGlobalQuit;                           ///< @brief    Set "true" to gracefully stop
         bool                         mDoLevelConversion;                    ///< @brief    Demonstrates a level A to level B conversion
         AJATimeCodeBurn              mTCBurner;                             ///< @brief    My timecode burner
         uint32_t                     mVideoBufferSize;                      ///< @brief    My video buffer size, in bytes
@@ -302,7 +387,11 @@ class NTV2Player
         uint8_t **                   mTestPatternVideoBuffers;              ///< @brief    My test pattern buffers
         int32_t                      mNumTestPatterns;                      ///< @brief    Number of test patterns to cycle through
 
-        AVDataBuffer                 mAVHostBuffer [CIRCULAR_BUFFER_SIZE];  ///< @brief    My host buffers
+        const uint32_t               mHostBufferCount;                      ///< @brief    Number of frames in my host ring buffer
+        const uint32_t               mDeviceBufferCount;                    ///< @brief    Number of frames AutoCirculate uses on the device
+        const bool                   mHugePages;                            ///< @brief    Allocate video buffers on large pages?
+        std::vector<AVDataBuffer>    mAVHostBuffer;                         ///< @brief    My host buffers
+        streampunk::Aja::VideoBufferPool * mVideoBufferPool;                ///< @brief    Page aligned, DMA locked memory for my video buffers
         MyCirculateBuffer            mAVCircularBuffer;                     ///< @brief    My ring buffer
 
         void *                       mCallbackUserData;                     ///< @brief    User data to be passed to the callback function
@@ -316,6 +405,11 @@ class NTV2Player
         bool                         mEnableTestPatternFill;
         bool                         mOutputStarted;
         std::atomic<uint32_t>        mBufferedFrames;
+        streampunk::Aja::DriverCallStats mDriverCalls;                      ///< @brief    Counts the playout thread's calls into the driver
+        streampunk::Aja::ThreadPolicy mThreadPolicy;                        ///< @brief    The CPUs, priority and NUMA node asked for
+        streampunk::Aja::ThreadPolicy mEffectiveThreadPolicy;               ///< @brief    What the playout thread actually got
+        bool                         mThreadPolicyApplied;
+        AJALock                      mThreadPolicyLock;                     ///< @brief    Guards the effective thread policy
 
 };    //    NTV2Player
 
@@ -25,4 +25,63 @@ void _outputTrace(std::string message)
     cout << message << endl;
 }
 
-#endif
\ No newline at end of file
+#endif
+
+
+namespace streampunk {
+
+Aja::ThreadPolicy parseThreadPolicy(v8::Local<v8::Object> options) {
+  Aja::ThreadPolicy policy;
+  v8::Local<v8::Value> cpusValue = Nan::Get(options, Nan::New("cpus").ToLocalChecked()).ToLocalChecked();
+  v8::Local<v8::Value> realtimeValue = Nan::Get(options, Nan::New("realtime").ToLocalChecked()).ToLocalChecked();
+  v8::Local<v8::Value> numaNodeValue = Nan::Get(options, Nan::New("numaNode").ToLocalChecked()).ToLocalChecked();
+
+  if (cpusValue->IsArray()) {
+    v8::Local<v8::Array> cpuArray = v8::Local<v8::Array>::Cast(cpusValue);
+    for (uint32_t i = 0; i < cpuArray->Length(); i++) {
+      uint32_t cpu = Nan::To<uint32_t>(Nan::Get(cpuArray, i).ToLocalChecked()).FromJust();
+      if (cpu < 64)
+        policy.cpuMask |= static_cast<uint64_t>(1) << cpu;
+    }
+  }
+  if (realtimeValue->IsBoolean())
+    policy.realtime = Nan::To<bool>(realtimeValue).FromJust();
+  if (numaNodeValue->IsNumber())
+    policy.numaNode = Nan::To<int32_t>(numaNodeValue).FromJust();
+
+  return policy;
+}
+
+
+v8::Local<v8::Object> makeThreadPolicy(const Aja::ThreadPolicy& policy) {
+  v8::Local<v8::Array> cpus = Nan::New<v8::Array>();
+  for (uint32_t cpu = 0; cpu < 64; cpu++) {
+    if (policy.cpuMask & (static_cast<uint64_t>(1) << cpu))
+      Nan::Set(cpus, cpus->Length(), Nan::New<v8::Uint32>(cpu));
+  }
+
+  v8::Local<v8::Object> result = Nan::New<v8::Object>();
+  Nan::Set(result, Nan::New("cpus").ToLocalChecked(), cpus);
+  Nan::Set(result, Nan::New("realtime").ToLocalChecked(), Nan::New<v8::Boolean>(policy.realtime));
+  Nan::Set(result, Nan::New("numaNode").ToLocalChecked(), Nan::New<v8::Int32>(policy.numaNode));
+
+  return result;
+}
+
+
+v8::Local<v8::Object> makeDriverCallSummary(const Aja::DriverCallSummary& summary) {
+  v8::Local<v8::Object> result = Nan::New<v8::Object>();
+  Nan::Set(result, Nan::New("passes").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(summary.passes)));
+  Nan::Set(result, Nan::New("vbiWaits").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(summary.calls[Aja::DriverCall_VbiWait])));
+  Nan::Set(result, Nan::New("statusQueries").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(summary.calls[Aja::DriverCall_Status])));
+  Nan::Set(result, Nan::New("transfers").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(summary.calls[Aja::DriverCall_Transfer])));
+  Nan::Set(result, Nan::New("other").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(summary.calls[Aja::DriverCall_Other])));
+  Nan::Set(result, Nan::New("meanPerPass").ToLocalChecked(), Nan::New<v8::Number>(summary.meanPerPass));
+  Nan::Set(result, Nan::New("maxPerPass").ToLocalChecked(), Nan::New<v8::Uint32>(summary.maxPerPass));
+  Nan::Set(result, Nan::New("budget").ToLocalChecked(), Nan::New<v8::Uint32>(summary.budget));
+  Nan::Set(result, Nan::New("overBudget").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(summary.overBudget)));
+
+  return result;
+}
+
+}
@@ -23,4 +23,19 @@
 void _outputTrace(std::string message);
 #else
 #define TRACE_LOG(message) 0
-#endif
\ No newline at end of file
+#endif
+
+#include <nan.h>
+#include "DriverCallStats.h"
+#include "ThreadPolicy.h"
+
+namespace streampunk {
+
+// Convert between { cpus, realtime, numaNode } and a thread policy; CPUs from 64 up can't be in the mask, and are ignored
+Aja::ThreadPolicy parseThreadPolicy(v8::Local<v8::Object> options);
+v8::Local<v8::Object> makeThreadPolicy(const Aja::ThreadPolicy& policy);
+
+// A capture or playout thread's calls into the driver, as { passes, vbiWaits, statusQueries, transfers, ... }
+v8::Local<v8::Object> makeDriverCallSummary(const Aja::DriverCallSummary& summary);
+
+}
@@ -66,5 +66,30 @@ namespace AjatationTest
             Assert::AreEqual((int)AjaDevice::GetRefCount(defaultDeviceId), 0);
         }
 
+        TEST_METHOD(TestMultiChannelSharing)
+        {
+            {
+                // One capture per channel, all sharing the device
+                AjaDevice::Ref channelRefs[4];
+
+                for (int channel = 0; channel < 4; channel++)
+                {
+                    auto result = channelRefs[channel].Initialize(defaultDeviceId, &MULTICHANNEL_INIT_PARAMS);
+
+                    Assert::AreEqual((int)AJA_STATUS_SUCCESS, (int)result);
+                    Assert::AreEqual(channel + 2, (int)AjaDevice::GetRefCount(defaultDeviceId));
+                }
+
+                // A single channel user can't join in
+                AjaDevice::Ref singleRef;
+                auto singleResult = singleRef.Initialize(defaultDeviceId, &DEFAULT_INIT_PARAMS);
+
+                Assert::AreEqual((int)AJA_STATUS_BAD_PARAM, (int)singleResult);
+                Assert::AreEqual(5, (int)AjaDevice::GetRefCount(defaultDeviceId));
+            }
+
+            Assert::AreEqual((int)AjaDevice::GetRefCount(defaultDeviceId), 0);
+        }
+
     };
 }
\ No newline at end of file
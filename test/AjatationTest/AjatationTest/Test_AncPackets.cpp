@@ -0,0 +1,170 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <cstring>
+#include <string>
+#include <vector>
+#include "AncPackets.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace streampunk::Aja;
+
+namespace AjatationTest
+{
+    TEST_CLASS(Test_AncPackets)
+    {
+    public:
+
+        TEST_METHOD(TestClassify)
+        {
+            Assert::AreEqual(static_cast<int>(AncPacketType_Cea708), static_cast<int>(ClassifyAncPacket(0x61, 0x01)));
+            Assert::AreEqual(static_cast<int>(AncPacketType_Cea608), static_cast<int>(ClassifyAncPacket(0x61, 0x02)));
+            Assert::AreEqual(static_cast<int>(AncPacketType_Afd), static_cast<int>(ClassifyAncPacket(0x41, 0x05)));
+            Assert::AreEqual(static_cast<int>(AncPacketType_Scte104), static_cast<int>(ClassifyAncPacket(0x41, 0x07)));
+            Assert::AreEqual(static_cast<int>(AncPacketType_Unknown), static_cast<int>(ClassifyAncPacket(0x50, 0x01)));
+            Assert::AreEqual(std::string("cea708"), std::string(GetAncPacketTypeName(AncPacketType_Cea708)));
+            Assert::AreEqual(std::string("unknown"), std::string(GetAncPacketTypeName(AncPacketType_LAST)));
+        }
+
+        TEST_METHOD(TestFilter)
+        {
+            AncFilter filter;
+            Assert::IsTrue(filter.Accepts(0x41, 0x07), L"An empty filter should keep everything");
+
+            std::vector<uint16_t> didSdids;
+            didSdids.push_back(0x6101);
+            didSdids.push_back(0x4105);
+            filter.Set(didSdids);
+
+            Assert::IsTrue(filter.Accepts(0x61, 0x01));
+            Assert::IsTrue(filter.Accepts(0x41, 0x05));
+            Assert::IsFalse(filter.Accepts(0x41, 0x07));
+            Assert::IsFalse(filter.Accepts(0x61, 0x02));
+        }
+
+        TEST_METHOD(TestPacketsArePacked)
+        {
+            AncPacketList packets;
+            packets.Reserve();
+
+            const uint8_t afd[] = { 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+            const uint8_t cdp[] = { 0x96, 0x69, 0x10, 0x4f };
+
+            Assert::IsTrue(packets.Add(0x41, 0x05, 1, 11, afd, sizeof(afd)));
+            Assert::IsTrue(packets.Add(0x61, 0x01, 2, 574, cdp, sizeof(cdp)));
+            Assert::AreEqual(2u, packets.GetCount());
+
+            const AncPacket& second = packets.GetPacket(1);
+            Assert::AreEqual(static_cast<int>(AncPacketType_Cea708), static_cast<int>(second.type));
+            Assert::AreEqual(2, static_cast<int>(second.field));
+            Assert::AreEqual(574, static_cast<int>(second.line));
+            Assert::AreEqual(static_cast<int>(sizeof(cdp)), static_cast<int>(second.payloadSize));
+            Assert::IsTrue(memcmp(packets.GetPayload(second), cdp, sizeof(cdp)) == 0);
+            Assert::IsTrue(memcmp(packets.GetPayload(packets.GetPacket(0)), afd, sizeof(afd)) == 0);
+
+            packets.Clear();
+            Assert::AreEqual(0u, packets.GetCount());
+        }
+
+        TEST_METHOD(TestDecodeCea608)
+        {
+            // Field 1, line 21, "Hi" with odd parity on the H
+            const uint8_t payload[] = { 0x80, 0xC8, 0x69 };
+            Cea608Data cc;
+
+            Assert::IsTrue(DecodeCea608(payload, sizeof(payload), cc));
+            Assert::AreEqual(1, static_cast<int>(cc.field));
+            Assert::AreEqual(0, static_cast<int>(cc.lineOffset));
+            Assert::AreEqual(static_cast<int>('H'), static_cast<int>(cc.data[0]));
+            Assert::AreEqual(static_cast<int>('i'), static_cast<int>(cc.data[1]));
+            Assert::IsFalse(cc.parityOk, L"0x69 has even parity");
+
+            const uint8_t field2[] = { 0x03, 0x80, 0x80 };
+            Assert::IsTrue(DecodeCea608(field2, sizeof(field2), cc));
+            Assert::AreEqual(2, static_cast<int>(cc.field));
+            Assert::AreEqual(3, static_cast<int>(cc.lineOffset));
+            Assert::IsTrue(cc.parityOk);
+
+            Assert::IsFalse(DecodeCea608(payload, 2, cc));
+        }
+
+        TEST_METHOD(TestDecodeCea708)
+        {
+            // A 29.97 CDP with cc data for both 608 fields and one DTVCC pair, then the footer
+            const uint8_t cdp[] = { 0x96, 0x69, 0x16, 0x4F, 0x43, 0x12, 0x34,
+                                    0x72, 0xE3,
+                                    0xFC, 0x94, 0x20,
+                                    0xFD, 0x80, 0x80,
+                                    0xFF, 0x02, 0x21,
+                                    0x74, 0x12, 0x34, 0x00 };
+            Cea708Data captions;
+
+            Assert::IsTrue(DecodeCea708(cdp, sizeof(cdp), captions));
+            Assert::AreEqual(4, static_cast<int>(captions.frameRate));
+            Assert::AreEqual(0x1234, static_cast<int>(captions.sequence));
+            Assert::AreEqual(3u, captions.ccCount);
+            Assert::IsTrue(captions.cc[0].valid);
+            Assert::AreEqual(0, static_cast<int>(captions.cc[0].type));
+            Assert::AreEqual(0x94, static_cast<int>(captions.cc[0].data[0]));
+            Assert::AreEqual(1, static_cast<int>(captions.cc[1].type));
+            Assert::AreEqual(3, static_cast<int>(captions.cc[2].type));
+            Assert::AreEqual(0x21, static_cast<int>(captions.cc[2].data[1]));
+
+            // A cc count running past the end of the packet is refused
+            uint8_t truncated[sizeof(cdp)];
+            memcpy(truncated, cdp, sizeof(cdp));
+            truncated[8] = 0xE8;
+            Assert::IsFalse(DecodeCea708(truncated, sizeof(truncated), captions));
+
+            truncated[0] = 0x00;
+            Assert::IsFalse(DecodeCea708(truncated, sizeof(truncated), captions), L"Not a CDP");
+        }
+
+        TEST_METHOD(TestDecodeAfd)
+        {
+            // AFD 9 (4:3 pillarboxed) in a 16:9 frame, with left and right bars
+            const uint8_t payload[] = { 0x4C, 0x00, 0x00, 0x30, 0x00, 0xF0, 0x06, 0x90 };
+            AfdData afd;
+
+            Assert::IsTrue(DecodeAfd(payload, sizeof(payload), afd));
+            Assert::AreEqual(9, static_cast<int>(afd.afd));
+            Assert::IsTrue(afd.wide);
+            Assert::AreEqual(static_cast<int>(AfdData::BAR_LEFT | AfdData::BAR_RIGHT), static_cast<int>(afd.barFlags));
+            Assert::AreEqual(240, static_cast<int>(afd.bar1));
+            Assert::AreEqual(1680, static_cast<int>(afd.bar2));
+
+            Assert::IsFalse(DecodeAfd(payload, 4, afd));
+        }
+
+        TEST_METHOD(TestFullListDropsPackets)
+        {
+            AncPacketList packets;
+            packets.Reserve();
+
+            const uint8_t payload[255] = {};
+
+            for (uint32_t packet = 0; packet < AncPacketList::MAX_PACKETS + 3; packet++)
+                packets.Add(0x41, 0x07, 1, 9, payload, sizeof(payload));
+
+            // The payload space runs out before the packet count does
+            const uint32_t fitted = AncPacketList::MAX_PAYLOAD_BYTES / sizeof(payload);
+            Assert::AreEqual(fitted, packets.GetCount());
+            Assert::AreEqual(AncPacketList::MAX_PACKETS + 3 - fitted, packets.GetDropped());
+        }
+    };
+}
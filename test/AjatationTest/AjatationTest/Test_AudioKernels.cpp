@@ -0,0 +1,154 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <vector>
+#include <random>
+#include <cmath>
+#include "AudioKernels.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace streampunk::Aja;
+
+namespace AjatationTest
+{
+    TEST_CLASS(Test_AudioKernels)
+    {
+    public:
+
+        TEST_METHOD(TestLevelKernelsMatchScalar)
+        {
+            const uint32_t channelCounts[] = { 2, 4, 6, 8, 16 };
+            const uint32_t sampleCounts[] = { 0, 1, 7, 1601, 1602, 2002 };
+            std::mt19937 rng(4242);
+
+            for (auto numChannels : channelCounts)
+            {
+                for (auto numSamples : sampleCounts)
+                {
+                    std::vector<uint32_t> input(numSamples * numChannels);
+                    for (auto& sample : input)
+                        sample = rng() & 0xFFFFFF00;
+
+                    // Make sure full scale samples of both signs turn up
+                    if (input.size() > 2)
+                    {
+                        input[0] = 0x7FFFFF00;
+                        input[input.size() - 1] = 0x80000000;
+                    }
+
+                    AudioLevels expected;
+                    MeasureAudioLevels(reinterpret_cast<const uint8_t*>(input.data()), numChannels, numSamples, AudioKernelIsa_Scalar, expected);
+
+                    for (uint32_t isa = AudioKernelIsa_SSSE3; isa < AudioKernelIsa_LAST; isa++)
+                    {
+                        if (!IsAudioKernelIsaSupported(static_cast<AudioKernelIsa>(isa)))
+                            continue;
+
+                        AudioLevels actual;
+                        MeasureAudioLevels(reinterpret_cast<const uint8_t*>(input.data()), numChannels, numSamples, static_cast<AudioKernelIsa>(isa), actual);
+
+                        Assert::AreEqual(expected.numChannels, actual.numChannels);
+                        Assert::IsTrue(memcmp(&expected, &actual, sizeof(AudioLevels)) == 0, L"Level kernel differs from the scalar loop");
+                    }
+                }
+            }
+        }
+
+        TEST_METHOD(TestFirKernelsMatchScalar)
+        {
+            const uint32_t numTaps = 40;
+            const uint32_t outputCounts[] = { 0, 1, 3, 4, 7, 8, 15, 16, 17, 801, 1602 };
+            std::mt19937 rng(8080);
+            std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+            std::vector<float> coeffs(numTaps);
+            for (auto& coeff : coeffs)
+                coeff = uniform(rng) * 0.1f;
+
+            for (auto numOutputs : outputCounts)
+            {
+                std::vector<float> input(numOutputs + numTaps - 1);
+                for (auto& sample : input)
+                    sample = uniform(rng);
+
+                std::vector<float> expected(numOutputs + 1, 0.0f);
+                FilterFir(input.data(), coeffs.data(), numTaps, numOutputs, expected.data(), AudioKernelIsa_Scalar);
+
+                for (uint32_t isa = AudioKernelIsa_SSSE3; isa < AudioKernelIsa_LAST; isa++)
+                {
+                    if (!IsAudioKernelIsaSupported(static_cast<AudioKernelIsa>(isa)))
+                        continue;
+
+                    // One spare output, which must not be written
+                    std::vector<float> actual(numOutputs + 1, 0.0f);
+                    FilterFir(input.data(), coeffs.data(), numTaps, numOutputs, actual.data(), static_cast<AudioKernelIsa>(isa));
+
+                    Assert::IsTrue(memcmp(expected.data(), actual.data(), actual.size() * sizeof(float)) == 0, L"FIR kernel differs from the scalar loop");
+                }
+            }
+        }
+
+        TEST_METHOD(TestLevelsOfKnownSignals)
+        {
+            const uint32_t numChannels = 16;
+            const uint32_t numSamples = 1920;
+            std::vector<int32_t> input(numSamples * numChannels, 0);
+
+            for (uint32_t sampleIdx = 0; sampleIdx < numSamples; sampleIdx++)
+            {
+                int32_t* frame = &input[sampleIdx * numChannels];
+
+                // Channel 0: full scale square wave, clipping on every sample
+                frame[0] = (sampleIdx & 1) ? 0x7FFFFF00 : static_cast<int32_t>(0x80000000);
+                // Channel 1: half scale DC
+                frame[1] = 0x400000 * 256;
+                // Channel 2: full scale sine, 1kHz at 48kHz
+                frame[2] = static_cast<int32_t>(std::lround(8388607.0 * std::sin(2.0 * 3.14159265358979323846 * 1000.0 * sampleIdx / 48000.0))) * 256;
+                // Channel 3 onwards: silence
+            }
+
+            for (uint32_t isa = AudioKernelIsa_Scalar; isa < AudioKernelIsa_LAST; isa++)
+            {
+                if (!IsAudioKernelIsaSupported(static_cast<AudioKernelIsa>(isa)))
+                    continue;
+
+                AudioLevels levels;
+                MeasureAudioLevels(reinterpret_cast<const uint8_t*>(input.data()), numChannels, numSamples, static_cast<AudioKernelIsa>(isa), levels);
+
+                Assert::AreEqual(numChannels, levels.numChannels);
+
+                Assert::AreEqual(1.0f, levels.peak[0], 1e-6f);
+                Assert::AreEqual(1.0f, levels.rms[0], 1e-6f);
+                Assert::AreEqual(numSamples, levels.clipCount[0]);
+
+                Assert::AreEqual(0.5f, levels.peak[1], 1e-6f);
+                Assert::AreEqual(0.5f, levels.rms[1], 1e-6f);
+                Assert::AreEqual(0u, levels.clipCount[1]);
+
+                Assert::AreEqual(1.0f, levels.peak[2], 1e-6f);
+                Assert::AreEqual(static_cast<float>(1.0 / std::sqrt(2.0)), levels.rms[2], 1e-5f);
+
+                for (uint32_t channel = 3; channel < numChannels; channel++)
+                {
+                    Assert::AreEqual(0.0f, levels.peak[channel]);
+                    Assert::AreEqual(0.0f, levels.rms[channel]);
+                    Assert::AreEqual(0u, levels.clipCount[channel]);
+                }
+            }
+        }
+    };
+}
@@ -0,0 +1,228 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <vector>
+#include <random>
+#include <cmath>
+#include <memory>
+#include "AudioResampler.h"
+#include "AudioTransform.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace streampunk::Aja;
+
+namespace AjatationTest
+{
+    const double RESAMPLER_PI = 3.14159265358979323846;
+
+    TEST_CLASS(Test_AudioResampler)
+    {
+    public:
+
+        TEST_METHOD(TestSineAccuracy)
+        {
+            const double frequencies[] = { 100.0, 1000.0, 10000.0, 18000.0 };
+
+            for (auto frequency : frequencies)
+            {
+                Assert::IsTrue(maxSineError(AudioResampler::Mode_Upsample2x, frequency) < -100.0, L"Upsampled sine is not accurate");
+                Assert::IsTrue(maxSineError(AudioResampler::Mode_Downsample2x, frequency) < -100.0, L"Downsampled sine is not accurate");
+            }
+
+            // Anything above 24kHz must not alias back into the 48kHz output
+            const uint32_t numSamples = 9600;
+            std::vector<float> input(numSamples);
+            for (uint32_t n = 0; n < numSamples; n++)
+                input[n] = static_cast<float>(sin(2.0 * RESAMPLER_PI * 30000.0 * n / 96000.0));
+
+            AudioResampler resampler;
+            Assert::IsTrue(resampler.Configure(AudioResampler::Mode_Downsample2x, 1));
+
+            std::vector<float> output(resampler.GetMaxOutputSamples(numSamples));
+            const uint32_t numOutputs = resampler.Process(input.data(), numSamples, output.data(), GetBestAudioKernelIsa());
+
+            for (uint32_t n = AudioResampler::BRANCH_TAPS; n < numOutputs; n++)
+                Assert::IsTrue(fabs(output[n]) < 1e-5f, L"30kHz aliased into the 48kHz output");
+        }
+
+        TEST_METHOD(TestFramesMatchOneShot)
+        {
+            const uint32_t numChannels = 3;
+            const uint32_t numSamples = 5001;
+            std::mt19937 rng(31337);
+            std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+            std::vector<float> input(numSamples * numChannels);
+            for (auto& sample : input)
+                sample = uniform(rng);
+
+            const AudioResampler::Mode modes[] = { AudioResampler::Mode_Upsample2x, AudioResampler::Mode_Downsample2x };
+
+            for (auto mode : modes)
+            {
+                AudioResampler oneShot;
+                Assert::IsTrue(oneShot.Configure(mode, numChannels));
+
+                std::vector<float> expected(oneShot.GetMaxOutputSamples(numSamples) * numChannels);
+                const uint32_t expectedSamples = oneShot.Process(input.data(), numSamples, expected.data(), AudioKernelIsa_Scalar);
+
+                for (uint32_t isa = AudioKernelIsa_Scalar; isa < AudioKernelIsa_LAST; isa++)
+                {
+                    if (!IsAudioKernelIsaSupported(static_cast<AudioKernelIsa>(isa)))
+                        continue;
+
+                    // Odd sized frames, including empty ones, so the downsampler has to carry a sample over
+                    AudioResampler framed;
+                    Assert::IsTrue(framed.Configure(mode, numChannels));
+
+                    std::vector<float> actual(expected.size() + numChannels);
+                    uint32_t position(0), actualSamples(0);
+
+                    while (position < numSamples)
+                    {
+                        const uint32_t frameSamples = std::min<uint32_t>(numSamples - position, rng() % 700);
+                        const uint32_t maxOutputs = framed.GetMaxOutputSamples(frameSamples);
+                        const uint32_t outputs = framed.Process(&input[position * numChannels], frameSamples, &actual[actualSamples * numChannels], static_cast<AudioKernelIsa>(isa));
+
+                        Assert::AreEqual(maxOutputs, outputs);
+                        position += frameSamples;
+                        actualSamples += outputs;
+                    }
+
+                    Assert::AreEqual(expectedSamples, actualSamples);
+                    Assert::IsTrue(memcmp(expected.data(), actual.data(), expectedSamples * numChannels * sizeof(float)) == 0,
+                                   L"Resampling in frames differs from resampling in one piece");
+                }
+            }
+        }
+
+        TEST_METHOD(TestTransformAt96k)
+        {
+            const uint32_t cardChannels = 16;
+            const uint32_t numSamples = 1602;
+            const std::vector<uint32_t> channelMap = { 4, 5 };
+
+            // A 1kHz tone on card channels 4 and 5, at half scale
+            std::vector<uint32_t> cardAudio(numSamples * cardChannels, 0);
+            for (uint32_t n = 0; n < numSamples; n++)
+            {
+                const int32_t sample = static_cast<int32_t>(floor(4194304.0 * sin(2.0 * RESAMPLER_PI * 1000.0 * n / 48000.0) + 0.5));
+                cardAudio[n * cardChannels + 4] = static_cast<uint32_t>(sample) << 8;
+                cardAudio[n * cardChannels + 5] = static_cast<uint32_t>(-sample) << 8;
+            }
+
+            std::unique_ptr<AudioTransform> capture(new AudioTransform);
+            Assert::IsTrue(capture->SetFromCardFormat(cardChannels, channelMap, AudioSampleType_F32));
+            Assert::IsFalse(capture->SetFromCardSampleRate(44100));
+            Assert::IsTrue(capture->SetFromCardSampleRate(96000));
+
+            const uint32_t inputSize = static_cast<uint32_t>(cardAudio.size() * sizeof(uint32_t));
+            const uint32_t outputSize = capture->GetFromCardOutputSize(inputSize);
+            Assert::AreEqual(numSamples * 2 * 2 * 4, outputSize);
+
+            std::vector<float> clientAudio(outputSize / sizeof(float));
+            Assert::AreEqual(outputSize, capture->TransformFromCard(reinterpret_cast<const char*>(cardAudio.data()), inputSize,
+                                                                   reinterpret_cast<char*>(clientAudio.data()), outputSize));
+
+            // Past the filter's start up, the output is the tone at 96kHz, 39 samples late
+            for (uint32_t n = 2 * AudioResampler::BRANCH_TAPS; n < numSamples * 2; n++)
+            {
+                const float expected = static_cast<float>(0.5 * sin(2.0 * RESAMPLER_PI * 1000.0 * (n - 39.0) / 96000.0));
+                Assert::AreEqual(expected, clientAudio[n * 2], 1e-5f);
+                Assert::AreEqual(-expected, clientAudio[n * 2 + 1], 1e-5f);
+            }
+
+            // Playing 96kHz audio back downsamples it to whole card frames, with the unrouted channels silent
+            std::unique_ptr<AudioTransform> playback(new AudioTransform);
+            Assert::IsTrue(playback->SetToCardChannelMap(cardChannels, { 4, 5 }));
+            Assert::IsTrue(playback->SetToCardSampleRate(96000));
+
+            // The same tone at 96kHz, as packed 24 bit big-endian client samples
+            std::vector<uint8_t> packed(numSamples * 2 * 2 * 3);
+            for (uint32_t n = 0; n < numSamples * 2; n++)
+            {
+                const int32_t sample = static_cast<int32_t>(floor(4194304.0 * sin(2.0 * RESAMPLER_PI * 1000.0 * n / 96000.0) + 0.5));
+
+                for (uint32_t channel = 0; channel < 2; channel++)
+                {
+                    const uint32_t word = static_cast<uint32_t>(channel == 0 ? sample : -sample);
+                    uint8_t* clientSample = &packed[(n * 2 + channel) * 3];
+
+                    clientSample[0] = static_cast<uint8_t>(word >> 16);
+                    clientSample[1] = static_cast<uint8_t>(word >> 8);
+                    clientSample[2] = static_cast<uint8_t>(word);
+                }
+            }
+
+            std::vector<uint32_t> played(playback->GetToCardOutputSize(static_cast<uint32_t>(packed.size())) / sizeof(uint32_t), 0xAAAAAAAA);
+            Assert::AreEqual(numSamples * cardChannels, static_cast<uint32_t>(played.size()));
+
+            const uint32_t playedSize = playback->TransformToCard(reinterpret_cast<const char*>(packed.data()), static_cast<uint32_t>(packed.size()),
+                                                                  reinterpret_cast<char*>(played.data()), static_cast<uint32_t>(played.size() * sizeof(uint32_t)));
+            Assert::AreEqual(static_cast<uint32_t>(played.size() * sizeof(uint32_t)), playedSize);
+
+            // Back at 48kHz, 19.5 samples late, to within the float precision of the filter (a few 24 bit steps)
+            for (uint32_t n = AudioResampler::BRANCH_TAPS; n < numSamples; n++)
+            {
+                const double expected = 4194304.0 * sin(2.0 * RESAMPLER_PI * 1000.0 * (n - 19.5) / 48000.0);
+
+                for (uint32_t channel = 0; channel < cardChannels; channel++)
+                {
+                    const int32_t actual = static_cast<int32_t>(played[n * cardChannels + channel]) / 256;
+
+                    if (channel == 4)
+                        Assert::AreEqual(expected, static_cast<double>(actual), 8.0);
+                    else if (channel == 5)
+                        Assert::AreEqual(-expected, static_cast<double>(actual), 8.0);
+                    else
+                        Assert::AreEqual(0, actual);
+                }
+            }
+        }
+
+    private:
+
+        // The worst error in dB relative to the signal, once the filter has filled, of a half scale sine
+        double maxSineError(AudioResampler::Mode mode, double frequency)
+        {
+            const bool up = mode == AudioResampler::Mode_Upsample2x;
+            const double inputRate = up ? 48000.0 : 96000.0;
+            const double outputRate = up ? 96000.0 : 48000.0;
+            const double delay = up ? 39.0 : 19.5;     // In output samples
+            const uint32_t numSamples = 19200;
+
+            std::vector<float> input(numSamples);
+            for (uint32_t n = 0; n < numSamples; n++)
+                input[n] = static_cast<float>(0.5 * sin(2.0 * RESAMPLER_PI * frequency * n / inputRate));
+
+            AudioResampler resampler;
+            Assert::IsTrue(resampler.Configure(mode, 1));
+
+            std::vector<float> output(resampler.GetMaxOutputSamples(numSamples));
+            const uint32_t numOutputs = resampler.Process(input.data(), numSamples, output.data(), GetBestAudioKernelIsa());
+
+            double maxError(0.0);
+            for (uint32_t n = 2 * AudioResampler::BRANCH_TAPS; n < numOutputs; n++)
+            {
+                const double expected = 0.5 * sin(2.0 * RESAMPLER_PI * frequency * (n - delay) / outputRate);
+                maxError = std::max(maxError, fabs(output[n] - expected));
+            }
+
+            return 20.0 * log10(maxError / 0.5);
+        }
+    };
+}
@@ -0,0 +1,426 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <vector>
+#include <random>
+#include <memory>
+#include "AudioTransform.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace streampunk::Aja;
+
+namespace AjatationTest
+{
+    const uint32_t CARD_CHANNELS = 16;
+    const uint32_t CLIENT_CHANNELS = 2;
+
+    // Sample counts the card delivers per frame across the supported frame rates, plus some awkward edge cases
+    const uint32_t testSampleCounts[] = { 0, 1, 2, 3, 7, 800, 801, 1001, 1601, 1602, 1920, 2002, 3203 };
+
+    TEST_CLASS(Test_AudioTransform)
+    {
+    public:
+
+        TEST_METHOD(TestFromCardKernelsMatchReference)
+        {
+            std::mt19937 rng(12345);
+
+            for (uint32_t isa = AudioKernelIsa_Scalar; isa < AudioKernelIsa_LAST; isa++)
+            {
+                if (!IsAudioKernelIsaSupported(static_cast<AudioKernelIsa>(isa)))
+                {
+                    Logger::WriteMessage((std::string("Skipping unsupported ISA: ") + AudioKernelIsaName(static_cast<AudioKernelIsa>(isa))).c_str());
+                    continue;
+                }
+
+                for (auto numSamples : testSampleCounts)
+                {
+                    std::vector<uint32_t> input(numSamples * CARD_CHANNELS);
+                    for (auto& sample : input)
+                        sample = rng();
+
+                    validateFromCard(static_cast<AudioKernelIsa>(isa), input, numSamples);
+                }
+            }
+        }
+
+        TEST_METHOD(TestFromCardFullScaleSamples)
+        {
+            // Full scale positive and negative samples exercise every bit of the byte swap
+            const uint32_t numSamples = 1602;
+            std::vector<uint32_t> input(numSamples * CARD_CHANNELS);
+
+            for (uint32_t i = 0; i < input.size(); i++)
+                input[i] = (i & 1) ? 0x7FFFFF00 : 0x80000000;
+
+            for (uint32_t isa = AudioKernelIsa_Scalar; isa < AudioKernelIsa_LAST; isa++)
+            {
+                if (IsAudioKernelIsaSupported(static_cast<AudioKernelIsa>(isa)))
+                    validateFromCard(static_cast<AudioKernelIsa>(isa), input, numSamples);
+            }
+        }
+
+        TEST_METHOD(TestFromCardChannelMaps)
+        {
+            // Reordered, repeated, sparse and full width maps all go through the same kernels as the default stereo map
+            const std::vector<std::vector<uint32_t>> channelMaps = {
+                { 5, 2, 9 },
+                { 1, 0 },
+                { 3, 3, 3, 3 },
+                { 15 },
+                { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+                { 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 }
+            };
+
+            std::mt19937 rng(54321);
+
+            for (const auto& channelMap : channelMaps)
+            {
+                for (uint32_t isa = AudioKernelIsa_Scalar; isa < AudioKernelIsa_LAST; isa++)
+                {
+                    if (!IsAudioKernelIsaSupported(static_cast<AudioKernelIsa>(isa)))
+                        continue;
+
+                    for (auto numSamples : testSampleCounts)
+                    {
+                        std::vector<uint32_t> input(numSamples * CARD_CHANNELS);
+                        for (auto& sample : input)
+                            sample = rng();
+
+                        validateFromCard(static_cast<AudioKernelIsa>(isa), input, numSamples, channelMap);
+                    }
+                }
+            }
+        }
+
+        TEST_METHOD(TestInvalidChannelMapsRejected)
+        {
+            std::unique_ptr<AudioTransform> transform(new AudioTransform);
+
+            Assert::IsFalse(transform->SetFromCardChannelMap(CARD_CHANNELS, std::vector<uint32_t>()));
+            Assert::IsFalse(transform->SetFromCardChannelMap(CARD_CHANNELS, { 16 }));
+            Assert::IsFalse(transform->SetFromCardChannelMap(0, { 0 }));
+            Assert::IsFalse(transform->SetToCardChannelMap(CARD_CHANNELS, { 4, 4 }));
+
+            // A rejected map leaves the existing routing in place
+            Assert::AreEqual(CLIENT_CHANNELS, transform->GetFromCardClientChannels());
+            Assert::AreEqual(CLIENT_CHANNELS, transform->GetToCardClientChannels());
+        }
+
+        TEST_METHOD(TestToCardChannelMap)
+        {
+            const uint32_t numSamples = 1602;
+            const std::vector<uint32_t> channelMap = { 7, 0, 12 };
+            const uint32_t clientChannels = static_cast<uint32_t>(channelMap.size());
+
+            std::unique_ptr<AudioTransform> transform(new AudioTransform);
+            Assert::IsTrue(transform->SetToCardChannelMap(CARD_CHANNELS, channelMap));
+
+            std::mt19937 rng(999);
+            std::vector<uint8_t> input(numSamples * clientChannels * 3);
+            for (auto& b : input)
+                b = static_cast<uint8_t>(rng());
+
+            // The destination is a reused host buffer, so start with stale data to check the unrouted channels are silenced
+            const uint32_t expectedSize = transform->GetToCardOutputSize(static_cast<uint32_t>(input.size()));
+            std::vector<char> output(expectedSize, static_cast<char>(0xAA));
+
+            const uint32_t outputSize = transform->TransformToCard(reinterpret_cast<const char*>(input.data()), static_cast<uint32_t>(input.size()),
+                                                                   output.data(), static_cast<uint32_t>(output.size()));
+
+            Assert::AreEqual(numSamples * CARD_CHANNELS * 4, outputSize);
+            Assert::AreEqual(expectedSize, outputSize);
+
+            const uint8_t* card = reinterpret_cast<const uint8_t*>(output.data());
+
+            for (uint32_t sampleIdx = 0; sampleIdx < numSamples; sampleIdx++)
+            {
+                const uint8_t* frame = card + sampleIdx * CARD_CHANNELS * 4;
+                uint32_t expected[CARD_CHANNELS] = { 0 };
+
+                for (uint32_t channel = 0; channel < clientChannels; channel++)
+                {
+                    const uint8_t* clientSample = &input[(sampleIdx * clientChannels + channel) * 3];
+                    expected[channel == 0 ? 7 : channel == 1 ? 0 : 12] = (clientSample[0] << 24) | (clientSample[1] << 16) | (clientSample[2] << 8);
+                }
+
+                for (uint32_t cardChannel = 0; cardChannel < CARD_CHANNELS; cardChannel++)
+                {
+                    const uint8_t* s = frame + cardChannel * 4;
+                    const uint32_t actual = s[0] | (s[1] << 8) | (s[2] << 16) | (static_cast<uint32_t>(s[3]) << 24);
+                    Assert::AreEqual(expected[cardChannel], actual, L"Card sample differs from the routed client sample");
+                }
+            }
+
+            // Capture to card round trip through the same map recovers the client samples
+            std::unique_ptr<AudioTransform> capture(new AudioTransform);
+            Assert::IsTrue(capture->SetFromCardChannelMap(CARD_CHANNELS, channelMap));
+
+            std::vector<char> roundTrip(capture->GetFromCardOutputSize(outputSize));
+            const uint32_t roundTripSize = capture->TransformFromCard(output.data(), outputSize, roundTrip.data(), static_cast<uint32_t>(roundTrip.size()));
+
+            Assert::AreEqual(static_cast<uint32_t>(input.size()), roundTripSize);
+            Assert::IsTrue(memcmp(input.data(), roundTrip.data(), roundTripSize) == 0, L"Round trip through the channel map is not lossless");
+
+            // A destination that is too small takes as many whole frames as fit, and no more
+            std::vector<char> shortOutput(CARD_CHANNELS * 4 * 10 + 7, static_cast<char>(0xAA));
+            const uint32_t shortOutputSize = transform->TransformToCard(reinterpret_cast<const char*>(input.data()), static_cast<uint32_t>(input.size()),
+                                                                        shortOutput.data(), static_cast<uint32_t>(shortOutput.size()));
+
+            Assert::AreEqual(CARD_CHANNELS * 4 * 10, shortOutputSize);
+            Assert::IsTrue(memcmp(output.data(), shortOutput.data(), shortOutputSize) == 0);
+            for (uint32_t i = shortOutputSize; i < shortOutput.size(); i++)
+                Assert::AreEqual(static_cast<char>(0xAA), shortOutput[i]);
+        }
+
+        TEST_METHOD(TestFromCardSampleFormats)
+        {
+            const uint32_t sampleTypes[] = { AudioSampleType_S16, AudioSampleType_S24, AudioSampleType_S32, AudioSampleType_F32 };
+            const std::vector<std::vector<uint32_t>> channelMaps = {
+                { 0, 1 },
+                { 5, 2, 9 },
+                { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 }
+            };
+
+            const uint32_t numSamples = 1602;
+            std::mt19937 rng(2468);
+
+            // Card words only ever carry 24 bits of audio, in the top three bytes
+            std::vector<uint32_t> input(numSamples * CARD_CHANNELS);
+            for (auto& sample : input)
+                sample = rng() & 0xFFFFFF00;
+
+            input[0] = 0x7FFFFF00;
+            input[1] = 0x80000000;
+
+            for (auto baseType : sampleTypes)
+            {
+                for (uint32_t planar = 0; planar < 2; planar++)
+                {
+                    const uint32_t sampleType = baseType | (planar ? AudioSampleType_Planar : 0);
+
+                    for (const auto& channelMap : channelMaps)
+                    {
+                        std::unique_ptr<AudioTransform> transform(new AudioTransform);
+                        transform->SetKernelIsa(AudioKernelIsa_Scalar);
+                        Assert::IsTrue(transform->SetFromCardFormat(CARD_CHANNELS, channelMap, sampleType));
+
+                        const uint32_t inputSize = static_cast<uint32_t>(input.size() * sizeof(uint32_t));
+                        std::vector<char> outputBuffer(transform->GetFromCardOutputSize(inputSize));
+                        const char* output = outputBuffer.data();
+
+                        const uint32_t outputSize = transform->TransformFromCard(reinterpret_cast<const char*>(input.data()), inputSize,
+                                                                                 outputBuffer.data(), static_cast<uint32_t>(outputBuffer.size()));
+
+                        const uint32_t clientChannels = static_cast<uint32_t>(channelMap.size());
+                        Assert::AreEqual(numSamples * clientChannels * bytesPerSample(sampleType), outputSize);
+
+                        for (uint32_t sampleIdx = 0; sampleIdx < numSamples; sampleIdx++)
+                        {
+                            for (uint32_t channel = 0; channel < clientChannels; channel++)
+                            {
+                                const uint32_t cardWord = input[sampleIdx * CARD_CHANNELS + channelMap[channel]];
+                                const uint32_t outIdx = planar ? channel * numSamples + sampleIdx : sampleIdx * clientChannels + channel;
+                                validateSample(baseType, cardWord, reinterpret_cast<const uint8_t*>(output) + outIdx * bytesPerSample(sampleType));
+                            }
+                        }
+
+                        // Interleaved integer formats also have SIMD kernels, which must match the converter
+                        for (uint32_t isa = AudioKernelIsa_SSSE3; isa < AudioKernelIsa_LAST; isa++)
+                        {
+                            if (IsAudioKernelIsaSupported(static_cast<AudioKernelIsa>(isa)))
+                                validateFromCard(static_cast<AudioKernelIsa>(isa), input, numSamples, channelMap, sampleType);
+                        }
+                    }
+                }
+            }
+        }
+
+        TEST_METHOD(TestInvalidSampleTypesRejected)
+        {
+            std::unique_ptr<AudioTransform> transform(new AudioTransform);
+
+            Assert::IsFalse(transform->SetFromCardFormat(CARD_CHANNELS, { 0, 1 }, 8));
+            Assert::IsFalse(transform->SetFromCardFormat(CARD_CHANNELS, { 0, 1 }, AudioSampleType_S16 | 0x400));
+            Assert::AreEqual((uint32_t)AudioSampleType_S24, transform->GetFromCardSampleType());
+        }
+
+        TEST_METHOD(TestNonPcmPairsPassThrough)
+        {
+            const uint32_t sampleTypes[] = { AudioSampleType_S16, AudioSampleType_S24, AudioSampleType_S32, AudioSampleType_F32 };
+            const std::vector<uint32_t> channelMap = { 2, 3, 0, 1, 7 };
+            const uint32_t clientChannels = static_cast<uint32_t>(channelMap.size());
+            const uint32_t nonPcmPairs = 1 << 1;    // Card channels 2 and 3
+            const uint32_t numSamples = 1602;
+            std::mt19937 rng(1357);
+
+            // A bitstream may use every bit of the card word, which no PCM conversion would preserve
+            std::vector<uint32_t> input(numSamples * CARD_CHANNELS);
+            for (uint32_t i = 0; i < input.size(); i++)
+            {
+                const uint32_t cardChannel = i % CARD_CHANNELS;
+                input[i] = (cardChannel == 2 || cardChannel == 3) ? rng() : rng() & 0xFFFFFF00;
+            }
+
+            for (auto baseType : sampleTypes)
+            {
+                for (uint32_t planar = 0; planar < 2; planar++)
+                {
+                    const uint32_t sampleType = baseType | (planar ? AudioSampleType_Planar : 0);
+                    const uint32_t bytes = bytesPerSample(sampleType);
+
+                    for (uint32_t isa = AudioKernelIsa_Scalar; isa < AudioKernelIsa_LAST; isa++)
+                    {
+                        if (!IsAudioKernelIsaSupported(static_cast<AudioKernelIsa>(isa)))
+                            continue;
+
+                        std::unique_ptr<AudioTransform> transform(new AudioTransform);
+                        transform->SetKernelIsa(static_cast<AudioKernelIsa>(isa));
+                        Assert::IsTrue(transform->SetFromCardFormat(CARD_CHANNELS, channelMap, sampleType));
+
+                        const uint32_t inputSize = static_cast<uint32_t>(input.size() * sizeof(uint32_t));
+                        std::vector<uint8_t> output(transform->GetFromCardOutputSize(inputSize));
+                        transform->TransformFromCard(reinterpret_cast<const char*>(input.data()), inputSize,
+                                                     reinterpret_cast<char*>(output.data()), static_cast<uint32_t>(output.size()), nonPcmPairs);
+
+                        for (uint32_t sampleIdx = 0; sampleIdx < numSamples; sampleIdx++)
+                        {
+                            for (uint32_t channel = 0; channel < clientChannels; channel++)
+                            {
+                                const uint32_t cardWord = input[sampleIdx * CARD_CHANNELS + channelMap[channel]];
+                                const uint32_t outIdx = planar ? channel * numSamples + sampleIdx : sampleIdx * clientChannels + channel;
+                                const uint8_t* out = &output[outIdx * bytes];
+
+                                if (channelMap[channel] == 2 || channelMap[channel] == 3)
+                                {
+                                    // The top bytes of the card word, in card order
+                                    const uint8_t* cardBytes = reinterpret_cast<const uint8_t*>(&cardWord);
+                                    Assert::IsTrue(memcmp(cardBytes + 4 - bytes, out, bytes) == 0, L"Non-PCM sample was not passed through");
+                                }
+                                else
+                                {
+                                    validateSample(baseType, cardWord, out);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            // Playback is the inverse: the client bytes go into the top of the card word untouched
+            std::unique_ptr<AudioTransform> transform(new AudioTransform);
+            Assert::IsTrue(transform->SetToCardChannelMap(CARD_CHANNELS, { 2, 3, 0, 1 }));
+
+            std::vector<uint8_t> clientAudio(numSamples * 4 * 3);
+            for (auto& b : clientAudio)
+                b = static_cast<uint8_t>(rng());
+
+            std::vector<uint8_t> card(transform->GetToCardOutputSize(static_cast<uint32_t>(clientAudio.size())));
+            transform->TransformToCard(reinterpret_cast<const char*>(clientAudio.data()), static_cast<uint32_t>(clientAudio.size()),
+                                       reinterpret_cast<char*>(card.data()), static_cast<uint32_t>(card.size()), nonPcmPairs);
+
+            for (uint32_t sampleIdx = 0; sampleIdx < numSamples; sampleIdx++)
+            {
+                const uint8_t* frame = &card[sampleIdx * CARD_CHANNELS * 4];
+                const uint8_t* clientSample = &clientAudio[sampleIdx * 4 * 3];
+
+                // Non-PCM client channel 0 is on card channel 2, PCM client channel 2 on card channel 0
+                Assert::AreEqual(static_cast<uint8_t>(0), frame[2 * 4]);
+                Assert::IsTrue(memcmp(clientSample, frame + 2 * 4 + 1, 3) == 0, L"Non-PCM sample was byte swapped");
+                Assert::AreEqual(clientSample[2 * 3], frame[0 * 4 + 3]);
+                Assert::AreEqual(clientSample[2 * 3 + 2], frame[0 * 4 + 1]);
+            }
+        }
+
+    private:
+
+        void validateSample(uint32_t sampleType, uint32_t cardWord, const uint8_t* out)
+        {
+            switch (sampleType)
+            {
+                case AudioSampleType_S16:
+                    Assert::AreEqual((int)(int16_t)(cardWord >> 16), (int)(int16_t)(out[0] | (out[1] << 8)));
+                    break;
+                case AudioSampleType_S24:
+                    Assert::AreEqual(cardWord >> 8, (uint32_t)((out[0] << 16) | (out[1] << 8) | out[2]));
+                    break;
+                case AudioSampleType_S32:
+                {
+                    uint32_t value;
+                    memcpy(&value, out, sizeof(value));
+                    Assert::AreEqual(cardWord, value);
+                    break;
+                }
+                case AudioSampleType_F32:
+                {
+                    float value;
+                    memcpy(&value, out, sizeof(value));
+                    Assert::AreEqual((double)(int32_t)cardWord / 2147483648.0, (double)value, 1e-7);
+                    Assert::IsTrue(value >= -1.0f && value < 1.0f);
+                    break;
+                }
+            }
+        }
+
+        void validateFromCard(AudioKernelIsa isa, const std::vector<uint32_t>& input, uint32_t numSamples,
+                              const std::vector<uint32_t>& channelMap = std::vector<uint32_t>(),
+                              uint32_t sampleType = AudioSampleType_S24)
+        {
+            std::unique_ptr<AudioTransform> reference(new AudioTransform);
+            std::unique_ptr<AudioTransform> kernel(new AudioTransform);
+
+            kernel->SetKernelIsa(isa);
+            Assert::AreEqual((int)isa, (int)kernel->GetKernelIsa());
+
+            const char* inputBuffer = reinterpret_cast<const char*>(input.data());
+            const uint32_t inputBufferSize = static_cast<uint32_t>(input.size() * sizeof(uint32_t));
+
+            if (!channelMap.empty())
+            {
+                Assert::IsTrue(reference->SetFromCardFormat(CARD_CHANNELS, channelMap, sampleType));
+                Assert::IsTrue(kernel->SetFromCardFormat(CARD_CHANNELS, channelMap, sampleType));
+            }
+
+            // Output buffers are sized exactly, with a guard band after them to catch any overrun from the SIMD stores
+            const uint32_t outputSize = reference->GetFromCardOutputSize(inputBufferSize);
+            const uint32_t GUARD_BYTES = 64;
+            std::vector<char> expected(outputSize + GUARD_BYTES, static_cast<char>(0xAA));
+            std::vector<char> actual(outputSize + GUARD_BYTES, static_cast<char>(0xAA));
+
+            const uint32_t expectedSize = reference->TransformFromCardReference(inputBuffer, inputBufferSize, expected.data(), outputSize);
+            const uint32_t actualSize = kernel->TransformFromCard(inputBuffer, inputBufferSize, actual.data(), outputSize);
+
+            Assert::AreEqual(numSamples * reference->GetFromCardClientChannels() * bytesPerSample(sampleType), expectedSize);
+            Assert::AreEqual(outputSize, expectedSize);
+            Assert::AreEqual(expectedSize, actualSize);
+            Assert::IsTrue(memcmp(expected.data(), actual.data(), expected.size()) == 0, L"Kernel output differs from the reference transform");
+
+            for (uint32_t i = outputSize; i < actual.size(); i++)
+                Assert::AreEqual(static_cast<char>(0xAA), actual[i], L"Kernel wrote past the end of the output buffer");
+        }
+
+        static uint32_t bytesPerSample(uint32_t sampleType)
+        {
+            switch (sampleType & AudioSampleType_FormatMask)
+            {
+                case AudioSampleType_S16: return 2;
+                case AudioSampleType_S24: return 3;
+                default:                  return 4;
+            }
+        }
+    };
+}
@@ -0,0 +1,93 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "DriverCallStats.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace streampunk::Aja;
+
+namespace AjatationTest
+{
+    TEST_CLASS(Test_DriverCallStats)
+    {
+    public:
+
+        TEST_METHOD(TestEmpty)
+        {
+            DriverCallStats stats(3);
+            DriverCallSummary summary;
+
+            stats.GetSummary(summary);
+            Assert::AreEqual(static_cast<uint64_t>(0), summary.passes);
+            Assert::AreEqual(3u, summary.budget);
+            Assert::AreEqual(0.0, summary.meanPerPass);
+        }
+
+        TEST_METHOD(TestPassesWithinBudget)
+        {
+            DriverCallStats stats(3);
+            DriverCallSummary summary;
+
+            for (int pass = 0; pass < 10; pass++)
+            {
+                stats.Count(DriverCall_VbiWait);
+                stats.Count(DriverCall_Status);
+                stats.Count(DriverCall_Transfer);
+                stats.EndPass();
+            }
+
+            stats.GetSummary(summary);
+            Assert::AreEqual(static_cast<uint64_t>(10), summary.passes);
+            Assert::AreEqual(static_cast<uint64_t>(10), summary.calls[DriverCall_Status]);
+            Assert::AreEqual(static_cast<uint64_t>(10), summary.calls[DriverCall_Transfer]);
+            Assert::AreEqual(static_cast<uint64_t>(0), summary.calls[DriverCall_Other]);
+            Assert::AreEqual(static_cast<uint64_t>(0), summary.overBudget);
+            Assert::AreEqual(3u, summary.maxPerPass);
+            Assert::AreEqual(3.0, summary.meanPerPass);
+        }
+
+        TEST_METHOD(TestOverBudget)
+        {
+            DriverCallStats stats(3);
+            DriverCallSummary summary;
+
+            // Catching up on two frames after a stall
+            stats.Count(DriverCall_VbiWait);
+            stats.Count(DriverCall_Status);
+            stats.Count(DriverCall_Transfer);
+            stats.Count(DriverCall_Transfer);
+            stats.EndPass();
+
+            stats.Count(DriverCall_VbiWait);
+            stats.Count(DriverCall_Status);
+            stats.EndPass();
+
+            stats.GetSummary(summary);
+            Assert::AreEqual(static_cast<uint64_t>(2), summary.passes);
+            Assert::AreEqual(static_cast<uint64_t>(1), summary.overBudget);
+            Assert::AreEqual(4u, summary.maxPerPass);
+            Assert::AreEqual(3.0, summary.meanPerPass);
+
+            stats.Reset();
+            stats.GetSummary(summary);
+            Assert::AreEqual(static_cast<uint64_t>(0), summary.passes);
+            Assert::AreEqual(0u, summary.maxPerPass);
+            Assert::AreEqual(3u, summary.budget);
+        }
+    };
+}
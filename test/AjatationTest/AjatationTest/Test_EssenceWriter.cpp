@@ -0,0 +1,168 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "EssenceWriter.h"
+#include "ajabase/system/memory.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace streampunk::Aja;
+
+namespace AjatationTest
+{
+    const char* TEST_ESSENCE_PATH = "Test_EssenceWriter.raw";
+    const char* TEST_INDEX_PATH = "Test_EssenceWriter.idx";
+
+    std::vector<uint8_t> ReadFile(const char* path)
+    {
+        std::vector<uint8_t> contents;
+        FILE* file = fopen(path, "rb");
+        Assert::IsTrue(file != nullptr, L"Unable to read back a recorded file");
+
+        uint8_t chunk[4096];
+        size_t got;
+        while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0)
+            contents.insert(contents.end(), chunk, chunk + got);
+
+        fclose(file);
+        return contents;
+    }
+
+    std::vector<EssenceIndexEntry> ReadIndex(const char* path)
+    {
+        std::vector<uint8_t> contents(ReadFile(path));
+        Assert::AreEqual(static_cast<size_t>(0), contents.size() % sizeof(EssenceIndexEntry), L"Index should be whole entries");
+
+        std::vector<EssenceIndexEntry> entries(contents.size() / sizeof(EssenceIndexEntry));
+        if (!entries.empty())
+            memcpy(&entries[0], &contents[0], contents.size());
+        return entries;
+    }
+
+    TEST_CLASS(Test_EssenceWriter)
+    {
+    public:
+
+        TEST_METHOD_CLEANUP(RemoveFiles)
+        {
+            remove(TEST_ESSENCE_PATH);
+            remove(TEST_INDEX_PATH);
+        }
+
+        TEST_METHOD(TestFramesAreIndexed)
+        {
+            // An aligned video frame, written in place, and an unaligned one of an odd size, which is staged
+            const uint32_t videoSize = 1920 * 1080 * 2;
+            const uint32_t oddVideoSize = 12345;
+            const uint32_t audioSize = 1602 * 16 * 4;
+            uint8_t* video = static_cast<uint8_t*>(AJAMemory::AllocateAligned(videoSize, EssenceWriter::BLOCK_SIZE));
+            std::vector<uint8_t> oddVideo(oddVideoSize + 1);
+            std::vector<uint8_t> audio(audioSize);
+
+            memset(video, 0x40, videoSize);
+            memset(&oddVideo[0], 0x50, oddVideo.size());
+            memset(&audio[0], 0x60, audioSize);
+
+            EssenceWriter writer;
+            Assert::IsTrue(writer.Open(TEST_ESSENCE_PATH, TEST_INDEX_PATH));
+
+            EssenceIndexEntry entry = {};
+            entry.sequence = 7;
+            entry.videoSize = videoSize;
+            entry.audioSize = audioSize;
+            entry.audioSamplePosition = 1000;
+            entry.audioSampleCount = 1602;
+            entry.timecodeLow = 0x01020304;
+            Assert::IsTrue(writer.WriteFrame(entry, video, &audio[0]));
+
+            entry.sequence = 9;
+            entry.videoSize = oddVideoSize;
+            entry.audioSize = audioSize;
+            Assert::IsTrue(writer.WriteFrame(entry, &oddVideo[1], nullptr));
+
+            Assert::AreEqual(static_cast<uint64_t>(2), writer.GetFramesWritten());
+            Assert::AreEqual(static_cast<uint64_t>(videoSize + audioSize + oddVideoSize), writer.GetBytesWritten());
+            writer.Close();
+            AJAMemory::FreeAligned(video);
+
+            std::vector<EssenceIndexEntry> index(ReadIndex(TEST_INDEX_PATH));
+            std::vector<uint8_t> essence(ReadFile(TEST_ESSENCE_PATH));
+            Assert::AreEqual(static_cast<size_t>(2), index.size());
+
+            Assert::AreEqual(static_cast<uint64_t>(7), index[0].sequence);
+            Assert::AreEqual(static_cast<uint64_t>(1000), index[0].audioSamplePosition);
+            Assert::AreEqual(1602u, index[0].audioSampleCount);
+            Assert::AreEqual(0x01020304u, index[0].timecodeLow);
+            Assert::AreEqual(static_cast<uint64_t>(9), index[1].sequence);
+            Assert::AreEqual(0u, index[1].audioSize, L"A frame without audio should have no audio in the index");
+
+            for (size_t frame = 0; frame < index.size(); frame++)
+            {
+                Assert::AreEqual(static_cast<uint64_t>(0), index[frame].videoOffset % EssenceWriter::BLOCK_SIZE);
+                Assert::AreEqual(static_cast<uint64_t>(0), index[frame].audioOffset % EssenceWriter::BLOCK_SIZE);
+                Assert::IsTrue(index[frame].videoOffset + index[frame].videoSize <= essence.size());
+                Assert::IsTrue(index[frame].audioOffset + index[frame].audioSize <= essence.size());
+            }
+
+            Assert::IsTrue(index[0].audioOffset >= index[0].videoOffset + videoSize);
+            Assert::IsTrue(index[1].videoOffset >= index[0].audioOffset + audioSize);
+            Assert::AreEqual(static_cast<size_t>(0), essence.size() % EssenceWriter::BLOCK_SIZE, L"Essence should be whole blocks");
+
+            Assert::AreEqual(0x40, static_cast<int>(essence[index[0].videoOffset + videoSize - 1]));
+            Assert::AreEqual(0x60, static_cast<int>(essence[index[0].audioOffset]));
+            Assert::AreEqual(0x60, static_cast<int>(essence[index[0].audioOffset + audioSize - 1]));
+            Assert::AreEqual(0x50, static_cast<int>(essence[index[1].videoOffset]));
+            Assert::AreEqual(0x50, static_cast<int>(essence[index[1].videoOffset + oddVideoSize - 1]));
+            Assert::AreEqual(0x00, static_cast<int>(essence[index[1].videoOffset + oddVideoSize]), L"Padding should be zeros");
+        }
+
+        TEST_METHOD(TestLargeUnalignedFrame)
+        {
+            // Bigger than the staging buffer, so it has to go through in several pieces
+            const uint32_t size = EssenceWriter::STAGING_SIZE * 2 + 100;
+            std::vector<uint8_t> video(size + 1);
+            for (uint32_t i = 0; i < size; i++)
+                video[i + 1] = static_cast<uint8_t>(i * 7);
+
+            EssenceWriter writer;
+            Assert::IsTrue(writer.Open(TEST_ESSENCE_PATH, TEST_INDEX_PATH));
+
+            EssenceIndexEntry entry = {};
+            entry.videoSize = size;
+            Assert::IsTrue(writer.WriteFrame(entry, &video[1], nullptr));
+            writer.Close();
+
+            std::vector<uint8_t> essence(ReadFile(TEST_ESSENCE_PATH));
+            Assert::IsTrue(essence.size() >= size);
+            Assert::IsTrue(memcmp(&essence[0], &video[1], size) == 0, L"Staged video should be written unchanged");
+        }
+
+        TEST_METHOD(TestOpenFailure)
+        {
+            EssenceWriter writer;
+            EssenceIndexEntry entry = {};
+
+            Assert::IsFalse(writer.Open("no/such/directory/essence.raw", TEST_INDEX_PATH));
+            Assert::IsFalse(writer.IsOpen());
+            Assert::IsFalse(writer.GetError().empty());
+            Assert::IsFalse(writer.WriteFrame(entry, nullptr, nullptr));
+        }
+    };
+}
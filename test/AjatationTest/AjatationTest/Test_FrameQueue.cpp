@@ -0,0 +1,163 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "FrameQueue.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace streampunk::Aja;
+
+namespace AjatationTest
+{
+    TEST_CLASS(Test_FrameQueue)
+    {
+    public:
+
+        // Produce a frame carrying value, returning false if the queue gave up
+        static bool Produce(FrameQueue<int*>& queue, int value)
+        {
+            int* frame = queue.StartProduceNextBuffer();
+            if (frame == nullptr)
+                return false;
+
+            *frame = value;
+            queue.EndProduceNextBuffer();
+            return true;
+        }
+
+        static int Consume(FrameQueue<int*>& queue)
+        {
+            int* frame = queue.StartConsumeNextBuffer();
+            Assert::IsNotNull(frame);
+
+            int value = *frame;
+            queue.EndConsumeNextBuffer();
+            return value;
+        }
+
+        TEST_METHOD(TestBlockLosesNothing)
+        {
+            int frames[3] = {};
+            std::atomic<bool> abort(false);
+            FrameQueue<int*> queue;
+            queue.SetAbortFlag(&abort);
+            for (int frame = 0; frame < 3; frame++)
+                queue.Add(&frames[frame]);
+
+            for (int value = 1; value <= 3; value++)
+                Assert::IsTrue(Produce(queue, value));
+            Assert::AreEqual(3u, queue.GetCircBufferCount());
+
+            // Full, so the producer waits until told to give up
+            abort = true;
+            Assert::IsFalse(Produce(queue, 4));
+            abort = false;
+
+            Assert::AreEqual(1, Consume(queue));
+            Assert::IsTrue(Produce(queue, 4));
+            Assert::AreEqual(2, Consume(queue));
+            Assert::AreEqual(3, Consume(queue));
+            Assert::AreEqual(4, Consume(queue));
+            Assert::AreEqual(static_cast<uint64_t>(0), queue.GetDropped());
+        }
+
+        TEST_METHOD(TestDropOldestKeepsFreshest)
+        {
+            int frames[3] = {};
+            FrameQueue<int*> queue;
+            queue.SetPolicy(BackpressurePolicy_DropOldest);
+            for (int frame = 0; frame < 3; frame++)
+                queue.Add(&frames[frame]);
+
+            for (int value = 1; value <= 5; value++)
+                Assert::IsTrue(Produce(queue, value));
+
+            Assert::AreEqual(static_cast<uint64_t>(2), queue.GetDropped());
+            Assert::AreEqual(3u, queue.GetCircBufferCount());
+            Assert::AreEqual(3, Consume(queue));
+            Assert::AreEqual(4, Consume(queue));
+            Assert::AreEqual(5, Consume(queue));
+        }
+
+        TEST_METHOD(TestDropOldestSparesFrameInUse)
+        {
+            int frames[3] = {};
+            FrameQueue<int*> queue;
+            queue.SetPolicy(BackpressurePolicy_DropOldest);
+            for (int frame = 0; frame < 3; frame++)
+                queue.Add(&frames[frame]);
+
+            Assert::IsTrue(Produce(queue, 1));
+            Assert::IsTrue(Produce(queue, 2));
+
+            // The consumer holds frame 1 while the producer laps it
+            int* held = queue.StartConsumeNextBuffer();
+            Assert::AreEqual(1, *held);
+            for (int value = 3; value <= 6; value++)
+                Assert::IsTrue(Produce(queue, value));
+
+            Assert::AreEqual(1, *held, L"A frame being consumed must not be overwritten");
+            queue.EndConsumeNextBuffer();
+
+            Assert::AreEqual(static_cast<uint64_t>(3), queue.GetDropped());
+            Assert::AreEqual(5, Consume(queue));
+            Assert::AreEqual(6, Consume(queue));
+        }
+
+        TEST_METHOD(TestAbandonedFrameIsNotConsumed)
+        {
+            int frames[2] = {};
+            FrameQueue<int*> queue;
+            queue.Add(&frames[0]);
+            queue.Add(&frames[1]);
+
+            Assert::IsTrue(Produce(queue, 1));
+
+            int* frame = queue.StartProduceNextBuffer();
+            *frame = 2;
+            queue.AbandonProduceNextBuffer();
+            Assert::AreEqual(1u, queue.GetCircBufferCount());
+
+            // The abandoned frame is free to fill again, so the queue isn't full
+            Assert::IsTrue(Produce(queue, 3));
+            Assert::AreEqual(1, Consume(queue));
+            Assert::AreEqual(3, Consume(queue));
+            Assert::AreEqual(static_cast<uint64_t>(0), queue.GetDropped());
+        }
+
+        TEST_METHOD(TestDropNewestKeepsWaiting)
+        {
+            int frames[2] = {};
+            int spare = 0;
+            FrameQueue<int*> queue;
+            queue.SetPolicy(BackpressurePolicy_DropNewest);
+            queue.Add(&frames[0]);
+            queue.Add(&frames[1]);
+            queue.SetSpare(&spare);
+
+            for (int value = 1; value <= 4; value++)
+                Assert::IsTrue(Produce(queue, value));
+
+            // The last two went into the spare and were thrown away
+            Assert::AreEqual(4, spare);
+            Assert::AreEqual(static_cast<uint64_t>(2), queue.GetDropped());
+            Assert::AreEqual(2u, queue.GetCircBufferCount());
+            Assert::AreEqual(1, Consume(queue));
+            Assert::AreEqual(2, Consume(queue));
+        }
+    };
+}
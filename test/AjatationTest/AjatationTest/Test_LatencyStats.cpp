@@ -0,0 +1,99 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "LatencyStats.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace streampunk::Aja;
+
+namespace AjatationTest
+{
+    TEST_CLASS(Test_LatencyStats)
+    {
+    public:
+
+        TEST_METHOD(TestEmpty)
+        {
+            LatencyStats stats;
+            LatencySummary summary;
+
+            stats.GetSummary(summary);
+            Assert::AreEqual(0u, summary.count);
+            Assert::AreEqual(static_cast<uint64_t>(0), summary.total);
+            Assert::AreEqual(0.0, summary.max);
+        }
+
+        TEST_METHOD(TestSummary)
+        {
+            LatencyStats stats(100);
+            LatencySummary summary;
+
+            // 1 to 100, added out of order
+            for (uint32_t sample = 0; sample < 100; sample++)
+                stats.Add(static_cast<double>((sample * 37) % 100 + 1));
+
+            stats.GetSummary(summary);
+            Assert::AreEqual(100u, summary.count);
+            Assert::AreEqual(1.0, summary.min);
+            Assert::AreEqual(100.0, summary.max);
+            Assert::AreEqual(50.5, summary.mean);
+            Assert::AreEqual(50.0, summary.p50);
+            Assert::AreEqual(99.0, summary.p99);
+            Assert::AreEqual(static_cast<double>((99 * 37) % 100 + 1), summary.last);
+        }
+
+        TEST_METHOD(TestSmallWindow)
+        {
+            LatencyStats stats(2);
+            LatencySummary summary;
+
+            // With so few samples the 99th percentile can only be the largest
+            stats.Add(10.0);
+            stats.GetSummary(summary);
+            Assert::AreEqual(10.0, summary.p50);
+            Assert::AreEqual(10.0, summary.p99);
+
+            stats.Add(20.0);
+            stats.GetSummary(summary);
+            Assert::AreEqual(10.0, summary.p50);
+            Assert::AreEqual(20.0, summary.p99);
+        }
+
+        TEST_METHOD(TestWindowRolls)
+        {
+            LatencyStats stats(10);
+            LatencySummary summary;
+
+            // A spike that has gone out of the window no longer counts
+            stats.Add(1000.0);
+            for (uint32_t sample = 0; sample < 10; sample++)
+                stats.Add(5.0);
+
+            stats.GetSummary(summary);
+            Assert::AreEqual(10u, summary.count);
+            Assert::AreEqual(static_cast<uint64_t>(11), summary.total);
+            Assert::AreEqual(5.0, summary.max);
+            Assert::AreEqual(5.0, summary.mean);
+
+            stats.Reset();
+            stats.GetSummary(summary);
+            Assert::AreEqual(0u, summary.count);
+            Assert::AreEqual(static_cast<uint64_t>(0), summary.total);
+        }
+    };
+}
@@ -0,0 +1,163 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <vector>
+#include <cmath>
+#include "LoudnessAnalyser.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace streampunk::Aja;
+
+namespace AjatationTest
+{
+    // Tolerance from EBU Tech 3341 for the minimum requirements tests
+    const double LOUDNESS_TOLERANCE = 0.1;
+
+    TEST_CLASS(Test_LoudnessAnalyser)
+    {
+    public:
+
+        // EBU Tech 3341 cases 1 and 2: stereo 1kHz sine at -23 and -33 dBFS
+        TEST_METHOD(TestSteadySine)
+        {
+            const double levels[] = { -23.0, -33.0 };
+
+            for (auto level : levels)
+            {
+                LoudnessAnalyser analyser;
+                addSine(analyser, 2, level, 20.0);
+
+                LoudnessResults results;
+                analyser.GetResults(results);
+
+                Assert::AreEqual(level, results.momentary, LOUDNESS_TOLERANCE);
+                Assert::AreEqual(level, results.shortTerm, LOUDNESS_TOLERANCE);
+                Assert::AreEqual(level, results.integrated, LOUDNESS_TOLERANCE);
+                Assert::AreEqual(static_cast<uint64_t>(20 * LoudnessAnalyser::SAMPLE_RATE), results.samplesProcessed);
+            }
+        }
+
+        // EBU Tech 3341 cases 3 and 4: quieter sections must be removed by the relative and absolute gates
+        TEST_METHOD(TestGating)
+        {
+            LoudnessAnalyser relative;
+            addSine(relative, 2, -36.0, 10.0);
+            addSine(relative, 2, -23.0, 60.0);
+            addSine(relative, 2, -36.0, 10.0);
+
+            LoudnessResults results;
+            relative.GetResults(results);
+            Assert::AreEqual(-23.0, results.integrated, LOUDNESS_TOLERANCE);
+
+            LoudnessAnalyser absolute;
+            addSine(absolute, 2, -72.0, 10.0);
+            addSine(absolute, 2, -36.0, 10.0);
+            addSine(absolute, 2, -23.0, 60.0);
+            addSine(absolute, 2, -36.0, 10.0);
+            addSine(absolute, 2, -72.0, 10.0);
+
+            absolute.GetResults(results);
+            Assert::AreEqual(-23.0, results.integrated, LOUDNESS_TOLERANCE);
+
+            // Trailing silence leaves the integrated figure alone, while the short-term window falls away
+            addSine(absolute, 2, -200.0, 5.0);
+            absolute.GetResults(results);
+            Assert::AreEqual(-23.0, results.integrated, LOUDNESS_TOLERANCE);
+            Assert::IsTrue(results.shortTerm < -70.0);
+        }
+
+        TEST_METHOD(TestChannelWeights)
+        {
+            // A full scale sine in one channel reads -3.01 LUFS
+            LoudnessAnalyser mono;
+            Assert::IsTrue(mono.Configure({ 1.0 }));
+            addSine(mono, 1, 0.0, 5.0);
+
+            LoudnessResults results;
+            mono.GetResults(results);
+            Assert::AreEqual(-3.01, results.integrated, LOUDNESS_TOLERANCE);
+
+            // An excluded channel (LFE) does not contribute, and surrounds are 1.5 dB up
+            LoudnessAnalyser surround;
+            Assert::IsTrue(surround.Configure({ 0.0, 1.41 }));
+            addSine(surround, 2, -20.0, 5.0);
+
+            surround.GetResults(results);
+            Assert::AreEqual(-20.0 - 3.01 + 10.0 * std::log10(1.41), results.integrated, LOUDNESS_TOLERANCE);
+
+            Assert::IsFalse(surround.Configure(std::vector<double>()));
+            Assert::IsFalse(surround.Configure({ -1.0 }));
+            Assert::IsFalse(surround.Configure(std::vector<double>(LoudnessAnalyser::MAX_CHANNELS + 1, 1.0)));
+        }
+
+        TEST_METHOD(TestTruePeak)
+        {
+            LoudnessAnalyser analyser;
+
+            LoudnessResults results;
+            analyser.GetResults(results);
+            Assert::IsTrue(std::isinf(results.truePeak) && results.truePeak < 0);
+            Assert::IsTrue(std::isinf(results.integrated) && results.integrated < 0);
+
+            // A sine at a quarter of the sample rate, sampled 45 degrees off its peaks: every sample is
+            // 3dB below the true peak, which only the oversampled measurement finds
+            const uint32_t numSamples = LoudnessAnalyser::SAMPLE_RATE;
+            std::vector<float> samples(numSamples * 2);
+            for (uint32_t i = 0; i < numSamples; i++)
+            {
+                const float value = static_cast<float>(0.5 * std::sin(3.14159265358979323846 * (i / 2.0 + 0.25)));
+                samples[i * 2] = value;
+                samples[i * 2 + 1] = value;
+            }
+
+            analyser.AddSamples(samples.data(), numSamples);
+            analyser.GetResults(results);
+
+            Assert::AreEqual(-6.02, results.truePeak, 0.2);
+
+            analyser.Reset();
+            analyser.GetResults(results);
+            Assert::AreEqual(static_cast<uint64_t>(0), results.samplesProcessed);
+            Assert::IsTrue(std::isinf(results.truePeak));
+        }
+
+    private:
+
+        // Add a 1kHz sine with the given peak level to every channel, in frame sized chunks as the capture thread does
+        static void addSine(LoudnessAnalyser& analyser, uint32_t numChannels, double levelDbfs, double seconds)
+        {
+            const double amplitude = std::pow(10.0, levelDbfs / 20.0);
+            const uint32_t totalSamples = static_cast<uint32_t>(seconds * LoudnessAnalyser::SAMPLE_RATE);
+            const uint32_t chunkSamples = 1602;
+            std::vector<float> chunk(chunkSamples * numChannels);
+
+            for (uint32_t start = 0; start < totalSamples; start += chunkSamples)
+            {
+                const uint32_t count = std::min(chunkSamples, totalSamples - start);
+
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    const float value = static_cast<float>(amplitude * std::sin(2.0 * 3.14159265358979323846 * 1000.0 * (start + i) / LoudnessAnalyser::SAMPLE_RATE));
+                    for (uint32_t channel = 0; channel < numChannels; channel++)
+                        chunk[i * numChannels + channel] = value;
+                }
+
+                analyser.AddSamples(chunk.data(), count);
+            }
+        }
+    };
+}
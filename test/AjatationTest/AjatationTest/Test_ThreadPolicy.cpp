@@ -0,0 +1,83 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <thread>
+#include "ThreadPolicy.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace streampunk::Aja;
+
+namespace AjatationTest
+{
+    TEST_CLASS(Test_ThreadPolicy)
+    {
+    public:
+
+        TEST_METHOD(TestDefaultLeavesThreadAlone)
+        {
+            ThreadPolicy policy;
+            ThreadPolicy effective;
+
+            std::thread worker([&]() { ApplyThreadPolicy(policy, true, effective); });
+            worker.join();
+
+            Assert::AreEqual(static_cast<uint64_t>(0), effective.cpuMask);
+            Assert::IsFalse(effective.realtime);
+            Assert::AreEqual(static_cast<int32_t>(ThreadPolicy::ANY_NUMA_NODE), effective.numaNode);
+        }
+
+        TEST_METHOD(TestCpuMaskIsNarrowed)
+        {
+            ThreadPolicy policy;
+            ThreadPolicy effective;
+            ThreadPolicy pinned;
+
+            // Asking for every CPU gets those the process may use...
+            policy.cpuMask = ~static_cast<uint64_t>(0);
+            policy.numaNode = 0;
+
+            std::thread worker([&]() { ApplyThreadPolicy(policy, false, effective); });
+            worker.join();
+
+            Assert::IsTrue(effective.cpuMask != 0);
+            Assert::AreEqual(0, effective.numaNode);
+
+            // ...and one of those can then be had on its own
+            policy.cpuMask = effective.cpuMask & (~effective.cpuMask + 1);
+
+            std::thread pinnedWorker([&]() { ApplyThreadPolicy(policy, false, pinned); });
+            pinnedWorker.join();
+
+            Assert::AreEqual(policy.cpuMask, pinned.cpuMask);
+        }
+
+        TEST_METHOD(TestRealtimeOnlyWhereAsked)
+        {
+            ThreadPolicy policy;
+            ThreadPolicy effective;
+
+            // The priority itself may be refused without privileges, so only check it isn't applied when not wanted
+            policy.realtime = true;
+
+            std::thread worker([&]() { ApplyThreadPolicy(policy, false, effective); });
+            worker.join();
+
+            Assert::IsFalse(effective.realtime);
+        }
+    };
+}
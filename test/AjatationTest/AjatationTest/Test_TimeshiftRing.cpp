@@ -0,0 +1,224 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "FrameQueue.h"
+#include "TimeshiftRing.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace streampunk::Aja;
+
+namespace AjatationTest
+{
+    const char* TEST_RING_PATH = "Test_TimeshiftRing.ring";
+    const uint32_t TEST_RING_SLOTS = 4;
+    const uint32_t TEST_RING_VIDEO_SIZE = 10000;
+    const uint32_t TEST_RING_AUDIO_SIZE = 3000;
+
+    // Write a frame whose video and audio are filled with a value derived from its number
+    void WriteTestFrame(TimeshiftRing& ring, uint64_t frameNumber)
+    {
+        std::vector<uint8_t> video(TEST_RING_VIDEO_SIZE, static_cast<uint8_t>(frameNumber * 2));
+        std::vector<uint8_t> audio(TEST_RING_AUDIO_SIZE, static_cast<uint8_t>(frameNumber * 2 + 1));
+
+        TimeshiftFrameInfo info = {};
+        info.captureSequence = 100 + frameNumber;
+        info.videoSize = TEST_RING_VIDEO_SIZE - static_cast<uint32_t>(frameNumber);
+        info.audioSize = TEST_RING_AUDIO_SIZE;
+        info.audioSampleCount = 1920;
+        info.timecodeLow = static_cast<uint32_t>(frameNumber);
+
+        Assert::IsTrue(ring.WriteFrame(info, &video[0], &audio[0]), L"WriteFrame failed");
+    }
+
+    void CheckTestFrame(const TimeshiftRing& ring, uint64_t frameNumber)
+    {
+        TimeshiftFrameInfo info;
+        const uint8_t* video;
+        const uint8_t* audio;
+
+        Assert::IsTrue(ring.GetFrame(frameNumber, info, video, audio), L"Frame should be in the ring");
+        Assert::AreEqual(100 + frameNumber, info.captureSequence);
+        Assert::AreEqual(TEST_RING_VIDEO_SIZE - static_cast<uint32_t>(frameNumber), info.videoSize);
+        Assert::AreEqual(static_cast<uint32_t>(frameNumber), info.timecodeLow);
+        Assert::AreEqual(static_cast<int>(frameNumber * 2 & 0xff), static_cast<int>(video[0]));
+        Assert::AreEqual(static_cast<int>(frameNumber * 2 & 0xff), static_cast<int>(video[info.videoSize - 1]));
+        Assert::AreEqual(static_cast<int>((frameNumber * 2 + 1) & 0xff), static_cast<int>(audio[info.audioSize - 1]));
+        Assert::AreEqual(static_cast<size_t>(0), reinterpret_cast<size_t>(video) % TimeshiftRing::PAGE_SIZE, L"Video should be page aligned");
+        Assert::IsTrue(ring.IsFrameValid(frameNumber));
+    }
+
+    // Schedule a frame from the ring as the player does: copy it into the next free frame, then queue it only if
+    // the slot is still valid. midCopy runs between the video and audio copies, where a capture could lap the reader.
+    bool ScheduleFromRing(const TimeshiftRing& ring, uint64_t frameNumber, FrameQueue<std::vector<uint8_t>*>& queue,
+                          const std::function<void()>& midCopy)
+    {
+        TimeshiftFrameInfo info;
+        const uint8_t* video;
+        const uint8_t* audio;
+
+        if (!ring.GetFrame(frameNumber, info, video, audio))
+            return false;
+
+        std::vector<uint8_t>* frame = queue.StartProduceNextBuffer();
+        frame->assign(video, video + info.videoSize);
+        midCopy();
+        frame->insert(frame->end(), audio, audio + info.audioSize);
+
+        if (!ring.IsFrameValid(frameNumber))
+        {
+            queue.AbandonProduceNextBuffer();
+            return false;
+        }
+
+        queue.EndProduceNextBuffer();
+        return true;
+    }
+
+    TEST_CLASS(Test_TimeshiftRing)
+    {
+    public:
+
+        TEST_METHOD_CLEANUP(RemoveRing)
+        {
+            remove(TEST_RING_PATH);
+        }
+
+        TEST_METHOD(TestFramesWrapRound)
+        {
+            TimeshiftRing writer;
+            uint64_t oldest, newest;
+
+            Assert::IsTrue(writer.Create(TEST_RING_PATH, TEST_RING_SLOTS, TEST_RING_VIDEO_SIZE, TEST_RING_AUDIO_SIZE, 16));
+            Assert::IsFalse(writer.GetRange(oldest, newest), L"A new ring should be empty");
+
+            for (uint64_t frame = 0; frame < 3; frame++)
+                WriteTestFrame(writer, frame);
+
+            Assert::IsTrue(writer.GetRange(oldest, newest));
+            Assert::AreEqual(static_cast<uint64_t>(0), oldest);
+            Assert::AreEqual(static_cast<uint64_t>(2), newest);
+            CheckTestFrame(writer, 0);
+
+            // Once the ring is full, the oldest frame is the next to go, so it isn't offered
+            for (uint64_t frame = 3; frame < 10; frame++)
+                WriteTestFrame(writer, frame);
+
+            Assert::IsTrue(writer.GetRange(oldest, newest));
+            Assert::AreEqual(static_cast<uint64_t>(7), oldest);
+            Assert::AreEqual(static_cast<uint64_t>(9), newest);
+
+            for (uint64_t frame = oldest; frame <= newest; frame++)
+                CheckTestFrame(writer, frame);
+
+            TimeshiftFrameInfo info;
+            const uint8_t* video;
+            const uint8_t* audio;
+            Assert::IsFalse(writer.GetFrame(5, info, video, audio), L"An overwritten frame should be gone");
+            Assert::IsFalse(writer.IsFrameValid(5));
+            Assert::IsFalse(writer.GetFrame(10, info, video, audio), L"A frame not yet written should not be there");
+        }
+
+        TEST_METHOD(TestReaderSeesWriter)
+        {
+            TimeshiftRing writer;
+            TimeshiftRing reader;
+            uint64_t oldest, newest;
+
+            Assert::IsTrue(writer.Create(TEST_RING_PATH, TEST_RING_SLOTS, TEST_RING_VIDEO_SIZE, TEST_RING_AUDIO_SIZE, 8));
+            WriteTestFrame(writer, 0);
+
+            Assert::IsTrue(reader.Open(TEST_RING_PATH));
+            Assert::AreEqual(TEST_RING_SLOTS, reader.GetNumSlots());
+            Assert::AreEqual(8u, reader.GetNumAudioChannels());
+            CheckTestFrame(reader, 0);
+
+            // Frames written after the reader opened the ring show up through its mapping
+            for (uint64_t frame = 1; frame < 6; frame++)
+                WriteTestFrame(writer, frame);
+
+            Assert::IsTrue(reader.GetRange(oldest, newest));
+            Assert::AreEqual(static_cast<uint64_t>(5), newest);
+            CheckTestFrame(reader, 5);
+            Assert::IsFalse(reader.IsFrameValid(0), L"The reader should see frames being overwritten");
+
+            TimeshiftFrameInfo info = {};
+            Assert::IsFalse(reader.WriteFrame(info, nullptr, nullptr), L"A reader should not be able to write");
+        }
+
+        TEST_METHOD(TestOverwriteDuringScheduleIsNotQueued)
+        {
+            TimeshiftRing writer;
+            TimeshiftRing reader;
+            std::vector<uint8_t> frames[2];
+            FrameQueue<std::vector<uint8_t>*> queue;
+            queue.Add(&frames[0]);
+            queue.Add(&frames[1]);
+
+            Assert::IsTrue(writer.Create(TEST_RING_PATH, TEST_RING_SLOTS, TEST_RING_VIDEO_SIZE, TEST_RING_AUDIO_SIZE, 16));
+            Assert::IsTrue(reader.Open(TEST_RING_PATH));
+            for (uint64_t frame = 0; frame < 3; frame++)
+                WriteTestFrame(writer, frame);
+
+            Assert::IsTrue(ScheduleFromRing(reader, 2, queue, [] {}));
+            Assert::AreEqual(1u, queue.GetCircBufferCount());
+
+            // The capture laps the reader while frame 0 is being copied, so its copy is half one frame and half another
+            uint64_t next = 3;
+            Assert::IsFalse(ScheduleFromRing(reader, 0, queue, [&] { while (next < 3 + TEST_RING_SLOTS) WriteTestFrame(writer, next++); }));
+            Assert::AreEqual(1u, queue.GetCircBufferCount(), L"A torn frame must not be queued to play");
+
+            // The slot it was copied into is free again, so the next frame can still be scheduled
+            Assert::IsTrue(ScheduleFromRing(reader, 6, queue, [] {}));
+            Assert::AreEqual(2u, queue.GetCircBufferCount());
+
+            std::vector<uint8_t>* played = queue.StartConsumeNextBuffer();
+            Assert::AreEqual(static_cast<int>(2 * 2), static_cast<int>((*played)[0]));
+            queue.EndConsumeNextBuffer();
+            played = queue.StartConsumeNextBuffer();
+            Assert::AreEqual(static_cast<int>(6 * 2), static_cast<int>((*played)[0]));
+            queue.EndConsumeNextBuffer();
+        }
+
+        TEST_METHOD(TestRejectsBadFramesAndFiles)
+        {
+            TimeshiftRing ring;
+            std::vector<uint8_t> video(TEST_RING_VIDEO_SIZE + 1);
+
+            Assert::IsFalse(ring.Create(TEST_RING_PATH, 1, TEST_RING_VIDEO_SIZE, TEST_RING_AUDIO_SIZE, 16), L"One slot is too few");
+            Assert::IsTrue(ring.Create(TEST_RING_PATH, TEST_RING_SLOTS, TEST_RING_VIDEO_SIZE, TEST_RING_AUDIO_SIZE, 16));
+
+            TimeshiftFrameInfo info = {};
+            info.videoSize = TEST_RING_VIDEO_SIZE + 1;
+            Assert::IsFalse(ring.WriteFrame(info, &video[0], nullptr), L"Oversized video should be refused");
+            ring.Close();
+
+            // Anything that isn't a ring is refused
+            FILE* file = fopen(TEST_RING_PATH, "wb");
+            fputs("not a ring", file);
+            fclose(file);
+
+            Assert::IsFalse(ring.Open(TEST_RING_PATH));
+            Assert::IsFalse(ring.GetError().empty());
+            Assert::IsFalse(ring.Open("no/such/directory/ring"));
+        }
+    };
+}
@@ -0,0 +1,288 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <cstring>
+#include <set>
+#include <vector>
+#include "VideoBufferPool.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace streampunk::Aja;
+
+namespace AjatationTest
+{
+    const uint32_t TEST_BUFFER_SIZE = 1920 * 1080 * 2;
+
+    // Stands in for the device's DMA lock calls, keeping track of what is locked
+    struct FakeDmaLocks
+    {
+        std::set<uint8_t*> locked;
+        uint32_t lockCalls;
+        uint32_t unlockCalls;
+
+        FakeDmaLocks() : lockCalls(0), unlockCalls(0) {}
+
+        static bool Lock(void* pInstance, uint8_t* buffer, uint32_t bufferSize)
+        {
+            FakeDmaLocks* locks = reinterpret_cast<FakeDmaLocks*>(pInstance);
+            Assert::AreEqual(TEST_BUFFER_SIZE, bufferSize);
+            locks->lockCalls++;
+            return locks->locked.insert(buffer).second;
+        }
+
+        static void Unlock(void* pInstance, uint8_t* buffer, uint32_t bufferSize)
+        {
+            FakeDmaLocks* locks = reinterpret_cast<FakeDmaLocks*>(pInstance);
+            Assert::AreEqual(TEST_BUFFER_SIZE, bufferSize);
+            locks->unlockCalls++;
+            Assert::AreEqual(static_cast<size_t>(1), locks->locked.erase(buffer), L"Unlocked a buffer that was not locked");
+        }
+    };
+
+    TEST_CLASS(Test_VideoBufferPool)
+    {
+    public:
+
+        TEST_METHOD(TestBuffersAreReused)
+        {
+            VideoBufferPool* pool = VideoBufferPool::Create(TEST_BUFFER_SIZE, 2, 4);
+            uint32_t outstanding, hugePageBuffers, dmaLockedBuffers;
+            uint64_t allocated;
+
+            uint8_t* first = pool->Acquire();
+            uint8_t* second = pool->Acquire();
+            Assert::IsTrue(first != nullptr && second != nullptr && first != second);
+
+            // Both buffers must be usable for the whole frame
+            memset(first, 0x10, TEST_BUFFER_SIZE);
+            memset(second, 0x80, TEST_BUFFER_SIZE);
+
+            pool->Release(first);
+            Assert::IsTrue(pool->Acquire() == first, L"A released buffer should be handed out again");
+
+            pool->GetStatistics(outstanding, allocated, hugePageBuffers, dmaLockedBuffers);
+            Assert::AreEqual(2u, outstanding);
+            Assert::AreEqual(static_cast<uint64_t>(2), allocated);
+
+            pool->Release(first);
+            pool->Release(second);
+            pool->Close();
+        }
+
+        TEST_METHOD(TestPoolGrowsWhenEmpty)
+        {
+            VideoBufferPool* pool = VideoBufferPool::Create(TEST_BUFFER_SIZE, 2, 3);
+            std::vector<uint8_t*> buffers;
+            uint32_t outstanding, hugePageBuffers, dmaLockedBuffers;
+            uint64_t allocated;
+
+            for (int i = 0; i < 5; i++)
+                buffers.push_back(pool->Acquire());
+
+            pool->GetStatistics(outstanding, allocated, hugePageBuffers, dmaLockedBuffers);
+            Assert::AreEqual(5u, outstanding);
+            Assert::AreEqual(static_cast<uint64_t>(5), allocated);
+
+            for (auto buffer : buffers)
+                pool->Release(buffer);
+
+            // Only maxFreeBuffers are kept, so taking four again needs one new allocation
+            buffers.clear();
+            for (int i = 0; i < 4; i++)
+                buffers.push_back(pool->Acquire());
+
+            pool->GetStatistics(outstanding, allocated, hugePageBuffers, dmaLockedBuffers);
+            Assert::AreEqual(4u, outstanding);
+            Assert::AreEqual(static_cast<uint64_t>(6), allocated);
+
+            for (auto buffer : buffers)
+                pool->Release(buffer);
+            pool->Close();
+        }
+
+        TEST_METHOD(TestBuffersArePageAligned)
+        {
+            const bool hugePages[] = { false, true };
+
+            // Huge pages may not be available here, in which case the pool falls back to ordinary pages
+            for (auto huge : hugePages)
+            {
+                VideoBufferPool* pool = VideoBufferPool::Create(TEST_BUFFER_SIZE, 3, 3, huge);
+                std::vector<uint8_t*> buffers;
+
+                for (int i = 0; i < 5; i++)
+                {
+                    buffers.push_back(pool->Acquire());
+                    Assert::IsTrue(buffers.back() != nullptr);
+                    Assert::AreEqual(static_cast<uintptr_t>(0), reinterpret_cast<uintptr_t>(buffers.back()) % VideoBufferPool::BUFFER_ALIGNMENT);
+                    memset(buffers.back(), 0x20, TEST_BUFFER_SIZE);
+                }
+
+                for (auto buffer : buffers)
+                    pool->Release(buffer);
+                pool->Close();
+            }
+        }
+
+        TEST_METHOD(TestDmaLocking)
+        {
+            FakeDmaLocks locks;
+            VideoBufferPool* pool = VideoBufferPool::Create(TEST_BUFFER_SIZE, 2, 2);
+            uint32_t outstanding, hugePageBuffers, dmaLockedBuffers;
+            uint64_t allocated;
+
+            uint8_t* first = pool->Acquire();
+
+            // Buffers already allocated are locked straight away, and new ones as they are allocated
+            pool->SetDmaLockCallbacks(&locks, FakeDmaLocks::Lock, FakeDmaLocks::Unlock);
+            Assert::AreEqual(static_cast<size_t>(2), locks.locked.size());
+
+            uint8_t* second = pool->Acquire();
+            uint8_t* third = pool->Acquire();
+            Assert::AreEqual(static_cast<size_t>(3), locks.locked.size());
+            Assert::IsTrue(locks.locked.count(first) == 1 && locks.locked.count(second) == 1 && locks.locked.count(third) == 1);
+
+            // Reusing a buffer must not lock it again
+            pool->Release(second);
+            Assert::IsTrue(pool->Acquire() == second);
+            Assert::AreEqual(3u, locks.lockCalls);
+
+            pool->GetStatistics(outstanding, allocated, hugePageBuffers, dmaLockedBuffers);
+            Assert::AreEqual(3u, dmaLockedBuffers);
+
+            // A buffer freed because the free list is full is unlocked first
+            pool->Release(first);
+            pool->Release(second);
+            pool->Release(third);
+            Assert::AreEqual(1u, locks.unlockCalls);
+
+            // Closing unlocks everything, even a buffer that is still out
+            uint8_t* held = pool->Acquire();
+            pool->Close();
+            Assert::AreEqual(static_cast<size_t>(0), locks.locked.size());
+
+            pool->Release(held);
+            Assert::AreEqual(3u, locks.unlockCalls);
+        }
+
+        TEST_METHOD(TestResize)
+        {
+            VideoBufferPool* pool = VideoBufferPool::Create(TEST_BUFFER_SIZE, 2, 2);
+            uint32_t outstanding, hugePageBuffers, dmaLockedBuffers;
+            uint64_t allocated;
+
+            uint8_t* held = pool->Acquire();
+
+            // A smaller format fits in the buffers there are
+            Assert::IsTrue(pool->Resize(TEST_BUFFER_SIZE / 2));
+            Assert::AreEqual(TEST_BUFFER_SIZE / 2, pool->GetBufferSize());
+            Assert::AreEqual(TEST_BUFFER_SIZE, pool->GetAllocationSize());
+            Assert::IsTrue(pool->Resize(TEST_BUFFER_SIZE));
+
+            pool->GetStatistics(outstanding, allocated, hugePageBuffers, dmaLockedBuffers);
+            Assert::AreEqual(static_cast<uint64_t>(2), allocated, L"Nothing should be reallocated for a format that fits");
+
+            // A bigger one replaces the free buffer straight away, and the held one once it comes back
+            Assert::IsFalse(pool->Resize(TEST_BUFFER_SIZE * 2));
+            Assert::AreEqual(TEST_BUFFER_SIZE * 2, pool->GetAllocationSize());
+
+            uint8_t* bigger = pool->Acquire();
+            memset(bigger, 0x30, TEST_BUFFER_SIZE * 2);
+
+            Assert::AreEqual(TEST_BUFFER_SIZE, pool->Release(held), L"Release should give the size the buffer was allocated with");
+            Assert::AreEqual(TEST_BUFFER_SIZE * 2, pool->Release(bigger));
+
+            pool->GetStatistics(outstanding, allocated, hugePageBuffers, dmaLockedBuffers);
+            Assert::AreEqual(static_cast<uint64_t>(3), allocated);
+
+            uint8_t* reused = pool->Acquire();
+            Assert::IsTrue(reused == bigger, L"Only buffers of the new size should be reused");
+            pool->Release(reused);
+            pool->Close();
+        }
+
+        TEST_METHOD(TestBuffersOutliveClose)
+        {
+            // Node Buffers can be collected after the capture has gone, so releasing after Close must be safe
+            VideoBufferPool* pool = VideoBufferPool::Create(TEST_BUFFER_SIZE, 2, 2);
+
+            uint8_t* buffer = pool->Acquire();
+            pool->Close();
+
+            memset(buffer, 0x40, TEST_BUFFER_SIZE);
+            pool->Release(buffer);
+        }
+
+        TEST_METHOD(TestRetainedBufferStaysOut)
+        {
+            VideoBufferPool* pool = VideoBufferPool::Create(TEST_BUFFER_SIZE, 2, 2);
+            uint32_t outstanding, hugePageBuffers, dmaLockedBuffers;
+            uint64_t allocated;
+
+            uint8_t* buffer = pool->Acquire();
+            Assert::IsFalse(pool->IsShared(buffer));
+
+            pool->Retain(buffer);
+            Assert::IsTrue(pool->IsShared(buffer));
+
+            // The first release leaves it with the other holder, so it mustn't be handed out again yet
+            Assert::AreEqual(TEST_BUFFER_SIZE, pool->Release(buffer));
+            Assert::IsFalse(pool->IsShared(buffer));
+            pool->GetStatistics(outstanding, allocated, hugePageBuffers, dmaLockedBuffers);
+            Assert::AreEqual(1u, outstanding);
+
+            uint8_t* other = pool->Acquire();
+            Assert::IsTrue(other != buffer);
+
+            pool->Release(buffer);
+            pool->GetStatistics(outstanding, allocated, hugePageBuffers, dmaLockedBuffers);
+            Assert::AreEqual(1u, outstanding);
+
+            pool->Release(other);
+            pool->Close();
+        }
+
+        TEST_METHOD(TestNumaPlacement)
+        {
+            // Every machine has a node 0, though the OS may still refuse to place memory on it
+            VideoBufferPool* pool = VideoBufferPool::Create(TEST_BUFFER_SIZE, 2, 2, false, 0);
+
+            uint8_t* buffer = pool->Acquire();
+            Assert::IsTrue(buffer != nullptr);
+            Assert::AreEqual(static_cast<uintptr_t>(0), reinterpret_cast<uintptr_t>(buffer) % VideoBufferPool::BUFFER_ALIGNMENT);
+            memset(buffer, 0x50, TEST_BUFFER_SIZE);
+
+            const int32_t node = pool->GetNumaNode();
+            Assert::IsTrue(node == 0 || node == VideoBufferPool::ANY_NUMA_NODE);
+
+            pool->Release(buffer);
+            pool->Close();
+
+            // A node that doesn't exist falls back to ordinary allocation, and says so
+            pool = VideoBufferPool::Create(TEST_BUFFER_SIZE, 2, 2, false, 1000);
+
+            buffer = pool->Acquire();
+            Assert::IsTrue(buffer != nullptr);
+            memset(buffer, 0x60, TEST_BUFFER_SIZE);
+            Assert::AreEqual(static_cast<int32_t>(VideoBufferPool::ANY_NUMA_NODE), pool->GetNumaNode());
+
+            pool->Release(buffer);
+            pool->Close();
+        }
+    };
+}